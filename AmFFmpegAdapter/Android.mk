@@ -6,6 +6,7 @@ LOCAL_SRC_FILES:= \
     utils/AmFFmpegByteIOAdapter.cpp \
     utils/AmFFmpegUtils.cpp \
     utils/AmPTSPopulator.cpp \
+    utils/AmSampleConvert.cpp \
     extractor/AmFFmpegExtractor.cpp \
     extractor/AmSimpleMediaExtractorPlugin.cpp \
     codec/AmFFmpegCodec.cpp \
@@ -52,3 +53,24 @@ LOCAL_PRELINK_MODULE := false
 LOCAL_MODULE:= libamffmpegadapter
 
 include $(BUILD_SHARED_LIBRARY)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    utils/AmSampleConvertBench.cpp
+
+LOCAL_C_INCLUDES:= \
+    $(LOCAL_PATH)/include
+
+LOCAL_SHARED_LIBRARIES := \
+    libamffmpegadapter \
+    liblog \
+    libutils
+
+LOCAL_MODULE_TAGS := debug
+
+LOCAL_MODULE:= amsampleconvertbench
+
+include $(BUILD_EXECUTABLE)
@@ -23,6 +23,7 @@
 
 #include "codec/AmAudioCodec.h"
 #include "AmFFmpegUtils.h"
+#include "AmSampleConvert.h"
 
 #include <media/stagefright/foundation/ADebug.h>
 
@@ -128,7 +129,6 @@ int32_t AmAudioCodec::audio_decode_frame(AUDIO_FRAME_WRAPPER_T * data, int * got
     int32_t ret = avcodec_decode_audio4(mctx, mFrame, got_frame, &pkt);
     Trace("used data: %d, no used data:%d", ret, avpkt->size - ret);
     data->datasize = 0;
-    memset(data->data, 0, 8192);
     if(ret < 0){
         return ret;
     }
@@ -145,30 +145,41 @@ int32_t AmAudioCodec::audio_decode_frame(AUDIO_FRAME_WRAPPER_T * data, int * got
 
           data->samplerate = mFrame->sample_rate;
           data->channels = channels;
-          data->bytes = samplesize;
-          if(mFrame->format == AV_SAMPLE_FMT_FLTP){
-            int i,ch;
-            float * in = (float *)mFrame->data[0];
-            short * out = (short *)data->data;
-            for (int i = 0; i < mFrame->nb_samples; i++)
-            {    
-                for (ch = 0; ch < channels; ch++)
-                {
-                    float* extended_data = (float*)mFrame->extended_data[ch];
-                    float sample = extended_data[i];
-                    if (sample < -1.0f) 
-                        sample = -1.0f;
-                    else if (sample > 1.0f) 
-                        sample = 1.0f;
-                    out[i * channels + ch] = (short)round(sample * 32767.0f);
-                }
-            }
-
-            data->datasize = data_size/2;
+
+          // Float output is converted to S16, planar output interleaved.
+          int format = mFrame->format;
+          int outSampleSize = samplesize;
+          if (format == AV_SAMPLE_FMT_FLTP || format == AV_SAMPLE_FMT_FLT) {
+              outSampleSize = 2;
+          }
+          data->bytes = outSampleSize;
+          size_t numSamples = mFrame->nb_samples;
+          if (numSamples * channels * outSampleSize > sizeof(data->data)) {
+              ALOGE("%zu samples on %d channels do not fit the output buffer",
+                      numSamples, channels);
+              *got_frame = 0;
+              return AVERROR(EINVAL);
+          }
+
+          if (format == AV_SAMPLE_FMT_FLTP) {
+            AmConvertFltpToS16((const float *const *)mFrame->extended_data,
+                    (int16_t *)data->data, numSamples, channels);
+            data->datasize = numSamples * channels * outSampleSize;
             Trace("decoder output: channel = %d,sample_rate = %d\n", channels, mFrame->sample_rate);
             Trace("decoder output: sample_size = %d\n",samplesize);
             Trace("output pcm data size: %d\n", data_size);
-
+          } else if (format == AV_SAMPLE_FMT_FLT) {
+            AmConvertFltToS16((const float *)mFrame->data[0],
+                    (int16_t *)data->data, numSamples * channels);
+            data->datasize = numSamples * channels * outSampleSize;
+          } else if (format == AV_SAMPLE_FMT_S16P) {
+            AmInterleaveS16((const int16_t *const *)mFrame->extended_data,
+                    (int16_t *)data->data, numSamples, channels);
+            data->datasize = numSamples * channels * outSampleSize;
+          } else if (format == AV_SAMPLE_FMT_S32P) {
+            AmInterleaveS32((const int32_t *const *)mFrame->extended_data,
+                    (int32_t *)data->data, numSamples, channels);
+            data->datasize = numSamples * channels * outSampleSize;
           } else{
             Trace("output pcm data size: %d\n", data_size);
             memcpy((char *)data->data, mFrame->data[0], data_size);
@@ -29,13 +29,13 @@ extern "C" {
 
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/MediaBuffer.h>
-#include <media/stagefright/MediaBufferGroup.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/AmMediaDefsExt.h>
 #include <media/stagefright/AmMetaDataExt.h>
@@ -50,8 +50,171 @@ namespace android {
 
 static const uint32_t kInvalidSourceIdx = 0xFFFFFFFF;
 
-static const size_t kDefaultFrameBufferSize = 512 * 1024;
+// Frame buffers come in powers of two between these sizes. Up to
+// kMaxPooledFrameBytes of returned ones are kept for reuse.
+static const size_t kMinFrameBufferSize = 4 * 1024;
 static const size_t kMaxFrameBufferSize = 8 * 1024 * 1024;
+static const size_t kNumFrameBufferSizes = 12;
+static const size_t kMaxPooledFrameBytes = 16 * 1024 * 1024;
+
+// Packets of a track that is read slower than the others pile up while
+// those are read. Once a started track has this much queued, non-blocking
+// reads of the other tracks return WOULD_BLOCK until it drains. Blocking
+// reads keep demuxing past the limit, MediaSource clients take any other
+// status than OK for an error.
+static const size_t kMaxQueuedBytes = 16 * 1024 * 1024;
+static const int64_t kMaxQueuedDurationUs = 20000000ll;
+
+// Demuxing held up by a full queue is logged at most this often.
+static const int64_t kQueueFullLogIntervalUs = 1000000ll;
+
+// Packets demuxed per AmFFmpegExtractor::feedMore() call.
+static const size_t kMaxPacketsPerFeed = 8;
+
+static const size_t kMaxPooledPackets = 64;
+
+// Recycles the AVPacket structs handed from the extractor to its sources.
+// The payload is still owned by FFmpeg and freed on release().
+struct AmFFmpegPacketPool : public RefBase {
+    AmFFmpegPacketPool() {}
+
+    AVPacket *acquire() {
+        Mutex::Autolock autoLock(mLock);
+        if (mPackets.isEmpty()) {
+            AVPacket *packet = new AVPacket();
+            av_init_packet(packet);
+            return packet;
+        }
+        AVPacket *packet = mPackets.top();
+        mPackets.pop();
+        return packet;
+    }
+
+    void release(AVPacket *packet) {
+        av_free_packet(packet);
+
+        Mutex::Autolock autoLock(mLock);
+        if (mPackets.size() < kMaxPooledPackets) {
+            mPackets.push(packet);
+        } else {
+            delete packet;
+        }
+    }
+
+protected:
+    virtual ~AmFFmpegPacketPool() {
+        for (size_t i = 0; i < mPackets.size(); ++i) {
+            delete mPackets[i];
+        }
+    }
+
+private:
+    Mutex mLock;
+    Vector<AVPacket *> mPackets;
+
+    DISALLOW_EVIL_CONSTRUCTORS(AmFFmpegPacketPool);
+};
+
+// Hands out the frame buffers of an AmFFmpegSource. Unlike a
+// MediaBufferGroup, acquire() never waits for a buffer to come back, so
+// readers may hold on to them for as long as they like. After shutdown()
+// buffers are freed as they come back, and the pool deletes itself with
+// the last one, possibly long after its source is gone.
+struct AmFrameBufferPool : public MediaBufferObserver {
+    AmFrameBufferPool()
+        : mPooledBytes(0),
+          mNumOutstanding(0),
+          mShutdown(false) {
+    }
+
+    // Returns a buffer of at least "size" bytes, with a reference held.
+    MediaBuffer *acquire(size_t size) {
+        CHECK_LE(size, kMaxFrameBufferSize);
+        size_t index = getSizeIndex(size);
+
+        MediaBuffer *buffer = NULL;
+        {
+            Mutex::Autolock autoLock(mLock);
+            CHECK(!mShutdown);
+            if (!mFreeBuffers[index].isEmpty()) {
+                buffer = mFreeBuffers[index].top();
+                mFreeBuffers[index].pop();
+                mPooledBytes -= buffer->size();
+            }
+            ++mNumOutstanding;
+        }
+
+        if (buffer == NULL) {
+            buffer = new MediaBuffer(kMinFrameBufferSize << index);
+            buffer->setObserver(this);
+        }
+        buffer->reset();
+        buffer->add_ref();
+        return buffer;
+    }
+
+    void shutdown() {
+        bool done;
+        {
+            Mutex::Autolock autoLock(mLock);
+            mShutdown = true;
+            for (size_t i = 0; i < kNumFrameBufferSizes; ++i) {
+                for (size_t j = 0; j < mFreeBuffers[i].size(); ++j) {
+                    freeBuffer(mFreeBuffers[i][j]);
+                }
+                mFreeBuffers[i].clear();
+            }
+            mPooledBytes = 0;
+            done = (mNumOutstanding == 0);
+        }
+        if (done) {
+            delete this;
+        }
+    }
+
+    virtual void signalBufferReturned(MediaBuffer *buffer) {
+        bool done;
+        {
+            Mutex::Autolock autoLock(mLock);
+            --mNumOutstanding;
+            if (!mShutdown
+                    && mPooledBytes + buffer->size() <= kMaxPooledFrameBytes) {
+                mFreeBuffers[getSizeIndex(buffer->size())].push(buffer);
+                mPooledBytes += buffer->size();
+            } else {
+                freeBuffer(buffer);
+            }
+            done = mShutdown && mNumOutstanding == 0;
+        }
+        if (done) {
+            delete this;
+        }
+    }
+
+private:
+    Mutex mLock;
+    Vector<MediaBuffer *> mFreeBuffers[kNumFrameBufferSizes];
+    size_t mPooledBytes;
+    size_t mNumOutstanding;
+    bool mShutdown;
+
+    virtual ~AmFrameBufferPool() {}
+
+    static size_t getSizeIndex(size_t size) {
+        size_t index = 0;
+        while ((kMinFrameBufferSize << index) < size) {
+            ++index;
+        }
+        return index;
+    }
+
+    static void freeBuffer(MediaBuffer *buffer) {
+        buffer->setObserver(NULL);
+        buffer->release();
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(AmFrameBufferPool);
+};
 
 struct AmFFmpegSource : public MediaSource {
     AmFFmpegSource(
@@ -59,6 +222,7 @@ struct AmFFmpegSource : public MediaSource {
             AVStream *stream,
             AVInputFormat *inputFormat,
             sp<AmPTSPopulator> &ptsPopulator,
+            sp<AmFFmpegPacketPool> &packetPool,
             bool seekable,
             int64_t startTimeUs);
 
@@ -69,8 +233,10 @@ struct AmFFmpegSource : public MediaSource {
     virtual status_t read(
             MediaBuffer **buffer, const ReadOptions *options = NULL);
 
-    // Callee retains the ownership of the packet.
-    status_t queuePacket(AVPacket *packet);
+    // Callee retains the ownership of the packet. Packets of a source that
+    // is not started are dropped. Returns false once the queue is full.
+    bool queuePacket(AVPacket *packet);
+    bool isQueueFull();
     status_t clearPendingPackets();
 
 private:
@@ -78,15 +244,19 @@ private:
     sp<MetaData> mMeta;
     sp<StreamFormatter> mFormatter;
     sp<AmPTSPopulator> mPTSPopulator;
+    sp<AmFFmpegPacketPool> mPacketPool;
     AVStream *mStream;
 
     Mutex mPacketQueueLock;
     List<AVPacket *> mPacketQueue;
+    size_t mQueuedBytes;
 
     bool mStarted;
     bool mFirstPacket;
     bool mStartRead;
-    MediaBufferGroup *mGroup;
+    // Created in start(), shut down in stop(). It frees itself once the
+    // reader has released the last of its buffers.
+    AmFrameBufferPool *mBufferPool;
 
     int64_t mStartTimeUs;
 
@@ -105,11 +275,13 @@ private:
 
     virtual ~AmFFmpegSource();
     AVPacket *dequeuePacket();
+    void popPacket_l();
+    int64_t getQueuedDurationUs_l();
+    bool isQueueFull_l();
     status_t init(
             AVStream *stream, AVInputFormat *inputFormat,
             AmFFmpegExtractor *extractor);
     int64_t convertStreamTimeToUs(int64_t timeInStreamTime);
-    void resetBufferGroup(size_t size);
 
     DISALLOW_EVIL_CONSTRUCTORS(AmFFmpegSource);
 };
@@ -119,14 +291,17 @@ AmFFmpegSource::AmFFmpegSource(
         AVStream *stream,
         AVInputFormat *inputFormat,
         sp<AmPTSPopulator> &ptsPopulator,
+        sp<AmFFmpegPacketPool> &packetPool,
         bool seekable,
         int64_t startTimeUs)
     : mExtractor(extractor),
       mPTSPopulator(ptsPopulator),
+      mPacketPool(packetPool),
+      mQueuedBytes(0),
       mStarted(false),
       mFirstPacket(true),
       mStartRead(false),
-      mGroup(NULL),
+      mBufferPool(NULL),
       mStream(stream),
       mMime(NULL),
       mStartTimeUs(startTimeUs),
@@ -278,14 +453,18 @@ status_t AmFFmpegSource::init(
 
     mFormatter = StreamFormatter::Create(stream->codec, inputFormat);
     mFormatter->addCodecMeta(mMeta);
+
+    // read() never waits for frame buffers, see AmFrameBufferPool.
+    mMeta->setInt32(kKeyAmHoldableBuffers, 1);
     return OK;
 }
 
 status_t AmFFmpegSource::start(MetaData *params) {
     CHECK(!mStarted);
 
-    resetBufferGroup(kDefaultFrameBufferSize);
+    mBufferPool = new AmFrameBufferPool;
 
+    Mutex::Autolock autoLock(mPacketQueueLock);
     mStarted = true;
 
     return OK;
@@ -294,9 +473,14 @@ status_t AmFFmpegSource::start(MetaData *params) {
 status_t AmFFmpegSource::stop() {
     CHECK(mStarted);
 
-    delete mGroup;
-    mGroup = NULL;
-    mStarted = false;
+    mBufferPool->shutdown();
+    mBufferPool = NULL;
+
+    {
+        Mutex::Autolock autoLock(mPacketQueueLock);
+        mStarted = false;
+    }
+    clearPendingPackets();
 
     return OK;
 }
@@ -317,6 +501,8 @@ status_t AmFFmpegSource::read(
         return UNKNOWN_ERROR;
     }
 
+    const bool nonBlocking = options != NULL && options->getNonBlocking();
+
     int64_t seekTimeUs;
     ReadOptions::SeekMode seekMode;
     AVPacket *packet = NULL;
@@ -326,16 +512,22 @@ status_t AmFFmpegSource::read(
 	    && mStream->codec->extradata_size == 0) {
 	     packet = dequeuePacket();
             while (packet == NULL) {
-                if (ERROR_END_OF_STREAM == extractor->feedMore()) {
+                status_t err = extractor->feedMore(nonBlocking);
+                if (err == ERROR_END_OF_STREAM) {
                     return ERROR_END_OF_STREAM;
+                } else if (err != OK) {
+                    // Held up by another track, the seek empties its queue.
+                    break;
                 }
                 packet = dequeuePacket();
             }
-	     int32_t cast_size = castHEVCSpecificData(packet->data, packet->size);
-	     if(cast_size > 0) {
-                av_shrink_packet(packet, cast_size);
+            if (packet != NULL) {
+                int32_t cast_size = castHEVCSpecificData(packet->data, packet->size);
+                if(cast_size > 0) {
+                    av_shrink_packet(packet, cast_size);
+                }
+                ALOGI("Need send hevc specific data first, size : %d", packet->size);
             }
-            ALOGI("Need send hevc specific data first, size : %d", packet->size);
 	 }
 
         extractor->seekTo(seekTimeUs + mStartTimeUs, seekMode);
@@ -346,47 +538,49 @@ status_t AmFFmpegSource::read(
     if(packet == NULL) {
         packet = dequeuePacket();
         while (packet == NULL) {
-            if (ERROR_END_OF_STREAM == extractor->feedMore()) {
-                return ERROR_END_OF_STREAM;
+            // WOULD_BLOCK while another started track is not being read,
+            // only if the caller asked for a non-blocking read.
+            status_t err = extractor->feedMore(nonBlocking);
+            if (err != OK) {
+                return err;
             }
             packet = dequeuePacket();
         }
     }
 
-    MediaBuffer *buffer = NULL;
-    status_t ret = mGroup->acquire_buffer(&buffer);
-    if (ret != OK) {
-        return ret;
+    // Length prefixed NALs are turned into start codes right in the packet,
+    // which then only needs a plain copy. That is not possible if FFmpeg
+    // shares the packet data with someone else.
+    const bool inPlace = mFormatter->canFormatInPlace()
+            && (packet->buf == NULL || av_buffer_is_writable(packet->buf));
+    int32_t formattedLength = 0;
+    uint32_t requiredLen;
+    if (inPlace) {
+        formattedLength =
+                mFormatter->formatESInPlace(packet->data, packet->size);
+        if (formattedLength < 0) {
+            ALOGE("Failed to format packet data.");
+            mPacketPool->release(packet);
+            return ERROR_MALFORMED;
+        }
+        requiredLen = formattedLength;
+    } else {
+        requiredLen = mFormatter->computeNewESLen(packet->data, packet->size);
     }
 
-    uint32_t requiredLen =
-            mFormatter->computeNewESLen(packet->data, packet->size);
-
     int32_t hevc_header_size = 0;
     if(mFirstPacket && !strcmp(mMime, MEDIA_MIMETYPE_VIDEO_HEVC) && mStream->codec->extradata_size > 0) {
         hevc_header_size = 10 + mStream->codec->extradata_size;
         requiredLen += hevc_header_size;
     }
-    if (buffer->size() < requiredLen) {
-        size_t newSize = buffer->size();
-        while (newSize < requiredLen) {
-            newSize = 2 * newSize;
-            if (newSize > kMaxFrameBufferSize) {
-                break;
-            }
-        }
-        buffer->release();
-        buffer = NULL;
-        if (newSize > kMaxFrameBufferSize) {
-            return ERROR_BUFFER_TOO_SMALL;
-        }
-        resetBufferGroup(newSize);
-        status_t ret = mGroup->acquire_buffer(&buffer);
-        if (ret != OK) {
-            return ret;
-        }
+    if (requiredLen > kMaxFrameBufferSize) {
+        ALOGE("Frame of %u bytes is too large.", requiredLen);
+        mPacketPool->release(packet);
+        return ERROR_BUFFER_TOO_SMALL;
     }
 
+    MediaBuffer *buffer = mBufferPool->acquire(requiredLen);
+
     int32_t filledLength = 0;
     if(mFirstPacket && !strcmp(mMime, MEDIA_MIMETYPE_VIDEO_HEVC) && hevc_header_size > 0) {
         const char * tag = "extradata";
@@ -397,6 +591,9 @@ status_t AmFFmpegSource::read(
             packet->data, packet->size,
             static_cast<uint8_t *>(buffer->data()) + hevc_header_size, buffer->size());
 	 filledLength += hevc_header_size;
+    } else if (inPlace) {
+        memcpy(buffer->data(), packet->data, formattedLength);
+        filledLength = formattedLength;
     } else {
         filledLength = mFormatter->formatES(
                 packet->data, packet->size,
@@ -442,8 +639,7 @@ status_t AmFFmpegSource::read(
     buffer->meta_data()->setInt64(kKeyTime, normalizedPTSInUs);
     buffer->meta_data()->setInt32(kKeyIsSyncFrame, isKeyFrame ? 1 : 0);
     *out = buffer;
-    av_free_packet(packet);
-    delete packet;
+    mPacketPool->release(packet);
     return OK;
 }
 
@@ -451,18 +647,23 @@ int64_t AmFFmpegSource::convertStreamTimeToUs(int64_t timeInStreamTime) {
     return timeInStreamTime * mTimeBase * mNumerator / mDenominator;
 }
 
-void AmFFmpegSource::resetBufferGroup(size_t size) {
-    if (mGroup != NULL) {
-        delete mGroup;
+bool AmFFmpegSource::queuePacket(AVPacket *packet) {
+    Mutex::Autolock autoLock(mPacketQueueLock);
+    if (!mStarted) {
+        // Nobody reads the track. Starting it again is followed by a seek.
+        mPacketPool->release(packet);
+        return true;
     }
-    mGroup = new MediaBufferGroup();
-    mGroup->add_buffer(new MediaBuffer(size));
+
+    mPacketQueue.push_back(packet);
+    mQueuedBytes += packet->size;
+
+    return !isQueueFull_l();
 }
 
-status_t AmFFmpegSource::queuePacket(AVPacket *packet) {
+bool AmFFmpegSource::isQueueFull() {
     Mutex::Autolock autoLock(mPacketQueueLock);
-    mPacketQueue.push_back(packet);
-    return OK;
+    return isQueueFull_l();
 }
 
 AVPacket *AmFFmpegSource::dequeuePacket() {
@@ -470,21 +671,48 @@ AVPacket *AmFFmpegSource::dequeuePacket() {
     if (!mPacketQueue.empty()) {
         AVPacket *packet = *mPacketQueue.begin();
         mPacketQueue.erase(mPacketQueue.begin());
+        mQueuedBytes -= packet->size;
         return packet;
     }
     return NULL;
 }
 
+void AmFFmpegSource::popPacket_l() {
+    AVPacket *packet = *mPacketQueue.begin();
+    mPacketQueue.erase(mPacketQueue.begin());
+    mQueuedBytes -= packet->size;
+    mPacketPool->release(packet);
+}
+
+int64_t AmFFmpegSource::getQueuedDurationUs_l() {
+    if (mPacketQueue.empty()) {
+        return 0;
+    }
+
+    const AVPacket *first = *mPacketQueue.begin();
+    const AVPacket *last = *(--mPacketQueue.end());
+    int64_t firstTime = (first->dts != static_cast<int64_t>(AV_NOPTS_VALUE))
+            ? first->dts : first->pts;
+    int64_t lastTime = (last->dts != static_cast<int64_t>(AV_NOPTS_VALUE))
+            ? last->dts : last->pts;
+    if (firstTime == static_cast<int64_t>(AV_NOPTS_VALUE)
+            || lastTime == static_cast<int64_t>(AV_NOPTS_VALUE)
+            || lastTime < firstTime) {
+        return 0;
+    }
+    return convertStreamTimeToUs(lastTime - firstTime);
+}
+
+bool AmFFmpegSource::isQueueFull_l() {
+    return mQueuedBytes >= kMaxQueuedBytes
+            || getQueuedDurationUs_l() >= kMaxQueuedDurationUs;
+}
+
 status_t AmFFmpegSource::clearPendingPackets() {
     Mutex::Autolock autoLock(mPacketQueueLock);
-    List<AVPacket *>::iterator it = mPacketQueue.begin();
-    while (it != mPacketQueue.end()) {
-        AVPacket *packet = *it;
-        av_free_packet(packet);
-        delete packet;
-        ++it;
+    while (!mPacketQueue.empty()) {
+        popPacket_l();
     }
-    mPacketQueue.clear();
     return OK;
 }
 
@@ -494,7 +722,9 @@ AmFFmpegExtractor::AmFFmpegExtractor(const sp<DataSource> &source)
     : mDataSource(source),
       mInputFormat(NULL),
       mPTSPopulator(NULL),
-      mFFmpegContext(NULL) {
+      mPacketPool(new AmFFmpegPacketPool),
+      mFFmpegContext(NULL),
+      mLastQueueFullLogUs(-1ll) {
     init();
 }
 
@@ -502,6 +732,7 @@ AmFFmpegExtractor::~AmFFmpegExtractor() {
     if (NULL != mFFmpegContext) {
         avformat_close_input(&mFFmpegContext);
     }
+    logIOStats("in total");
 }
 
 size_t AmFFmpegExtractor::countTracks() {
@@ -554,6 +785,8 @@ void AmFFmpegExtractor::init() {
         ALOGE("Failed to open FFmpeg context.");
         return;
     }
+    // What probing and index parsing cost, before any packet is read.
+    logIOStats("to open");
 
     mPTSPopulator = new AmPTSPopulator(mFFmpegContext->nb_streams);
 
@@ -589,7 +822,8 @@ void AmFFmpegExtractor::init() {
             }
             mSources.editTop().mSource =
                     new AmFFmpegSource(this, mFFmpegContext->streams[i],
-                            mInputFormat, mPTSPopulator, seekable, startTimeUs);
+                            mInputFormat, mPTSPopulator, mPacketPool,
+                            seekable, startTimeUs);
             mStreamIdxToSourceIdx.add(mSources.size() - 1);
             if (codec->codec_type == AVMEDIA_TYPE_AUDIO) {
                 audioAdded = true;
@@ -602,32 +836,59 @@ void AmFFmpegExtractor::init() {
     }
 }
 
-status_t AmFFmpegExtractor::feedMore() {
+status_t AmFFmpegExtractor::feedMore(bool nonBlocking) {
     Mutex::Autolock autoLock(mLock);
-    status_t ret = OK;
-    AVPacket *packet = new AVPacket();
-    while (true) {
-        int res = av_read_frame(mFFmpegContext, packet);
-        if (res >= 0) {
-            uint32_t sourceIdx = kInvalidSourceIdx;
-            if (static_cast<size_t>(packet->stream_index) < mStreamIdxToSourceIdx.size()) {
-                sourceIdx = mStreamIdxToSourceIdx[packet->stream_index];
+    // Demuxing more would only grow a queue whose reader is behind. Its
+    // packets are not dropped; a non-blocking reader is told to let that
+    // track catch up first, a blocking one has to be served regardless.
+    for (size_t i = 0; i < mSources.size(); ++i) {
+        if (mSources[i].mIsActive && mSources[i].mSource->isQueueFull()) {
+            int64_t nowUs = ALooper::GetNowUs();
+            if (mLastQueueFullLogUs < 0
+                    || nowUs - mLastQueueFullLogUs >= kQueueFullLogIntervalUs) {
+                ALOGW("Packet queue of track %zu is full, %s.", i,
+                      nonBlocking ? "waiting for it to be read" : "demuxing past it");
+                mLastQueueFullLogUs = nowUs;
             }
-            if (sourceIdx == kInvalidSourceIdx
-                    || !mSources[sourceIdx].mIsActive || packet->size <= 0 || packet->pts < 0) {
-                av_free_packet(packet);
-                continue;
+            if (nonBlocking) {
+                return WOULD_BLOCK;
+            }
+            break;
+        }
+    }
+
+    // Demux a few packets at a time, the readers of all tracks contend for
+    // mLock. Stop early when a queue fills up.
+    size_t numPackets = 0;
+    while (numPackets < kMaxPacketsPerFeed) {
+        AVPacket *packet = mPacketPool->acquire();
+        int res = av_read_frame(mFFmpegContext, packet);
+        if (res < 0) {
+            mPacketPool->release(packet);
+            if (numPackets > 0) {
+                // Reported on the next call.
+                break;
             }
-            av_dup_packet(packet);
-            mSources[sourceIdx].mSource->queuePacket(packet);
-        } else {
-            delete packet;
             ALOGV("No more packets from ffmpeg.");
-            ret = ERROR_END_OF_STREAM;
+            return ERROR_END_OF_STREAM;
+        }
+
+        uint32_t sourceIdx = kInvalidSourceIdx;
+        if (static_cast<size_t>(packet->stream_index) < mStreamIdxToSourceIdx.size()) {
+            sourceIdx = mStreamIdxToSourceIdx[packet->stream_index];
+        }
+        if (sourceIdx == kInvalidSourceIdx
+                || !mSources[sourceIdx].mIsActive || packet->size <= 0 || packet->pts < 0) {
+            mPacketPool->release(packet);
+            continue;
+        }
+        av_dup_packet(packet);
+        ++numPackets;
+        if (!mSources[sourceIdx].mSource->queuePacket(packet)) {
+            break;
         }
-        break;
     }
-    return ret;
+    return OK;
 }
 
 void AmFFmpegExtractor::seekTo(
@@ -667,6 +928,20 @@ void AmFFmpegExtractor::seekTo(
     ALOGV("Seeking to %lld was successful.", seekPosition);
 }
 
+void AmFFmpegExtractor::logIOStats(const char *when) {
+    if (mSourceAdapter == NULL || mSourceAdapter->getContext() == NULL) {
+        return;
+    }
+
+    AmFFmpegByteIOAdapter::Stats stats;
+    mSourceAdapter->getStats(&stats);
+    ALOGI("I/O %s: read %lld bytes in %u reads, served %lld bytes, "
+          "%u seeks, cache hits %u, misses %u, bypasses %u",
+          when, (long long)stats.mBytesRead, stats.mNumReads,
+          (long long)stats.mBytesServed, stats.mNumSeeks,
+          stats.mCacheHits, stats.mCacheMisses, stats.mCacheBypasses);
+}
+
 int32_t AmFFmpegExtractor::getPrimaryStreamIndex(AVFormatContext *context) {
     int firstAudioIndex = -1;
 
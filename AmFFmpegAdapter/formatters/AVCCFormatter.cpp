@@ -168,4 +168,48 @@ int32_t AVCCFormatter::formatES(
     return dstOffset;
 }
 
+bool AVCCFormatter::canFormatInPlace() const {
+    // Shorter length fields would have to grow into 4 byte start codes.
+    return mAVCCFound && mNALLengthSize == 4;
+}
+
+int32_t AVCCFormatter::formatESInPlace(uint8_t* data, uint32_t size) const {
+    CHECK(canFormatInPlace());
+
+    size_t srcOffset = 0;
+    size_t dstOffset = 0;
+    const size_t packetSize = static_cast<size_t>(size);
+
+    while (srcOffset < packetSize) {
+        if (srcOffset + 4 > packetSize) {
+            ALOGE("Truncated NAL length at %u of %u.", srcOffset, packetSize);
+            return -1;
+        }
+        size_t nalLength = U32_AT(&data[srcOffset]);
+        srcOffset += 4;
+
+        if (nalLength > packetSize - srcOffset) {
+            ALOGE("Invalid nalLength (%u) or packet size(%u).",
+                    nalLength, packetSize);
+            return -1;
+        }
+
+        if (nalLength == 0) {
+            continue;
+        }
+
+        // The output only falls behind the input after empty NAL units.
+        if (dstOffset + 4 < srcOffset) {
+            memmove(&data[dstOffset + 4], &data[srcOffset], nalLength);
+        }
+
+        static const uint8_t kNALStartCode[4] =  { 0x00, 0x00, 0x00, 0x01 };
+        memcpy(&data[dstOffset], kNALStartCode, 4);
+
+        srcOffset += nalLength;
+        dstOffset += 4 + nalLength;
+    }
+    return dstOffset;
+}
+
 }  // namespace android
@@ -35,6 +35,10 @@ public:
             const uint8_t* in, uint32_t inAllocLen, uint8_t* out,
             uint32_t outAllocLen) const;
 
+    virtual bool canFormatInPlace() const;
+
+    virtual int32_t formatESInPlace(uint8_t* data, uint32_t size) const;
+
 private:
     bool parseCodecExtraData(AVCodecContext* codec);
     size_t parseNALSize(const uint8_t *data) const ;
@@ -57,6 +57,17 @@ class StreamFormatter : public RefBase{
     virtual int32_t formatES(
             const uint8_t* in, uint32_t inAllocLen, uint8_t* out,
             uint32_t outAllocLen) const = 0;
+
+    // Returns true if formatESInPlace() can be used for this stream, i.e.
+    // the formatted elementary stream is never longer than the input.
+    virtual bool canFormatInPlace() const { return false; }
+
+    // Same as formatES() but rewrites "data" in a single pass instead of
+    // copying it out. Returns the number of bytes used if successful and
+    // returns -1 otherwise, in which case "data" may be partly rewritten.
+    virtual int32_t formatESInPlace(uint8_t* data, uint32_t size) const {
+        return -1;
+    }
 };
 
 }  // namespace android
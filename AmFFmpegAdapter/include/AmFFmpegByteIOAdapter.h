@@ -24,20 +24,53 @@ extern "C" {
 }
 
 #include <utils/RefBase.h>
+#include <utils/Vector.h>
 
 namespace android {
 
 class DataSource;
 
+// Reads for libavformat go through a small cache of aligned blocks, with
+// the least recently used one being replaced. Probing and index parsing
+// seek back and forth over the same few areas of the file, which then no
+// longer cost a DataSource::readAt() each. Reads of a block or more that
+// miss the cache go straight to the DataSource.
 class AmFFmpegByteIOAdapter : public RefBase {
 public:
+    enum {
+        kDefaultNumCacheBlocks = 8,
+        kDefaultCacheBlockSize = 64 * 1024,
+    };
+
+    struct Stats {
+        int64_t mBytesRead;     // from the DataSource
+        int64_t mBytesServed;   // to libavformat
+        uint32_t mNumReads;     // DataSource::readAt() calls
+        uint32_t mNumSeeks;
+        uint32_t mCacheHits;
+        uint32_t mCacheMisses;
+        uint32_t mCacheBypasses;  // large reads straight from the DataSource
+    };
+
     AmFFmpegByteIOAdapter();
     ~AmFFmpegByteIOAdapter();
 
-    bool init(sp<DataSource> src);
+    // "numCacheBlocks" 0 disables the cache.
+    bool init(sp<DataSource> src,
+            size_t numCacheBlocks = kDefaultNumCacheBlocks,
+            size_t cacheBlockSize = kDefaultCacheBlockSize);
     AVIOContext* getContext() { return mInitCheck ? mContext : NULL; }
 
+    void getStats(Stats *stats) const;
+
 private:
+    struct CacheBlock {
+        int64_t mOffset;
+        size_t mLength;
+        uint32_t mLastUse;
+        uint8_t *mData;
+    };
+
     bool mInitCheck;
     AVIOContext* mContext;
     sp<DataSource> mSource;
@@ -45,9 +78,26 @@ private:
     int64_t mNextReadPos;
     int32_t mWakeupHandle;
 
+    // The size is only asked for until the DataSource knows it, and again
+    // once the end of the data was reached.
+    bool mSizeKnown;
+    int64_t mSize;
+
+    Vector<CacheBlock> mCacheBlocks;
+    size_t mCacheBlockSize;
+    uint32_t mUseCounter;
+
+    Stats mStats;
+
     int32_t read(uint8_t* buf, int amt);
     int64_t seek(int64_t offset, int whence);
 
+    bool getSize(int64_t *size);
+    void onEndOfData();
+    bool isCached(int64_t offset) const;
+    ssize_t readFromSource(int64_t offset, uint8_t *buf, size_t size);
+    status_t findCacheBlock(int64_t offset, size_t *index, bool *hit);
+
     // I/O callback functions which will be called from FFmpeg.
     static int32_t staticRead(void* thiz, uint8_t* buf, int amt);
     static int32_t staticWrite(void* thiz, uint8_t* buf, int amt);
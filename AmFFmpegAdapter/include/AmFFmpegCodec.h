@@ -34,8 +34,12 @@ typedef struct VIDEO_FRAME_WRAPPER {
     int32_t format;
 }VIDEO_FRAME_WRAPPER_T;
 
+// Large enough for one decoded frame of 2048 samples on 8 channels of 32
+// bit samples, 5.1 AC-3 alone needs 18 KB once converted to S16.
+#define AUDIO_FRAME_MAX_SIZE (8 * 2048 * 4)
+
 typedef struct AUDIO_FRAME_WRAPPER{
-    uint8_t data[8192];
+    uint8_t data[AUDIO_FRAME_MAX_SIZE];
     unsigned int datasize;
     int samplerate;
     int channels;
@@ -34,8 +34,16 @@ class AmPTSPopulator;
 struct AMessage;
 class DataSource;
 struct AmFFmpegSource;
+struct AmFFmpegPacketPool;
 class String8;
 
+enum {
+    // int32_t, set on track formats. Non-zero if read() never waits for
+    // earlier MediaBuffers to be released, so the reader may keep them
+    // for as long as it likes instead of copying their data out.
+    kKeyAmHoldableBuffers = 'amhb',
+};
+
 /*
  * A MediaExtractor implementation based on the FFmpeg library.
  *
@@ -75,18 +83,23 @@ private:
     AVInputFormat *mInputFormat;
     sp<AmFFmpegByteIOAdapter> mSourceAdapter;
     sp<AmPTSPopulator> mPTSPopulator;
+    sp<AmFFmpegPacketPool> mPacketPool;
 
     Mutex mLock;
     // Start of protected variables by mLock.
     Vector<SourceInfo> mSources;
     AVFormatContext *mFFmpegContext;
     Vector<uint32_t> mStreamIdxToSourceIdx;
+    int64_t mLastQueueFullLogUs;
     // End of protected variables by mLock.
 
     virtual ~AmFFmpegExtractor();
     void init();
-    status_t feedMore();
+    // Returns WOULD_BLOCK instead of demuxing if "nonBlocking" and the
+    // packet queue of a started track is full.
+    status_t feedMore(bool nonBlocking);
     int32_t getPrimaryStreamIndex(AVFormatContext *context);
+    void logIOStats(const char *when);
 
     DISALLOW_EVIL_CONSTRUCTORS(AmFFmpegExtractor);
 };
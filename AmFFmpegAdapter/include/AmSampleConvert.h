@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+#ifndef AM_SAMPLE_CONVERT_H_
+#define AM_SAMPLE_CONVERT_H_
+
+#include <sys/types.h>
+#include <stdint.h>
+
+namespace android {
+
+// Sample format conversions from FFmpeg decoder output to interleaved PCM.
+// NEON and SSE2 versions are used when built for them, the AVX2 one when
+// the CPU supports it, with a plain C loop as fallback. Float samples are
+// clamped to [-1, 1] and scaled by 32767 with round(), all versions give
+// the same result for any non-NaN input.
+
+// Interleaved float to interleaved S16, "count" samples in total.
+void AmConvertFltToS16(const float *in, int16_t *out, size_t count);
+
+// Planar float (AV_SAMPLE_FMT_FLTP) to interleaved S16.
+void AmConvertFltpToS16(
+        const float *const *in, int16_t *out,
+        size_t numSamples, size_t channels);
+
+// Planar to interleaved samples of the same format.
+void AmInterleaveS16(
+        const int16_t *const *in, int16_t *out,
+        size_t numSamples, size_t channels);
+void AmInterleaveS32(
+        const int32_t *const *in, int32_t *out,
+        size_t numSamples, size_t channels);
+
+}  // namespace android
+
+#endif  // AM_SAMPLE_CONVERT_H_
@@ -28,6 +28,7 @@ extern "C" {
 }
 
 #include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/foundation/ADebug.h>
 
 #include "AmFFmpegByteIOAdapter.h"
@@ -39,10 +40,18 @@ static uint32_t kAdapterBufferSize = 32768;
 AmFFmpegByteIOAdapter::AmFFmpegByteIOAdapter()
     : mInitCheck(false),
       mContext(NULL),
-      mNextReadPos(0) {
+      mNextReadPos(0),
+      mSizeKnown(false),
+      mSize(0),
+      mCacheBlockSize(0),
+      mUseCounter(0) {
+    memset(&mStats, 0, sizeof(mStats));
 }
 
 AmFFmpegByteIOAdapter::~AmFFmpegByteIOAdapter() {
+    for (size_t i = 0; i < mCacheBlocks.size(); ++i) {
+        delete[] mCacheBlocks[i].mData;
+    }
     if (mInitCheck && NULL != mContext->buffer) {
         // This may be the original buffer we allocated for init_put_byte or
         // ffmpeg may have freed it and replaced it with another one in the
@@ -53,7 +62,8 @@ AmFFmpegByteIOAdapter::~AmFFmpegByteIOAdapter() {
     av_free(mContext);
 }
 
-bool AmFFmpegByteIOAdapter::init(sp<DataSource> src) {
+bool AmFFmpegByteIOAdapter::init(
+        sp<DataSource> src, size_t numCacheBlocks, size_t cacheBlockSize) {
     // Make certain the parameters the called passed are reasonable.
     if (NULL == src.get()) {
         ALOGE("Input source should not be NULL.");
@@ -82,6 +92,18 @@ bool AmFFmpegByteIOAdapter::init(sp<DataSource> src) {
         if (mContext != NULL) {
             mSource = src;
             mInitCheck = true;
+
+            if (cacheBlockSize > 0) {
+                mCacheBlockSize = cacheBlockSize;
+                for (size_t i = 0; i < numCacheBlocks; ++i) {
+                    CacheBlock block;
+                    block.mOffset = -1;
+                    block.mLength = 0;
+                    block.mLastUse = 0;
+                    block.mData = new uint8_t[cacheBlockSize];
+                    mCacheBlocks.push(block);
+                }
+            }
         } else {
             ALOGE("Failed to initialize AVIOContext.");
         }
@@ -116,16 +138,179 @@ int AmFFmpegByteIOAdapter::read(uint8_t* buf, int amt) {
     }
 #endif
 
-    ssize_t result = 0;
-    uint64_t pos = mNextReadPos;
+    if (mCacheBlocks.isEmpty()) {
+        ssize_t result = readFromSource(mNextReadPos, buf, amt);
+        if (result > 0) {
+            mNextReadPos += result;
+            mStats.mBytesServed += result;
+        } else if (result == 0) {
+            onEndOfData();
+        }
+        return static_cast<int>(result);
+    }
+
+    size_t total = 0;
+    while (total < static_cast<size_t>(amt)) {
+        size_t remaining = amt - total;
+        if (remaining >= mCacheBlockSize && !isCached(mNextReadPos)) {
+            // Large sequential reads, such as whole video frames, would
+            // only be copied once more through the cache.
+            ssize_t result = readFromSource(mNextReadPos, buf + total, remaining);
+            ++mStats.mCacheBypasses;
+            if (result == 0) {
+                onEndOfData();
+            }
+            if (result <= 0) {
+                // Errors are only reported if nothing was read at all.
+                if (total == 0) {
+                    return static_cast<int>(result);
+                }
+                break;
+            }
+            total += result;
+            mNextReadPos += result;
+            if (static_cast<size_t>(result) < remaining) {
+                break;
+            }
+            continue;
+        }
+
+        size_t index;
+        bool hit;
+        status_t err = findCacheBlock(mNextReadPos, &index, &hit);
+        if (err != OK) {
+            if (err == ERROR_END_OF_STREAM) {
+                onEndOfData();
+            }
+            // Errors are only reported if nothing was read at all.
+            if (total == 0) {
+                return err == ERROR_END_OF_STREAM ? 0 : static_cast<int>(err);
+            }
+            break;
+        }
+
+        if (hit) {
+            ++mStats.mCacheHits;
+        } else {
+            ++mStats.mCacheMisses;
+        }
+
+        CacheBlock *block = &mCacheBlocks.editItemAt(index);
+        block->mLastUse = ++mUseCounter;
+
+        size_t offsetInBlock = mNextReadPos - block->mOffset;
+        size_t copy = block->mLength - offsetInBlock;
+        if (copy > amt - total) {
+            copy = amt - total;
+        }
+        memcpy(buf + total, block->mData + offsetInBlock, copy);
+        total += copy;
+        mNextReadPos += copy;
+
+        if (block->mLength < mCacheBlockSize) {
+            // Short block, the end of the data for now.
+            onEndOfData();
+            break;
+        }
+    }
+
+    mStats.mBytesServed += total;
+    return static_cast<int>(total);
+}
+
+// The end of the data was reached. A source that is still growing, like a
+// progressive download, knows a larger size by now, or none at all.
+void AmFFmpegByteIOAdapter::onEndOfData() {
+    mSizeKnown = false;
+}
+
+bool AmFFmpegByteIOAdapter::isCached(int64_t offset) const {
+    int64_t blockOffset = offset - offset % mCacheBlockSize;
+    for (size_t i = 0; i < mCacheBlocks.size(); ++i) {
+        const CacheBlock &block = mCacheBlocks[i];
+        if (block.mOffset == blockOffset) {
+            return offset < block.mOffset + (int64_t)block.mLength;
+        }
+    }
+    return false;
+}
+
+bool AmFFmpegByteIOAdapter::getSize(int64_t *size) {
+    if (!mSizeKnown) {
+        off64_t sourceSize;
+        if (OK != mSource->getSize(&sourceSize)) {
+            return false;
+        }
+        mSize = sourceSize;
+        mSizeKnown = true;
+    }
+    *size = mSize;
+    return true;
+}
 
-    ALOGV("readAt pos %lld amt %d", pos, amt);
-    result = mSource->readAt(pos, buf, amt);
+ssize_t AmFFmpegByteIOAdapter::readFromSource(
+        int64_t offset, uint8_t *buf, size_t size) {
+    ALOGV("readAt pos %lld amt %zu", (long long)offset, size);
+    ssize_t result = mSource->readAt(offset, buf, size);
+    ++mStats.mNumReads;
     if (result > 0) {
-        mNextReadPos += result;
+        mStats.mBytesRead += result;
+    }
+    return result;
+}
+
+// Finds the block holding "offset", or loads it into the least recently
+// used one. Returns ERROR_END_OF_STREAM if there is no data at "offset".
+status_t AmFFmpegByteIOAdapter::findCacheBlock(
+        int64_t offset, size_t *index, bool *hit) {
+    int64_t blockOffset = offset - offset % mCacheBlockSize;
+
+    size_t victim = 0;
+    bool found = false;
+    for (size_t i = 0; i < mCacheBlocks.size(); ++i) {
+        const CacheBlock &block = mCacheBlocks[i];
+        if (block.mOffset == blockOffset) {
+            victim = i;
+            found = true;
+            break;
+        }
+        if (block.mLastUse < mCacheBlocks[victim].mLastUse) {
+            victim = i;
+        }
+    }
+
+    *index = victim;
+
+    CacheBlock *block = &mCacheBlocks.editItemAt(victim);
+    if (found && offset < block->mOffset + (int64_t)block->mLength) {
+        *hit = true;
+        return OK;
+    }
+
+    *hit = false;
+
+    // A block found here ended short, see if there is more by now.
+    if (!found) {
+        block->mOffset = blockOffset;
+        block->mLength = 0;
+    }
+
+    while (block->mLength < mCacheBlockSize) {
+        ssize_t result = readFromSource(
+                blockOffset + block->mLength, block->mData + block->mLength,
+                mCacheBlockSize - block->mLength);
+        if (result < 0 && block->mLength == 0) {
+            block->mOffset = -1;
+            return static_cast<status_t>(result);
+        }
+        if (result <= 0) {
+            break;
+        }
+        block->mLength += result;
     }
 
-    return static_cast<int>(result);
+    return offset < blockOffset + (int64_t)block->mLength
+            ? OK : ERROR_END_OF_STREAM;
 }
 
 // Upon successful completion, returns the current position after seeking.
@@ -141,7 +326,7 @@ int64_t AmFFmpegByteIOAdapter::seek(int64_t offset, int whence) {
 
     int64_t target = -1;
     int64_t size = 0;
-    bool sizeSupported = (OK == mSource->getSize(&size));
+    bool sizeSupported = getSize(&size);
 
     switch(whence) {
     case SEEK_SET:
@@ -166,11 +351,18 @@ int64_t AmFFmpegByteIOAdapter::seek(int64_t offset, int whence) {
         return -1;
     }
 
+    if (target != mNextReadPos) {
+        ++mStats.mNumSeeks;
+    }
     mNextReadPos = target;
 
     return target;
 }
 
+void AmFFmpegByteIOAdapter::getStats(Stats *stats) const {
+    *stats = mStats;
+}
+
 int32_t AmFFmpegByteIOAdapter::staticRead(void* thiz, uint8_t* buf, int amt) {
     CHECK(thiz);
     return static_cast<AmFFmpegByteIOAdapter *>(thiz)->read(buf, amt);
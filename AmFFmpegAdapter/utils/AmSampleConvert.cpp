@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AmSampleConvert"
+#include <utils/Log.h>
+
+#include "AmSampleConvert.h"
+
+#include <math.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON) || defined(__aarch64__)
+#define AM_CONVERT_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define AM_CONVERT_SSE2 1
+#include <emmintrin.h>
+// The AVX2 loop is built for every x86 target and only used when the CPU
+// has it, see SelectFloatToS16().
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define AM_CONVERT_AVX2 1
+#include <immintrin.h>
+#include <pthread.h>
+#endif
+#endif
+
+namespace android {
+
+// Planar input is converted in blocks of this many samples per channel,
+// then interleaved from the stack.
+enum {
+    kBlockSamples = 256,
+    kBlockChannels = 8,
+};
+
+// The reference all vector versions have to match.
+static inline int16_t FloatToS16Sample(float sample) {
+    if (sample < -1.0f) {
+        sample = -1.0f;
+    } else if (sample > 1.0f) {
+        sample = 1.0f;
+    }
+    return (int16_t)round(sample * 32767.0f);
+}
+
+// The vector versions truncate and then round the remainder half away
+// from zero, as round() does. Hardware rounding would round half to even.
+// The remainder is exact as long as the values stay below 2^23.
+
+#if defined(AM_CONVERT_NEON)
+
+static inline int32x4_t FloatToS32x4(float32x4_t x) {
+    float32x4_t v = vmulq_n_f32(
+            vminq_f32(vmaxq_f32(x, vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f)),
+            32767.0f);
+    int32x4_t r = vcvtq_s32_f32(v);
+    float32x4_t frac = vsubq_f32(v, vcvtq_f32_s32(r));
+    r = vsubq_s32(r, vreinterpretq_s32_u32(vcgeq_f32(frac, vdupq_n_f32(0.5f))));
+    r = vaddq_s32(r, vreinterpretq_s32_u32(vcleq_f32(frac, vdupq_n_f32(-0.5f))));
+    return r;
+}
+
+static void FloatToS16(const float *in, int16_t *out, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int32x4_t lo = FloatToS32x4(vld1q_f32(&in[i]));
+        int32x4_t hi = FloatToS32x4(vld1q_f32(&in[i + 4]));
+        vst1q_s16(&out[i], vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+    for (; i < count; ++i) {
+        out[i] = FloatToS16Sample(in[i]);
+    }
+}
+
+static void InterleaveStereoS16(
+        const int16_t *left, const int16_t *right, int16_t *out, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8x2_t pair;
+        pair.val[0] = vld1q_s16(&left[i]);
+        pair.val[1] = vld1q_s16(&right[i]);
+        vst2q_s16(&out[2 * i], pair);
+    }
+    for (; i < count; ++i) {
+        out[2 * i] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+static void InterleaveStereoS32(
+        const int32_t *left, const int32_t *right, int32_t *out, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32x4x2_t pair;
+        pair.val[0] = vld1q_s32(&left[i]);
+        pair.val[1] = vld1q_s32(&right[i]);
+        vst2q_s32(&out[2 * i], pair);
+    }
+    for (; i < count; ++i) {
+        out[2 * i] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+#elif defined(AM_CONVERT_SSE2)
+
+static inline __m128i FloatToS32x4(__m128 x) {
+    __m128 v = _mm_mul_ps(
+            _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f)),
+            _mm_set1_ps(32767.0f));
+    __m128i r = _mm_cvttps_epi32(v);
+    __m128 frac = _mm_sub_ps(v, _mm_cvtepi32_ps(r));
+    r = _mm_sub_epi32(r, _mm_castps_si128(_mm_cmpge_ps(frac, _mm_set1_ps(0.5f))));
+    r = _mm_add_epi32(r, _mm_castps_si128(_mm_cmple_ps(frac, _mm_set1_ps(-0.5f))));
+    return r;
+}
+
+static void FloatToS16Sse2(const float *in, int16_t *out, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = FloatToS32x4(_mm_loadu_ps(&in[i]));
+        __m128i hi = FloatToS32x4(_mm_loadu_ps(&in[i + 4]));
+        _mm_storeu_si128((__m128i *)&out[i], _mm_packs_epi32(lo, hi));
+    }
+    for (; i < count; ++i) {
+        out[i] = FloatToS16Sample(in[i]);
+    }
+}
+
+#if defined(AM_CONVERT_AVX2)
+
+static inline __attribute__((target("avx2")))
+__m256i FloatToS32x8(__m256 x) {
+    __m256 v = _mm256_mul_ps(
+            _mm256_min_ps(
+                    _mm256_max_ps(x, _mm256_set1_ps(-1.0f)),
+                    _mm256_set1_ps(1.0f)),
+            _mm256_set1_ps(32767.0f));
+    __m256i r = _mm256_cvttps_epi32(v);
+    __m256 frac = _mm256_sub_ps(v, _mm256_cvtepi32_ps(r));
+    r = _mm256_sub_epi32(r, _mm256_castps_si256(
+            _mm256_cmp_ps(frac, _mm256_set1_ps(0.5f), _CMP_GE_OQ)));
+    r = _mm256_add_epi32(r, _mm256_castps_si256(
+            _mm256_cmp_ps(frac, _mm256_set1_ps(-0.5f), _CMP_LE_OQ)));
+    return r;
+}
+
+static __attribute__((target("avx2")))
+void FloatToS16Avx2(const float *in, int16_t *out, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i lo = FloatToS32x8(_mm256_loadu_ps(&in[i]));
+        __m256i hi = FloatToS32x8(_mm256_loadu_ps(&in[i + 8]));
+        // The pack works per 128 bit lane, put the quarters back in order.
+        __m256i packed = _mm256_permute4x64_epi64(
+                _mm256_packs_epi32(lo, hi), 0xD8);
+        _mm256_storeu_si256((__m256i *)&out[i], packed);
+    }
+    FloatToS16Sse2(in + i, out + i, count - i);
+}
+
+typedef void (*FloatToS16Func)(const float *in, int16_t *out, size_t count);
+
+static pthread_once_t sFloatToS16Once = PTHREAD_ONCE_INIT;
+static FloatToS16Func sFloatToS16 = FloatToS16Sse2;
+
+static void SelectFloatToS16() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        sFloatToS16 = FloatToS16Avx2;
+    }
+    ALOGV("float to s16 conversion uses %s",
+            sFloatToS16 == FloatToS16Avx2 ? "avx2" : "sse2");
+}
+
+static void FloatToS16(const float *in, int16_t *out, size_t count) {
+    pthread_once(&sFloatToS16Once, SelectFloatToS16);
+    sFloatToS16(in, out, count);
+}
+
+#else
+
+static void FloatToS16(const float *in, int16_t *out, size_t count) {
+    FloatToS16Sse2(in, out, count);
+}
+
+#endif
+
+static void InterleaveStereoS16(
+        const int16_t *left, const int16_t *right, int16_t *out, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i l = _mm_loadu_si128((const __m128i *)&left[i]);
+        __m128i r = _mm_loadu_si128((const __m128i *)&right[i]);
+        _mm_storeu_si128((__m128i *)&out[2 * i], _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128((__m128i *)&out[2 * i + 8], _mm_unpackhi_epi16(l, r));
+    }
+    for (; i < count; ++i) {
+        out[2 * i] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+static void InterleaveStereoS32(
+        const int32_t *left, const int32_t *right, int32_t *out, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i l = _mm_loadu_si128((const __m128i *)&left[i]);
+        __m128i r = _mm_loadu_si128((const __m128i *)&right[i]);
+        _mm_storeu_si128((__m128i *)&out[2 * i], _mm_unpacklo_epi32(l, r));
+        _mm_storeu_si128((__m128i *)&out[2 * i + 4], _mm_unpackhi_epi32(l, r));
+    }
+    for (; i < count; ++i) {
+        out[2 * i] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+#else
+
+static void FloatToS16(const float *in, int16_t *out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = FloatToS16Sample(in[i]);
+    }
+}
+
+static void InterleaveStereoS16(
+        const int16_t *left, const int16_t *right, int16_t *out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[2 * i] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+static void InterleaveStereoS32(
+        const int32_t *left, const int32_t *right, int32_t *out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[2 * i] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+#endif
+
+// More than two channels are interleaved a frame at a time, like the
+// reference. A strided pass per channel writes every output cache line
+// once per channel and is slower than that, 0.65x with 8 channels.
+template<typename T>
+static void InterleaveFrames(
+        const T *const *in, T *out, size_t count, size_t channels) {
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t ch = 0; ch < channels; ++ch) {
+            out[ch] = in[ch][i];
+        }
+        out += channels;
+    }
+}
+
+void AmConvertFltToS16(const float *in, int16_t *out, size_t count) {
+    FloatToS16(in, out, count);
+}
+
+void AmConvertFltpToS16(
+        const float *const *in, int16_t *out,
+        size_t numSamples, size_t channels) {
+    if (channels == 1) {
+        FloatToS16(in[0], out, numSamples);
+        return;
+    }
+
+    // Up to kBlockChannels channels are converted into blocks at a time,
+    // then interleaved into their slots of each frame.
+    int16_t block[kBlockChannels][kBlockSamples];
+
+    for (size_t i = 0; i < numSamples; i += kBlockSamples) {
+        size_t count = numSamples - i;
+        if (count > kBlockSamples) {
+            count = kBlockSamples;
+        }
+
+        if (channels == 2) {
+            FloatToS16(in[0] + i, block[0], count);
+            FloatToS16(in[1] + i, block[1], count);
+            InterleaveStereoS16(block[0], block[1], out + 2 * i, count);
+            continue;
+        }
+
+        for (size_t first = 0; first < channels; first += kBlockChannels) {
+            size_t num = channels - first;
+            if (num > kBlockChannels) {
+                num = kBlockChannels;
+            }
+            for (size_t ch = 0; ch < num; ++ch) {
+                FloatToS16(in[first + ch] + i, block[ch], count);
+            }
+
+            int16_t *dst = out + i * channels + first;
+            for (size_t j = 0; j < count; ++j) {
+                for (size_t ch = 0; ch < num; ++ch) {
+                    dst[ch] = block[ch][j];
+                }
+                dst += channels;
+            }
+        }
+    }
+}
+
+void AmInterleaveS16(
+        const int16_t *const *in, int16_t *out,
+        size_t numSamples, size_t channels) {
+    if (channels == 2) {
+        InterleaveStereoS16(in[0], in[1], out, numSamples);
+        return;
+    }
+
+    InterleaveFrames(in, out, numSamples, channels);
+}
+
+void AmInterleaveS32(
+        const int32_t *const *in, int32_t *out,
+        size_t numSamples, size_t channels) {
+    if (channels == 2) {
+        InterleaveStereoS32(in[0], in[1], out, numSamples);
+        return;
+    }
+
+    InterleaveFrames(in, out, numSamples, channels);
+}
+
+}  // namespace android
@@ -0,0 +1,381 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Checks the AmSampleConvert conversions against plain C loops, bit for
+// bit, on random samples mixed with the values where rounding and
+// clamping change: exact halves, +-1 and beyond, at every length and
+// alignment up to a few vector blocks. Then reports the throughput of both
+// on frames of the usual decoder sizes.
+//
+// usage: amsampleconvertbench [-n iterations] [-s samples]
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AmSampleConvertBench"
+#include <utils/Log.h>
+
+#include "AmSampleConvert.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace android {
+
+static const size_t kMaxChannels = 8;
+
+static int16_t RefFloatToS16(float sample) {
+    if (sample < -1.0f) {
+        sample = -1.0f;
+    } else if (sample > 1.0f) {
+        sample = 1.0f;
+    }
+    return (int16_t)round(sample * 32767.0f);
+}
+
+static void RefConvertFltToS16(const float *in, int16_t *out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = RefFloatToS16(in[i]);
+    }
+}
+
+static void RefConvertFltpToS16(
+        const float *const *in, int16_t *out,
+        size_t numSamples, size_t channels) {
+    for (size_t i = 0; i < numSamples; ++i) {
+        for (size_t ch = 0; ch < channels; ++ch) {
+            out[i * channels + ch] = RefFloatToS16(in[ch][i]);
+        }
+    }
+}
+
+template<typename T>
+static void RefInterleave(
+        const T *const *in, T *out, size_t numSamples, size_t channels) {
+    for (size_t i = 0; i < numSamples; ++i) {
+        for (size_t ch = 0; ch < channels; ++ch) {
+            out[i * channels + ch] = in[ch][i];
+        }
+    }
+}
+
+static float RandomSample() {
+    static const float kEdges[] = {
+        0.0f, -0.0f, 1.0f, -1.0f, 1.5f, -1.5f, 1e10f, -1e10f,
+        0.5f / 32767.0f, -0.5f / 32767.0f,
+        1.5f / 32767.0f, -1.5f / 32767.0f,
+        32766.5f / 32767.0f, -32766.5f / 32767.0f,
+        nextafterf(1.0f, 2.0f), nextafterf(-1.0f, -2.0f),
+    };
+
+    switch (rand() % 4) {
+        case 0:
+            return kEdges[rand() % NELEM(kEdges)];
+        case 1: {
+            // Right at, or one ulp around, a rounding boundary.
+            float half = ((rand() % 65535) - 32767 + 0.5f) / 32767.0f;
+            int ulps = rand() % 3 - 1;
+            return ulps == 0 ? half
+                    : nextafterf(half, ulps > 0 ? 2.0f : -2.0f);
+        }
+        default:
+            return (rand() / (float)RAND_MAX) * 2.4f - 1.2f;
+    }
+}
+
+static bool Check(const char *what, const void *expected, const void *actual,
+        size_t bytes, size_t numSamples, size_t channels, size_t offset) {
+    if (memcmp(expected, actual, bytes) != 0) {
+        fprintf(stderr, "%s: %zu samples on %zu channels at offset %zu "
+                "differ from the reference\n",
+                what, numSamples, channels, offset);
+        return false;
+    }
+    return true;
+}
+
+// Every length up to a few 256 sample blocks, from every alignment of a
+// 32 byte vector.
+static bool Verify() {
+    static const size_t kMaxSamples = 560;
+    static const size_t kPad = 8;
+
+    // The first plane also holds the interleaved stereo input.
+    float *flt[kMaxChannels];
+    int16_t *s16[kMaxChannels];
+    int32_t *s32[kMaxChannels];
+    for (size_t ch = 0; ch < kMaxChannels; ++ch) {
+        flt[ch] = new float[(kMaxSamples + kPad) * (ch == 0 ? 2 : 1)];
+        s16[ch] = new int16_t[kMaxSamples + kPad];
+        s32[ch] = new int32_t[kMaxSamples + kPad];
+    }
+
+    size_t outSize = (kMaxSamples + kPad) * kMaxChannels;
+    int16_t *expected16 = new int16_t[outSize];
+    int16_t *actual16 = new int16_t[outSize];
+    int32_t *expected32 = new int32_t[outSize];
+    int32_t *actual32 = new int32_t[outSize];
+
+    bool ok = true;
+    for (size_t numSamples = 0; ok && numSamples <= kMaxSamples;
+            numSamples += numSamples < 80 ? 1 : 37) {
+        for (size_t offset = 0; ok && offset < kPad; ++offset) {
+            const float *fltIn[kMaxChannels];
+            const int16_t *s16In[kMaxChannels];
+            const int32_t *s32In[kMaxChannels];
+            for (size_t ch = 0; ch < kMaxChannels; ++ch) {
+                for (size_t i = 0; i < (kMaxSamples + kPad) * 2; ++i) {
+                    if (ch == 0 || i < kMaxSamples + kPad) {
+                        flt[ch][i] = RandomSample();
+                    }
+                }
+                for (size_t i = 0; i < kMaxSamples + kPad; ++i) {
+                    s16[ch][i] = rand();
+                    s32[ch][i] = (int32_t)((uint32_t)rand() * 2 + (rand() & 1));
+                }
+                fltIn[ch] = flt[ch] + offset;
+                s16In[ch] = s16[ch] + offset;
+                s32In[ch] = s32[ch] + offset;
+            }
+
+            size_t count = numSamples * 2;
+            RefConvertFltToS16(fltIn[0], expected16, count);
+            AmConvertFltToS16(fltIn[0], actual16 + offset, count);
+            ok = Check("flt", expected16, actual16 + offset,
+                    count * sizeof(int16_t), numSamples, 2, offset);
+
+            for (size_t channels = 1; ok && channels <= kMaxChannels;
+                    ++channels) {
+                size_t total = numSamples * channels;
+
+                RefConvertFltpToS16(fltIn, expected16, numSamples, channels);
+                AmConvertFltpToS16(fltIn, actual16 + offset,
+                        numSamples, channels);
+                ok = Check("fltp", expected16, actual16 + offset,
+                        total * sizeof(int16_t), numSamples, channels, offset);
+
+                if (ok) {
+                    RefInterleave(s16In, expected16, numSamples, channels);
+                    AmInterleaveS16(s16In, actual16 + offset,
+                            numSamples, channels);
+                    ok = Check("s16p", expected16, actual16 + offset,
+                            total * sizeof(int16_t),
+                            numSamples, channels, offset);
+                }
+
+                if (ok) {
+                    RefInterleave(s32In, expected32, numSamples, channels);
+                    AmInterleaveS32(s32In, actual32 + offset,
+                            numSamples, channels);
+                    ok = Check("s32p", expected32, actual32 + offset,
+                            total * sizeof(int32_t),
+                            numSamples, channels, offset);
+                }
+            }
+        }
+    }
+
+    for (size_t ch = 0; ch < kMaxChannels; ++ch) {
+        delete[] flt[ch];
+        delete[] s16[ch];
+        delete[] s32[ch];
+    }
+    delete[] expected16;
+    delete[] actual16;
+    delete[] expected32;
+    delete[] actual32;
+
+    return ok;
+}
+
+static int64_t NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+enum Conversion {
+    kFlt,
+    kFltp,
+    kS16p,
+    kS32p,
+    kNumConversions,
+};
+
+static const char *const kConversionNames[kNumConversions] = {
+    "flt", "fltp", "s16p", "s32p",
+};
+
+struct Planes {
+    const float *mFlt[kMaxChannels];
+    const int16_t *mS16[kMaxChannels];
+    const int32_t *mS32[kMaxChannels];
+};
+
+static void Convert(
+        Conversion conversion, bool ref, const Planes &planes, void *out,
+        size_t numSamples, size_t channels) {
+    switch (conversion) {
+        case kFlt:
+            if (ref) {
+                RefConvertFltToS16(planes.mFlt[0], (int16_t *)out,
+                        numSamples * channels);
+            } else {
+                AmConvertFltToS16(planes.mFlt[0], (int16_t *)out,
+                        numSamples * channels);
+            }
+            break;
+        case kFltp:
+            if (ref) {
+                RefConvertFltpToS16(planes.mFlt, (int16_t *)out,
+                        numSamples, channels);
+            } else {
+                AmConvertFltpToS16(planes.mFlt, (int16_t *)out,
+                        numSamples, channels);
+            }
+            break;
+        case kS16p:
+            if (ref) {
+                RefInterleave(planes.mS16, (int16_t *)out, numSamples, channels);
+            } else {
+                AmInterleaveS16(planes.mS16, (int16_t *)out, numSamples, channels);
+            }
+            break;
+        default:
+            if (ref) {
+                RefInterleave(planes.mS32, (int32_t *)out, numSamples, channels);
+            } else {
+                AmInterleaveS32(planes.mS32, (int32_t *)out, numSamples, channels);
+            }
+            break;
+    }
+}
+
+// Converts "numSamples" per channel in frames of "frameSamples", the way
+// AmAudioCodec gets them from the decoder.
+static int64_t Run(
+        Conversion conversion, bool ref, const Planes &planes, void *out,
+        size_t numSamples, size_t frameSamples, size_t channels,
+        int iterations) {
+    int64_t startUs = NowUs();
+    for (int n = 0; n < iterations; ++n) {
+        for (size_t i = 0; i + frameSamples <= numSamples; i += frameSamples) {
+            Planes frame;
+            for (size_t ch = 0; ch < channels; ++ch) {
+                // Interleaved float input lives in the first plane.
+                frame.mFlt[ch] = planes.mFlt[ch]
+                        + (conversion == kFlt ? i * channels : i);
+                frame.mS16[ch] = planes.mS16[ch] + i;
+                frame.mS32[ch] = planes.mS32[ch] + i;
+            }
+            Convert(conversion, ref, frame, out, frameSamples, channels);
+        }
+    }
+    return NowUs() - startUs;
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n iterations] [-s samples]\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int iterations = 50;
+    size_t numSamples = 48000 * 4;
+
+    int res;
+    while ((res = getopt(argc, argv, "n:s:h")) >= 0) {
+        switch (res) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 's':
+                numSamples = (size_t)atoi(optarg);
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    if (iterations <= 0 || numSamples < 2048) {
+        usage(me);
+    }
+
+    srand(1);
+
+    if (!Verify()) {
+        return 1;
+    }
+
+    // AAC stereo, 5.1 AC-3 and 7.1 at the decoders' frame sizes.
+    static const struct {
+        size_t mChannels;
+        size_t mFrameSamples;
+    } kLayouts[] = {
+        { 2, 1024 },
+        { 6, 1536 },
+        { 8, 2048 },
+    };
+
+    // The first plane also holds interleaved input for all channels.
+    Planes planes;
+    for (size_t ch = 0; ch < kMaxChannels; ++ch) {
+        size_t size = ch == 0 ? numSamples * kMaxChannels : numSamples;
+        float *flt = new float[size];
+        int16_t *s16 = new int16_t[numSamples];
+        int32_t *s32 = new int32_t[numSamples];
+        for (size_t i = 0; i < size; ++i) {
+            flt[i] = (rand() / (float)RAND_MAX) * 2.2f - 1.1f;
+        }
+        for (size_t i = 0; i < numSamples; ++i) {
+            s16[i] = rand();
+            s32[i] = rand();
+        }
+        planes.mFlt[ch] = flt;
+        planes.mS16[ch] = s16;
+        planes.mS32[ch] = s32;
+    }
+
+    int32_t *out = new int32_t[2048 * kMaxChannels];
+
+    for (size_t l = 0; l < NELEM(kLayouts); ++l) {
+        size_t channels = kLayouts[l].mChannels;
+        size_t frameSamples = kLayouts[l].mFrameSamples;
+
+        for (int c = 0; c < kNumConversions; ++c) {
+            Conversion conversion = (Conversion)c;
+            int64_t refUs = Run(conversion, true, planes, out,
+                    numSamples, frameSamples, channels, iterations);
+            int64_t us = Run(conversion, false, planes, out,
+                    numSamples, frameSamples, channels, iterations);
+
+            double msamples = (double)(numSamples / frameSamples)
+                    * frameSamples * channels * iterations / 1E6;
+            printf("%zu ch %-5s c: %8.1f Msamples/s  "
+                   "convert: %8.1f Msamples/s  (%.2fx)\n",
+                   channels, kConversionNames[c],
+                   msamples * 1E6 / (refUs > 0 ? refUs : 1),
+                   msamples * 1E6 / (us > 0 ? us : 1),
+                   us > 0 ? (double)refUs / us : 0.0);
+        }
+    }
+
+    for (size_t ch = 0; ch < kMaxChannels; ++ch) {
+        delete[] planes.mFlt[ch];
+        delete[] planes.mS16[ch];
+        delete[] planes.mS32[ch];
+    }
+    delete[] out;
+
+    return 0;
+}
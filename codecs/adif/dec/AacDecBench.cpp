@@ -0,0 +1,641 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Runs libfaad's synthesis filterbank and SBR QMF banks with the plain C
+// code and with every vector version built in and supported by this CPU,
+// checks that they agree, and reports the speed of each. The filterbank
+// gets random spectra in every window sequence and shape, at both frame
+// lengths, the QMF banks random subband samples. Then it decodes an ADTS
+// or ADIF file with each version and compares the 16 bit output: it has
+// to be the same bit for bit, or within 1/sqrt(12) LSB RMS and 1 LSB at
+// most, the limits of the MPEG-4 conformance test. Without a file it
+// decodes generated ADTS frames: mono and stereo AAC LC in every window
+// sequence, with noise substituted spectra of random energy, at 44.1 kHz
+// and at 22.05 kHz, where the SBR QMF banks upsample the output.
+//
+// usage: aacdecbench [-n iterations] [-f frames] [file.aac]
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AacDecBench"
+#include <utils/Log.h>
+
+#include "neaacdec.h"
+
+#include "common.h"
+#include "structs.h"
+#include "filtbank.h"
+#include "syntax.h"
+#include "sbr_dec.h"
+#include "sbr_qmf.h"
+#include "simd.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace android {
+
+static const char *kVersions[] = { "neon", "sse2", "avx" };
+
+static const uint16_t kFrameLengths[] = { 1024, 960 };
+
+// Enough rounds for every pair of window shapes, and to go around the
+// QMF ring buffers a few times.
+static const int kCheckIterations = 16;
+
+// The vector code may fuse a multiply and an add where the C code rounds
+// in between, on arm64 for instance, so the kernels are allowed this much
+// relative to the largest value.
+static const double kMaxRelativeError = 1E-5;
+
+static int64_t NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+static real_t Random() {
+    return (real_t)((rand() % 65537) - 32768);
+}
+
+struct Output {
+    Output()
+        : mData(NULL),
+          mSize(0),
+          mCapacity(0),
+          mFilterBankUs(0),
+          mSynthesisUs(0),
+          mAnalysisUs(0),
+          mDecodeUs(0) {
+    }
+
+    ~Output() {
+        free(mData);
+    }
+
+    void append(const void *data, size_t size) {
+        if (mSize + size > mCapacity) {
+            mCapacity = (mSize + size) * 2;
+            mData = (uint8_t *)realloc(mData, mCapacity);
+        }
+        memcpy(mData + mSize, data, size);
+        mSize += size;
+    }
+
+    uint8_t *mData;
+    size_t mSize;
+    size_t mCapacity;
+    int64_t mFilterBankUs;
+    int64_t mSynthesisUs;
+    int64_t mAnalysisUs;
+    int64_t mDecodeUs;
+};
+
+// The same random input every time, so that every version sees it.
+static void RunKernels(int iterations, bool keep, Output *output) {
+    static real_t freq[1024];
+    static real_t time[1024];
+    static real_t overlap[1024];
+
+    srand(1);
+    for (size_t l = 0; l < NELEM(kFrameLengths); ++l) {
+        uint16_t frameLength = kFrameLengths[l];
+        fb_info *fb = filter_bank_init(frameLength);
+        memset(overlap, 0, sizeof(overlap));
+
+        for (int n = 0; n < iterations; ++n) {
+            for (uint8_t sequence = ONLY_LONG_SEQUENCE;
+                    sequence <= LONG_STOP_SEQUENCE; ++sequence) {
+                for (uint16_t i = 0; i < frameLength; ++i) {
+                    freq[i] = Random();
+                }
+
+                int64_t startUs = NowUs();
+                ifilter_bank(fb, sequence, n & 1, (n >> 1) & 1,
+                             freq, time, overlap, LC, frameLength);
+                output->mFilterBankUs += NowUs() - startUs;
+
+                if (keep) {
+                    output->append(time, frameLength * sizeof(real_t));
+                    output->append(overlap, frameLength * sizeof(real_t));
+                }
+            }
+        }
+        filter_bank_end(fb);
+    }
+
+    sbr_info *sbr = (sbr_info *)calloc(1, sizeof(sbr_info));
+    sbr->numTimeSlotsRate = 32;
+    qmfs_info *qmfs = qmfs_init(64);
+    qmfa_info *qmfa = qmfa_init(32);
+
+    static qmf_t X[MAX_NTSRHFG][64];
+    static real_t pcm[32 * 64];
+    static real_t input[32 * 32];
+
+    for (int n = 0; n < iterations; ++n) {
+        for (int i = 0; i < MAX_NTSRHFG; ++i) {
+            for (int k = 0; k < 64; ++k) {
+                QMF_RE(X[i][k]) = Random();
+                QMF_IM(X[i][k]) = Random();
+            }
+        }
+
+        int64_t startUs = NowUs();
+        sbr_qmf_synthesis_64(sbr, qmfs, X, pcm);
+        output->mSynthesisUs += NowUs() - startUs;
+
+        if (keep) {
+            output->append(pcm, sizeof(pcm));
+        }
+
+        for (size_t i = 0; i < NELEM(input); ++i) {
+            input[i] = Random();
+        }
+
+        startUs = NowUs();
+        sbr_qmf_analysis_32(sbr, qmfa, input, X, 0, 32);
+        output->mAnalysisUs += NowUs() - startUs;
+
+        if (keep) {
+            output->append(X, 32 * sizeof(X[0]));
+        }
+    }
+
+    qmfa_end(qmfa);
+    qmfs_end(qmfs);
+    free(sbr);
+}
+
+// Returns false if the outputs differ by more than the vector code may.
+static bool CompareKernels(
+        const char *version, const Output &reference, const Output &output) {
+    if (reference.mSize != output.mSize) {
+        fprintf(stderr, "%s: %zu bytes of output, expected %zu\n",
+                version, output.mSize, reference.mSize);
+        return false;
+    }
+
+    if (!memcmp(reference.mData, output.mData, reference.mSize)) {
+        printf("    %-6s bit exact\n", version);
+        return true;
+    }
+
+    const real_t *a = (const real_t *)reference.mData;
+    const real_t *b = (const real_t *)output.mData;
+    size_t count = reference.mSize / sizeof(real_t);
+
+    double peak = 0.0, maxError = 0.0;
+    size_t maxIndex = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (fabs(a[i]) > peak) {
+            peak = fabs(a[i]);
+        }
+        if (fabs(a[i] - b[i]) > maxError) {
+            maxError = fabs(a[i] - b[i]);
+            maxIndex = i;
+        }
+    }
+
+    double error = peak > 0.0 ? maxError / peak : maxError;
+    printf("    %-6s max error %.3g of the peak, at value %zu\n",
+           version, error, maxIndex);
+    return error <= kMaxRelativeError;
+}
+
+static bool RunAllKernels(int iterations) {
+    printf("filterbank and QMF banks\n");
+
+    Output reference;
+    faad_simd_select("c");
+    RunKernels(kCheckIterations, true, &reference);
+
+    Output refTime;
+    RunKernels(iterations, false, &refTime);
+
+    printf("    c:     filterbank %6.2f us  synthesis %6.2f us  analysis %6.2f us\n",
+           refTime.mFilterBankUs / (iterations * 8.0),
+           refTime.mSynthesisUs / (double)iterations,
+           refTime.mAnalysisUs / (double)iterations);
+
+    bool ok = true;
+    for (size_t v = 0; v < NELEM(kVersions); ++v) {
+        if (faad_simd_select(kVersions[v]) != 0) {
+            continue;
+        }
+
+        Output output;
+        RunKernels(kCheckIterations, true, &output);
+        if (!CompareKernels(kVersions[v], reference, output)) {
+            ok = false;
+            continue;
+        }
+
+        Output time;
+        RunKernels(iterations, false, &time);
+
+        printf("    %-6s filterbank %6.2f us  synthesis %6.2f us  analysis %6.2f us"
+               "  (%.2fx %.2fx %.2fx)\n", kVersions[v],
+               time.mFilterBankUs / (iterations * 8.0),
+               time.mSynthesisUs / (double)iterations,
+               time.mAnalysisUs / (double)iterations,
+               (double)refTime.mFilterBankUs / (time.mFilterBankUs ? time.mFilterBankUs : 1),
+               (double)refTime.mSynthesisUs / (time.mSynthesisUs ? time.mSynthesisUs : 1),
+               (double)refTime.mAnalysisUs / (time.mAnalysisUs ? time.mAnalysisUs : 1));
+    }
+    return ok;
+}
+
+struct BitWriter {
+    BitWriter()
+        : mData(NULL),
+          mSize(0),
+          mCapacity(0),
+          mNumBits(0) {
+    }
+
+    void putBits(uint32_t value, int n) {
+        while (n-- > 0) {
+            if (mNumBits == mSize * 8) {
+                if (mSize == mCapacity) {
+                    mCapacity = mCapacity ? mCapacity * 2 : 65536;
+                    mData = (uint8_t *)realloc(mData, mCapacity);
+                }
+                mData[mSize++] = 0;
+            }
+            if ((value >> n) & 1) {
+                mData[mNumBits / 8] |= 0x80 >> (mNumBits % 8);
+            }
+            ++mNumBits;
+        }
+    }
+
+    void byteAlign() {
+        mNumBits = mSize * 8;
+    }
+
+    uint8_t *mData;
+    size_t mSize;
+    size_t mCapacity;
+    size_t mNumBits;
+};
+
+struct StreamType {
+    int mSampleRate;
+    int mSampleRateIndex;
+    int mChannels;
+};
+
+static const StreamType kStreamTypes[] = {
+    { 44100, 4, 2 },
+    { 44100, 4, 1 },
+    { 22050, 7, 2 },
+    { 22050, 7, 1 },
+};
+
+// Scale factor band counts that fit both rates, long and short windows.
+static const int kMaxSfbLong = 40;
+static const int kMaxSfbShort = 12;
+
+// Section data of one section over maxSfb bands, in the noise codebook.
+static void WriteSection(BitWriter *bits, int maxSfb, int lenBits) {
+    int escape = (1 << lenBits) - 1;
+    bits->putBits(NOISE_HCB, 4);
+    int len = maxSfb;
+    while (len >= escape) {
+        bits->putBits(escape, lenBits);
+        len -= escape;
+    }
+    bits->putBits(len, lenBits);
+}
+
+// An individual_channel_stream of noise bands only, with the energy
+// wandering from band to band.
+static void WriteIcs(BitWriter *bits, uint8_t sequence) {
+    bits->putBits(140 + rand() % 16, 8);  // global_gain
+
+    bits->putBits(0, 1);  // ics_reserved_bit
+    bits->putBits(sequence, 2);
+    bits->putBits(rand() & 1, 1);  // window_shape
+
+    int numGroups = 1;
+    int maxSfb;
+    if (sequence == EIGHT_SHORT_SEQUENCE) {
+        maxSfb = kMaxSfbShort;
+        bits->putBits(maxSfb, 4);
+        int grouping = rand() & 0x7f;
+        bits->putBits(grouping, 7);
+        for (int i = 0; i < 7; ++i) {
+            if (!(grouping & (1 << i))) {
+                ++numGroups;
+            }
+        }
+        for (int g = 0; g < numGroups; ++g) {
+            WriteSection(bits, maxSfb, 3);
+        }
+    } else {
+        maxSfb = kMaxSfbLong;
+        bits->putBits(maxSfb, 6);
+        bits->putBits(0, 1);  // predictor_data_present
+        WriteSection(bits, maxSfb, 5);
+    }
+
+    // The first noise energy relative to the global gain, the others
+    // Huffman coded relative to the one before: 0, -1 or +1.
+    int energy = 0;
+    bits->putBits(256, 9);
+    for (int i = 1; i < numGroups * maxSfb; ++i) {
+        int delta = rand() % 3 - 1;
+        if (energy + delta < -12 || energy + delta > 4) {
+            delta = -delta;
+        }
+        energy += delta;
+        if (delta == 0) {
+            bits->putBits(0x0, 1);
+        } else if (delta < 0) {
+            bits->putBits(0x4, 3);
+        } else {
+            bits->putBits(0xa, 4);
+        }
+    }
+
+    bits->putBits(0, 1);  // pulse_data_present
+    bits->putBits(0, 1);  // tns_data_present
+    bits->putBits(0, 1);  // gain_control_data_present
+}
+
+static void AppendFrames(
+        const StreamType &type, int numFrames, uint8_t **data, size_t *size) {
+    BitWriter bits;
+    for (int n = 0; n < numFrames; ++n) {
+        size_t start = bits.mSize;
+
+        // adts_fixed_header and adts_variable_header, the frame length
+        // filled in below
+        bits.putBits(0xfff, 12);
+        bits.putBits(0, 1);  // MPEG-4
+        bits.putBits(0, 2);
+        bits.putBits(1, 1);  // no CRC
+        bits.putBits(LC - 1, 2);
+        bits.putBits(type.mSampleRateIndex, 4);
+        bits.putBits(0, 1);
+        bits.putBits(type.mChannels, 3);
+        bits.putBits(0, 4);
+        bits.putBits(0, 13);
+        bits.putBits(0x7ff, 11);
+        bits.putBits(0, 2);
+
+        uint8_t sequence = rand() % 4;
+        if (type.mChannels == 1) {
+            bits.putBits(ID_SCE, 3);
+            bits.putBits(0, 4);
+            WriteIcs(&bits, sequence);
+        } else {
+            bits.putBits(ID_CPE, 3);
+            bits.putBits(0, 4);
+            bits.putBits(0, 1);  // common_window
+            WriteIcs(&bits, sequence);
+            WriteIcs(&bits, sequence);
+        }
+        bits.putBits(ID_END, 3);
+        bits.byteAlign();
+
+        size_t frameLength = bits.mSize - start;
+        uint8_t *header = bits.mData + start;
+        header[3] |= frameLength >> 11;
+        header[4] = frameLength >> 3;
+        header[5] |= (frameLength & 7) << 5;
+    }
+
+    *data = bits.mData;
+    *size = bits.mSize;
+}
+
+// Decodes the whole stream to 16 bit PCM the way SoftADTS drives the
+// library.
+static bool Decode(
+        const char *version, uint8_t *data, size_t size, bool keep,
+        Output *output) {
+    faad_simd_select(version);
+
+    NeAACDecHandle decoder = NeAACDecOpen();
+    if (decoder == NULL) {
+        return false;
+    }
+
+    NeAACDecConfigurationPtr config = NeAACDecGetCurrentConfiguration(decoder);
+    config->outputFormat = FAAD_FMT_16BIT;
+    NeAACDecSetConfiguration(decoder, config);
+
+    unsigned long sampleRate;
+    unsigned char channels;
+    long offset = NeAACDecInit(decoder, data, size, &sampleRate, &channels);
+    if (offset < 0) {
+        fprintf(stderr, "not an ADTS or ADIF stream\n");
+        NeAACDecClose(decoder);
+        return false;
+    }
+
+    int64_t startUs = NowUs();
+    size_t pos = offset;
+    while (pos < size) {
+        NeAACDecFrameInfo info;
+        void *samples = NeAACDecDecode(decoder, &info, data + pos, size - pos);
+        if (info.bytesconsumed == 0) {
+            break;
+        }
+        pos += info.bytesconsumed;
+
+        if (info.error == 0 && samples != NULL && info.samples > 0 && keep) {
+            output->append(samples, info.samples * sizeof(int16_t));
+        }
+    }
+    output->mDecodeUs += NowUs() - startUs;
+
+    NeAACDecClose(decoder);
+    return true;
+}
+
+static bool ComparePcm(
+        const char *version, const Output &reference, const Output &output) {
+    if (reference.mSize != output.mSize) {
+        fprintf(stderr, "%s: %zu bytes decoded, expected %zu\n",
+                version, output.mSize, reference.mSize);
+        return false;
+    }
+
+    if (!memcmp(reference.mData, output.mData, reference.mSize)) {
+        printf("    %-6s bit exact\n", version);
+        return true;
+    }
+
+    const int16_t *a = (const int16_t *)reference.mData;
+    const int16_t *b = (const int16_t *)output.mData;
+    size_t count = reference.mSize / sizeof(int16_t);
+
+    double sum = 0.0;
+    int maxDiff = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int diff = abs(a[i] - b[i]);
+        sum += (double)diff * diff;
+        if (diff > maxDiff) {
+            maxDiff = diff;
+        }
+    }
+
+    double rms = sqrt(sum / count);
+    printf("    %-6s RMS %.4f LSB, max %d LSB\n", version, rms, maxDiff);
+    return rms <= 1.0 / sqrt(12.0) && maxDiff <= 1;
+}
+
+static bool Run(uint8_t *data, size_t size, int iterations) {
+    Output reference;
+    if (!Decode("c", data, size, true, &reference)) {
+        return false;
+    }
+
+    Output refTime;
+    for (int n = 0; n < iterations; ++n) {
+        Decode("c", data, size, false, &refTime);
+    }
+
+    printf("    c:     %7.1f ms a pass  (%zu bytes)\n",
+           refTime.mDecodeUs / 1000.0 / iterations, reference.mSize);
+
+    bool ok = true;
+    for (size_t v = 0; v < NELEM(kVersions); ++v) {
+        if (faad_simd_select(kVersions[v]) != 0) {
+            continue;
+        }
+
+        Output output;
+        Decode(kVersions[v], data, size, true, &output);
+        if (!ComparePcm(kVersions[v], reference, output)) {
+            ok = false;
+            continue;
+        }
+
+        Output time;
+        for (int n = 0; n < iterations; ++n) {
+            Decode(kVersions[v], data, size, false, &time);
+        }
+
+        printf("    %-6s %7.1f ms a pass  (%.2fx)\n", kVersions[v],
+               time.mDecodeUs / 1000.0 / iterations,
+               time.mDecodeUs > 0
+                    ? (double)refTime.mDecodeUs / time.mDecodeUs : 0.0);
+    }
+
+    return ok;
+}
+
+static bool ReadFile(const char *path, uint8_t **data, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open '%s'\n", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        fprintf(stderr, "unable to stat '%s'\n", path);
+        close(fd);
+        return false;
+    }
+
+    *data = (uint8_t *)malloc(st.st_size);
+    *size = 0;
+    while (*size < (size_t)st.st_size) {
+        ssize_t n = read(fd, *data + *size, st.st_size - *size);
+        if (n <= 0) {
+            break;
+        }
+        *size += n;
+    }
+    close(fd);
+    return true;
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n iterations] [-f frames] [file.aac]\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int iterations = 1000;
+    int numFrames = 400;
+
+    int res;
+    while ((res = getopt(argc, argv, "n:f:h")) >= 0) {
+        switch (res) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 'f':
+                numFrames = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc > 1 || iterations <= 0 || numFrames <= 0) {
+        usage(me);
+    }
+
+    printf("picked for this CPU: %s\n", faad_simd_name());
+
+    int result = 0;
+    if (!RunAllKernels(iterations)) {
+        result = 1;
+    }
+
+    // A pass over a stream takes a hundred times longer.
+    int passes = iterations / 100 > 0 ? iterations / 100 : 1;
+
+    if (argc == 1) {
+        uint8_t *data;
+        size_t size;
+        if (!ReadFile(argv[0], &data, &size)) {
+            return 1;
+        }
+        printf("%s\n", argv[0]);
+        if (!Run(data, size, passes)) {
+            result = 1;
+        }
+        free(data);
+    } else {
+        srand(1);
+        for (size_t t = 0; t < NELEM(kStreamTypes); ++t) {
+            uint8_t *data;
+            size_t size;
+            AppendFrames(kStreamTypes[t], numFrames, &data, &size);
+
+            printf("%d Hz %s\n", kStreamTypes[t].mSampleRate,
+                   kStreamTypes[t].mChannels == 2 ? "stereo" : "mono");
+            if (!Run(data, size, passes)) {
+                result = 1;
+            }
+            free(data);
+        }
+    }
+
+    return result;
+}
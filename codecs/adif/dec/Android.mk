@@ -1,8 +1,6 @@
 LOCAL_PATH:= $(call my-dir)
 
-include $(CLEAR_VARS)
-
-  LOCAL_SRC_FILES := \
+adifdec_src_files := \
 			libfaad/bits.c \
 			libfaad/cfft.c \
 			libfaad/decoder.c \
@@ -40,7 +38,16 @@ include $(CLEAR_VARS)
 			libfaad/sbr_qmf.c \
 			libfaad/sbr_syntax.c \
 			libfaad/sbr_tf_grid.c \
-			libfaad/sbr_dec.c 
+			libfaad/sbr_dec.c \
+			libfaad/simd.c
+
+include $(CLEAR_VARS)
+
+  LOCAL_SRC_FILES := $(adifdec_src_files)
+
+  # The NEON kernels are built for NEON and only run where the CPU has it.
+  LOCAL_SRC_FILES_arm += libfaad/simd_neon.c.neon
+  LOCAL_SRC_FILES_arm64 += libfaad/simd_neon.c
 
   LOCAL_C_INCLUDES := \
 	 $(LOCAL_PATH)/libfaad \
@@ -130,3 +137,52 @@ include $(CLEAR_VARS)
   LOCAL_MODULE_TAGS := optional
 
   include $(BUILD_SHARED_LIBRARY)
+
+  ################################################################################
+
+  # Host build of the decoder, and a benchmark that checks the vector
+  # filterbank and QMF kernels against the C code and times them; it also
+  # decodes a given stream, or generated ones, with each.
+  include $(CLEAR_VARS)
+
+  LOCAL_SRC_FILES := $(adifdec_src_files)
+
+  LOCAL_C_INCLUDES := \
+	 $(LOCAL_PATH)/libfaad \
+  	 $(LOCAL_PATH)/libfaad/codebook \
+  	 $(LOCAL_PATH)/include
+
+  LOCAL_CFLAGS := \
+        -DOSCL_UNUSED_ARG=
+
+  LOCAL_MULTILIB := 64
+
+  LOCAL_MODULE := libstagefright_adifdec_host
+  LOCAL_MODULE_TAGS := optional
+
+  include $(BUILD_HOST_STATIC_LIBRARY)
+
+  include $(CLEAR_VARS)
+
+  LOCAL_SRC_FILES := \
+        AacDecBench.cpp
+
+  LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/libfaad \
+  	$(LOCAL_PATH)/libfaad/codebook \
+  	$(LOCAL_PATH)/include
+
+  LOCAL_STATIC_LIBRARIES := \
+	 libstagefright_adifdec_host
+
+  LOCAL_SHARED_LIBRARIES := \
+        liblog
+
+  LOCAL_LDLIBS += -lm -lpthread
+
+  LOCAL_MULTILIB := 64
+
+  LOCAL_MODULE := aacdecbench
+  LOCAL_MODULE_TAGS := debug
+
+  include $(BUILD_HOST_EXECUTABLE)
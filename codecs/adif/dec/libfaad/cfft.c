@@ -44,6 +44,7 @@
 
 #include "cfft.h"
 #include "cfft_tab.h"
+#include "simd.h"
 
 
 /* static function declarations */
@@ -92,7 +93,8 @@ static void passf2pos(const uint16_t ido, const uint16_t l1, const complex_t *cc
             ah = k*ido;
             ac = 2*k*ido;
 
-            for (i = 0; i < ido; i++)
+            i = vector_passf2(ch+ah, ch+ah+l1*ido, cc+ac, cc+ac+ido, wa, ido);
+            for (; i < ido; i++)
             {
                 complex_t t2;
 
@@ -306,7 +308,8 @@ static void passf4pos(const uint16_t ido, const uint16_t l1, const complex_t *cc
 
     if (ido == 1)
     {
-        for (k = 0; k < l1; k++)
+        k = vector_passf4_ido1(ch, cc, l1);
+        for (; k < l1; k++)
         {
             complex_t t1, t2, t3, t4;
 
@@ -340,7 +343,8 @@ static void passf4pos(const uint16_t ido, const uint16_t l1, const complex_t *cc
             ac = 4*k*ido;
             ah = k*ido;
 
-            for (i = 0; i < ido; i++)
+            i = vector_passf4(ch+ah, cc+ac, wa1, wa2, wa3, ido, l1*ido);
+            for (; i < ido; i++)
             {
                 complex_t c2, c3, c4, t1, t2, t3, t4;
 
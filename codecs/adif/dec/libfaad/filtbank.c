@@ -44,6 +44,7 @@
 #include "kbd_win.h"
 #include "sine_win.h"
 #include "mdct.h"
+#include "simd.h"
 
 
 fb_info *filter_bank_init(uint16_t frame_len)
@@ -218,7 +219,8 @@ void ifilter_bank(fb_info *fb, uint8_t window_sequence, uint8_t window_shape,
         imdct_long(fb, freq_in, transf_buf, 2*nlong);
 
         /* add second half output of previous frame to windowed output of current frame */
-        for (i = 0; i < nlong; i+=4)
+        i = vector_window_add(time_out, overlap, transf_buf, window_long_prev, nlong);
+        for (; i < nlong; i+=4)
         {
             time_out[i]   = overlap[i]   + MUL_F(transf_buf[i],window_long_prev[i]);
             time_out[i+1] = overlap[i+1] + MUL_F(transf_buf[i+1],window_long_prev[i+1]);
@@ -227,7 +229,8 @@ void ifilter_bank(fb_info *fb, uint8_t window_sequence, uint8_t window_shape,
         }
 
         /* window the second half and save as overlap for next frame */
-        for (i = 0; i < nlong; i+=4)
+        i = vector_window_rev(overlap, transf_buf+nlong, window_long+nlong-1, nlong);
+        for (; i < nlong; i+=4)
         {
             overlap[i]   = MUL_F(transf_buf[nlong+i],window_long[nlong-1-i]);
             overlap[i+1] = MUL_F(transf_buf[nlong+i+1],window_long[nlong-2-i]);
@@ -241,7 +244,8 @@ void ifilter_bank(fb_info *fb, uint8_t window_sequence, uint8_t window_shape,
         imdct_long(fb, freq_in, transf_buf, 2*nlong);
 
         /* add second half output of previous frame to windowed output of current frame */
-        for (i = 0; i < nlong; i+=4)
+        i = vector_window_add(time_out, overlap, transf_buf, window_long_prev, nlong);
+        for (; i < nlong; i+=4)
         {
             time_out[i]   = overlap[i]   + MUL_F(transf_buf[i],window_long_prev[i]);
             time_out[i+1] = overlap[i+1] + MUL_F(transf_buf[i+1],window_long_prev[i+1]);
@@ -253,7 +257,8 @@ void ifilter_bank(fb_info *fb, uint8_t window_sequence, uint8_t window_shape,
         /* construct second half window using padding with 1's and 0's */
         for (i = 0; i < nflat_ls; i++)
             overlap[i] = transf_buf[nlong+i];
-        for (i = 0; i < nshort; i++)
+        i = vector_window_rev(overlap+nflat_ls, transf_buf+nlong+nflat_ls, window_short+nshort-1, nshort);
+        for (; i < nshort; i++)
             overlap[nflat_ls+i] = MUL_F(transf_buf[nlong+nflat_ls+i],window_short[nshort-i-1]);
         for (i = 0; i < nflat_ls; i++)
             overlap[nflat_ls+nshort+i] = 0;
@@ -305,13 +310,15 @@ void ifilter_bank(fb_info *fb, uint8_t window_sequence, uint8_t window_shape,
         /* construct first half window using padding with 1's and 0's */
         for (i = 0; i < nflat_ls; i++)
             time_out[i] = overlap[i];
-        for (i = 0; i < nshort; i++)
+        i = vector_window_add(time_out+nflat_ls, overlap+nflat_ls, transf_buf+nflat_ls, window_short_prev, nshort);
+        for (; i < nshort; i++)
             time_out[nflat_ls+i] = overlap[nflat_ls+i] + MUL_F(transf_buf[nflat_ls+i],window_short_prev[i]);
         for (i = 0; i < nflat_ls; i++)
             time_out[nflat_ls+nshort+i] = overlap[nflat_ls+nshort+i] + transf_buf[nflat_ls+nshort+i];
 
         /* window the second half and save as overlap for next frame */
-        for (i = 0; i < nlong; i++)
+        i = vector_window_rev(overlap, transf_buf+nlong, window_long+nlong-1, nlong);
+        for (; i < nlong; i++)
             overlap[i] = MUL_F(transf_buf[nlong+i],window_long[nlong-1-i]);
 		break;
     }
@@ -57,6 +57,7 @@
 #include "cfft.h"
 #include "mdct.h"
 #include "mdct_tab.h"
+#include "simd.h"
 
 
 mdct_info *faad_mdct_init(uint16_t N)
@@ -155,7 +156,8 @@ void faad_imdct(mdct_info *mdct, real_t *X_in, real_t *X_out)
 #endif
 
     /* pre-IFFT complex multiplication */
-    for (k = 0; k < N4; k++)
+    k = vector_imdct_pre(Z1, X_in, sincos, N4);
+    for (; k < N4; k++)
     {
         ComplexMult(&IM(Z1[k]), &RE(Z1[k]),
             X_in[2*k], X_in[N2 - 1 - 2*k], RE(sincos[k]), IM(sincos[k]));
@@ -173,7 +175,8 @@ void faad_imdct(mdct_info *mdct, real_t *X_in, real_t *X_out)
 #endif
 
     /* post-IFFT complex multiplication */
-    for (k = 0; k < N4; k++)
+    k = vector_complex_mult(Z1, sincos, N4);
+    for (; k < N4; k++)
     {
         RE(x) = RE(Z1[k]);
         IM(x) = IM(Z1[k]);
@@ -44,6 +44,7 @@
 
 
 #include "sbr_dct.h"
+#include "simd.h"
 
 void DCT4_32(real_t *y, real_t *x)
 {
@@ -1905,7 +1906,8 @@ static void fft_dif(real_t * Real, real_t * Imag)
     // 4*16*2=64*2=128 multiplications
     // 6*16*2=96*2=192 additions
 	// Stage 1 of 32 point FFT decimation in frequency
-    for (i = 0; i < 16; i++)
+    i = vector_butterfly(Real, Imag, 16, w_array_real, w_array_imag, 1, 16);
+    for (; i < 16; i++)
     {
         point1_real = Real[i];
         point1_imag = Imag[i];
@@ -1929,7 +1931,10 @@ static void fft_dif(real_t * Real, real_t * Imag)
         Imag[i2] = (MUL_F(point1_real,w_imag) + MUL_F(point1_imag,w_real));
      }
     // Stage 2 of 32 point FFT decimation in frequency
-    for (j = 0, w_index = 0; j < 8; j++, w_index += 2)
+    j = vector_butterfly(Real, Imag, 8, w_array_real, w_array_imag, 2, 8);
+    vector_butterfly(Real + 16, Imag + 16, 8, w_array_real, w_array_imag, 2, 8);
+    w_index = 2*j;
+    for (; j < 8; j++, w_index += 2)
     {
         w_real = w_array_real[w_index];
         w_imag = w_array_imag[w_index];
@@ -2231,7 +2236,8 @@ void dct4_kernel(real_t * in_real, real_t * in_imag, real_t * out_real, real_t *
     /* Step 2: modulate */
     // 3*32=96 multiplications
     // 3*32=96 additions
-    for (i = 0; i < 32; i++)
+    i = vector_dct4_modulate(in_real, in_imag, dct4_64_tab, 32);
+    for (; i < 32; i++)
     {
     	real_t x_re, x_im, tmp;
     	x_re = in_real[i];
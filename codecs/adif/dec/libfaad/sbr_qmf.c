@@ -40,6 +40,7 @@
 #include "sbr_qmf.h"
 #include "sbr_qmf_c.h"
 #include "sbr_syntax.h"
+#include "simd.h"
 
 qmfa_info *qmfa_init(uint8_t channels)
 {
@@ -66,6 +67,11 @@ void qmfa_end(qmfa_info *qmfa)
     }
 }
 
+/* input buffer offsets of the 5 window taps in sbr_qmf_analysis_32 */
+static const uint16_t qmf32_window_offset[5] = {
+    0, 64, 128, 192, 256
+};
+
 void sbr_qmf_analysis_32(sbr_info *sbr, qmfa_info *qmfa, const real_t *input,
                          qmf_t X[MAX_NTSRHFG][64], uint8_t offset, uint8_t kx)
 {
@@ -98,13 +104,15 @@ void sbr_qmf_analysis_32(sbr_info *sbr, qmfa_info *qmfa, const real_t *input,
         }
 
         /* window and summation to create array u */
-        for (n = 0; n < 64; n++)
+        n = vector_window_sum(u, qmfa->x + qmfa->x_index, qmf32_window_offset,
+                              qmf32_c, 64, 5, 64);
+        for (; n < 64; n++)
         {
-            u[n] = MUL_F(qmfa->x[qmfa->x_index + n], qmf_c[2*n]) +
-                MUL_F(qmfa->x[qmfa->x_index + n + 64], qmf_c[2*(n + 64)]) +
-                MUL_F(qmfa->x[qmfa->x_index + n + 128], qmf_c[2*(n + 128)]) +
-                MUL_F(qmfa->x[qmfa->x_index + n + 192], qmf_c[2*(n + 192)]) +
-                MUL_F(qmfa->x[qmfa->x_index + n + 256], qmf_c[2*(n + 256)]);
+            u[n] = MUL_F(qmfa->x[qmfa->x_index + n], qmf32_c[n]) +
+                MUL_F(qmfa->x[qmfa->x_index + n + 64], qmf32_c[n + 64]) +
+                MUL_F(qmfa->x[qmfa->x_index + n + 128], qmf32_c[n + 128]) +
+                MUL_F(qmfa->x[qmfa->x_index + n + 192], qmf32_c[n + 192]) +
+                MUL_F(qmfa->x[qmfa->x_index + n + 256], qmf32_c[n + 256]);
         }
 
 		/* update ringbuffer index */
@@ -454,6 +462,11 @@ void sbr_qmf_synthesis_32(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][6
     }
 }
 
+/* ring buffer offsets of the 10 window taps in sbr_qmf_synthesis_64 */
+static const uint16_t qmf64_window_offset[10] = {
+    0, 192, 256, 256+192, 512, 512+192, 768, 768+192, 1024, 1024+192
+};
+
 void sbr_qmf_synthesis_64(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][64],
                           real_t *output)
 {
@@ -596,7 +609,19 @@ void sbr_qmf_synthesis_64(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][6
 #endif // #ifdef PREFER_POINTERS
 
         /* calculate 64 output samples and window */
-        for (k = 0; k < 64; k++)
+        k = vector_window_sum(output + out, pring_buffer_1, qmf64_window_offset,
+                              qmf_c, 64, 10, 64);
+        out += k;
+#ifdef PREFER_POINTERS
+        pring_buffer_1 += k; pring_buffer_2 += k; pring_buffer_3 += k;
+        pring_buffer_4 += k; pring_buffer_5 += k; pring_buffer_6 += k;
+        pring_buffer_7 += k; pring_buffer_8 += k; pring_buffer_9 += k;
+        pring_buffer_10 += k;
+        pqmf_c_1 += k; pqmf_c_2 += k; pqmf_c_3 += k; pqmf_c_4 += k;
+        pqmf_c_5 += k; pqmf_c_6 += k; pqmf_c_7 += k; pqmf_c_8 += k;
+        pqmf_c_9 += k; pqmf_c_10 += k;
+#endif
+        for (; k < 64; k++)
         {
 #ifdef PREFER_POINTERS
             output[out++] =
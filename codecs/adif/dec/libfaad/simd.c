@@ -0,0 +1,314 @@
+/*
+** FAAD2 - Freeware Advanced Audio (AAC) Decoder including SBR decoding
+** Copyright (C) 2003-2005 M. Bakker, Nero AG, http://www.nero.com
+**  
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software 
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+** Any non-GPL usage of this software or parts of this software is strictly
+** forbidden.
+**
+** The "appropriate copyright message" mentioned in section 2c of the GPLv2
+** must read: "Code from FAAD2 is copyright (c) Nero AG, www.nero.com"
+**
+** Commercial non-GPL licensing of this software is possible.
+** For more info contact Nero AG through Mpeg4AAClicense@nero.com.
+**
+**/
+
+/*
+ * Picks the vector kernels for the CPU at the first call. On x86 the
+ * SSE2 and AVX versions are built here with function target attributes,
+ * so they do not depend on the compiler flags; the NEON version is in
+ * simd_neon.c.
+ */
+
+#include "common.h"
+#include "structs.h"
+
+#include "simd.h"
+
+#ifdef FAAD_SIMD
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+#define FAAD_SSE2_TARGET __attribute__((target("sse2")))
+#define FAAD_AVX_TARGET __attribute__((target("avx")))
+
+typedef __m128 vec4_t;
+
+static INLINE FAAD_SSE2_TARGET vec4_t vec_load(const real_t *p) { return _mm_loadu_ps(p); }
+static INLINE FAAD_SSE2_TARGET void vec_store(real_t *p, vec4_t v) { _mm_storeu_ps(p, v); }
+static INLINE FAAD_SSE2_TARGET vec4_t vec_add(vec4_t a, vec4_t b) { return _mm_add_ps(a, b); }
+static INLINE FAAD_SSE2_TARGET vec4_t vec_sub(vec4_t a, vec4_t b) { return _mm_sub_ps(a, b); }
+static INLINE FAAD_SSE2_TARGET vec4_t vec_mul(vec4_t a, vec4_t b) { return _mm_mul_ps(a, b); }
+
+static INLINE FAAD_SSE2_TARGET vec4_t vec_reverse(vec4_t a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(0,1,2,3)); }
+static INLINE FAAD_SSE2_TARGET vec4_t vec_swap(vec4_t a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1)); }
+static INLINE FAAD_SSE2_TARGET vec4_t vec_dup_even(vec4_t a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,2,0,0)); }
+static INLINE FAAD_SSE2_TARGET vec4_t vec_dup_odd(vec4_t a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3,3,1,1)); }
+static INLINE FAAD_SSE2_TARGET vec4_t vec_even(vec4_t a, vec4_t b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0)); }
+static INLINE FAAD_SSE2_TARGET vec4_t vec_odd(vec4_t a, vec4_t b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1)); }
+static INLINE FAAD_SSE2_TARGET vec4_t vec_zip_lo(vec4_t a, vec4_t b) { return _mm_unpacklo_ps(a, b); }
+static INLINE FAAD_SSE2_TARGET vec4_t vec_zip_hi(vec4_t a, vec4_t b) { return _mm_unpackhi_ps(a, b); }
+static INLINE FAAD_SSE2_TARGET vec4_t vec_lo_lo(vec4_t a, vec4_t b) { return _mm_movelh_ps(a, b); }
+static INLINE FAAD_SSE2_TARGET vec4_t vec_hi_hi(vec4_t a, vec4_t b) { return _mm_movehl_ps(b, a); }
+
+static INLINE FAAD_SSE2_TARGET vec4_t vec_blend_odd(vec4_t a, vec4_t b)
+{
+    __m128 odd = _mm_castsi128_ps(_mm_setr_epi32(0, -1, 0, -1));
+    return _mm_or_ps(_mm_andnot_ps(odd, a), _mm_and_ps(odd, b));
+}
+
+static INLINE FAAD_SSE2_TARGET vec4_t vec_neg_even(vec4_t a) { return _mm_xor_ps(a, _mm_setr_ps(-0.0f, 0.0f, -0.0f, 0.0f)); }
+
+#define SIMD_TARGET FAAD_SSE2_TARGET
+#define SIMD_NAME(x) x##_sse2
+#define SIMD_ISA "sse2"
+#include "simd_kernels.h"
+
+/* AVX versions of the plain vector loops; the last four values, if
+   any, go through the SSE2 ones. */
+static FAAD_AVX_TARGET uint16_t window_add_avx(real_t *out, const real_t *add,
+                                               const real_t *in, const real_t *win,
+                                               uint16_t len)
+{
+    uint16_t i;
+
+    for (i = 0; i + 8 <= len; i += 8)
+    {
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(add + i),
+            _mm256_mul_ps(_mm256_loadu_ps(in + i), _mm256_loadu_ps(win + i))));
+    }
+    _mm256_zeroupper();
+    return i + window_add_sse2(out + i, add + i, in + i, win + i, len - i);
+}
+
+static FAAD_AVX_TARGET uint16_t window_rev_avx(real_t *out, const real_t *in,
+                                               const real_t *win, uint16_t len)
+{
+    uint16_t i;
+
+    for (i = 0; i + 8 <= len; i += 8)
+    {
+        __m256 w = _mm256_loadu_ps(win - i - 7);
+        /* reverse within the 128 bit lanes, then swap the lanes */
+        w = _mm256_permute_ps(w, _MM_SHUFFLE(0,1,2,3));
+        w = _mm256_permute2f128_ps(w, w, 1);
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(in + i), w));
+    }
+    _mm256_zeroupper();
+    return i + window_rev_sse2(out + i, in + i, win - i, len - i);
+}
+
+static FAAD_AVX_TARGET uint16_t window_sum_avx(real_t *out, const real_t *in,
+                                               const uint16_t *offset, const real_t *c,
+                                               uint16_t c_step, uint8_t taps,
+                                               uint16_t len)
+{
+    uint16_t k;
+    uint8_t j;
+
+    for (k = 0; k + 8 <= len; k += 8)
+    {
+        __m256 sum = _mm256_mul_ps(_mm256_loadu_ps(in + offset[0] + k),
+                                   _mm256_loadu_ps(c + k));
+        for (j = 1; j < taps; j++)
+        {
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(in + offset[j] + k),
+                _mm256_loadu_ps(c + j*c_step + k)));
+        }
+        _mm256_storeu_ps(out + k, sum);
+    }
+    _mm256_zeroupper();
+    return k + window_sum_sse2(out + k, in + k, offset, c + k, c_step, taps, len - k);
+}
+
+static const simd_kernels faad_simd_avx =
+{
+    "avx",
+    window_add_avx,
+    window_rev_avx,
+    window_sum_avx,
+    passf2_sse2,
+    passf4_sse2,
+    passf4_ido1_sse2,
+    imdct_pre_sse2,
+    complex_mult_sse2,
+    butterfly_sse2,
+    dct4_modulate_sse2
+};
+
+/* best first */
+static const simd_kernels *const kernel_list[] = { &faad_simd_avx, &faad_simd_sse2 };
+
+static uint8_t cpu_supports(const char *name)
+{
+    __builtin_cpu_init();
+    if (!strcmp(name, "avx"))
+        return __builtin_cpu_supports("avx") ? 1 : 0;
+    return __builtin_cpu_supports("sse2") ? 1 : 0;
+}
+
+#else
+
+#include <sys/auxv.h>
+
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+
+/* in simd_neon.c, without a name where the compiler has no NEON */
+extern const simd_kernels faad_simd_neon;
+
+static const simd_kernels *const kernel_list[] = { &faad_simd_neon };
+
+static uint8_t cpu_supports(const char *name)
+{
+    (void)name;
+#ifdef __aarch64__
+    return 1;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) ? 1 : 0;
+#endif
+}
+
+#endif
+
+static const simd_kernels *kernels;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+/* The best version the CPU has, or the one named if it has that. */
+static const simd_kernels *find_kernels(const char *name)
+{
+    uint8_t i;
+
+    for (i = 0; i < sizeof(kernel_list)/sizeof(kernel_list[0]); i++)
+    {
+        const simd_kernels *k = kernel_list[i];
+
+        if (k->name != NULL && (name == NULL || !strcmp(k->name, name)) &&
+            cpu_supports(k->name))
+        {
+            return k;
+        }
+    }
+    return NULL;
+}
+
+static void init_kernels(void)
+{
+    kernels = find_kernels(NULL);
+}
+
+static INLINE const simd_kernels *get_kernels(void)
+{
+    pthread_once(&kernels_once, init_kernels);
+    return kernels;
+}
+
+int8_t faad_simd_select(const char *name)
+{
+    const simd_kernels *k = NULL;
+
+    get_kernels();
+    if (strcmp(name, "c") && (k = find_kernels(name)) == NULL)
+        return -1;
+    kernels = k;
+    return 0;
+}
+
+const char *faad_simd_name(void)
+{
+    const simd_kernels *k = get_kernels();
+    return k ? k->name : "c";
+}
+
+uint16_t vector_window_add(real_t *out, const real_t *add, const real_t *in,
+                           const real_t *win, uint16_t len)
+{
+    const simd_kernels *k = get_kernels();
+    return k ? k->window_add(out, add, in, win, len) : 0;
+}
+
+uint16_t vector_window_rev(real_t *out, const real_t *in, const real_t *win,
+                           uint16_t len)
+{
+    const simd_kernels *k = get_kernels();
+    return k ? k->window_rev(out, in, win, len) : 0;
+}
+
+uint16_t vector_window_sum(real_t *out, const real_t *in, const uint16_t *offset,
+                           const real_t *c, uint16_t c_step, uint8_t taps,
+                           uint16_t len)
+{
+    const simd_kernels *k = get_kernels();
+    return k ? k->window_sum(out, in, offset, c, c_step, taps, len) : 0;
+}
+
+uint16_t vector_passf2(complex_t *ch0, complex_t *ch1, const complex_t *cc0,
+                       const complex_t *cc1, const complex_t *wa, uint16_t n)
+{
+    const simd_kernels *k = get_kernels();
+    return k ? k->passf2(ch0, ch1, cc0, cc1, wa, n) : 0;
+}
+
+uint16_t vector_passf4(complex_t *ch, const complex_t *cc, const complex_t *wa1,
+                       const complex_t *wa2, const complex_t *wa3,
+                       uint16_t ido, uint16_t ch_stride)
+{
+    const simd_kernels *k = get_kernels();
+    return k ? k->passf4(ch, cc, wa1, wa2, wa3, ido, ch_stride) : 0;
+}
+
+uint16_t vector_passf4_ido1(complex_t *ch, const complex_t *cc, uint16_t l1)
+{
+    const simd_kernels *k = get_kernels();
+    return k ? k->passf4_ido1(ch, cc, l1) : 0;
+}
+
+uint16_t vector_imdct_pre(complex_t *Z, const real_t *X_in,
+                          const complex_t *sincos, uint16_t n)
+{
+    const simd_kernels *k = get_kernels();
+    return k ? k->imdct_pre(Z, X_in, sincos, n) : 0;
+}
+
+uint16_t vector_complex_mult(complex_t *x, const complex_t *w, uint16_t n)
+{
+    const simd_kernels *k = get_kernels();
+    return k ? k->complex_mult(x, w, n) : 0;
+}
+
+uint16_t vector_butterfly(real_t *re, real_t *im, uint16_t dist,
+                          const real_t *w_re, const real_t *w_im,
+                          uint8_t w_step, uint16_t n)
+{
+    const simd_kernels *k = get_kernels();
+    return k ? k->butterfly(re, im, dist, w_re, w_im, w_step, n) : 0;
+}
+
+uint16_t vector_dct4_modulate(real_t *re, real_t *im, const real_t *tab,
+                              uint16_t n)
+{
+    const simd_kernels *k = get_kernels();
+    return k ? k->dct4_modulate(re, im, tab, n) : 0;
+}
+
+#endif
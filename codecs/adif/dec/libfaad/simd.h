@@ -0,0 +1,184 @@
+/*
+** FAAD2 - Freeware Advanced Audio (AAC) Decoder including SBR decoding
+** Copyright (C) 2003-2005 M. Bakker, Nero AG, http://www.nero.com
+**  
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software 
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+** Any non-GPL usage of this software or parts of this software is strictly
+** forbidden.
+**
+** The "appropriate copyright message" mentioned in section 2c of the GPLv2
+** must read: "Code from FAAD2 is copyright (c) Nero AG, www.nero.com"
+**
+** Commercial non-GPL licensing of this software is possible.
+** For more info contact Nero AG through Mpeg4AAClicense@nero.com.
+**
+**/
+
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Vector kernels for the floating point filterbank, IMDCT and SBR QMF
+ * banks, in NEON, SSE2 and AVX versions.
+ *
+ * The version is picked at the first call for the CPU the decoder runs
+ * on; without a vector unit the plain C code runs. The kernels do the
+ * same operations in the same order as the C loops they stand in for,
+ * just on several values at a time. Each returns how many elements it
+ * did, always from the start and 0 when there is nothing to run on, and
+ * the caller's C loop does the rest.
+ */
+
+#if !defined(FIXED_POINT) && !defined(USE_DOUBLE_PRECISION)
+#if defined(__arm__) || defined(__aarch64__)
+#define FAAD_SIMD
+#elif (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__) && \
+    ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+#define FAAD_SIMD
+#endif
+#endif
+
+#ifdef FAAD_SIMD
+
+/* out[i] = add[i] + in[i]*win[i] */
+uint16_t vector_window_add(real_t *out, const real_t *add, const real_t *in,
+                           const real_t *win, uint16_t len);
+
+/* out[i] = in[i]*win[-i], the window is read backwards from win */
+uint16_t vector_window_rev(real_t *out, const real_t *in, const real_t *win,
+                           uint16_t len);
+
+/* out[k] = in[k+offset[0]]*c[k] + in[k+offset[1]]*c[k+c_step] + ...
+   for taps terms, summed in that order */
+uint16_t vector_window_sum(real_t *out, const real_t *in, const uint16_t *offset,
+                           const real_t *c, uint16_t c_step, uint8_t taps,
+                           uint16_t len);
+
+/* the passf2pos butterfly: ch0[i] = cc0[i] + cc1[i],
+   ch1[i] = (cc0[i] - cc1[i])*wa[i] */
+uint16_t vector_passf2(complex_t *ch0, complex_t *ch1, const complex_t *cc0,
+                       const complex_t *cc1, const complex_t *wa, uint16_t n);
+
+/* the passf4pos butterfly of ido values, cc[i + m*ido] to
+   ch[i + m*ch_stride]; and the one of ido 1 for l1 values of k */
+uint16_t vector_passf4(complex_t *ch, const complex_t *cc, const complex_t *wa1,
+                       const complex_t *wa2, const complex_t *wa3,
+                       uint16_t ido, uint16_t ch_stride);
+uint16_t vector_passf4_ido1(complex_t *ch, const complex_t *cc, uint16_t l1);
+
+/* the IMDCT pre-twiddle of X_in into Z, n of the N/4 products */
+uint16_t vector_imdct_pre(complex_t *Z, const real_t *X_in,
+                          const complex_t *sincos, uint16_t n);
+
+/* x[i] = x[i]*w[i], as ComplexMult does it */
+uint16_t vector_complex_mult(complex_t *x, const complex_t *w, uint16_t n);
+
+/* the fft_dif butterfly: x[i] = x[i] + x[i+dist],
+   x[i+dist] = (x[i] - x[i+dist])*w[w_step*i]; w_step is 1 or 2 */
+uint16_t vector_butterfly(real_t *re, real_t *im, uint16_t dist,
+                          const real_t *w_re, const real_t *w_im,
+                          uint8_t w_step, uint16_t n);
+
+/* the DCT-IV pre-modulation of dct4_kernel, with tab[i], tab[i+n] and
+   tab[i+2*n] */
+uint16_t vector_dct4_modulate(real_t *re, real_t *im, const real_t *tab,
+                              uint16_t n);
+
+/* One table per instruction set. */
+typedef struct
+{
+    const char *name;
+    uint16_t (*window_add)(real_t *out, const real_t *add, const real_t *in,
+                           const real_t *win, uint16_t len);
+    uint16_t (*window_rev)(real_t *out, const real_t *in, const real_t *win,
+                           uint16_t len);
+    uint16_t (*window_sum)(real_t *out, const real_t *in, const uint16_t *offset,
+                           const real_t *c, uint16_t c_step, uint8_t taps,
+                           uint16_t len);
+    uint16_t (*passf2)(complex_t *ch0, complex_t *ch1, const complex_t *cc0,
+                       const complex_t *cc1, const complex_t *wa, uint16_t n);
+    uint16_t (*passf4)(complex_t *ch, const complex_t *cc, const complex_t *wa1,
+                       const complex_t *wa2, const complex_t *wa3,
+                       uint16_t ido, uint16_t ch_stride);
+    uint16_t (*passf4_ido1)(complex_t *ch, const complex_t *cc, uint16_t l1);
+    uint16_t (*imdct_pre)(complex_t *Z, const real_t *X_in,
+                          const complex_t *sincos, uint16_t n);
+    uint16_t (*complex_mult)(complex_t *x, const complex_t *w, uint16_t n);
+    uint16_t (*butterfly)(real_t *re, real_t *im, uint16_t dist,
+                          const real_t *w_re, const real_t *w_im,
+                          uint8_t w_step, uint16_t n);
+    uint16_t (*dct4_modulate)(real_t *re, real_t *im, const real_t *tab,
+                              uint16_t n);
+} simd_kernels;
+
+/* Replaces the version picked for the CPU, for testing: "c", "neon",
+   "sse2" or "avx". Returns 0, or -1 if that version is not built in or
+   the CPU lacks it. Must not be called while a decoder runs. */
+int8_t faad_simd_select(const char *name);
+
+/* The version in use, "c" when there is none. */
+const char *faad_simd_name(void);
+
+#else
+
+/* Nothing to run on, the C loops do all of it. */
+static INLINE uint16_t vector_window_add(real_t *out, const real_t *add, const real_t *in,
+                                         const real_t *win, uint16_t len)
+{ return 0; }
+static INLINE uint16_t vector_window_rev(real_t *out, const real_t *in, const real_t *win,
+                                         uint16_t len)
+{ return 0; }
+static INLINE uint16_t vector_window_sum(real_t *out, const real_t *in, const uint16_t *offset,
+                                         const real_t *c, uint16_t c_step, uint8_t taps,
+                                         uint16_t len)
+{ return 0; }
+static INLINE uint16_t vector_passf2(complex_t *ch0, complex_t *ch1, const complex_t *cc0,
+                                     const complex_t *cc1, const complex_t *wa, uint16_t n)
+{ return 0; }
+static INLINE uint16_t vector_passf4(complex_t *ch, const complex_t *cc, const complex_t *wa1,
+                                     const complex_t *wa2, const complex_t *wa3,
+                                     uint16_t ido, uint16_t ch_stride)
+{ return 0; }
+static INLINE uint16_t vector_passf4_ido1(complex_t *ch, const complex_t *cc, uint16_t l1)
+{ return 0; }
+static INLINE uint16_t vector_imdct_pre(complex_t *Z, const real_t *X_in,
+                                        const complex_t *sincos, uint16_t n)
+{ return 0; }
+static INLINE uint16_t vector_complex_mult(complex_t *x, const complex_t *w, uint16_t n)
+{ return 0; }
+static INLINE uint16_t vector_butterfly(real_t *re, real_t *im, uint16_t dist,
+                                        const real_t *w_re, const real_t *w_im,
+                                        uint8_t w_step, uint16_t n)
+{ return 0; }
+static INLINE uint16_t vector_dct4_modulate(real_t *re, real_t *im, const real_t *tab,
+                                            uint16_t n)
+{ return 0; }
+
+static INLINE int8_t faad_simd_select(const char *name)
+{ return (name[0] == 'c' && name[1] == '\0') ? 0 : -1; }
+static INLINE const char *faad_simd_name(void)
+{ return "c"; }
+
+#endif /* FAAD_SIMD */
+
+#ifdef __cplusplus
+}
+#endif
+#endif
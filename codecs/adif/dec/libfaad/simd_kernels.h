@@ -0,0 +1,281 @@
+/*
+** FAAD2 - Freeware Advanced Audio (AAC) Decoder including SBR decoding
+** Copyright (C) 2003-2005 M. Bakker, Nero AG, http://www.nero.com
+**  
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software 
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+** Any non-GPL usage of this software or parts of this software is strictly
+** forbidden.
+**
+** The "appropriate copyright message" mentioned in section 2c of the GPLv2
+** must read: "Code from FAAD2 is copyright (c) Nero AG, www.nero.com"
+**
+** Commercial non-GPL licensing of this software is possible.
+** For more info contact Nero AG through Mpeg4AAClicense@nero.com.
+**
+**/
+
+/*
+ * The vector kernels, written once on four float wide vec4_t helpers.
+ * simd.c and simd_neon.c include this after defining the helpers for
+ * their instruction set, SIMD_TARGET for the function attributes it
+ * needs, SIMD_NAME() for the suffix of the names and SIMD_ISA for the
+ * name of the table. Complex values are
+ * kept interleaved like complex_t, two per vector.
+ */
+
+/* Two interleaved complex products, as ComplexMult does them:
+   re = a.re*w.re - a.im*w.im, im = a.im*w.re + a.re*w.im
+   Negating a product and adding it is exactly the same as subtracting it. */
+static INLINE SIMD_TARGET vec4_t vec_cmul(vec4_t a, vec4_t w)
+{
+    return vec_add(vec_mul(a, vec_dup_even(w)),
+                   vec_neg_even(vec_mul(vec_swap(a), vec_dup_odd(w))));
+}
+
+static SIMD_TARGET uint16_t SIMD_NAME(window_add)(real_t *out, const real_t *add,
+                                                  const real_t *in, const real_t *win,
+                                                  uint16_t len)
+{
+    uint16_t i;
+
+    for (i = 0; i + 4 <= len; i += 4)
+    {
+        vec_store(out + i, vec_add(vec_load(add + i),
+            vec_mul(vec_load(in + i), vec_load(win + i))));
+    }
+    return i;
+}
+
+static SIMD_TARGET uint16_t SIMD_NAME(window_rev)(real_t *out, const real_t *in,
+                                                  const real_t *win, uint16_t len)
+{
+    uint16_t i;
+
+    for (i = 0; i + 4 <= len; i += 4)
+    {
+        vec_store(out + i, vec_mul(vec_load(in + i),
+            vec_reverse(vec_load(win - i - 3))));
+    }
+    return i;
+}
+
+static INLINE SIMD_TARGET vec4_t load_coef(const real_t *c, uint8_t stride)
+{
+    if (stride == 2)
+        return vec_even(vec_load(c), vec_load(c + 4));
+    return vec_load(c);
+}
+
+static SIMD_TARGET uint16_t SIMD_NAME(window_sum)(real_t *out, const real_t *in,
+                                                  const uint16_t *offset, const real_t *c,
+                                                  uint16_t c_step, uint8_t taps,
+                                                  uint16_t len)
+{
+    uint16_t k;
+    uint8_t j;
+
+    for (k = 0; k + 4 <= len; k += 4)
+    {
+        vec4_t sum = vec_mul(vec_load(in + offset[0] + k), vec_load(c + k));
+
+        for (j = 1; j < taps; j++)
+        {
+            sum = vec_add(sum, vec_mul(vec_load(in + offset[j] + k),
+                vec_load(c + j*c_step + k)));
+        }
+        vec_store(out + k, sum);
+    }
+    return k;
+}
+
+static SIMD_TARGET uint16_t SIMD_NAME(passf2)(complex_t *ch0, complex_t *ch1,
+                                              const complex_t *cc0, const complex_t *cc1,
+                                              const complex_t *wa, uint16_t n)
+{
+    uint16_t i;
+
+    for (i = 0; i + 2 <= n; i += 2)
+    {
+        vec4_t x0 = vec_load(&RE(cc0[i]));
+        vec4_t x1 = vec_load(&RE(cc1[i]));
+
+        vec_store(&RE(ch0[i]), vec_add(x0, x1));
+        vec_store(&RE(ch1[i]), vec_cmul(vec_sub(x0, x1), vec_load(&RE(wa[i]))));
+    }
+    return i;
+}
+
+/* t4 of passf4pos: RE(t4) = IM(x3) - IM(x1), IM(t4) = RE(x1) - RE(x3) */
+static INLINE SIMD_TARGET vec4_t passf4_t4(vec4_t x1, vec4_t x3)
+{
+    return vec_swap(vec_blend_odd(vec_sub(x1, x3), vec_sub(x3, x1)));
+}
+
+static SIMD_TARGET uint16_t SIMD_NAME(passf4)(complex_t *ch, const complex_t *cc,
+                                              const complex_t *wa1, const complex_t *wa2,
+                                              const complex_t *wa3, uint16_t ido,
+                                              uint16_t ch_stride)
+{
+    uint16_t i;
+
+    for (i = 0; i + 2 <= ido; i += 2)
+    {
+        vec4_t x0 = vec_load(&RE(cc[i]));
+        vec4_t x1 = vec_load(&RE(cc[i+ido]));
+        vec4_t x2 = vec_load(&RE(cc[i+2*ido]));
+        vec4_t x3 = vec_load(&RE(cc[i+3*ido]));
+        vec4_t t1, t2, t3, t4;
+
+        t2 = vec_add(x0, x2);
+        t1 = vec_sub(x0, x2);
+        t3 = vec_add(x1, x3);
+        t4 = passf4_t4(x1, x3);
+
+        vec_store(&RE(ch[i]), vec_add(t2, t3));
+        vec_store(&RE(ch[i+ch_stride]),
+            vec_cmul(vec_add(t1, t4), vec_load(&RE(wa1[i]))));
+        vec_store(&RE(ch[i+2*ch_stride]),
+            vec_cmul(vec_sub(t2, t3), vec_load(&RE(wa2[i]))));
+        vec_store(&RE(ch[i+3*ch_stride]),
+            vec_cmul(vec_sub(t1, t4), vec_load(&RE(wa3[i]))));
+    }
+    return i;
+}
+
+static SIMD_TARGET uint16_t SIMD_NAME(passf4_ido1)(complex_t *ch, const complex_t *cc,
+                                                   uint16_t l1)
+{
+    uint16_t k;
+
+    for (k = 0; k + 2 <= l1; k += 2)
+    {
+        vec4_t a, b, c, d, x0, x1, x2, x3, t1, t2, t3, t4;
+
+        /* cc[4*k .. 4*k+3] of two k, transposed to x0..x3 of both */
+        a = vec_load(&RE(cc[4*k]));
+        b = vec_load(&RE(cc[4*k+2]));
+        c = vec_load(&RE(cc[4*k+4]));
+        d = vec_load(&RE(cc[4*k+6]));
+        x0 = vec_lo_lo(a, c);
+        x1 = vec_hi_hi(a, c);
+        x2 = vec_lo_lo(b, d);
+        x3 = vec_hi_hi(b, d);
+
+        t2 = vec_add(x0, x2);
+        t1 = vec_sub(x0, x2);
+        t3 = vec_add(x1, x3);
+        t4 = passf4_t4(x1, x3);
+
+        vec_store(&RE(ch[k]),      vec_add(t2, t3));
+        vec_store(&RE(ch[k+2*l1]), vec_sub(t2, t3));
+        vec_store(&RE(ch[k+l1]),   vec_add(t1, t4));
+        vec_store(&RE(ch[k+3*l1]), vec_sub(t1, t4));
+    }
+    return k;
+}
+
+static SIMD_TARGET uint16_t SIMD_NAME(imdct_pre)(complex_t *Z, const real_t *X_in,
+                                                 const complex_t *sincos, uint16_t n)
+{
+    uint16_t N2 = 2*n;
+    uint16_t k;
+
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+        /* X_in[2*k] and X_in[N2 - 1 - 2*k] of four k */
+        vec4_t x1 = vec_even(vec_load(X_in + 2*k), vec_load(X_in + 2*k + 4));
+        vec4_t x2 = vec_reverse(vec_odd(vec_load(X_in + N2 - 8 - 2*k),
+                                        vec_load(X_in + N2 - 4 - 2*k)));
+        vec4_t s0 = vec_load(&RE(sincos[k]));
+        vec4_t s1 = vec_load(&RE(sincos[k + 2]));
+        vec4_t c1 = vec_even(s0, s1);
+        vec4_t c2 = vec_odd(s0, s1);
+        vec4_t im = vec_add(vec_mul(x1, c1), vec_mul(x2, c2));
+        vec4_t re = vec_sub(vec_mul(x2, c1), vec_mul(x1, c2));
+
+        vec_store(&RE(Z[k]),     vec_zip_lo(re, im));
+        vec_store(&RE(Z[k + 2]), vec_zip_hi(re, im));
+    }
+    return k;
+}
+
+static SIMD_TARGET uint16_t SIMD_NAME(complex_mult)(complex_t *x, const complex_t *w,
+                                                    uint16_t n)
+{
+    uint16_t k;
+
+    for (k = 0; k + 2 <= n; k += 2)
+        vec_store(&RE(x[k]), vec_cmul(vec_load(&RE(x[k])), vec_load(&RE(w[k]))));
+    return k;
+}
+
+static SIMD_TARGET uint16_t SIMD_NAME(butterfly)(real_t *re, real_t *im, uint16_t dist,
+                                                 const real_t *w_re, const real_t *w_im,
+                                                 uint8_t w_step, uint16_t n)
+{
+    uint16_t i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        vec4_t p1_re = vec_load(re + i);
+        vec4_t p1_im = vec_load(im + i);
+        vec4_t p2_re = vec_load(re + i + dist);
+        vec4_t p2_im = vec_load(im + i + dist);
+        vec4_t wr = load_coef(w_re + w_step*i, w_step);
+        vec4_t wi = load_coef(w_im + w_step*i, w_step);
+
+        vec_store(re + i, vec_add(p1_re, p2_re));
+        vec_store(im + i, vec_add(p1_im, p2_im));
+
+        p1_re = vec_sub(p1_re, p2_re);
+        p1_im = vec_sub(p1_im, p2_im);
+        vec_store(re + i + dist, vec_sub(vec_mul(p1_re, wr), vec_mul(p1_im, wi)));
+        vec_store(im + i + dist, vec_add(vec_mul(p1_re, wi), vec_mul(p1_im, wr)));
+    }
+    return i;
+}
+
+static SIMD_TARGET uint16_t SIMD_NAME(dct4_modulate)(real_t *re, real_t *im,
+                                                     const real_t *tab, uint16_t n)
+{
+    uint16_t i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        vec4_t x_re = vec_load(re + i);
+        vec4_t x_im = vec_load(im + i);
+        vec4_t tmp = vec_mul(vec_add(x_re, x_im), vec_load(tab + i));
+
+        vec_store(re + i, vec_add(vec_mul(x_im, vec_load(tab + i + 2*n)), tmp));
+        vec_store(im + i, vec_add(vec_mul(x_re, vec_load(tab + i + n)), tmp));
+    }
+    return i;
+}
+
+const simd_kernels SIMD_NAME(faad_simd) =
+{
+    SIMD_ISA,
+    SIMD_NAME(window_add),
+    SIMD_NAME(window_rev),
+    SIMD_NAME(window_sum),
+    SIMD_NAME(passf2),
+    SIMD_NAME(passf4),
+    SIMD_NAME(passf4_ido1),
+    SIMD_NAME(imdct_pre),
+    SIMD_NAME(complex_mult),
+    SIMD_NAME(butterfly),
+    SIMD_NAME(dct4_modulate)
+};
@@ -0,0 +1,108 @@
+/*
+** FAAD2 - Freeware Advanced Audio (AAC) Decoder including SBR decoding
+** Copyright (C) 2003-2005 M. Bakker, Nero AG, http://www.nero.com
+**  
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+** 
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+** 
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software 
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+** Any non-GPL usage of this software or parts of this software is strictly
+** forbidden.
+**
+** The "appropriate copyright message" mentioned in section 2c of the GPLv2
+** must read: "Code from FAAD2 is copyright (c) Nero AG, www.nero.com"
+**
+** Commercial non-GPL licensing of this software is possible.
+** For more info contact Nero AG through Mpeg4AAClicense@nero.com.
+**
+**/
+
+/*
+ * NEON versions of the vector kernels. Built with NEON enabled; armv7
+ * CPUs without it get the C code, see simd.c.
+ */
+
+#include "common.h"
+#include "structs.h"
+
+#include "simd.h"
+
+#if defined(FAAD_SIMD) && (defined(__ARM_NEON__) || defined(__ARM_NEON) || defined(__aarch64__))
+
+#include <arm_neon.h>
+
+typedef float32x4_t vec4_t;
+
+static INLINE vec4_t vec_load(const real_t *p) { return vld1q_f32(p); }
+static INLINE void vec_store(real_t *p, vec4_t v) { vst1q_f32(p, v); }
+static INLINE vec4_t vec_add(vec4_t a, vec4_t b) { return vaddq_f32(a, b); }
+static INLINE vec4_t vec_sub(vec4_t a, vec4_t b) { return vsubq_f32(a, b); }
+static INLINE vec4_t vec_mul(vec4_t a, vec4_t b) { return vmulq_f32(a, b); }
+
+/* [a3 a2 a1 a0] */
+static INLINE vec4_t vec_reverse(vec4_t a)
+{
+    a = vrev64q_f32(a);
+    return vcombine_f32(vget_high_f32(a), vget_low_f32(a));
+}
+
+/* [a1 a0 a3 a2], swaps real and imaginary parts */
+static INLINE vec4_t vec_swap(vec4_t a) { return vrev64q_f32(a); }
+
+/* [a0 a0 a2 a2] and [a1 a1 a3 a3] */
+static INLINE vec4_t vec_dup_even(vec4_t a) { return vtrnq_f32(a, a).val[0]; }
+static INLINE vec4_t vec_dup_odd(vec4_t a) { return vtrnq_f32(a, a).val[1]; }
+
+/* [a0 a2 b0 b2] and [a1 a3 b1 b3] */
+static INLINE vec4_t vec_even(vec4_t a, vec4_t b) { return vuzpq_f32(a, b).val[0]; }
+static INLINE vec4_t vec_odd(vec4_t a, vec4_t b) { return vuzpq_f32(a, b).val[1]; }
+
+/* [a0 b0 a1 b1] and [a2 b2 a3 b3] */
+static INLINE vec4_t vec_zip_lo(vec4_t a, vec4_t b) { return vzipq_f32(a, b).val[0]; }
+static INLINE vec4_t vec_zip_hi(vec4_t a, vec4_t b) { return vzipq_f32(a, b).val[1]; }
+
+/* [a0 a1 b0 b1] and [a2 a3 b2 b3] */
+static INLINE vec4_t vec_lo_lo(vec4_t a, vec4_t b)
+{
+    return vcombine_f32(vget_low_f32(a), vget_low_f32(b));
+}
+static INLINE vec4_t vec_hi_hi(vec4_t a, vec4_t b)
+{
+    return vcombine_f32(vget_high_f32(a), vget_high_f32(b));
+}
+
+/* [a0 b1 a2 b3] */
+static INLINE vec4_t vec_blend_odd(vec4_t a, vec4_t b)
+{
+    static const uint32_t odd[4] = { 0, ~0u, 0, ~0u };
+    return vbslq_f32(vld1q_u32(odd), b, a);
+}
+
+/* flips the sign of a0 and a2 */
+static INLINE vec4_t vec_neg_even(vec4_t a)
+{
+    static const uint32_t sign[4] = { 0x80000000, 0, 0x80000000, 0 };
+    return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), vld1q_u32(sign)));
+}
+
+#define SIMD_TARGET
+#define SIMD_NAME(x) x##_neon
+#define SIMD_ISA "neon"
+#include "simd_kernels.h"
+
+#elif defined(FAAD_SIMD) && defined(__arm__)
+
+/* Built without NEON: an empty table, so there is nothing to pick. */
+const simd_kernels faad_simd_neon = { NULL };
+
+#endif
@@ -22,3 +22,28 @@ LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
 
+
+#####################################################################################################
+
+# Decodes generated frames with the C filter kernel and the SIMD ones,
+# checks they agree bit for bit and compares their speed.
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        apedec.c    \
+        ApeDecBench.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/
+
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+	LOCAL_CFLAGS += -D__ARM_HAVE_NEON -DOPT_NEON
+endif
+
+LOCAL_SHARED_LIBRARIES := \
+        libutils liblog
+
+LOCAL_MODULE := apedecbench
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,407 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Decodes Monkey's Audio frames with the C filter kernel and with every
+// SIMD kernel built in and supported by this CPU, checks that all of them
+// give the same samples bit for bit, and reports the decoding speed of
+// each. The frames are generated with an encoder for the version 3.99
+// entropy coding, mono and stereo at every compression level, from random
+// residuals whose size wanders like music does, so the filters of every
+// order adapt all the time.
+//
+// usage: apedecbench [-n iterations] [-b blocks]
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ApeDecBench"
+#include <utils/Log.h>
+
+#include "apedec.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace android {
+
+static const char *kKernels[] = { "neon", "sse2", "ssse3", "avx2" };
+
+struct Config {
+    int mFileVersion;
+    int mCompressionLevel;
+    int mChannels;
+};
+
+static const Config kConfigs[] = {
+    { 3990, 1000, 2 },
+    { 3990, 2000, 2 },
+    { 3990, 3000, 2 },
+    { 3990, 4000, 2 },
+    { 3990, 5000, 2 },
+    { 3990, 3000, 1 },
+    { 3990, 5000, 1 },
+    { 3990, 4000, 1 },
+};
+
+// Monkey's Audio's range coder, the encoder side of the one in apedec.c.
+struct RangeEncoder {
+    static const uint32_t kTopValue = 1u << 31;
+    static const uint32_t kBottomValue = kTopValue >> 8;
+    static const int kShiftBits = 23;
+
+    RangeEncoder(uint8_t headerByte)
+        : mData(NULL),
+          mSize(0),
+          mCapacity(0),
+          mLow(0),
+          mRange(kTopValue),
+          mBuffer(headerByte),
+          mHelp(0) {
+    }
+
+    void put(uint8_t byte) {
+        if (mSize == mCapacity) {
+            mCapacity = mCapacity ? mCapacity * 2 : 65536;
+            mData = (uint8_t *)realloc(mData, mCapacity);
+        }
+        mData[mSize++] = byte;
+    }
+
+    void putBE32(uint32_t x) {
+        put(x >> 24);
+        put(x >> 16);
+        put(x >> 8);
+        put(x);
+    }
+
+    // Moves the top byte of "low" out, holding back runs of 0xff until
+    // it is known whether a carry ripples into them.
+    void shiftLow() {
+        if (mLow < (0xffu << kShiftBits)) {
+            put(mBuffer);
+            for (; mHelp > 0; --mHelp) {
+                put(0xff);
+            }
+            mBuffer = mLow >> kShiftBits;
+        } else if (mLow & kTopValue) {
+            put(mBuffer + 1);
+            for (; mHelp > 0; --mHelp) {
+                put(0);
+            }
+            mBuffer = mLow >> kShiftBits;
+        } else {
+            ++mHelp;
+        }
+        mLow = (mLow << 8) & (kTopValue - 1);
+    }
+
+    void normalize() {
+        while (mRange <= kBottomValue) {
+            shiftLow();
+            mRange <<= 8;
+        }
+    }
+
+    void encode(uint32_t help, uint32_t cumFreq, uint32_t freq) {
+        mLow += help * cumFreq;
+        mRange = help * freq;
+    }
+
+    void encodeShift(uint32_t cumFreq, uint32_t freq, int shift) {
+        normalize();
+        encode(mRange >> shift, cumFreq, freq);
+    }
+
+    void encodeFreq(uint32_t cumFreq, uint32_t freq, uint32_t totFreq) {
+        normalize();
+        encode(mRange / totFreq, cumFreq, freq);
+    }
+
+    void finish() {
+        normalize();
+        for (int i = 0; i < 5; ++i) {
+            shiftLow();
+        }
+    }
+
+    uint8_t *mData;
+    size_t mSize;
+    size_t mCapacity;
+
+    uint32_t mLow;
+    uint32_t mRange;
+    uint8_t mBuffer;
+    uint32_t mHelp;
+};
+
+struct Rice {
+    uint32_t mK;
+    uint32_t mKSum;
+};
+
+// Symbol model of version 3.98 and later.
+static const uint16_t kCounts[22] = {
+        0, 19578, 36160, 48417, 56323, 60899, 63265, 64435,
+    64971, 65232, 65351, 65416, 65447, 65466, 65476, 65482,
+    65485, 65488, 65490, 65491, 65492, 65493,
+};
+
+static const uint32_t kEscape = 65535;
+
+static void EncodeValue(RangeEncoder *rc, Rice *rice, int32_t value) {
+    uint32_t x = value > 0 ? 2 * (uint32_t)value - 1 : -2 * value;
+
+    uint32_t pivot = rice->mKSum >> 5;
+    if (pivot == 0) {
+        pivot = 1;
+    }
+
+    uint32_t overflow = x / pivot;
+    uint32_t base = x % pivot;
+
+    if (overflow < NELEM(kCounts) - 1) {
+        rc->encodeShift(kCounts[overflow],
+                        kCounts[overflow + 1] - kCounts[overflow], 16);
+    } else {
+        rc->encodeShift(kEscape, 1, 16);
+        rc->encodeShift(overflow >> 16, 1, 16);
+        rc->encodeShift(overflow & 0xffff, 1, 16);
+    }
+
+    if (pivot < 0x10000) {
+        rc->encodeFreq(base, 1, pivot);
+    } else {
+        int bbits = 0;
+        while ((pivot >> bbits) & ~0xffff) {
+            ++bbits;
+        }
+        rc->encodeFreq(base >> bbits, 1, (pivot >> bbits) + 1);
+        rc->encodeFreq(base & ((1u << bbits) - 1), 1, 1u << bbits);
+    }
+
+    uint32_t lim = rice->mK ? (1u << (rice->mK + 4)) : 0;
+    rice->mKSum += (x + 1) / 2 - ((rice->mKSum + 16) >> 5);
+    if (rice->mKSum < lim) {
+        --rice->mK;
+    } else if (rice->mKSum >= (1u << (rice->mK + 5))) {
+        ++rice->mK;
+    }
+}
+
+// A version 3.99 frame the way the extractor hands it over: every 32 bit
+// word byte swapped, starting with the block count and the byte offset,
+// then the CRC without frame flags and the range coded residuals.
+static uint8_t *MakeFrame(uint32_t numBlocks, int channels, size_t *size) {
+    RangeEncoder rc(0);
+    rc.putBE32(numBlocks);
+    rc.putBE32(0);
+    rc.putBE32(rand() & 0x7fffffff);
+
+    Rice rice[2] = { { 10, 16 << 10 }, { 10, 16 << 10 } };
+    int32_t amplitude = 256;
+    for (uint32_t i = 0; i < numBlocks; ++i) {
+        if ((i & 255) == 0) {
+            amplitude = amplitude * (rand() % 3 + 1) / 2 + 4;
+            if (amplitude > 8192) {
+                amplitude = 8192;
+            }
+        }
+        for (int c = 0; c < channels; ++c) {
+            EncodeValue(&rc, &rice[c], rand() % (2 * amplitude + 1) - amplitude);
+        }
+    }
+    rc.finish();
+
+    // Room for the decoder to read ahead past the last symbol.
+    for (int i = 0; i < 8 || (rc.mSize & 3); ++i) {
+        rc.put(0);
+    }
+
+    for (size_t i = 0; i < rc.mSize; i += 4) {
+        uint8_t *p = rc.mData + i;
+        uint8_t t = p[0];
+        p[0] = p[3];
+        p[3] = t;
+        t = p[1];
+        p[1] = p[2];
+        p[2] = t;
+    }
+
+    *size = rc.mSize;
+    return rc.mData;
+}
+
+static int64_t NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+struct Output {
+    Output()
+        : mData(NULL),
+          mSize(0),
+          mNumErrors(0),
+          mDecodeUs(0) {
+    }
+
+    ~Output() {
+        free(mData);
+    }
+
+    uint8_t *mData;
+    size_t mSize;
+    int mNumErrors;
+    int64_t mDecodeUs;
+};
+
+// Decodes the frame in 8192 block slices, the way SoftApe drives the
+// decoder, and appends the samples.
+static bool Decode(
+        const char *kernel, const Config &config,
+        uint8_t *frame, size_t size, bool keep, Output *output) {
+    APEContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    uint8_t extradata[6];
+    extradata[0] = config.mFileVersion;
+    extradata[1] = config.mFileVersion >> 8;
+    extradata[2] = config.mCompressionLevel;
+    extradata[3] = config.mCompressionLevel >> 8;
+    extradata[4] = 0;
+    extradata[5] = 0;
+
+    if (ape_decode_init(&ctx, extradata, sizeof(extradata), config.mChannels, 16) != 0
+            || ape_select_dsp(&ctx, kernel) != 0) {
+        ape_decode_close(&ctx);
+        return false;
+    }
+
+    int16_t pcm[8192 * 2];
+
+    int64_t startUs = NowUs();
+    do {
+        int pcmSize = sizeof(pcm);
+        if (ape_decode_frame(&ctx, frame, size, pcm, &pcmSize) < 0) {
+            ++output->mNumErrors;
+            break;
+        }
+
+        if (keep && pcmSize > 0) {
+            output->mData = (uint8_t *)realloc(output->mData, output->mSize + pcmSize);
+            memcpy(output->mData + output->mSize, pcm, pcmSize);
+        }
+        output->mSize += pcmSize;
+    } while (ctx.samples > 0);
+    output->mDecodeUs += NowUs() - startUs;
+
+    ape_decode_close(&ctx);
+    return true;
+}
+
+static bool Run(const Config &config, uint32_t numBlocks, int iterations) {
+    size_t size;
+    uint8_t *frame = MakeFrame(numBlocks, config.mChannels, &size);
+
+    printf("version %d level %d %s\n", config.mFileVersion,
+           config.mCompressionLevel, config.mChannels == 2 ? "stereo" : "mono");
+
+    Output reference;
+    Decode("c", config, frame, size, true, &reference);
+
+    Output refTime;
+    for (int n = 0; n < iterations; ++n) {
+        Decode("c", config, frame, size, false, &refTime);
+    }
+
+    double mb = (double)refTime.mSize / (1024 * 1024);
+    printf("    c:     %7.1f MB/s  (%zu bytes, %d errors)\n",
+           mb * 1E6 / (refTime.mDecodeUs > 0 ? refTime.mDecodeUs : 1),
+           reference.mSize, reference.mNumErrors);
+
+    bool ok = true;
+    for (size_t k = 0; k < NELEM(kKernels); ++k) {
+        Output output;
+        if (!Decode(kKernels[k], config, frame, size, true, &output)) {
+            continue;
+        }
+
+        if (reference.mSize != output.mSize
+                || reference.mNumErrors != output.mNumErrors
+                || memcmp(reference.mData, output.mData, reference.mSize) != 0) {
+            size_t i = 0;
+            while (i < reference.mSize && i < output.mSize
+                    && reference.mData[i] == output.mData[i]) {
+                ++i;
+            }
+            fprintf(stderr, "    %s: %zu bytes decoded, expected %zu, "
+                    "first difference at byte %zu\n",
+                    kKernels[k], output.mSize, reference.mSize, i);
+            ok = false;
+            continue;
+        }
+
+        Output time;
+        for (int n = 0; n < iterations; ++n) {
+            Decode(kKernels[k], config, frame, size, false, &time);
+        }
+
+        printf("    %-6s %7.1f MB/s  (%.2fx)\n", kKernels[k],
+               mb * 1E6 / (time.mDecodeUs > 0 ? time.mDecodeUs : 1),
+               time.mDecodeUs > 0
+                    ? (double)refTime.mDecodeUs / time.mDecodeUs : 0.0);
+    }
+
+    free(frame);
+    return ok;
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n iterations] [-b blocks]\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int iterations = 5;
+    // A frame of the normal and high compression levels.
+    int numBlocks = 73728;
+
+    int res;
+    while ((res = getopt(argc, argv, "n:b:h")) >= 0) {
+        switch (res) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 'b':
+                numBlocks = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    if (argc != optind || iterations <= 0 || numBlocks <= 0) {
+        usage(me);
+    }
+
+    srand(1);
+
+    int result = 0;
+    for (size_t i = 0; i < NELEM(kConfigs); ++i) {
+        if (!Run(kConfigs[i], numBlocks, iterations)) {
+            result = 1;
+        }
+    }
+
+    return result;
+}
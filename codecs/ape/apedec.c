@@ -31,9 +31,18 @@
 #include <utils/Log.h>
 #ifdef __ARM_HAVE_NEON
 #include <arm_neon.h>
+#elif defined(__SSE2__)
+#define APE_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+#define APE_SSSE3_AVX2 1
+#include <immintrin.h>
+#endif
 #endif
 #define PRINTF ALOGI
 
+static void ape_dsp_init(APEContext *s);
+
 //---------------------------------------------------------------------
 av_cold int ape_decode_close(APEContext *s)
 {
@@ -88,6 +97,7 @@ av_cold int ape_decode_init(APEContext *s,uint8_t *extradata,int extradata_size,
         return AVERROR_INVALIDDATA;
     }
     s->fset = s->compression_level / 1000 - 1;
+    ape_dsp_init(s);
     for (i = 0; i < APE_FILTER_LEVELS; i++) {
         if (!ape_filter_orders[s->fset][i])
             break;
@@ -539,78 +549,187 @@ static void init_filter(APEContext *ctx, APEFilter *f, int16_t *buf, int order)
     do_init_filter(&f[0], buf, order);
     do_init_filter(&f[1], buf + order * 3 + HISTORY_SIZE, order);
 }
-static int32_t scalarproduct_int16_c(int16_t * v1, int16_t * v2, int order, int shift)
-{
-    int res = 0;
-	
-#ifndef __ARM_HAVE_NEON
-    while (order--)
-        res += (*v1++ * *v2++)/* >> shift*/;
-#else
-	int j=order/4;
-	int k=order%4;
-	int32x4_t neonres=vdupq_n_s32(0);
-	
-	while(j--) {
-		neonres = vmlal_s16(neonres, vld1_s16(v1),vld1_s16(v2));
-		v1+=4;
-		v2+=4;
-	}
-
-	while(k--) {
-		res += (*v1++ * *v2++);
-	}
-
-	res += vgetq_lane_s32(neonres, 0) + vgetq_lane_s32(neonres, 1) +
-		vgetq_lane_s32(neonres, 2) + vgetq_lane_s32(neonres, 3);
+/**
+ * The filter kernels below compute the scalar product of the coefficients
+ * with the history and adapt the coefficients in the same pass, so both
+ * arrays are read only once per sample. All versions wrap around exactly
+ * like the C one in apedec.h: the products are summed mod 2^32 and the
+ * coefficients are updated mod 2^16.
+ * The SSSE3 and AVX2 versions use psignw for mul * v3, which is only the
+ * same as the multiplication for mul in {-1, 0, 1}. do_apply_filter only
+ * ever passes APESIGN().
+ */
+#ifdef __ARM_HAVE_NEON
+static int32_t scalarproduct_and_madd_int16_neon(int16_t *v1, const int16_t *v2,
+                                                 const int16_t *v3, int order, int mul)
+{
+    int32x4_t res0 = vdupq_n_s32(0);
+    int32x4_t res1 = vdupq_n_s32(0);
+    int32x2_t sum;
+    int res;
+    int i = 0;
+
+    for (; i + 8 <= order; i += 8) {
+        int16x8_t c = vld1q_s16(v1 + i);
+        int16x8_t h = vld1q_s16(v2 + i);
+        res0 = vmlal_s16(res0, vget_low_s16(c), vget_low_s16(h));
+        res1 = vmlal_s16(res1, vget_high_s16(c), vget_high_s16(h));
+        vst1q_s16(v1 + i, vmlaq_n_s16(c, vld1q_s16(v3 + i), mul));
+    }
+
+    res0 = vaddq_s32(res0, res1);
+    sum = vadd_s32(vget_low_s32(res0), vget_high_s32(res0));
+    res = vget_lane_s32(vpadd_s32(sum, sum), 0);
+
+    for (; i < order; i++) {
+        res   += v1[i] * v2[i];
+        v1[i] += mul * v3[i];
+    }
+    return res;
+}
 #endif
+
+#ifdef APE_SSE2
+static inline int32_t hsum_epi32(__m128i x)
+{
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(x);
+}
+
+/* v2 follows the filter history and is unaligned for most samples, so
+   all loads are unaligned ones. The filter orders are multiples of 16. */
+#define SCALARPRODUCT_AND_MADD_SSE(name, target, madd)                          \
+static target int32_t name(int16_t *v1, const int16_t *v2,                     \
+                           const int16_t *v3, int order, int mul)              \
+{                                                                               \
+    __m128i res0 = _mm_setzero_si128();                                         \
+    __m128i res1 = _mm_setzero_si128();                                         \
+    __m128i m    = _mm_set1_epi16(mul);                                         \
+    int res;                                                                    \
+    int i = 0;                                                                  \
+                                                                                \
+    for (; i + 16 <= order; i += 16) {                                          \
+        __m128i c0 = _mm_loadu_si128((const __m128i *)(v1 + i));                \
+        __m128i c1 = _mm_loadu_si128((const __m128i *)(v1 + i + 8));            \
+        res0 = _mm_add_epi32(res0, _mm_madd_epi16(c0,                           \
+                   _mm_loadu_si128((const __m128i *)(v2 + i))));                \
+        res1 = _mm_add_epi32(res1, _mm_madd_epi16(c1,                           \
+                   _mm_loadu_si128((const __m128i *)(v2 + i + 8))));            \
+        c0 = _mm_add_epi16(c0,                                                  \
+                 madd(_mm_loadu_si128((const __m128i *)(v3 + i)), m));          \
+        c1 = _mm_add_epi16(c1,                                                  \
+                 madd(_mm_loadu_si128((const __m128i *)(v3 + i + 8)), m));      \
+        _mm_storeu_si128((__m128i *)(v1 + i), c0);                              \
+        _mm_storeu_si128((__m128i *)(v1 + i + 8), c1);                          \
+    }                                                                           \
+                                                                                \
+    res = hsum_epi32(_mm_add_epi32(res0, res1));                                \
+                                                                                \
+    for (; i < order; i++) {                                                    \
+        res   += v1[i] * v2[i];                                                 \
+        v1[i] += mul * v3[i];                                                   \
+    }                                                                           \
+    return res;                                                                 \
+}
+
+SCALARPRODUCT_AND_MADD_SSE(scalarproduct_and_madd_int16_sse2, , _mm_mullo_epi16)
+
+#ifdef APE_SSSE3_AVX2
+SCALARPRODUCT_AND_MADD_SSE(scalarproduct_and_madd_int16_ssse3,
+                           __attribute__((target("ssse3"))), _mm_sign_epi16)
+
+static __attribute__((target("avx2")))
+int32_t scalarproduct_and_madd_int16_avx2(int16_t *v1, const int16_t *v2,
+                                          const int16_t *v3, int order, int mul)
+{
+    __m256i res0 = _mm256_setzero_si256();
+    __m256i res1 = _mm256_setzero_si256();
+    __m256i m    = _mm256_set1_epi16(mul);
+    __m128i sum;
+    int res;
+    int i = 0;
+
+    for (; i + 32 <= order; i += 32) {
+        __m256i c0 = _mm256_loadu_si256((const __m256i *)(v1 + i));
+        __m256i c1 = _mm256_loadu_si256((const __m256i *)(v1 + i + 16));
+        res0 = _mm256_add_epi32(res0, _mm256_madd_epi16(c0,
+                   _mm256_loadu_si256((const __m256i *)(v2 + i))));
+        res1 = _mm256_add_epi32(res1, _mm256_madd_epi16(c1,
+                   _mm256_loadu_si256((const __m256i *)(v2 + i + 16))));
+        c0 = _mm256_add_epi16(c0, _mm256_sign_epi16(
+                 _mm256_loadu_si256((const __m256i *)(v3 + i)), m));
+        c1 = _mm256_add_epi16(c1, _mm256_sign_epi16(
+                 _mm256_loadu_si256((const __m256i *)(v3 + i + 16)), m));
+        _mm256_storeu_si256((__m256i *)(v1 + i), c0);
+        _mm256_storeu_si256((__m256i *)(v1 + i + 16), c1);
+    }
+    /* order 16 and the odd 16 of 1280 */
+    if (i + 16 <= order) {
+        __m256i c0 = _mm256_loadu_si256((const __m256i *)(v1 + i));
+        res0 = _mm256_add_epi32(res0, _mm256_madd_epi16(c0,
+                   _mm256_loadu_si256((const __m256i *)(v2 + i))));
+        c0 = _mm256_add_epi16(c0, _mm256_sign_epi16(
+                 _mm256_loadu_si256((const __m256i *)(v3 + i)), m));
+        _mm256_storeu_si256((__m256i *)(v1 + i), c0);
+        i += 16;
+    }
+
+    res0 = _mm256_add_epi32(res0, res1);
+    sum  = _mm_add_epi32(_mm256_castsi256_si128(res0),
+                         _mm256_extracti128_si256(res0, 1));
+    _mm256_zeroupper();
+    res = hsum_epi32(sum);
+
+    for (; i < order; i++) {
+        res   += v1[i] * v2[i];
+        v1[i] += mul * v3[i];
+    }
     return res;
 }
+#endif
+#endif
 
-static void add_int16_c(int16_t * v1, int16_t * v2, int order)
-{
-#ifndef  __ARM_HAVE_NEON
-    while (order--)
-       *v1++ += *v2++;
-#else	
-	int j=order/8;
-	int k=order%8;
-	int16x8_t neonv1;
-	
-	while(j--) {
-		neonv1 = vaddq_s16(vld1q_s16(v1), vld1q_s16(v2));
-		vst1q_s16(v1, neonv1);
-		v1+=8;
-		v2+=8;
-	}
-
-	while(k--) {
-		*v1++ += *v2++;
-	}
+static void ape_dsp_init(APEContext *s)
+{
+    s->scalarproduct_and_madd_int16 = scalarproduct_and_madd_int16_c;
+#ifdef __ARM_HAVE_NEON
+    s->scalarproduct_and_madd_int16 = scalarproduct_and_madd_int16_neon;
+#elif defined(APE_SSE2)
+    s->scalarproduct_and_madd_int16 = scalarproduct_and_madd_int16_sse2;
+#ifdef APE_SSSE3_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        s->scalarproduct_and_madd_int16 = scalarproduct_and_madd_int16_avx2;
+    else if (__builtin_cpu_supports("ssse3"))
+        s->scalarproduct_and_madd_int16 = scalarproduct_and_madd_int16_ssse3;
+#endif
 #endif
 }
 
-static void sub_int16_c(int16_t * v1, int16_t * v2, int order)
-{
-#ifndef __ARM_HAVE_NEON
-    while (order--)
-        *v1++ -= *v2++;
-#else
-	int j=order/8;
-	int k=order%8;
-	int16x8_t neonv1;
-	
-	while(j--) {
-		neonv1 = vsubq_s16(vld1q_s16(v1), vld1q_s16(v2));
-		vst1q_s16(v1, neonv1);
-		v1+=8;
-		v2+=8;
-	}
-
-	while(k--) {
-		 *v1++ -= *v2++;
-	}
+int ape_select_dsp(APEContext *s, const char *name)
+{
+    int32_t (*f)(int16_t *, const int16_t *, const int16_t *, int, int) = NULL;
+
+    if (!strcmp(name, "c"))
+        f = scalarproduct_and_madd_int16_c;
+#ifdef __ARM_HAVE_NEON
+    else if (!strcmp(name, "neon"))
+        f = scalarproduct_and_madd_int16_neon;
+#elif defined(APE_SSE2)
+    else if (!strcmp(name, "sse2"))
+        f = scalarproduct_and_madd_int16_sse2;
+#ifdef APE_SSSE3_AVX2
+    else if (!strcmp(name, "ssse3") && (__builtin_cpu_init(), __builtin_cpu_supports("ssse3")))
+        f = scalarproduct_and_madd_int16_ssse3;
+    else if (!strcmp(name, "avx2") && (__builtin_cpu_init(), __builtin_cpu_supports("avx2")))
+        f = scalarproduct_and_madd_int16_avx2;
 #endif
+#endif
+    if (!f)
+        return -1;
+    s->scalarproduct_and_madd_int16 = f;
+    return 0;
 }
 
 static void do_apply_filter(APEContext *ctx, int version, APEFilter *f,
@@ -621,19 +740,10 @@ static void do_apply_filter(APEContext *ctx, int version, APEFilter *f,
 
     while (count--) {
         /* round fixedpoint scalar product */
-        #ifndef __ARM_HAVE_NEON
-        res = scalarproduct_and_madd_int16_c(f->coeffs, f->delay - order,
-                                                    f->adaptcoeffs - order,
-                                                    order, APESIGN(*data));
+        res = ctx->scalarproduct_and_madd_int16(f->coeffs, f->delay - order,
+                                                f->adaptcoeffs - order,
+                                                order, APESIGN(*data));
         res = (res + (1 << (fracbits - 1))) >> fracbits;
-        #else
-        res = (scalarproduct_int16_c(f->delay - order, f->coeffs, order, 0) + (1 << (fracbits - 1))) >> fracbits;
-
-        if (*data < 0)
-            add_int16_c(f->coeffs, f->adaptcoeffs - order, order);
-        else if (*data > 0)
-            sub_int16_c(f->coeffs, f->adaptcoeffs - order, order);
-        #endif
         res += *data;
         *data++ = res;
 
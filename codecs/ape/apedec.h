@@ -264,6 +264,10 @@ typedef struct APEContext {
     APERice riceY;                           ///< rice code parameters for the first channel
     APEFilter filters[APE_FILTER_LEVELS][2]; ///< filters used for reconstruction
 
+    /** filter scalar product fused with the coefficient adaption, chosen for the CPU */
+    int32_t (*scalarproduct_and_madd_int16)(int16_t *v1, const int16_t *v2,
+                                            const int16_t *v3, int order, int mul);
+
     uint8_t *data;                           ///< current frame data
     uint8_t *data_end;                       ///< frame data end
     int data_size;                           ///< frame data allocated size
@@ -276,6 +280,12 @@ int ape_decode_frame(APEContext *s,uint8_t *inbuf,int inlen,void *outbuf,int *ou
 av_cold int ape_decode_init(APEContext *s,uint8_t *extradata,int extradata_size,int channels,int bits_per_coded_sample);
 av_cold int ape_decode_close(APEContext *s);
 void ape_flush(APEContext *s);
+/**
+ * Replace the filter kernel ape_decode_init() picked for this CPU, for
+ * testing: "c", "neon", "sse2", "ssse3" or "avx2".
+ * @return 0, or -1 if the kernel is not built in or the CPU lacks it
+ */
+int ape_select_dsp(APEContext *s, const char *name);
 
 #ifdef __cplusplus
 }
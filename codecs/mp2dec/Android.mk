@@ -1,11 +1,6 @@
 LOCAL_PATH := $(call my-dir)
-ifeq ($(TARGET_ARCH),arm)
-include $(CLEAR_VARS)
 
-LOCAL_MODULE_TAGS := optional
-
-LOCAL_SRC_FILES :=  \
-                    src/libmpg123/synth_neon_s32.S \
+mp2dec_src_files := \
                     src/libmpg123/compat.c \
                     src/libmpg123/icy.c \
                     src/libmpg123/synth_8bit.c\
@@ -14,9 +9,7 @@ LOCAL_SRC_FILES :=  \
                     src/libmpg123/id3.c   \
                     src/libmpg123/synth_s32.c \
                     src/libmpg123/index.c \
-                    src/libmpg123/synth_arm_accurate.S  \
                     src/libmpg123/equalizer.c \
-                    src/libmpg123/synth_arm.S     \
                     src/libmpg123/feature.c \
                     src/libmpg123/synth.c    \
                     src/libmpg123/dct64.c   \
@@ -25,40 +18,73 @@ LOCAL_SRC_FILES :=  \
                     src/libmpg123/tabinit.c \
                     src/libmpg123/frame.c  \
                     src/libmpg123/optimize.c \
-                    src/libmpg123/synth_stereo_neon_accurate.S \
                     src/libmpg123/layer1.c \
                     src/libmpg123/parse.c  \
-                    src/libmpg123/synth_stereo_neon_float.S     \
-                    src/libmpg123/dct64_neon_float.S \
                     src/libmpg123/layer2.c   \
-                    src/libmpg123/synth_stereo_neon.S \
-                    src/libmpg123/dct64_neon.S \
                     src/libmpg123/layer3.c \
-                    src/libmpg123/synth_stereo_neon_s32.S\
                     src/libmpg123/lfs_alias.c   \
                     src/libmpg123/readers.c     \
-                    src/libmpg123/synth_neon_accurate.S \
                     src/libmpg123/lfs_wrap.c \
-                    src/libmpg123/synth_neon_float.S     \
                     src/libmpg123/icy2utf8.c  \
                     src/libmpg123/libmpg123.c \
-                    src/libmpg123/stringbuf.c         \
-                    src/libmpg123/synth_neon.S
+                    src/libmpg123/stringbuf.c
+
+# SSE2 synth and dct64 in C intrinsics, AVX2 is picked at runtime.
+# OPT_MULTI keeps the generic decoder around as fallback, and as the
+# reference mp2decbench compares against.
+mp2dec_x86_64_src_files := \
+                    src/libmpg123/dct64_x86_64_sse.c \
+                    src/libmpg123/synth_x86_64_sse.c
+
+mp2dec_generic_cflags := -DHAVE_CONFIG -DREAL_IS_FLOAT -DACCURATE_ROUNDING \
+                -DOPT_GENERIC
+
+mp2dec_x86_64_cflags := $(mp2dec_generic_cflags) -DOPT_MULTI -DOPT_X86_64 -msse2
+
+ifneq ($(filter arm x86 x86_64,$(TARGET_ARCH)),)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SRC_FILES := $(mp2dec_src_files)
 
 # for logging
 LOCAL_LDLIBS += -llog
 # for native asset manager
 
+ifeq ($(TARGET_ARCH),arm)
+LOCAL_SRC_FILES += \
+                    src/libmpg123/synth_neon_s32.S \
+                    src/libmpg123/synth_arm_accurate.S  \
+                    src/libmpg123/synth_arm.S     \
+                    src/libmpg123/synth_stereo_neon_accurate.S \
+                    src/libmpg123/synth_stereo_neon_float.S     \
+                    src/libmpg123/dct64_neon_float.S \
+                    src/libmpg123/synth_stereo_neon.S \
+                    src/libmpg123/dct64_neon.S \
+                    src/libmpg123/synth_stereo_neon_s32.S\
+                    src/libmpg123/synth_neon_accurate.S \
+                    src/libmpg123/synth_neon_float.S     \
+                    src/libmpg123/synth_neon.S
+
 LOCAL_CFLAGS := -DHAVE_NEON=1 -DHAVE_CONFIG -DOPT_NEON -DREAL_IS_FLOAT -mfloat-abi=softfp -mfpu=neon
 
+LOCAL_ARM_MODE := arm
+else ifeq ($(TARGET_ARCH),x86_64)
+LOCAL_SRC_FILES += $(mp2dec_x86_64_src_files)
+LOCAL_CFLAGS := $(mp2dec_x86_64_cflags)
+else
+# The x86-64 decoder has never been built for 32 bit x86, which gets the
+# generic C one.
+LOCAL_CFLAGS := $(mp2dec_generic_cflags)
+endif
+
 LOCAL_C_INCLUDES += \
          $(LOCAL_PATH)/src \
          $(LOCAL_PATH)/src/libmpg123
 
 LOCAL_MODULE := libstagefright_mp2dec
 
-LOCAL_ARM_MODE := arm
-
 include $(BUILD_STATIC_LIBRARY)
 
 #####################################################################################################
@@ -89,3 +115,53 @@ LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
 endif
+
+#####################################################################################################
+
+# Host build of the x86-64 decoder, and a test that decodes with it and
+# with the generic one and checks they agree bit for bit. It also runs
+# SoftMP2 itself, on top of a host stand-in for SimpleSoftOMXComponent.
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(mp2dec_src_files) $(mp2dec_x86_64_src_files)
+
+LOCAL_CFLAGS := $(mp2dec_x86_64_cflags)
+
+LOCAL_C_INCLUDES += \
+         $(LOCAL_PATH)/src \
+         $(LOCAL_PATH)/src/libmpg123
+
+LOCAL_MULTILIB := 64
+
+LOCAL_MODULE := libstagefright_mp2dec_host
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        MP2DecBench.cpp \
+        SoftMP2.cpp \
+        host/SimpleSoftOMXComponent.cpp \
+        host/MediaDefs.cpp
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/host \
+        $(LOCAL_PATH)/include \
+        frameworks/native/include/media/openmax
+
+LOCAL_STATIC_LIBRARIES := \
+        libstagefright_mp2dec_host \
+        libutils \
+        liblog
+
+LOCAL_LDLIBS += -lm -lpthread
+
+LOCAL_MULTILIB := 64
+
+LOCAL_MODULE := mp2decbench
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,711 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Decodes MPEG audio with libmpg123's generic decoder and with the one it
+// picks for this CPU, and checks that both give the same samples bit for
+// bit in 16 bit, 32 bit and float output. Then runs the stream through
+// SoftMP2 the way ACodec would, one frame per input buffer, checks it
+// gives the same samples as the library does, and reports the decoding
+// speed of all three. Without a file it decodes generated Layer II and
+// Layer III frames: valid headers and side info in mono, stereo, joint
+// stereo and dual channel at a few rates, with random payloads, so every
+// subband, scale factor and Huffman table gets exercised.
+//
+// usage: mp2decbench [-n iterations] [-f frames] [file.mp2|file.mp3]
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MP2DecBench"
+#include <utils/Log.h>
+
+#include "SoftMP2.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+
+#include "mpg123.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace android {
+
+struct Format {
+    const char *mName;
+    int mEncoding;
+};
+
+static const Format kFormats[] = {
+    { "s16", MPG123_ENC_SIGNED_16 },
+    { "s32", MPG123_ENC_SIGNED_32 },
+    { "float", MPG123_ENC_FLOAT_32 },
+};
+
+// MPEG-1 headers without CRC: layer, bitrate index, sample rate index and
+// mode. Layer II and III frames both take 144 * bitrate / rate bytes,
+// 576 bytes at 48 kHz and 192 kbps.
+struct FrameType {
+    int mLayer;
+    int mBitrateKbps;
+    int mBitrateIndex;
+    int mSampleRate;
+    int mSampleRateIndex;
+    int mMode;
+};
+
+static const FrameType kFrameTypes[] = {
+    { 2, 192, 10, 48000, 1, 0 },  // stereo
+    { 2, 192, 10, 48000, 1, 1 },  // joint stereo
+    { 2,  96,  6, 48000, 1, 3 },  // mono
+    { 2,  64,  4, 32000, 2, 2 },  // dual channel
+    { 2, 384, 14, 32000, 2, 0 },
+    { 3, 128,  9, 44100, 0, 0 },
+    { 3, 128,  9, 44100, 0, 1 },
+    { 3,  64,  5, 48000, 1, 3 },
+    { 3, 320, 14, 32000, 2, 2 },
+};
+
+struct BitWriter {
+    BitWriter(uint8_t *data)
+        : mData(data),
+          mNumBits(0) {
+    }
+
+    void put(uint32_t value, int numBits) {
+        while (numBits-- > 0) {
+            uint8_t *byte = mData + (mNumBits >> 3);
+            int shift = 7 - (mNumBits & 7);
+            *byte = (*byte & ~(1 << shift)) | (((value >> numBits) & 1) << shift);
+            ++mNumBits;
+        }
+    }
+
+private:
+    uint8_t *mData;
+    size_t mNumBits;
+};
+
+// Layer III side info that the decoder takes as it is: no bit reservoir,
+// the main data split evenly between granules and channels, and Huffman
+// tables other than the two unused ones. The main data itself is random,
+// as are the gains, the block types and the region boundaries.
+static void WriteLayer3SideInfo(
+        int numChannels, size_t mainDataSize, uint8_t *sideInfo) {
+    uint32_t part23Length = mainDataSize * 8 / (2 * numChannels);
+    uint32_t maxBigValues = part23Length / 16 < 288 ? part23Length / 16 : 288;
+
+    BitWriter bits(sideInfo);
+    bits.put(0, 9);  // main_data_begin
+    bits.put(0, numChannels == 1 ? 5 : 3);  // private_bits
+    bits.put(0, 4 * numChannels);  // scfsi
+
+    for (int gr = 0; gr < 2; ++gr) {
+        for (int ch = 0; ch < numChannels; ++ch) {
+            bits.put(part23Length, 12);
+            // No more value pairs than the bits could hold, most of the
+            // time.
+            bits.put(rand() % (maxBigValues + 1), 9);  // big_values
+            bits.put(120 + rand() % 80, 8);  // global_gain
+            bits.put(rand() & 15, 4);  // scalefac_compress
+
+            bool windowSwitching = (rand() & 3) == 0;
+            bits.put(windowSwitching, 1);
+            int numTables = windowSwitching ? 2 : 3;
+            if (windowSwitching) {
+                bits.put(1 + rand() % 3, 2);  // block_type
+                bits.put(rand() & 1, 1);  // mixed_block_flag
+            }
+            for (int i = 0; i < numTables; ++i) {
+                // Tables 4 and 14 do not exist.
+                int table = rand() % 30;
+                table += table >= 4;
+                table += table >= 14;
+                bits.put(table, 5);
+            }
+            if (windowSwitching) {
+                bits.put(rand() & 0x1ff, 9);  // subblock_gain
+            } else {
+                bits.put(rand() & 15, 4);  // region0_count
+                bits.put(rand() & 7, 3);  // region1_count
+            }
+            // preflag, scalefac_scale, count1table_select
+            bits.put(rand() & 7, 3);
+        }
+    }
+}
+
+static void AppendFrames(
+        const FrameType &type, size_t numFrames,
+        uint8_t **data, size_t *size) {
+    size_t frameSize = 144 * type.mBitrateKbps * 1000 / type.mSampleRate;
+    *data = (uint8_t *)realloc(*data, *size + numFrames * frameSize);
+
+    for (size_t n = 0; n < numFrames; ++n) {
+        uint8_t *frame = *data + *size;
+        frame[0] = 0xff;
+        frame[1] = type.mLayer == 3 ? 0xfb : 0xfd;
+        frame[2] = (type.mBitrateIndex << 4) | (type.mSampleRateIndex << 2);
+        // Random joint stereo bound, or intensity and M/S stereo flags.
+        frame[3] = (type.mMode << 6) | ((rand() & 3) << 4);
+        for (size_t i = 4; i < frameSize; ++i) {
+            frame[i] = rand();
+        }
+        if (type.mLayer == 3) {
+            int numChannels = type.mMode == 3 ? 1 : 2;
+            size_t sideInfoSize = numChannels == 1 ? 17 : 32;
+            WriteLayer3SideInfo(
+                    numChannels, frameSize - 4 - sideInfoSize, frame + 4);
+        }
+        *size += frameSize;
+    }
+}
+
+// Size and number of samples of the frame whose header starts at data, 0
+// if there is none. Any MPEG-1, 2 or 2.5 layer.
+static size_t ParseFrameHeader(
+        const uint8_t *data, size_t size,
+        int *sampleRate, int *numSamples) {
+    if (size < 4 || data[0] != 0xff || (data[1] & 0xe0) != 0xe0) {
+        return 0;
+    }
+
+    // 3 is MPEG-1, 2 MPEG-2 and 0 MPEG-2.5.
+    int version = (data[1] >> 3) & 3;
+    int layer = 4 - ((data[1] >> 1) & 3);
+    int bitrateIndex = data[2] >> 4;
+    int sampleRateIndex = (data[2] >> 2) & 3;
+    int padding = (data[2] >> 1) & 1;
+    if (version == 1 || layer == 4 || bitrateIndex == 0
+            || bitrateIndex == 15 || sampleRateIndex == 3) {
+        return 0;
+    }
+
+    static const int kBitrates[2][3][15] = {
+        {
+            { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+            { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+            { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+        },
+        {
+            { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+            { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+            { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        },
+    };
+    static const int kSampleRates[] = { 44100, 48000, 32000 };
+
+    int bitrate = kBitrates[version != 3][layer - 1][bitrateIndex] * 1000;
+    *sampleRate = kSampleRates[sampleRateIndex] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+
+    if (layer == 1) {
+        *numSamples = 384;
+        return (12 * bitrate / *sampleRate + padding) * 4;
+    }
+    if (layer == 3 && version != 3) {
+        *numSamples = 576;
+        return 72 * bitrate / *sampleRate + padding;
+    }
+    *numSamples = 1152;
+    return 144 * bitrate / *sampleRate + padding;
+}
+
+static int64_t NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+struct Output {
+    Output()
+        : mData(NULL),
+          mSize(0),
+          mCapacity(0),
+          mDecodeUs(0) {
+    }
+
+    ~Output() {
+        free(mData);
+    }
+
+    uint8_t *mData;
+    size_t mSize;
+    size_t mCapacity;
+    int64_t mDecodeUs;
+};
+
+// Feeds the whole stream and collects every decoded sample, the way
+// SoftMP2 drives the library.
+static bool Decode(
+        const char *decoder, int encoding,
+        const uint8_t *data, size_t size, bool keep, Output *output) {
+    int err;
+    mpg123_handle *handle = mpg123_new(decoder, &err);
+    if (handle == NULL) {
+        fprintf(stderr, "no %s decoder: %s\n", decoder,
+                mpg123_plain_strerror(err));
+        return false;
+    }
+
+    mpg123_param(handle, MPG123_ADD_FLAGS, MPG123_QUIET, 0);
+    mpg123_format_none(handle);
+    static const long kRates[] = { 32000, 44100, 48000 };
+    for (size_t i = 0; i < NELEM(kRates); ++i) {
+        mpg123_format(handle, kRates[i], MPG123_MONO | MPG123_STEREO, encoding);
+    }
+    mpg123_open_feed(handle);
+
+    int64_t startUs = NowUs();
+    mpg123_feed(handle, data, size);
+
+    bool ok = true;
+    for (;;) {
+        off_t num;
+        unsigned char *audio;
+        size_t bytes;
+        int ret = mpg123_decode_frame(handle, &num, &audio, &bytes);
+        if (ret == MPG123_NEED_MORE || ret == MPG123_DONE) {
+            break;
+        }
+        if (ret == MPG123_NEW_FORMAT) {
+            continue;
+        }
+        if (ret != MPG123_OK) {
+            // Random payloads may not survive every check; the frame is
+            // skipped by both decoders alike.
+            if (ret == MPG123_ERR) {
+                fprintf(stderr, "%s: %s\n", decoder, mpg123_strerror(handle));
+                ok = false;
+                break;
+            }
+            continue;
+        }
+
+        if (keep && bytes > 0) {
+            if (output->mSize + bytes > output->mCapacity) {
+                output->mCapacity = (output->mSize + bytes) * 2;
+                output->mData = (uint8_t *)realloc(output->mData, output->mCapacity);
+            }
+            memcpy(output->mData + output->mSize, audio, bytes);
+        }
+        output->mSize += bytes;
+    }
+    output->mDecodeUs += NowUs() - startUs;
+
+    mpg123_close(handle);
+    mpg123_delete(handle);
+    return ok;
+}
+
+// ACodec's side of SoftMP2: one frame per input buffer, the way the
+// extractors and ESQueue hand them out, timestamped from the samples that
+// came before it. Output buffers go back to the component as soon as they
+// are copied out. Everything the callbacks hand back is queued here and
+// handled once the component call returns.
+struct Client {
+    Client()
+        : mPortSettingsChanged(false),
+          mDisablingOutput(false),
+          mError(false) {
+    }
+
+    Vector<OMX_BUFFERHEADERTYPE *> mInputBuffers;
+    Vector<OMX_BUFFERHEADERTYPE *> mOutputBuffers;
+    bool mPortSettingsChanged;
+    bool mDisablingOutput;
+    bool mError;
+
+    static OMX_ERRORTYPE OnEvent(
+            OMX_HANDLETYPE component, OMX_PTR appData,
+            OMX_EVENTTYPE event, OMX_U32 data1, OMX_U32 data2,
+            OMX_PTR eventData);
+
+    static OMX_ERRORTYPE OnEmptyBufferDone(
+            OMX_HANDLETYPE component, OMX_PTR appData,
+            OMX_BUFFERHEADERTYPE *header);
+
+    static OMX_ERRORTYPE OnFillBufferDone(
+            OMX_HANDLETYPE component, OMX_PTR appData,
+            OMX_BUFFERHEADERTYPE *header);
+};
+
+// static
+OMX_ERRORTYPE Client::OnEvent(
+        OMX_HANDLETYPE /* component */, OMX_PTR appData,
+        OMX_EVENTTYPE event, OMX_U32 data1, OMX_U32 /* data2 */,
+        OMX_PTR /* eventData */) {
+    Client *client = (Client *)appData;
+    if (event == OMX_EventPortSettingsChanged && data1 == 1) {
+        client->mPortSettingsChanged = true;
+    } else if (event == OMX_EventError) {
+        client->mError = true;
+    }
+    return OMX_ErrorNone;
+}
+
+// static
+OMX_ERRORTYPE Client::OnEmptyBufferDone(
+        OMX_HANDLETYPE /* component */, OMX_PTR appData,
+        OMX_BUFFERHEADERTYPE *header) {
+    ((Client *)appData)->mInputBuffers.push(header);
+    return OMX_ErrorNone;
+}
+
+// static
+OMX_ERRORTYPE Client::OnFillBufferDone(
+        OMX_HANDLETYPE /* component */, OMX_PTR appData,
+        OMX_BUFFERHEADERTYPE *header) {
+    Client *client = (Client *)appData;
+    if (client->mDisablingOutput) {
+        // Nothing in them, they go back once the port is enabled again.
+        header->nFilledLen = 0;
+        header->nFlags = 0;
+    }
+    client->mOutputBuffers.push(header);
+    return OMX_ErrorNone;
+}
+
+static OMX_BUFFERHEADERTYPE *AllocateBuffer(
+        const sp<SimpleSoftOMXComponent> &component, OMX_U32 portIndex) {
+    OMX_PARAM_PORTDEFINITIONTYPE def;
+    memset(&def, 0, sizeof(def));
+    def.nSize = sizeof(def);
+    def.nPortIndex = portIndex;
+    CHECK_EQ(component->getParameter(OMX_IndexParamPortDefinition, &def),
+             OMX_ErrorNone);
+
+    OMX_BUFFERHEADERTYPE *header = new OMX_BUFFERHEADERTYPE;
+    memset(header, 0, sizeof(*header));
+    header->nSize = sizeof(*header);
+    header->pBuffer = new OMX_U8[def.nBufferSize];
+    header->nAllocLen = def.nBufferSize;
+    component->useBuffer(portIndex, header);
+    return header;
+}
+
+static void FreeBuffers(Vector<OMX_BUFFERHEADERTYPE *> *buffers) {
+    for (size_t i = 0; i < buffers->size(); ++i) {
+        delete[] buffers->itemAt(i)->pBuffer;
+        delete buffers->itemAt(i);
+    }
+    buffers->clear();
+}
+
+static bool DecodeSoftMP2(
+        const uint8_t *data, size_t size, bool keep, Output *output) {
+    static const OMX_CALLBACKTYPE kCallbacks = {
+        &Client::OnEvent, &Client::OnEmptyBufferDone, &Client::OnFillBufferDone
+    };
+
+    Client client;
+    OMX_COMPONENTTYPE *handle;
+    sp<SimpleSoftOMXComponent> component = new SoftMP2(
+            "OMX.google.mp2.decoder", &kCallbacks, &client, &handle);
+
+    // All buffers, which start out with the client.
+    Vector<OMX_BUFFERHEADERTYPE *> inputBuffers, outputBuffers;
+    for (size_t i = 0; i < 4; ++i) {
+        inputBuffers.push(AllocateBuffer(component, 0));
+        outputBuffers.push(AllocateBuffer(component, 1));
+    }
+    client.mInputBuffers = inputBuffers;
+    client.mOutputBuffers = outputBuffers;
+
+    int64_t startUs = NowUs();
+
+    size_t offset = 0;
+    int64_t timeUs = 0;
+    int64_t numSamples = 0;
+    int sampleRate = 0;
+    bool sawInputEOS = false;
+    bool sawOutputEOS = false;
+    while (!sawOutputEOS && !client.mError) {
+        if (client.mPortSettingsChanged) {
+            client.mPortSettingsChanged = false;
+            client.mDisablingOutput = true;
+            component->enablePort(1, false);
+            client.mDisablingOutput = false;
+            component->enablePort(1, true);
+            continue;
+        }
+
+        if (!client.mOutputBuffers.isEmpty()) {
+            OMX_BUFFERHEADERTYPE *header = client.mOutputBuffers.itemAt(0);
+            client.mOutputBuffers.removeAt(0);
+
+            size_t bytes = header->nFilledLen;
+            if (keep && bytes > 0) {
+                if (output->mSize + bytes > output->mCapacity) {
+                    output->mCapacity = (output->mSize + bytes) * 2;
+                    output->mData = (uint8_t *)realloc(output->mData, output->mCapacity);
+                }
+                memcpy(output->mData + output->mSize,
+                       header->pBuffer + header->nOffset, bytes);
+            }
+            output->mSize += bytes;
+            sawOutputEOS = (header->nFlags & OMX_BUFFERFLAG_EOS) != 0;
+
+            header->nFilledLen = 0;
+            header->nFlags = 0;
+            component->fillThisBuffer(header);
+            continue;
+        }
+
+        if (sawInputEOS || client.mInputBuffers.isEmpty()) {
+            // Every buffer is with the component, and it has nothing
+            // left to give back.
+            fprintf(stderr, "SoftMP2 stalled at byte %zu\n", offset);
+            client.mError = true;
+            break;
+        }
+
+        OMX_BUFFERHEADERTYPE *header = client.mInputBuffers.itemAt(0);
+        client.mInputBuffers.removeAt(0);
+
+        // Bytes that are no frame go along with the next one.
+        size_t start = offset;
+        size_t frameSize = 0;
+        int frameSamples = 0;
+        while (offset < size && frameSize == 0) {
+            frameSize = ParseFrameHeader(
+                    data + offset, size - offset, &sampleRate, &frameSamples);
+            if (frameSize == 0) {
+                ++offset;
+            }
+        }
+        offset += frameSize;
+        if (offset > size || offset - start > header->nAllocLen) {
+            offset = start + header->nAllocLen;
+            if (offset > size) {
+                offset = size;
+            }
+        }
+
+        memcpy(header->pBuffer, data + start, offset - start);
+        header->nOffset = 0;
+        header->nFilledLen = offset - start;
+        header->nTimeStamp = timeUs;
+        header->nFlags = 0;
+        if (offset == size) {
+            header->nFlags = OMX_BUFFERFLAG_EOS;
+            sawInputEOS = true;
+        }
+
+        if (frameSize > 0) {
+            numSamples += frameSamples;
+            timeUs = numSamples * 1000000ll / sampleRate;
+        }
+
+        component->emptyThisBuffer(header);
+    }
+
+    output->mDecodeUs += NowUs() - startUs;
+
+    // Take back whatever the component still holds.
+    component->flushPort(0);
+    component->flushPort(1);
+    component->freeBuffers(0);
+    component->freeBuffers(1);
+    FreeBuffers(&inputBuffers);
+    FreeBuffers(&outputBuffers);
+
+    if (client.mError) {
+        fprintf(stderr, "SoftMP2 signalled an error\n");
+        return false;
+    }
+    return true;
+}
+
+static bool Compare(
+        const char *name, const char *format,
+        const Output &reference, const Output &output) {
+    if (reference.mSize == output.mSize
+            && memcmp(reference.mData, output.mData, reference.mSize) == 0) {
+        return true;
+    }
+
+    size_t i = 0;
+    while (i < reference.mSize && i < output.mSize
+            && reference.mData[i] == output.mData[i]) {
+        ++i;
+    }
+    fprintf(stderr, "%s %s: %zu bytes decoded, expected %zu, "
+            "first difference at byte %zu\n",
+            name, format, output.mSize, reference.mSize, i);
+    return false;
+}
+
+static void PrintSpeed(
+        const char *format, const char *refName, const Output &refTime,
+        const char *name, const Output &time) {
+    double mb = (double)time.mSize / (1024 * 1024);
+    printf("%-6s %s: %7.1f MB/s  %s: %7.1f MB/s  (%.2fx)\n",
+           format, refName,
+           mb * 1E6 / (refTime.mDecodeUs > 0 ? refTime.mDecodeUs : 1),
+           name,
+           mb * 1E6 / (time.mDecodeUs > 0 ? time.mDecodeUs : 1),
+           time.mDecodeUs > 0
+                ? (double)refTime.mDecodeUs / time.mDecodeUs : 0.0);
+}
+
+static bool Run(
+        const char *decoder, const uint8_t *data, size_t size,
+        int iterations) {
+    bool ok = true;
+    for (size_t f = 0; f < NELEM(kFormats); ++f) {
+        Output reference, output;
+        if (!Decode("generic", kFormats[f].mEncoding, data, size, true, &reference)
+                || !Decode(decoder, kFormats[f].mEncoding, data, size, true, &output)) {
+            return false;
+        }
+
+        if (!Compare(decoder, kFormats[f].mName, reference, output)) {
+            ok = false;
+            continue;
+        }
+
+        Output refTime, time;
+        for (int n = 0; n < iterations; ++n) {
+            Decode("generic", kFormats[f].mEncoding, data, size, false, &refTime);
+            Decode(decoder, kFormats[f].mEncoding, data, size, false, &time);
+        }
+
+        PrintSpeed(kFormats[f].mName, "generic", refTime, decoder, time);
+    }
+
+    // SoftMP2 asks for no particular format, and gets 16 bit samples from
+    // the decoder picked for this CPU.
+    Output reference, output;
+    if (!Decode(decoder, MPG123_ENC_SIGNED_16, data, size, true, &reference)
+            || !DecodeSoftMP2(data, size, true, &output)) {
+        return false;
+    }
+
+    if (!Compare("SoftMP2", "s16", reference, output)) {
+        return false;
+    }
+
+    Output refTime, time;
+    for (int n = 0; n < iterations; ++n) {
+        Decode(decoder, MPG123_ENC_SIGNED_16, data, size, false, &refTime);
+        DecodeSoftMP2(data, size, false, &time);
+    }
+
+    PrintSpeed("s16", decoder, refTime, "SoftMP2", time);
+
+    return ok;
+}
+
+static bool ReadFile(const char *path, uint8_t **data, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open '%s'\n", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        fprintf(stderr, "unable to stat '%s'\n", path);
+        close(fd);
+        return false;
+    }
+
+    *data = (uint8_t *)malloc(st.st_size);
+    *size = 0;
+    while (*size < (size_t)st.st_size) {
+        ssize_t n = read(fd, *data + *size, st.st_size - *size);
+        if (n <= 0) {
+            break;
+        }
+        *size += n;
+    }
+    close(fd);
+    return true;
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n iterations] [-f frames] [file.mp2|file.mp3]\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int iterations = 10;
+    int numFrames = 400;
+
+    int res;
+    while ((res = getopt(argc, argv, "n:f:h")) >= 0) {
+        switch (res) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 'f':
+                numFrames = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc > 1 || iterations <= 0 || numFrames <= 0) {
+        usage(me);
+    }
+
+    mpg123_init();
+
+    int err;
+    mpg123_handle *handle = mpg123_new(NULL, &err);
+    if (handle == NULL) {
+        fprintf(stderr, "mpg123_new failed: %s\n", mpg123_plain_strerror(err));
+        return 1;
+    }
+    const char *decoder = mpg123_current_decoder(handle);
+    mpg123_delete(handle);
+
+    printf("decoder: %s\n", decoder);
+
+    int result = 0;
+    if (argc == 1) {
+        uint8_t *data;
+        size_t size;
+        if (!ReadFile(argv[0], &data, &size)) {
+            return 1;
+        }
+        if (!Run(decoder, data, size, iterations)) {
+            result = 1;
+        }
+        free(data);
+    } else {
+        srand(1);
+        for (size_t t = 0; t < NELEM(kFrameTypes); ++t) {
+            uint8_t *data = NULL;
+            size_t size = 0;
+            AppendFrames(kFrameTypes[t], numFrames, &data, &size);
+
+            printf("layer %d %d kbps %d Hz mode %d\n", kFrameTypes[t].mLayer,
+                   kFrameTypes[t].mBitrateKbps, kFrameTypes[t].mSampleRate,
+                   kFrameTypes[t].mMode);
+            if (!Run(decoder, data, size, iterations)) {
+                result = 1;
+            }
+            free(data);
+        }
+    }
+
+    mpg123_exit();
+
+    return result;
+}
@@ -42,6 +42,10 @@ SoftMP2::SoftMP2(
     : SimpleSoftOMXComponent(name, callbacks, appData, component),
       mAnchorTimeUs(0),
       mNumFramesOutput(0),
+      mNumBytesFed(0),
+      mFramePending(false),
+      mOutputFilled(0),
+      mSawInputEOS(false),
 	  m_handle(NULL),
       mNumChannels(2),
       mSamplingRate(44100),
@@ -214,6 +218,40 @@ void SoftMP2::onPortEnableCompleted(OMX_U32 portIndex, bool enabled) {
         }
     }
 }
+void SoftMP2::sendOutputBuffer(OMX_U32 flags) {
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+    BufferInfo *outInfo = *outQueue.begin();
+    OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
+    outHeader->nFilledLen = mOutputFilled;
+    outHeader->nOffset = 0;
+    outHeader->nFlags = flags;
+    mOutputFilled = 0;
+
+    outInfo->mOwnedByUs = false;
+    outQueue.erase(outQueue.begin());
+    notifyFillBufferDone(outHeader);
+}
+
+// Input buffers may start anywhere in a frame. The timestamp of an input
+// buffer belongs to the first frame that starts in it, so that is the
+// buffer the frame starts in. Buffers that no frame starts in carry no
+// timestamp of their own and are skipped. Returns end() if the frame
+// starts past the input fed so far.
+List<SoftMP2::InputTimestamp>::iterator SoftMP2::findInputTimestamp(
+        int64_t frameOffset) {
+    if (frameOffset >= mNumBytesFed) {
+        return mInputTimestamps.end();
+    }
+
+    List<InputTimestamp>::iterator found = mInputTimestamps.end();
+    for (List<InputTimestamp>::iterator it = mInputTimestamps.begin();
+            it != mInputTimestamps.end() && it->mOffset <= frameOffset; ++it) {
+        found = it;
+    }
+    return found;
+}
+
 void SoftMP2::onQueueFilled(OMX_U32 portIndex) {
     if (mSignalledError || mOutputPortSettingsChange != NONE) {
         return;
@@ -222,84 +260,154 @@ void SoftMP2::onQueueFilled(OMX_U32 portIndex) {
     List<BufferInfo *> &inQueue = getPortQueue(0);
     List<BufferInfo *> &outQueue = getPortQueue(1);
 
-    while (!inQueue.empty() && !outQueue.empty()) {
-        BufferInfo *inInfo = *inQueue.begin();
-        OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
-
+    // mpg123 keeps its own copy of the fed input, so input buffers are
+    // returned right away. Frames are decoded straight into the output
+    // buffer, which goes out once the next frame would not fit, on a
+    // format change or at EOS.
+    while (!outQueue.empty()) {
         BufferInfo *outInfo = *outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
-        if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
-            inQueue.erase(inQueue.begin());
-            inInfo->mOwnedByUs = false;
-            notifyEmptyBufferDone(inHeader);
+        // The output block size is only known once a frame was decoded.
+        if (mOutputFilled > 0
+                && mOutputFilled + mpg123_outblock(m_handle) > kOutputBufferSize) {
+            sendOutputBuffer(0);
+            continue;
+        }
 
-            outHeader->nFilledLen = 0;
-            outHeader->nFlags = OMX_BUFFERFLAG_EOS;
+        // A frame whose timestamp is off from the samples counted so far
+        // starts a new output buffer, so it goes out with its own.
+        if (mOutputFilled > 0) {
+            // Once parsed, the frame starts before the current position.
+            int64_t offset = mFramePending
+                    ? mpg123_framepos(m_handle) : mpg123_tell_stream(m_handle);
+            List<InputTimestamp>::iterator it = findInputTimestamp(offset);
+            if (it != mInputTimestamps.end()) {
+                int64_t diffUs = it->mTimeUs - mAnchorTimeUs
+                        - (mNumFramesOutput * 1000000ll) / mSamplingRate;
+                if (diffUs > kMaxTimestampErrorUs
+                        || diffUs < -kMaxTimestampErrorUs) {
+                    ALOGV("timestamp moves by %lld us", (long long)diffUs);
+                    sendOutputBuffer(0);
+                    continue;
+                }
+            }
+        }
 
-            outQueue.erase(outQueue.begin());
-            outInfo->mOwnedByUs = false;
-            notifyFillBufferDone(outHeader);
-            return;
+        // mpg123 switches back to its own buffer when the format changes,
+        // so the target has to be set again before every frame.
+        mpg123_replace_buffer(m_handle,
+                outHeader->pBuffer + mOutputFilled,
+                kOutputBufferSize - mOutputFilled);
+
+        size_t size = 0;
+        int ret = mpg123_decode_frame(m_handle, NULL, NULL, &size);
+
+        if (ret == MPG123_OK) {
+            mFramePending = false;
+
+            List<InputTimestamp>::iterator it =
+                findInputTimestamp(mpg123_framepos(m_handle));
+            if (it != mInputTimestamps.end()) {
+                mAnchorTimeUs = it->mTimeUs;
+                mNumFramesOutput = 0;
+                mInputTimestamps.erase(mInputTimestamps.begin(), ++it);
+            }
+
+            if (mOutputFilled == 0) {
+                outHeader->nTimeStamp =
+                    mAnchorTimeUs
+                        + (mNumFramesOutput * 1000000ll) / mSamplingRate;
+            }
+            mOutputFilled += size;
+            mNumFramesOutput += size / (mNumChannels * sizeof(int16_t));
+            continue;
         }
 
-        if (inHeader->nOffset == 0) {
-            mAnchorTimeUs = inHeader->nTimeStamp;
+        if (ret == MPG123_NEW_FORMAT) {
+            // The frame is parsed, it is decoded by the next call.
+            mFramePending = true;
+
+            long rate;
+            int channels, enc;
+            mpg123_getformat(m_handle, &rate, &channels, &enc);
+            if (rate == mSamplingRate && channels == mNumChannels) {
+                continue;
+            }
+
+            // Whatever is decoded so far is still in the old format.
+            if (mOutputFilled > 0) {
+                sendOutputBuffer(0);
+            }
+
+            mAnchorTimeUs += (mNumFramesOutput * 1000000ll) / mSamplingRate;
             mNumFramesOutput = 0;
+
+            mSamplingRate = rate;
+            mNumChannels = channels;
+            notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
+            mOutputPortSettingsChange = AWAITING_DISABLED;
+            return;
+        }
+
+        if (ret != MPG123_NEED_MORE) {
+            ALOGE("mpg123_decode_frame failed: %s", mpg123_strerror(m_handle));
+            notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+            mSignalledError = true;
+            return;
+        }
+
+        if (mSawInputEOS) {
+            sendOutputBuffer(OMX_BUFFERFLAG_EOS);
+            mSawInputEOS = false;
+            return;
+        }
+
+        if (inQueue.empty()) {
+            return;
         }
-		
-		const OMX_U8 * inputptr = inHeader->pBuffer + inHeader->nOffset;
-		size_t size;
-		/* Feed input chunk and get first chunk of decoded audio. */
-		int ret = mpg123_decode(m_handle, inputptr, inHeader->nFilledLen, outHeader->pBuffer,kOutputBufferSize,&size);
-		if(1/*ret == MPG123_NEW_FORMAT*/)
-		{
-			long rate;
-			int channels, enc;
-			mpg123_getformat(m_handle, &rate, &channels, &enc);
-			if (rate != mSamplingRate || channels!= mNumChannels) {
-            	mSamplingRate = rate;
-           		mNumChannels = channels;
-            	notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
-            	mOutputPortSettingsChange = AWAITING_DISABLED;
-            	return;
-        	}
-		}
-
-		while(ret != MPG123_ERR && ret != MPG123_NEED_MORE)
-		{ /* Get all decoded audio that is available now before feeding more input. */
-			ret = mpg123_decode(m_handle, NULL, 0, outHeader->pBuffer, kOutputBufferSize,&size);
-			//write(1,out,size);
-			//outc += size;
-		}
-		if(ret == MPG123_ERR){ 
-			ALOGI("some error: %s", mpg123_strerror(m_handle)); 
-			return; 
-		}
-
-		outHeader->nFilledLen = size;
-        outHeader->nOffset = 0;
-
-        outHeader->nTimeStamp =
-            mAnchorTimeUs
-                + (mNumFramesOutput * 1000000ll) / mSamplingRate; 
-
-        outHeader->nFlags = 0;
-
-		inHeader->nFilledLen = 0;
-		if (inHeader->nFilledLen == 0) {
-            inInfo->mOwnedByUs = false;
-            inQueue.erase(inQueue.begin());
-            inInfo = NULL;
-            notifyEmptyBufferDone(inHeader);
-            inHeader = NULL;
+
+        BufferInfo *inInfo = *inQueue.begin();
+        OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
+
+        if (inHeader->nFilledLen > 0) {
+            if (mpg123_feed(m_handle,
+                        inHeader->pBuffer + inHeader->nOffset,
+                        inHeader->nFilledLen) != MPG123_OK) {
+                ALOGE("mpg123_feed failed: %s", mpg123_strerror(m_handle));
+                notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+                mSignalledError = true;
+                return;
+            }
+
+            InputTimestamp timestamp;
+            timestamp.mOffset = mNumBytesFed;
+            timestamp.mTimeUs = inHeader->nTimeStamp;
+            mInputTimestamps.push_back(timestamp);
+            mNumBytesFed += inHeader->nFilledLen;
         }
 
-        outInfo->mOwnedByUs = false;
-        outQueue.erase(outQueue.begin());
-        outInfo = NULL;
-        notifyFillBufferDone(outHeader);
-        outHeader = NULL;
+        if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
+            mSawInputEOS = true;
+        }
+
+        inInfo->mOwnedByUs = false;
+        inQueue.erase(inQueue.begin());
+        notifyEmptyBufferDone(inHeader);
+    }
+}
+
+void SoftMP2::onPortFlushCompleted(OMX_U32 portIndex) {
+    if (portIndex == 0) {
+        // Drop the buffered input, the next buffer starts a new stream
+        // at offset 0.
+        mpg123_open_feed(m_handle);
+        mInputTimestamps.clear();
+        mNumBytesFed = 0;
+        mFramePending = false;
+        mSawInputEOS = false;
+    } else if (portIndex == 1) {
+        mOutputFilled = 0;
     }
 }
 
@@ -40,17 +40,40 @@ protected:
             OMX_INDEXTYPE index, const OMX_PTR params);
 
     virtual void onQueueFilled(OMX_U32 portIndex);
+    virtual void onPortFlushCompleted(OMX_U32 portIndex);
     virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
 
 
 private:
     enum {
         kNumBuffers = 4,
-        kOutputBufferSize = 4608 * 2
+        // Room for four stereo layer II frames, decoded frames are
+        // appended until the next one would not fit.
+        kOutputBufferSize = 4608 * 4,
+        // Input timestamps off by more than this from the decoded samples
+        // start a new output buffer.
+        kMaxTimestampErrorUs = 1000
+    };
+
+    // Start of an input buffer in the fed stream, and its timestamp.
+    struct InputTimestamp {
+        int64_t mOffset;
+        int64_t mTimeUs;
     };
 
     int64_t mAnchorTimeUs;
     int64_t mNumFramesOutput;
+
+    // Input buffers fed since start or flush that no decoded frame has
+    // reached yet, and the number of bytes fed.
+    List<InputTimestamp> mInputTimestamps;
+    int64_t mNumBytesFed;
+    // A frame was parsed on a format change but not decoded yet.
+    bool mFramePending;
+
+    // Bytes already decoded into the head of the output queue.
+    size_t mOutputFilled;
+    bool mSawInputEOS;
 	unsigned char* m_buffer;
 
     int32_t mNumChannels;
@@ -68,6 +91,8 @@ private:
 
     void initPorts();
     void initDecoder();
+    void sendOutputBuffer(OMX_U32 flags);
+    List<InputTimestamp>::iterator findInputTimestamp(int64_t frameOffset);
 	
 	bool init_mpg123decoder();
 
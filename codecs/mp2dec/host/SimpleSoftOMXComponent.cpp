@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SimpleSoftOMXComponent"
+#include <utils/Log.h>
+
+#include "SimpleSoftOMXComponent.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+
+#include <string.h>
+
+namespace android {
+
+SoftOMXComponent::SoftOMXComponent(
+        const char * /* name */,
+        const OMX_CALLBACKTYPE *callbacks,
+        OMX_PTR appData,
+        OMX_COMPONENTTYPE **component)
+    : mCallbacks(callbacks),
+      mComponent(new OMX_COMPONENTTYPE) {
+    memset(mComponent, 0, sizeof(*mComponent));
+    mComponent->nSize = sizeof(*mComponent);
+    mComponent->pComponentPrivate = this;
+    mComponent->pApplicationPrivate = appData;
+
+    *component = mComponent;
+}
+
+SoftOMXComponent::~SoftOMXComponent() {
+    delete mComponent;
+    mComponent = NULL;
+}
+
+void SoftOMXComponent::notify(
+        OMX_EVENTTYPE event,
+        OMX_U32 data1, OMX_U32 data2, OMX_PTR data) {
+    (*mCallbacks->EventHandler)(
+            mComponent, mComponent->pApplicationPrivate,
+            event, data1, data2, data);
+}
+
+void SoftOMXComponent::notifyEmptyBufferDone(OMX_BUFFERHEADERTYPE *header) {
+    (*mCallbacks->EmptyBufferDone)(
+            mComponent, mComponent->pApplicationPrivate, header);
+}
+
+void SoftOMXComponent::notifyFillBufferDone(OMX_BUFFERHEADERTYPE *header) {
+    (*mCallbacks->FillBufferDone)(
+            mComponent, mComponent->pApplicationPrivate, header);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SimpleSoftOMXComponent::SimpleSoftOMXComponent(
+        const char *name,
+        const OMX_CALLBACKTYPE *callbacks,
+        OMX_PTR appData,
+        OMX_COMPONENTTYPE **component)
+    : SoftOMXComponent(name, callbacks, appData, component) {
+}
+
+SimpleSoftOMXComponent::~SimpleSoftOMXComponent() {
+}
+
+void SimpleSoftOMXComponent::addPort(const OMX_PARAM_PORTDEFINITIONTYPE &def) {
+    CHECK_EQ(def.nPortIndex, mPorts.size());
+
+    mPorts.push();
+    PortInfo *info = &mPorts.editItemAt(mPorts.size() - 1);
+    info->mDef = def;
+}
+
+OMX_ERRORTYPE SimpleSoftOMXComponent::getParameter(
+        OMX_INDEXTYPE index, OMX_PTR params) {
+    return internalGetParameter(index, params);
+}
+
+OMX_ERRORTYPE SimpleSoftOMXComponent::setParameter(
+        OMX_INDEXTYPE index, const OMX_PTR params) {
+    return internalSetParameter(index, params);
+}
+
+OMX_ERRORTYPE SimpleSoftOMXComponent::internalGetParameter(
+        OMX_INDEXTYPE index, OMX_PTR params) {
+    switch (index) {
+        case OMX_IndexParamPortDefinition:
+        {
+            OMX_PARAM_PORTDEFINITIONTYPE *defParams =
+                (OMX_PARAM_PORTDEFINITIONTYPE *)params;
+
+            if (defParams->nPortIndex >= mPorts.size()) {
+                return OMX_ErrorUndefined;
+            }
+
+            *defParams = mPorts.itemAt(defParams->nPortIndex).mDef;
+            return OMX_ErrorNone;
+        }
+
+        default:
+            return OMX_ErrorUnsupportedIndex;
+    }
+}
+
+OMX_ERRORTYPE SimpleSoftOMXComponent::internalSetParameter(
+        OMX_INDEXTYPE /* index */, const OMX_PTR /* params */) {
+    return OMX_ErrorUnsupportedIndex;
+}
+
+void SimpleSoftOMXComponent::useBuffer(
+        OMX_U32 portIndex, OMX_BUFFERHEADERTYPE *header) {
+    CHECK_LT(portIndex, mPorts.size());
+
+    PortInfo *port = &mPorts.editItemAt(portIndex);
+    if (port->mDef.eDir == OMX_DirInput) {
+        header->nInputPortIndex = portIndex;
+    } else {
+        header->nOutputPortIndex = portIndex;
+    }
+
+    BufferInfo buffer;
+    buffer.mHeader = header;
+    buffer.mOwnedByUs = false;
+    port->mBuffers.push(buffer);
+}
+
+void SimpleSoftOMXComponent::freeBuffers(OMX_U32 portIndex) {
+    CHECK_LT(portIndex, mPorts.size());
+
+    PortInfo *port = &mPorts.editItemAt(portIndex);
+    CHECK(port->mQueue.empty());
+    port->mBuffers.clear();
+}
+
+void SimpleSoftOMXComponent::emptyThisBuffer(OMX_BUFFERHEADERTYPE *header) {
+    queueBuffer(header->nInputPortIndex, header);
+}
+
+void SimpleSoftOMXComponent::fillThisBuffer(OMX_BUFFERHEADERTYPE *header) {
+    queueBuffer(header->nOutputPortIndex, header);
+}
+
+void SimpleSoftOMXComponent::queueBuffer(
+        OMX_U32 portIndex, OMX_BUFFERHEADERTYPE *header) {
+    CHECK_LT(portIndex, mPorts.size());
+
+    PortInfo *port = &mPorts.editItemAt(portIndex);
+
+    BufferInfo *buffer = NULL;
+    for (size_t i = 0; i < port->mBuffers.size(); ++i) {
+        if (port->mBuffers.itemAt(i).mHeader == header) {
+            buffer = &port->mBuffers.editItemAt(i);
+            break;
+        }
+    }
+    CHECK(buffer != NULL);
+    CHECK(!buffer->mOwnedByUs);
+
+    buffer->mOwnedByUs = true;
+    port->mQueue.push_back(buffer);
+
+    onQueueFilled(portIndex);
+}
+
+void SimpleSoftOMXComponent::returnBuffers(OMX_U32 portIndex) {
+    PortInfo *port = &mPorts.editItemAt(portIndex);
+
+    for (size_t i = 0; i < port->mBuffers.size(); ++i) {
+        BufferInfo *buffer = &port->mBuffers.editItemAt(i);
+        if (!buffer->mOwnedByUs) {
+            continue;
+        }
+
+        buffer->mOwnedByUs = false;
+        if (port->mDef.eDir == OMX_DirInput) {
+            notifyEmptyBufferDone(buffer->mHeader);
+        } else {
+            notifyFillBufferDone(buffer->mHeader);
+        }
+    }
+    port->mQueue.clear();
+}
+
+void SimpleSoftOMXComponent::flushPort(OMX_U32 portIndex) {
+    CHECK_LT(portIndex, mPorts.size());
+
+    returnBuffers(portIndex);
+    onPortFlushCompleted(portIndex);
+}
+
+void SimpleSoftOMXComponent::enablePort(OMX_U32 portIndex, bool enable) {
+    CHECK_LT(portIndex, mPorts.size());
+
+    PortInfo *port = &mPorts.editItemAt(portIndex);
+    if (!enable) {
+        returnBuffers(portIndex);
+    }
+    port->mDef.bEnabled = enable ? OMX_TRUE : OMX_FALSE;
+
+    onPortEnableCompleted(portIndex, enable);
+}
+
+void SimpleSoftOMXComponent::onQueueFilled(OMX_U32 /* portIndex */) {
+}
+
+List<SimpleSoftOMXComponent::BufferInfo *> &
+SimpleSoftOMXComponent::getPortQueue(OMX_U32 portIndex) {
+    CHECK_LT(portIndex, mPorts.size());
+    return mPorts.editItemAt(portIndex).mQueue;
+}
+
+void SimpleSoftOMXComponent::onPortFlushCompleted(OMX_U32 /* portIndex */) {
+}
+
+void SimpleSoftOMXComponent::onPortEnableCompleted(
+        OMX_U32 /* portIndex */, bool /* enabled */) {
+}
+
+}  // namespace android
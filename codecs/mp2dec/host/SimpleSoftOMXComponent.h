@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+#ifndef SIMPLE_SOFT_OMX_COMPONENT_H_
+
+#define SIMPLE_SOFT_OMX_COMPONENT_H_
+
+// Host stand-in for libstagefright_omx's SimpleSoftOMXComponent, so that
+// mp2decbench runs SoftMP2's own onQueueFilled() loop without mediaserver.
+// Ports are plain queues, and buffers come back through the OMX callbacks
+// as they would from the real one. Everything runs on the caller's thread:
+// callbacks must not hand buffers back to the component before they
+// return.
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/List.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+#include <OMX_Component.h>
+
+namespace android {
+
+struct SoftOMXComponent : public RefBase {
+    SoftOMXComponent(
+            const char *name,
+            const OMX_CALLBACKTYPE *callbacks,
+            OMX_PTR appData,
+            OMX_COMPONENTTYPE **component);
+
+protected:
+    virtual ~SoftOMXComponent();
+
+    void notify(
+            OMX_EVENTTYPE event,
+            OMX_U32 data1, OMX_U32 data2, OMX_PTR data);
+
+    void notifyEmptyBufferDone(OMX_BUFFERHEADERTYPE *header);
+    void notifyFillBufferDone(OMX_BUFFERHEADERTYPE *header);
+
+private:
+    const OMX_CALLBACKTYPE *mCallbacks;
+    OMX_COMPONENTTYPE *mComponent;
+
+    DISALLOW_EVIL_CONSTRUCTORS(SoftOMXComponent);
+};
+
+struct SimpleSoftOMXComponent : public SoftOMXComponent {
+    SimpleSoftOMXComponent(
+            const char *name,
+            const OMX_CALLBACKTYPE *callbacks,
+            OMX_PTR appData,
+            OMX_COMPONENTTYPE **component);
+
+    // In place of OMX_GetParameter, OMX_SetParameter, OMX_UseBuffer,
+    // OMX_EmptyThisBuffer, OMX_FillThisBuffer and the port commands.
+    OMX_ERRORTYPE getParameter(OMX_INDEXTYPE index, OMX_PTR params);
+    OMX_ERRORTYPE setParameter(OMX_INDEXTYPE index, const OMX_PTR params);
+
+    void useBuffer(OMX_U32 portIndex, OMX_BUFFERHEADERTYPE *header);
+    void freeBuffers(OMX_U32 portIndex);
+
+    void emptyThisBuffer(OMX_BUFFERHEADERTYPE *header);
+    void fillThisBuffer(OMX_BUFFERHEADERTYPE *header);
+
+    void flushPort(OMX_U32 portIndex);
+    void enablePort(OMX_U32 portIndex, bool enable);
+
+protected:
+    struct BufferInfo {
+        OMX_BUFFERHEADERTYPE *mHeader;
+        bool mOwnedByUs;
+    };
+
+    struct PortInfo {
+        OMX_PARAM_PORTDEFINITIONTYPE mDef;
+        Vector<BufferInfo> mBuffers;
+        List<BufferInfo *> mQueue;
+    };
+
+    virtual ~SimpleSoftOMXComponent();
+
+    void addPort(const OMX_PARAM_PORTDEFINITIONTYPE &def);
+
+    virtual OMX_ERRORTYPE internalGetParameter(
+            OMX_INDEXTYPE index, OMX_PTR params);
+
+    virtual OMX_ERRORTYPE internalSetParameter(
+            OMX_INDEXTYPE index, const OMX_PTR params);
+
+    virtual void onQueueFilled(OMX_U32 portIndex);
+    List<BufferInfo *> &getPortQueue(OMX_U32 portIndex);
+
+    virtual void onPortFlushCompleted(OMX_U32 portIndex);
+    virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
+
+private:
+    Vector<PortInfo> mPorts;
+
+    void queueBuffer(OMX_U32 portIndex, OMX_BUFFERHEADERTYPE *header);
+    void returnBuffers(OMX_U32 portIndex);
+
+    DISALLOW_EVIL_CONSTRUCTORS(SimpleSoftOMXComponent);
+};
+
+}  // namespace android
+
+#endif  // SIMPLE_SOFT_OMX_COMPONENT_H_
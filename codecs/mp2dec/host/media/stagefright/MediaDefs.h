@@ -0,0 +1,21 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+#ifndef MEDIA_DEFS_H_
+
+#define MEDIA_DEFS_H_
+
+// Host stand-in for MediaDefs.h with the types SoftMP2 uses, which are
+// otherwise defined in libstagefright.
+
+namespace android {
+
+extern const char *MEDIA_MIMETYPE_AUDIO_MPEG;
+extern const char *MEDIA_MIMETYPE_AUDIO_MPEG_LAYER_II;
+extern const char *MEDIA_MIMETYPE_AUDIO_RAW;
+
+}  // namespace android
+
+#endif  // MEDIA_DEFS_H_
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+#ifndef A_DEBUG_H_
+
+#define A_DEBUG_H_
+
+// Host stand-in for the foundation ADebug.h. The real CHECK_xx macros
+// format their operands into an AString, which would pull
+// libstagefright_foundation into the host bench.
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Log.h>
+
+#define LITERAL_TO_STRING_INTERNAL(x)    #x
+#define LITERAL_TO_STRING(x) LITERAL_TO_STRING_INTERNAL(x)
+
+#define CHECK(condition)                                \
+    LOG_ALWAYS_FATAL_IF(                                \
+            !(condition),                               \
+            "%s",                                       \
+            __FILE__ ":" LITERAL_TO_STRING(__LINE__)    \
+            " CHECK(" #condition ") failed.")
+
+#define CHECK_OP(x, y, op) CHECK((x) op (y))
+
+#define CHECK_EQ(x,y)   CHECK_OP(x,y,==)
+#define CHECK_NE(x,y)   CHECK_OP(x,y,!=)
+#define CHECK_LE(x,y)   CHECK_OP(x,y,<=)
+#define CHECK_LT(x,y)   CHECK_OP(x,y,<)
+#define CHECK_GE(x,y)   CHECK_OP(x,y,>=)
+#define CHECK_GT(x,y)   CHECK_OP(x,y,>)
+
+#define TRESPASS()      LOG_ALWAYS_FATAL("Should not be here.")
+
+#endif  // A_DEBUG_H_
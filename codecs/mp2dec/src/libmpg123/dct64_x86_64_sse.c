@@ -0,0 +1,176 @@
+/*
+	dct64_x86_64_sse.c: DCT64 with SSE intrinsics, for float output of the x86-64 decoder
+
+	copyright 1995-2008 by the mpg123 project - free software under the terms of the LGPL 2.1
+	see COPYING and AUTHORS files in distribution or http://mpg123.org
+
+	This stands in for the dct64_x86_64_float assembler routine and works on
+	x86 and x86-64 with SSE2. It does the same operations in the same order as
+	the plain C dct64(), so both give bit-identical results.
+	The butterfly stages run four values at a time; the final additions are a
+	chain of dependent sums and stay scalar.
+*/
+
+#include "mpg123lib_intern.h"
+
+#include <emmintrin.h>
+
+#ifndef REAL_IS_FLOAT
+#error "The SSE dct64 needs REAL_IS_FLOAT."
+#endif
+
+void dct64_real_x86_64(real *out0, real *out1, real *samples);
+
+#define REVERSE(v) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(0,1,2,3))
+
+/* load a[i], a[i-1], a[i-2], a[i-3] */
+#define LOADR(a, i) REVERSE(_mm_loadu_ps((a)+(i)-3))
+
+void dct64_real_x86_64(real *out0, real *out1, real *samples)
+{
+	ALIGNED(16) real b1[32];
+	ALIGNED(16) real b2[32];
+	const real *c;
+	__m128 x, y, s, d;
+	int i, j;
+
+	/* Stage 1: a[i] + a[31-i] and (a[15-i] - a[16+i]) * cos64[15-i] */
+	c = pnts[0];
+	for(i=0; i<16; i+=4)
+	{
+		x = _mm_loadu_ps(samples+i);
+		y = LOADR(samples, 31-i);
+		_mm_store_ps(b1+i, _mm_add_ps(x, y));
+		x = LOADR(samples, 15-i);
+		y = _mm_loadu_ps(samples+16+i);
+		_mm_store_ps(b1+16+i, _mm_mul_ps(_mm_sub_ps(x, y), LOADR(c, 15-i)));
+	}
+
+	/* Stage 2: the same on both halves, the second one with reversed sign. */
+	c = pnts[1];
+	for(i=0; i<8; i+=4)
+	{
+		x = _mm_load_ps(b1+i);
+		y = LOADR(b1, 15-i);
+		_mm_store_ps(b2+i, _mm_add_ps(x, y));
+		x = LOADR(b1, 7-i);
+		y = _mm_load_ps(b1+8+i);
+		_mm_store_ps(b2+8+i, _mm_mul_ps(_mm_sub_ps(x, y), LOADR(c, 7-i)));
+
+		x = _mm_load_ps(b1+16+i);
+		y = LOADR(b1, 31-i);
+		_mm_store_ps(b2+16+i, _mm_add_ps(x, y));
+		x = _mm_load_ps(b1+24+i);
+		y = LOADR(b1, 23-i);
+		_mm_store_ps(b2+24+i, _mm_mul_ps(_mm_sub_ps(x, y), LOADR(c, 7-i)));
+	}
+
+	/* Stage 3: blocks of 8, alternating sign. */
+	{
+		__m128 c2 = LOADR(pnts[2], 3);
+		for(j=0; j<32; j+=16)
+		{
+			x = _mm_load_ps(b2+j);
+			y = REVERSE(_mm_load_ps(b2+j+4));
+			_mm_store_ps(b1+j, _mm_add_ps(x, y));
+			_mm_store_ps(b1+j+4, _mm_mul_ps(_mm_sub_ps(REVERSE(x), REVERSE(y)), c2));
+
+			x = _mm_load_ps(b2+j+8);
+			y = REVERSE(_mm_load_ps(b2+j+12));
+			_mm_store_ps(b1+j+8, _mm_add_ps(x, y));
+			_mm_store_ps(b1+j+12, _mm_mul_ps(_mm_sub_ps(REVERSE(y), REVERSE(x)), c2));
+		}
+	}
+
+	/* Stage 4: blocks of 4, two sums followed by two scaled differences. */
+	{
+		__m128 c3 = _mm_setr_ps(0, 0, pnts[3][1], pnts[3][0]);
+		for(j=0; j<32; j+=8)
+		{
+			x = _mm_load_ps(b1+j);
+			y = REVERSE(x);
+			s = _mm_add_ps(x, y);
+			d = _mm_mul_ps(_mm_sub_ps(y, x), c3);
+			_mm_store_ps(b2+j, _mm_shuffle_ps(s, d, _MM_SHUFFLE(3,2,1,0)));
+
+			x = _mm_load_ps(b1+j+4);
+			y = REVERSE(x);
+			s = _mm_add_ps(x, y);
+			d = _mm_mul_ps(_mm_sub_ps(x, y), c3);
+			_mm_store_ps(b2+j+4, _mm_shuffle_ps(s, d, _MM_SHUFFLE(3,2,1,0)));
+		}
+	}
+
+	/* Stage 5: pairs; v0-v1 in the first and v1-v0 in the second one.
+	   Both differences are computed as such, negating one would flip the sign of zeros. */
+	{
+		__m128 c4 = _mm_set1_ps(pnts[4][0]);
+		for(j=0; j<32; j+=4)
+		{
+			x = _mm_load_ps(b2+j);
+			y = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2,3,0,1));
+			s = _mm_add_ps(x, y);
+			/* [v0-v1, v0-v1, v3-v2, v3-v2] */
+			d = _mm_shuffle_ps(_mm_sub_ps(y, x), _mm_sub_ps(x, y), _MM_SHUFFLE(3,3,1,1));
+			d = _mm_mul_ps(d, c4);
+			x = _mm_shuffle_ps(s, d, _MM_SHUFFLE(3,0,2,0));
+			_mm_store_ps(b1+j, _mm_shuffle_ps(x, x, _MM_SHUFFLE(3,1,2,0)));
+		}
+	}
+
+	for(i=0; i<32; i+=4)
+	b1[i+2] += b1[i+3];
+
+	for(i=0; i<32; i+=8)
+	{
+		b1[i+4] += b1[i+6];
+		b1[i+6] += b1[i+5];
+		b1[i+5] += b1[i+7];
+	}
+
+	for(i=0; i<32; i+=16)
+	{
+		b1[i+8]  += b1[i+12];
+		b1[i+12] += b1[i+10];
+		b1[i+10] += b1[i+14];
+		b1[i+14] += b1[i+9];
+		b1[i+9]  += b1[i+13];
+		b1[i+13] += b1[i+11];
+		b1[i+11] += b1[i+15];
+	}
+
+	out0[0x10*16] = b1[0];
+	out0[0x10*15] = b1[16+0]  + b1[16+8];
+	out0[0x10*14] = b1[8];
+	out0[0x10*13] = b1[16+8]  + b1[16+4];
+	out0[0x10*12] = b1[4];
+	out0[0x10*11] = b1[16+4]  + b1[16+12];
+	out0[0x10*10] = b1[12];
+	out0[0x10* 9] = b1[16+12] + b1[16+2];
+	out0[0x10* 8] = b1[2];
+	out0[0x10* 7] = b1[16+2]  + b1[16+10];
+	out0[0x10* 6] = b1[10];
+	out0[0x10* 5] = b1[16+10] + b1[16+6];
+	out0[0x10* 4] = b1[6];
+	out0[0x10* 3] = b1[16+6]  + b1[16+14];
+	out0[0x10* 2] = b1[14];
+	out0[0x10* 1] = b1[16+14] + b1[16+1];
+	out0[0x10* 0] = b1[1];
+
+	out1[0x10* 0] = b1[1];
+	out1[0x10* 1] = b1[16+1]  + b1[16+9];
+	out1[0x10* 2] = b1[9];
+	out1[0x10* 3] = b1[16+9]  + b1[16+5];
+	out1[0x10* 4] = b1[5];
+	out1[0x10* 5] = b1[16+5]  + b1[16+13];
+	out1[0x10* 6] = b1[13];
+	out1[0x10* 7] = b1[16+13] + b1[16+3];
+	out1[0x10* 8] = b1[3];
+	out1[0x10* 9] = b1[16+3]  + b1[16+11];
+	out1[0x10*10] = b1[11];
+	out1[0x10*11] = b1[16+11] + b1[16+7];
+	out1[0x10*12] = b1[7];
+	out1[0x10*13] = b1[16+7]  + b1[16+15];
+	out1[0x10*14] = b1[15];
+	out1[0x10*15] = b1[16+15];
+}
@@ -0,0 +1,383 @@
+/*
+	synth_x86_64_sse.c: synth windowing with SSE2/AVX2 intrinsics, for the x86-64 decoder
+
+	copyright 1995-2008 by the mpg123 project - free software under the terms of the LGPL 2.1
+	see COPYING and AUTHORS files in distribution or http://mpg123.org
+
+	These stand in for the x86-64 assembler routines behind the hulls in synth.c,
+	synth_real.c and synth_s32.c and work on x86 and x86-64 with SSE2.
+	AVX2 is used when the CPU has it, checked once at runtime.
+
+	Each of the 32 output samples is a chain of 16 multiply-adds. The generic C synth
+	runs these chains one after the other; here 4 (SSE2) or 8 (AVX2) chains run side
+	by side, one per vector lane, with the products transposed into place.
+	Every chain still does the same operations in the same order, so the output is
+	bit-identical to the generic synth with accurate rounding.
+
+	The window is the one make_decode_tables() prepares for the x86-64 decoder:
+	decwin[512+32+i] = -decwin[511-i], which lets the second half of the samples run
+	forward through memory. Negation is exact, so this changes no result bits.
+*/
+
+#include "mpg123lib_intern.h"
+
+#include <emmintrin.h>
+
+#ifndef REAL_IS_FLOAT
+#error "The SSE synth needs REAL_IS_FLOAT."
+#endif
+
+#ifndef ACCURATE_ROUNDING
+#error "The SSE synth only has the accurate rounding variant, build with ACCURATE_ROUNDING."
+#endif
+
+#if defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+#define SYNTH_AVX2 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+int synth_1to1_x86_64_accurate_asm(real *window, real *b0, short *samples, int bo1);
+int synth_1to1_s_x86_64_accurate_asm(real *window, real *b0l, real *b0r, short *samples, int bo1);
+int synth_1to1_real_x86_64_asm(real *window, real *b0, real *samples, int bo1);
+int synth_1to1_real_s_x86_64_asm(real *window, real *b0l, real *b0r, real *samples, int bo1);
+int synth_1to1_s32_x86_64_asm(real *window, real *b0, int32_t *samples, int bo1);
+int synth_1to1_s32_s_x86_64_asm(real *window, real *b0l, real *b0r, int32_t *samples, int bo1);
+
+/*
+	Sample n of the block, with w = decwin+16-bo1 as in the generic synth:
+	  n = 0..15:  w[32n+k] * b0[16n+k], k = 0..15, alternately added and subtracted
+	  n = 16:     w[512+k] * b0[256+k], k = 0, 2, .. 14, all added
+	  n = 17..31: decwin[560-bo1+32m+k] * b0[240-16m+k], m = n-17, k = 0..15, all added
+	The sample 32 lane of the last group only reads valid memory and is dropped.
+*/
+
+/*
+	Four samples; "bstep" is the distance between dct64 rows, "alternate" selects the
+	signs of the first half. The products of one row do not depend on each other, so
+	they are formed first and only the products get transposed.
+*/
+static inline void window_sse(const real *w, const real *b, int bstep, int alternate, real *sums)
+{
+	__m128 p0, p1, p2, p3, acc;
+	int k;
+
+	acc = _mm_setzero_ps();
+	for(k=0; k<16; k+=4)
+	{
+		p0 = _mm_mul_ps(_mm_loadu_ps(w+k), _mm_loadu_ps(b+k));
+		p1 = _mm_mul_ps(_mm_loadu_ps(w+32+k), _mm_loadu_ps(b+bstep+k));
+		p2 = _mm_mul_ps(_mm_loadu_ps(w+64+k), _mm_loadu_ps(b+2*bstep+k));
+		p3 = _mm_mul_ps(_mm_loadu_ps(w+96+k), _mm_loadu_ps(b+3*bstep+k));
+		_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+		acc = k == 0 ? p0 : _mm_add_ps(acc, p0);
+		if(alternate)
+		{
+			acc = _mm_sub_ps(acc, p1);
+			acc = _mm_add_ps(acc, p2);
+			acc = _mm_sub_ps(acc, p3);
+		}
+		else
+		{
+			acc = _mm_add_ps(acc, p1);
+			acc = _mm_add_ps(acc, p2);
+			acc = _mm_add_ps(acc, p3);
+		}
+	}
+	_mm_storeu_ps(sums, acc);
+}
+
+static void window_sums_sse(const real *decwin, const real *b0, int bo1, real *sums)
+{
+	const real *w = decwin + 16 - bo1;
+	int n;
+
+	for(n=0; n<16; n+=4)
+	window_sse(w+32*n, b0+16*n, 16, 1, sums+n);
+
+	for(n=0; n<16; n+=4)
+	window_sse(decwin+560-bo1+32*n, b0+240-16*n, -16, 0, sums+17+n);
+}
+
+#ifdef SYNTH_AVX2
+/* Rows i and i+4 of a group of eight, in the low and high half. */
+#define LOAD_ROWS(p, step, i, k) _mm256_insertf128_ps( \
+	_mm256_castps128_ps256(_mm_loadu_ps((p)+(step)*(i)+(k))), \
+	_mm_loadu_ps((p)+(step)*((i)+4)+(k)), 1)
+
+/* Eight samples, the same as window_sse() with twice the lanes. */
+static inline AVX2_TARGET void window_avx2(const real *w, const real *b, int bstep, int alternate, real *sums)
+{
+	__m256 p0, p1, p2, p3, t0, t1, t2, t3, acc;
+	int k;
+
+	acc = _mm256_setzero_ps();
+	for(k=0; k<16; k+=4)
+	{
+		p0 = _mm256_mul_ps(LOAD_ROWS(w, 32, 0, k), LOAD_ROWS(b, bstep, 0, k));
+		p1 = _mm256_mul_ps(LOAD_ROWS(w, 32, 1, k), LOAD_ROWS(b, bstep, 1, k));
+		p2 = _mm256_mul_ps(LOAD_ROWS(w, 32, 2, k), LOAD_ROWS(b, bstep, 2, k));
+		p3 = _mm256_mul_ps(LOAD_ROWS(w, 32, 3, k), LOAD_ROWS(b, bstep, 3, k));
+		/* 4x4 transpose within each half */
+		t0 = _mm256_unpacklo_ps(p0, p1);
+		t1 = _mm256_unpackhi_ps(p0, p1);
+		t2 = _mm256_unpacklo_ps(p2, p3);
+		t3 = _mm256_unpackhi_ps(p2, p3);
+		p0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1,0,1,0));
+		p1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3,2,3,2));
+		p2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1,0,1,0));
+		p3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3,2,3,2));
+		acc = k == 0 ? p0 : _mm256_add_ps(acc, p0);
+		if(alternate)
+		{
+			acc = _mm256_sub_ps(acc, p1);
+			acc = _mm256_add_ps(acc, p2);
+			acc = _mm256_sub_ps(acc, p3);
+		}
+		else
+		{
+			acc = _mm256_add_ps(acc, p1);
+			acc = _mm256_add_ps(acc, p2);
+			acc = _mm256_add_ps(acc, p3);
+		}
+	}
+	_mm256_storeu_ps(sums, acc);
+}
+
+static AVX2_TARGET void window_sums_avx2(const real *decwin, const real *b0, int bo1, real *sums)
+{
+	const real *w = decwin + 16 - bo1;
+
+	window_avx2(w, b0, 16, 1, sums);
+	window_avx2(w+256, b0+128, 16, 1, sums+8);
+	window_avx2(decwin+560-bo1, b0+240, -16, 0, sums+17);
+	window_avx2(decwin+560-bo1+256, b0+112, -16, 0, sums+25);
+	_mm256_zeroupper();
+}
+#endif
+
+typedef void (*window_sums_func)(const real *decwin, const real *b0, int bo1, real *sums);
+
+static window_sums_func choose_window_sums(void)
+{
+#ifdef SYNTH_AVX2
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) return window_sums_avx2;
+#endif
+	return window_sums_sse;
+}
+
+/* Fills sums[0..31] with the unscaled output samples of one block. */
+static void window_sums(const real *decwin, const real *b0, int bo1, real *sums)
+{
+	/* Choosing twice in a race does no harm. */
+	static window_sums_func func = NULL;
+	const real *w;
+	real sum;
+
+	if(func == NULL) func = choose_window_sums();
+
+	/* Writes sums[0..15] and sums[17..32], sample 16 is done here. */
+	func(decwin, b0, bo1, sums);
+
+	w = decwin + 16 - bo1 + 512;
+	b0 += 256;
+	sum  = w[0x0] * b0[0x0];
+	sum += w[0x2] * b0[0x2];
+	sum += w[0x4] * b0[0x4];
+	sum += w[0x6] * b0[0x6];
+	sum += w[0x8] * b0[0x8];
+	sum += w[0xA] * b0[0xA];
+	sum += w[0xC] * b0[0xC];
+	sum += w[0xE] * b0[0xE];
+	sums[16] = sum;
+}
+
+/* Round half away from zero as the +-0.5 rounding in sample.h does:
+   truncate and look at the exact remainder. */
+static inline __m128i round_away(__m128 x)
+{
+	__m128i r = _mm_cvttps_epi32(x);
+	__m128 frac = _mm_sub_ps(x, _mm_cvtepi32_ps(r));
+	r = _mm_sub_epi32(r, _mm_castps_si128(_mm_cmpge_ps(frac, _mm_set1_ps(0.5f))));
+	r = _mm_add_epi32(r, _mm_castps_si128(_mm_cmple_ps(frac, _mm_set1_ps(-0.5f))));
+	return r;
+}
+
+/* REAL_TO_SHORT_ACCURATE after clamping to the 16 bit range. */
+static inline __m128i round_s16(__m128 x, __m128 lo, __m128 hi)
+{
+	x = _mm_min_ps(_mm_max_ps(x, lo), hi);
+#ifdef IEEE_FLOAT
+	/* ftoi16() rounds half to even, like the default MXCSR mode. */
+	return _mm_cvtps_epi32(x);
+#else
+	return round_away(x);
+#endif
+}
+
+static inline int count_clipped(__m128 x, __m128 lo, __m128 hi)
+{
+	return __builtin_popcount(_mm_movemask_ps(
+		_mm_or_ps(_mm_cmpgt_ps(x, hi), _mm_cmplt_ps(x, lo))));
+}
+
+static int sums_to_s16(const real *sums, short *out)
+{
+	const __m128 lo = _mm_set1_ps(-32768.0f);
+	const __m128 hi = _mm_set1_ps(32767.0f);
+	int clip = 0;
+	int i;
+
+	for(i=0; i<32; i+=8)
+	{
+		__m128 x0 = _mm_load_ps(sums+i);
+		__m128 x1 = _mm_load_ps(sums+i+4);
+		clip += count_clipped(x0, lo, hi) + count_clipped(x1, lo, hi);
+		_mm_store_si128((__m128i *)(out+i),
+			_mm_packs_epi32(round_s16(x0, lo, hi), round_s16(x1, lo, hi)));
+	}
+	return clip;
+}
+
+static int sums_to_s32(const real *sums, int32_t *out)
+{
+	/* Clipping as WRITE_S32_SAMPLE does it, against the double limits.
+	   2^31 is the first float above 2147483647, -2^31 is exact. */
+	const __m128 scale = _mm_set1_ps((float)S32_RESCALE);
+	const __m128 lo = _mm_set1_ps(-2147483648.0f);
+	const __m128 hi = _mm_set1_ps(2147483648.0f);
+	const __m128 maxbelow = _mm_set1_ps(2147483520.0f);
+	int clip = 0;
+	int i;
+
+	for(i=0; i<32; i+=4)
+	{
+		__m128 x = _mm_mul_ps(_mm_load_ps(sums+i), scale);
+		__m128 over = _mm_cmpge_ps(x, hi);
+		__m128i r;
+		clip += __builtin_popcount(_mm_movemask_ps(_mm_or_ps(over, _mm_cmplt_ps(x, lo))));
+		r = round_away(_mm_min_ps(_mm_max_ps(x, lo), maxbelow));
+		r = _mm_or_si128(_mm_andnot_si128(_mm_castps_si128(over), r),
+			_mm_and_si128(_mm_castps_si128(over), _mm_set1_epi32(0x7fffffff)));
+		_mm_storeu_si128((__m128i *)(out+i), r);
+	}
+	return clip;
+}
+
+static void sums_to_real(const real *sums, real *out)
+{
+	const __m128 scale = _mm_set1_ps((real)1./SHORT_SCALE);
+	int i;
+
+	for(i=0; i<32; i+=4)
+	_mm_store_ps(out+i, _mm_mul_ps(scale, _mm_load_ps(sums+i)));
+}
+
+int synth_1to1_x86_64_accurate_asm(real *window, real *b0, short *samples, int bo1)
+{
+	ALIGNED(16) real sums[40];
+	ALIGNED(16) short out[32];
+	int clip, i;
+
+	window_sums(window, b0, bo1, sums);
+	clip = sums_to_s16(sums, out);
+	for(i=0; i<32; ++i)
+	samples[2*i] = out[i];
+
+	return clip;
+}
+
+int synth_1to1_s_x86_64_accurate_asm(real *window, real *b0l, real *b0r, short *samples, int bo1)
+{
+	ALIGNED(16) real sums[2][40];
+	ALIGNED(16) short out[2][32];
+	int clip, i;
+
+	window_sums(window, b0l, bo1, sums[0]);
+	window_sums(window, b0r, bo1, sums[1]);
+	clip = sums_to_s16(sums[0], out[0]);
+	clip += sums_to_s16(sums[1], out[1]);
+
+	for(i=0; i<32; i+=8)
+	{
+		__m128i l = _mm_load_si128((const __m128i *)(out[0]+i));
+		__m128i r = _mm_load_si128((const __m128i *)(out[1]+i));
+		_mm_storeu_si128((__m128i *)(samples+2*i), _mm_unpacklo_epi16(l, r));
+		_mm_storeu_si128((__m128i *)(samples+2*i+8), _mm_unpackhi_epi16(l, r));
+	}
+
+	return clip;
+}
+
+int synth_1to1_real_x86_64_asm(real *window, real *b0, real *samples, int bo1)
+{
+	ALIGNED(16) real sums[40];
+	ALIGNED(16) real out[32];
+	int i;
+
+	window_sums(window, b0, bo1, sums);
+	sums_to_real(sums, out);
+	for(i=0; i<32; ++i)
+	samples[2*i] = out[i];
+
+	return 0;
+}
+
+int synth_1to1_real_s_x86_64_asm(real *window, real *b0l, real *b0r, real *samples, int bo1)
+{
+	ALIGNED(16) real sums[2][40];
+	ALIGNED(16) real out[2][32];
+	int i;
+
+	window_sums(window, b0l, bo1, sums[0]);
+	window_sums(window, b0r, bo1, sums[1]);
+	sums_to_real(sums[0], out[0]);
+	sums_to_real(sums[1], out[1]);
+
+	for(i=0; i<32; i+=4)
+	{
+		__m128 l = _mm_load_ps(out[0]+i);
+		__m128 r = _mm_load_ps(out[1]+i);
+		_mm_storeu_ps(samples+2*i, _mm_unpacklo_ps(l, r));
+		_mm_storeu_ps(samples+2*i+4, _mm_unpackhi_ps(l, r));
+	}
+
+	return 0;
+}
+
+int synth_1to1_s32_x86_64_asm(real *window, real *b0, int32_t *samples, int bo1)
+{
+	ALIGNED(16) real sums[40];
+	ALIGNED(16) int32_t out[32];
+	int clip, i;
+
+	window_sums(window, b0, bo1, sums);
+	clip = sums_to_s32(sums, out);
+	for(i=0; i<32; ++i)
+	samples[2*i] = out[i];
+
+	return clip;
+}
+
+int synth_1to1_s32_s_x86_64_asm(real *window, real *b0l, real *b0r, int32_t *samples, int bo1)
+{
+	ALIGNED(16) real sums[2][40];
+	ALIGNED(16) int32_t out[2][32];
+	int clip, i;
+
+	window_sums(window, b0l, bo1, sums[0]);
+	window_sums(window, b0r, bo1, sums[1]);
+	clip = sums_to_s32(sums[0], out[0]);
+	clip += sums_to_s32(sums[1], out[1]);
+
+	for(i=0; i<32; i+=4)
+	{
+		__m128i l = _mm_load_si128((const __m128i *)(out[0]+i));
+		__m128i r = _mm_load_si128((const __m128i *)(out[1]+i));
+		_mm_storeu_si128((__m128i *)(samples+2*i), _mm_unpacklo_epi32(l, r));
+		_mm_storeu_si128((__m128i *)(samples+2*i+4), _mm_unpackhi_epi32(l, r));
+	}
+
+	return clip;
+}
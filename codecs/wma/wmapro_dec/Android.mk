@@ -20,3 +20,42 @@ LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
 
+
+#####################################################################################################
+
+# Host build of the decoder, and a test that decodes a WMA Pro corpus with
+# the C kernels and with the vector ones and checks they agree bit for bit.
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        bitstream.c     \
+        WmaproApi.c     \
+        wmaprodec.c
+
+LOCAL_MULTILIB := 64
+
+LOCAL_MODULE := libstagefright_wmaprodec_host
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        WmaproDecBench.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+        libstagefright_wmaprodec_host
+
+LOCAL_SHARED_LIBRARIES := \
+        liblog
+
+LOCAL_LDLIBS += -lpthread
+
+LOCAL_MULTILIB := 64
+
+LOCAL_MODULE := wmaprodecbench
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -11,6 +11,7 @@ extern int  decode_init(AudioContext *avctx);
 extern int  decode_end(AudioContext *avctx);
 extern int  decode_packet(AudioContext *avctx, void *data, int *data_size, uint8_t* buf, int buf_size);
 extern void flush(AudioContext *avctx);
+extern int  select_dsp(const char *name);
 
 _malloc_lib  malloc_lib;
 _realloc_lib realloc_lib;
@@ -124,3 +125,8 @@ void wmapro_dec_reset(AudioContext *avctx)
 	 flush(avctx);
 }
 
+
+int wmapro_dec_select_dsp(const char *name)
+{
+    return select_dsp(name);
+}
@@ -0,0 +1,627 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Decodes the WMA Pro stream of each ASF file given with the C kernels and
+// with every vector kernel built in and supported by this CPU, checks that
+// all of them give the same samples bit for bit, and reports the decoding
+// speed of each. The audio payloads are put back together into media
+// objects and fed to the decoder the way SoftWmapro does, so a directory of
+// files makes a regression corpus for the FFT, windowing and channel
+// transform kernels.
+//
+// usage: wmaprodecbench [-n iterations] file.wma...
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "WmaproDecBench"
+#include <utils/Log.h>
+
+#include "wmapro_dec_api.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace android {
+
+static const char *kKernels[] = { "neon", "sse2", "sse4.1", "avx2" };
+
+static const uint16_t kWmaproFormatTag = 0x0162;
+
+static const uint8_t kHeaderGuid[16] = {
+    0x30, 0x26, 0xb2, 0x75, 0x8e, 0x66, 0xcf, 0x11,
+    0xa6, 0xd9, 0x00, 0xaa, 0x00, 0x62, 0xce, 0x6c,
+};
+static const uint8_t kDataGuid[16] = {
+    0x36, 0x26, 0xb2, 0x75, 0x8e, 0x66, 0xcf, 0x11,
+    0xa6, 0xd9, 0x00, 0xaa, 0x00, 0x62, 0xce, 0x6c,
+};
+static const uint8_t kFilePropertiesGuid[16] = {
+    0xa1, 0xdc, 0xab, 0x8c, 0x47, 0xa9, 0xcf, 0x11,
+    0x8e, 0xe4, 0x00, 0xc0, 0x0c, 0x20, 0x53, 0x65,
+};
+static const uint8_t kStreamPropertiesGuid[16] = {
+    0x91, 0x07, 0xdc, 0xb7, 0xb7, 0xa9, 0xcf, 0x11,
+    0x8e, 0xe6, 0x00, 0xc0, 0x0c, 0x20, 0x53, 0x65,
+};
+static const uint8_t kAudioMediaGuid[16] = {
+    0x40, 0x9e, 0x69, 0xf8, 0x4d, 0x5b, 0xcf, 0x11,
+    0xa8, 0xfd, 0x00, 0x80, 0x5f, 0x5c, 0x44, 0x2b,
+};
+static const uint8_t kAudioSpreadGuid[16] = {
+    0x50, 0xcd, 0xc3, 0xbf, 0x8f, 0x61, 0xcf, 0x11,
+    0x8b, 0xb2, 0x00, 0xaa, 0x00, 0xb4, 0xe2, 0x20,
+};
+
+static uint32_t U16LE(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t U32LE(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t U64LE(const uint8_t *p) {
+    return U32LE(p) | ((uint64_t)U32LE(p + 4) << 32);
+}
+
+struct Buffer {
+    Buffer()
+        : mData(NULL),
+          mSize(0),
+          mCapacity(0) {
+    }
+
+    ~Buffer() {
+        free(mData);
+    }
+
+    void append(const uint8_t *data, size_t size) {
+        if (mSize + size > mCapacity) {
+            mCapacity = (mSize + size) * 2;
+            mData = (uint8_t *)realloc(mData, mCapacity);
+        }
+        memcpy(mData + mSize, data, size);
+        mSize += size;
+    }
+
+    uint8_t *mData;
+    size_t mSize;
+    size_t mCapacity;
+};
+
+// The audio stream of an ASF file, and its media objects in order, each
+// one the payload of a buffer SoftWmapro would get from the extractor.
+struct Stream {
+    Stream()
+        : mStreamNumber(-1),
+          mExtraData(NULL),
+          mExtraDataSize(0),
+          mSpan(1),
+          mVirtualPacketSize(0),
+          mVirtualChunkSize(0) {
+        memset(&mFormat, 0, sizeof(mFormat));
+    }
+
+    int mStreamNumber;
+    waveformat_t mFormat;
+    const uint8_t *mExtraData;
+    size_t mExtraDataSize;
+
+    // Audio spread error correction, which interleaves the chunks of
+    // "span" consecutive objects.
+    int mSpan;
+    size_t mVirtualPacketSize;
+    size_t mVirtualChunkSize;
+
+    Buffer mObjects;
+    Buffer mObjectSizes;
+};
+
+static bool ParseStreamProperties(const uint8_t *p, size_t size, Stream *stream) {
+    if (size < 54 || memcmp(p, kAudioMediaGuid, 16) != 0) {
+        return true;
+    }
+
+    size_t typeSize = U32LE(p + 40);
+    size_t ecSize = U32LE(p + 44);
+    const uint8_t *type = p + 54;
+    if (54 + typeSize + ecSize > size || typeSize < 18) {
+        return false;
+    }
+
+    if (U16LE(type) != kWmaproFormatTag || stream->mStreamNumber >= 0) {
+        return true;
+    }
+
+    stream->mStreamNumber = U16LE(p + 48) & 0x7f;
+    stream->mFormat.wFormatTag = U16LE(type);
+    stream->mFormat.nChannels = U16LE(type + 2);
+    stream->mFormat.nSamplesPerSec = U32LE(type + 4);
+    stream->mFormat.nAvgBytesPerSec = U32LE(type + 8);
+    stream->mFormat.nBlockAlign = U16LE(type + 12);
+    stream->mFormat.wBitsPerSample = U16LE(type + 14);
+    stream->mExtraDataSize = U16LE(type + 16);
+    stream->mExtraData = type + 18;
+    if (18 + stream->mExtraDataSize > typeSize) {
+        return false;
+    }
+
+    const uint8_t *ec = type + typeSize;
+    if (memcmp(p + 16, kAudioSpreadGuid, 16) == 0 && ecSize >= 5) {
+        stream->mSpan = ec[0];
+        stream->mVirtualPacketSize = U16LE(ec + 1);
+        stream->mVirtualChunkSize = U16LE(ec + 3);
+        if (stream->mSpan > 1 && (stream->mVirtualChunkSize == 0
+                || stream->mVirtualPacketSize % stream->mVirtualChunkSize != 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Undoes the audio spread of a complete object, like libavformat does.
+static void Descramble(const Stream &stream, uint8_t *data, size_t size) {
+    size_t chunk = stream.mVirtualChunkSize;
+    if (stream.mSpan <= 1
+            || size != stream.mVirtualPacketSize * stream.mSpan) {
+        return;
+    }
+
+    uint8_t *copy = (uint8_t *)malloc(size);
+    memcpy(copy, data, size);
+    for (size_t offset = 0; offset < size; offset += chunk) {
+        size_t n = offset / chunk;
+        size_t row = n / stream.mSpan;
+        size_t col = n % stream.mSpan;
+        size_t index = row + col * stream.mVirtualPacketSize / chunk;
+        memcpy(data + offset, copy + index * chunk, chunk);
+    }
+    free(copy);
+}
+
+static uint32_t ReadValue(const uint8_t **p, const uint8_t *end, int type, bool *ok) {
+    static const int kSizes[] = { 0, 1, 2, 4 };
+    int n = kSizes[type & 3];
+    if (*p + n > end) {
+        *ok = false;
+        return 0;
+    }
+
+    uint32_t value = n == 1 ? (*p)[0] : n == 2 ? U16LE(*p) : n == 4 ? U32LE(*p) : 0;
+    *p += n;
+    return value;
+}
+
+struct Assembler {
+    Assembler(Stream *stream)
+        : mStream(stream),
+          mObjectNumber(-1),
+          mObjectSize(0),
+          mReceived(0) {
+    }
+
+    void finish() {
+        if (mObject.mSize > 0 && mReceived == mObjectSize) {
+            Descramble(*mStream, mObject.mData, mObject.mSize);
+            mStream->mObjects.append(mObject.mData, mObject.mSize);
+            uint32_t size = mObject.mSize;
+            mStream->mObjectSizes.append((const uint8_t *)&size, sizeof(size));
+        }
+        mObject.mSize = 0;
+        mObjectNumber = -1;
+    }
+
+    void add(uint32_t objectNumber, uint32_t objectSize, uint32_t offset,
+             const uint8_t *data, size_t size) {
+        if ((int64_t)objectNumber != mObjectNumber || offset == 0) {
+            finish();
+            mObjectNumber = objectNumber;
+            mObjectSize = objectSize;
+            mReceived = 0;
+            mObject.mSize = 0;
+            if (mObject.mCapacity < objectSize) {
+                mObject.mCapacity = objectSize;
+                mObject.mData = (uint8_t *)realloc(mObject.mData, objectSize);
+            }
+            mObject.mSize = objectSize;
+        }
+
+        // Fragments that do not fit are damage; drop the object.
+        if (objectSize != mObjectSize || offset != mReceived
+                || offset + size > mObjectSize) {
+            mObject.mSize = 0;
+            return;
+        }
+        memcpy(mObject.mData + offset, data, size);
+        mReceived += size;
+        if (mReceived == mObjectSize) {
+            finish();
+        }
+    }
+
+    Stream *mStream;
+    Buffer mObject;
+    int64_t mObjectNumber;
+    uint32_t mObjectSize;
+    uint32_t mReceived;
+};
+
+static bool ParsePacket(
+        const uint8_t *packet, size_t packetSize, Assembler *assembler) {
+    const uint8_t *p = packet;
+    const uint8_t *end = packet + packetSize;
+    bool ok = true;
+
+    if (p[0] & 0x80) {
+        p += 1 + (p[0] & 0x0f);
+    }
+    if (p + 2 > end) {
+        return false;
+    }
+
+    int lengthFlags = *p++;
+    int propertyFlags = *p++;
+
+    uint32_t length = ReadValue(&p, end, lengthFlags >> 5, &ok);
+    ReadValue(&p, end, lengthFlags >> 1, &ok);
+    uint32_t padding = ReadValue(&p, end, lengthFlags >> 3, &ok);
+    p += 6;  // send time and duration
+
+    if ((lengthFlags >> 5) & 3) {
+        if (length > packetSize) {
+            return false;
+        }
+        padding += packetSize - length;
+    }
+    if (!ok || p > end || padding > (size_t)(end - p)) {
+        return false;
+    }
+    end -= padding;
+
+    int numPayloads = 1;
+    int payloadLengthType = 0;
+    bool multiple = lengthFlags & 1;
+    if (multiple) {
+        if (p >= end) {
+            return false;
+        }
+        numPayloads = *p & 0x3f;
+        payloadLengthType = *p >> 6;
+        ++p;
+    }
+
+    for (int i = 0; i < numPayloads; ++i) {
+        if (p >= end) {
+            return false;
+        }
+        int streamNumber = *p++ & 0x7f;
+        uint32_t objectNumber = ReadValue(&p, end, propertyFlags >> 4, &ok);
+        uint32_t offset = ReadValue(&p, end, propertyFlags >> 2, &ok);
+        uint32_t replicatedSize = ReadValue(&p, end, propertyFlags, &ok);
+        if (!ok || replicatedSize > (size_t)(end - p)) {
+            return false;
+        }
+
+        uint32_t objectSize = 0;
+        bool compressed = replicatedSize == 1;
+        if (replicatedSize >= 8) {
+            objectSize = U32LE(p);
+        }
+        p += replicatedSize;
+        if (compressed) {
+            ++p;  // presentation time delta
+        }
+
+        size_t size = end - p;
+        if (multiple) {
+            size = ReadValue(&p, end, payloadLengthType, &ok);
+            if (!ok || size > (size_t)(end - p)) {
+                return false;
+            }
+        }
+
+        if (streamNumber == assembler->mStream->mStreamNumber) {
+            if (compressed) {
+                // Whole objects, each with a one byte size.
+                const uint8_t *q = p;
+                while (q < p + size) {
+                    size_t n = *q++;
+                    if (n > (size_t)(p + size - q)) {
+                        return false;
+                    }
+                    assembler->add(objectNumber++, n, 0, q, n);
+                    q += n;
+                }
+            } else if (replicatedSize >= 8) {
+                assembler->add(objectNumber, objectSize, offset, p, size);
+            }
+        }
+        p += size;
+    }
+    return true;
+}
+
+// Finds the WMA Pro stream and collects its media objects.
+static bool ParseAsf(const uint8_t *data, size_t size, Stream *stream) {
+    if (size < 30 || memcmp(data, kHeaderGuid, 16) != 0) {
+        fprintf(stderr, "not an ASF file\n");
+        return false;
+    }
+
+    uint64_t headerSize = U64LE(data + 16);
+    if (headerSize < 30 || headerSize > size) {
+        fprintf(stderr, "bad ASF header\n");
+        return false;
+    }
+
+    size_t packetSize = 0;
+    for (size_t pos = 30; pos + 24 <= headerSize;) {
+        uint64_t objectSize = U64LE(data + pos + 16);
+        if (objectSize < 24 || objectSize > headerSize - pos) {
+            fprintf(stderr, "bad ASF header object\n");
+            return false;
+        }
+
+        const uint8_t *p = data + pos + 24;
+        if (memcmp(data + pos, kFilePropertiesGuid, 16) == 0 && objectSize >= 24 + 80) {
+            // Packets are of a fixed size, the minimum and maximum agree.
+            packetSize = U32LE(p + 68);
+            if (packetSize != U32LE(p + 72)) {
+                packetSize = 0;
+            }
+        } else if (memcmp(data + pos, kStreamPropertiesGuid, 16) == 0) {
+            if (!ParseStreamProperties(p, objectSize - 24, stream)) {
+                fprintf(stderr, "bad stream properties\n");
+                return false;
+            }
+        }
+        pos += objectSize;
+    }
+
+    if (stream->mStreamNumber < 0) {
+        fprintf(stderr, "no WMA Pro stream\n");
+        return false;
+    }
+    if (packetSize == 0) {
+        fprintf(stderr, "packets are not of a fixed size\n");
+        return false;
+    }
+
+    size_t pos = headerSize;
+    if (pos + 50 > size || memcmp(data + pos, kDataGuid, 16) != 0) {
+        fprintf(stderr, "no ASF data object\n");
+        return false;
+    }
+    uint64_t dataSize = U64LE(data + pos + 16);
+    if (dataSize < 50 || dataSize > size - pos) {
+        // A file still being written, or cut short.
+        dataSize = size - pos;
+    }
+
+    Assembler assembler(stream);
+    const uint8_t *end = data + pos + dataSize;
+    for (const uint8_t *packet = data + pos + 50;
+            packet + packetSize <= end; packet += packetSize) {
+        if (!ParsePacket(packet, packetSize, &assembler)) {
+            ALOGV("bad packet at %zu", (size_t)(packet - data));
+        }
+    }
+    assembler.finish();
+    return true;
+}
+
+static int64_t NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+struct Output {
+    Output()
+        : mNumErrors(0),
+          mDecodeUs(0) {
+    }
+
+    Buffer mData;
+    int mNumErrors;
+    int64_t mDecodeUs;
+};
+
+// Decodes every object, calling the decoder until it has used the whole
+// buffer or fails, like SoftWmapro::onQueueFilled.
+static bool Decode(const char *kernel, Stream *stream, bool keep, Output *output) {
+    if (wmapro_dec_select_dsp(kernel) != 0) {
+        return false;
+    }
+
+    AudioContext *ctx = wmapro_dec_init();
+    if (ctx == NULL) {
+        return false;
+    }
+
+    waveformat_t format = stream->mFormat;
+    format.extradata_size = stream->mExtraDataSize;
+    format.extradata = (unsigned char *)stream->mExtraData;
+    wmapro_dec_set_property(ctx, WMAPRO_Set_WavFormat, &format);
+
+    static int16_t pcm[MAX_OUT_BUF_SIZE / sizeof(int16_t)];
+    const uint32_t *sizes = (const uint32_t *)stream->mObjectSizes.mData;
+    size_t numObjects = stream->mObjectSizes.mSize / sizeof(uint32_t);
+
+    int64_t startUs = NowUs();
+    uint8_t *object = stream->mObjects.mData;
+    for (size_t i = 0; i < numObjects; object += sizes[i++]) {
+        int usedCount = 0;
+        while (usedCount < (int)sizes[i]) {
+            int used = 0;
+            if (wmapro_dec_decode_frame(ctx, object + usedCount,
+                                        sizes[i] - usedCount, pcm, &used)
+                    != WMAPRO_ERR_NoErr) {
+                ++output->mNumErrors;
+                break;
+            }
+            usedCount += used;
+
+            int numSamples = 0;
+            wmapro_dec_get_property(ctx, WMAPRO_Get_Samples, &numSamples);
+            if (keep && numSamples > 0) {
+                output->mData.append((const uint8_t *)pcm, numSamples * sizeof(int16_t));
+            } else {
+                output->mData.mSize += numSamples * sizeof(int16_t);
+            }
+        }
+    }
+    output->mDecodeUs += NowUs() - startUs;
+
+    wmapro_dec_free(ctx);
+    return true;
+}
+
+static bool Run(Stream *stream, int iterations) {
+    printf("%u Hz, %u channels, %u bytes a block, %zu objects\n",
+           stream->mFormat.nSamplesPerSec, stream->mFormat.nChannels,
+           stream->mFormat.nBlockAlign,
+           stream->mObjectSizes.mSize / sizeof(uint32_t));
+
+    Output reference;
+    if (!Decode("c", stream, true, &reference)) {
+        return false;
+    }
+    if (reference.mData.mSize == 0) {
+        fprintf(stderr, "    nothing decoded, %d errors\n", reference.mNumErrors);
+        return false;
+    }
+
+    Output refTime;
+    for (int n = 0; n < iterations; ++n) {
+        Decode("c", stream, false, &refTime);
+    }
+
+    double mb = (double)refTime.mData.mSize / (1024 * 1024);
+    printf("    c:      %7.1f MB/s  (%zu bytes, %d errors)\n",
+           mb * 1E6 / (refTime.mDecodeUs > 0 ? refTime.mDecodeUs : 1),
+           reference.mData.mSize, reference.mNumErrors);
+
+    bool ok = true;
+    for (size_t k = 0; k < NELEM(kKernels); ++k) {
+        Output output;
+        if (!Decode(kKernels[k], stream, true, &output)) {
+            continue;
+        }
+
+        const Buffer &a = reference.mData;
+        const Buffer &b = output.mData;
+        if (a.mSize != b.mSize
+                || reference.mNumErrors != output.mNumErrors
+                || memcmp(a.mData, b.mData, a.mSize) != 0) {
+            size_t i = 0;
+            while (i < a.mSize && i < b.mSize && a.mData[i] == b.mData[i]) {
+                ++i;
+            }
+            fprintf(stderr, "    %s: %zu bytes decoded, expected %zu, "
+                    "first difference at byte %zu\n",
+                    kKernels[k], b.mSize, a.mSize, i);
+            ok = false;
+            continue;
+        }
+
+        Output time;
+        for (int n = 0; n < iterations; ++n) {
+            Decode(kKernels[k], stream, false, &time);
+        }
+
+        printf("    %-7s %7.1f MB/s  (%.2fx)\n", kKernels[k],
+               mb * 1E6 / (time.mDecodeUs > 0 ? time.mDecodeUs : 1),
+               time.mDecodeUs > 0
+                    ? (double)refTime.mDecodeUs / time.mDecodeUs : 0.0);
+    }
+    return ok;
+}
+
+static bool ReadFile(const char *path, uint8_t **data, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open '%s'\n", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        fprintf(stderr, "unable to stat '%s'\n", path);
+        close(fd);
+        return false;
+    }
+
+    *data = (uint8_t *)malloc(st.st_size);
+    *size = 0;
+    while (*size < (size_t)st.st_size) {
+        ssize_t n = read(fd, *data + *size, st.st_size - *size);
+        if (n <= 0) {
+            break;
+        }
+        *size += n;
+    }
+    close(fd);
+    return true;
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n iterations] file.wma...\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int iterations = 3;
+
+    int res;
+    while ((res = getopt(argc, argv, "n:h")) >= 0) {
+        switch (res) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1 || iterations <= 0) {
+        usage(me);
+    }
+
+    int result = 0;
+    for (int i = 0; i < argc; ++i) {
+        printf("%s: ", argv[i]);
+        fflush(stdout);
+
+        uint8_t *data;
+        size_t size;
+        if (!ReadFile(argv[i], &data, &size)) {
+            result = 1;
+            continue;
+        }
+
+        Stream stream;
+        if (!ParseAsf(data, size, &stream) || !Run(&stream, iterations)) {
+            result = 1;
+        }
+        free(data);
+    }
+
+    return result;
+}
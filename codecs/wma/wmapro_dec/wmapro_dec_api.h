@@ -160,6 +160,15 @@ int wmapro_dec_set_property(AudioContext *avctx,int property,void *value);
  */
 void wmapro_dec_reset(AudioContext *avctx);
 
+/*
+ * Replaces the FFT, channel transform and windowing kernels picked for the
+ * CPU, for testing: "c", "neon", "sse2", "sse4.1" or "avx2". They are
+ * shared by all decoders, so this must not be called while one runs.
+ *
+ * Returns 0, or -1 if that version is not built in or the CPU lacks it.
+ */
+int wmapro_dec_select_dsp(const char *name);
+
 #ifdef __cplusplus
 }
 #endif
@@ -94,6 +94,20 @@
 #include "common.h"
 #define LOG_TAG "SoftWmapro"
 #include <utils/Log.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__ARM_NEON__) || defined(__ARM_NEON) || defined(__aarch64__)
+#define WMAPRO_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define WMAPRO_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+#define WMAPRO_SSE41_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
 
 
 
@@ -133,6 +147,8 @@ static VLC              vec1_vlc;         ///< 1 coefficient per symbol
 static VLC              coef_vlc[2];      ///< coefficient run length vlc codes
 static int32_t          sin64[33];        ///< sinus table for decorrelation
 
+static void wmapro_dsp_init(void);
+
 typedef int32_t FixFFTSample;
 typedef struct FixFFTComplex {
     FixFFTSample re, im;
@@ -1385,7 +1401,7 @@ static const uint16_t revtab[1<<12] = {
 		}
 		
 		/* z[0...8n-1], w[1...2n-1] */
-		static void pass(FixFFTComplex *z_arg, unsigned int STEP_arg, unsigned int n_arg)
+		static void pass_c(FixFFTComplex *z_arg, unsigned int STEP_arg, unsigned int n_arg)
 		{
 			register FixFFTComplex * z = z_arg;
 			register unsigned int STEP = STEP_arg;
@@ -1423,13 +1439,224 @@ static const uint16_t revtab[1<<12] = {
 			}
 		}
 		
+		/* The vector passes below do two TRANSFORMs per iteration, four with
+		AVX2. All products are formed in 64 bit and reduced with >>32 <<1
+		exactly like XPROD31_R/XNPROD31_R, the sums wrap around like the C
+		code, so the result is bit-identical. The twiddles come from the same
+		table, [sin, cos] for the first half and [cos, sin] for the second one. */
+#ifdef WMAPRO_NEON
+		static INLINE int32x4_t pack_hi31_neon(int64x2_t even, int64x2_t odd)
+		{
+			int32x2x2_t t = vzip_s32(vshrn_n_s64(even, 32), vshrn_n_s64(odd, 32));
+			return vshlq_n_s32(vcombine_s32(t.val[0], t.val[1]), 1);
+		}
+		
+		static void pass_neon(FixFFTComplex *z, unsigned int STEP, unsigned int n)
+		{
+			static const int32_t neg_re[4] = { -1, 1, -1, 1 };
+			const int32x4_t sign = vld1q_s32(neg_re);
+			const FixFFTSample *w = sincos_lookup0;
+			unsigned int k;
+			
+			if (n < 8) {
+				pass_c(z, STEP, n);
+				return;
+			}
+			
+			TRANSFORM_ZERO(z, n);
+			TRANSFORM_W10(z + 1, n, w + STEP);
+			for (k = 2; k < n; k += 2) {
+				int32_t *z0 = (int32_t *)(z + k);
+				int32_t *z1 = (int32_t *)(z + k + n);
+				int32_t *z2 = (int32_t *)(z + k + n*2);
+				int32_t *z3 = (int32_t *)(z + k + n*3);
+				int32x2x2_t tw, a, b;
+				int32x2_t wre, wim;
+				int32x4_t t12, t56, s, d, a0, a1;
+				
+				if (k < n/2) {
+					tw = vtrn_s32(vld1_s32(w + k*STEP), vld1_s32(w + (k+1)*STEP));
+					wim = tw.val[0];
+					wre = tw.val[1];
+				} else {
+					tw = vtrn_s32(vld1_s32(w + (n-k)*STEP), vld1_s32(w + (n-k-1)*STEP));
+					wre = tw.val[0];
+					wim = tw.val[1];
+				}
+				
+				/* t1 = re*wre + im*wim, t2 = im*wre - re*wim */
+				a = vld2_s32(z2);
+				t12 = pack_hi31_neon(vmlal_s32(vmull_s32(a.val[0], wre), a.val[1], wim),
+					vmlsl_s32(vmull_s32(a.val[1], wre), a.val[0], wim));
+				/* t5 = re*wre - im*wim, t6 = im*wre + re*wim */
+				b = vld2_s32(z3);
+				t56 = pack_hi31_neon(vmlsl_s32(vmull_s32(b.val[0], wre), b.val[1], wim),
+					vmlal_s32(vmull_s32(b.val[1], wre), b.val[0], wim));
+				
+				/* [t5+t1, t6+t2] and [t2-t6, t5-t1] */
+				s = vaddq_s32(t56, t12);
+				d = vmulq_s32(vrev64q_s32(vsubq_s32(t56, t12)), sign);
+				
+				a0 = vld1q_s32(z0);
+				a1 = vld1q_s32(z1);
+				vst1q_s32(z0, vaddq_s32(a0, s));
+				vst1q_s32(z2, vsubq_s32(a0, s));
+				vst1q_s32(z1, vaddq_s32(a1, d));
+				vst1q_s32(z3, vsubq_s32(a1, d));
+			}
+		}
+#endif
+		
+#ifdef WMAPRO_SSE41_AVX2
+		/* SSE2 has no signed 32x32->64 multiply, the fixed up unsigned one is
+		slower than plain C here, so the x86 passes need SSE4.1 or AVX2.
+		pmuldq only uses the 32 bit lanes 0 and 2, the odd lanes are shifted
+		down for the other products. */
+		
+		/* [hi(even[0]), hi(odd[0]), hi(even[1]), hi(odd[1])] << 1 */
+		static INLINE __m128i pack_hi31_sse(__m128i even, __m128i odd)
+		{
+			return _mm_slli_epi32(_mm_or_si128(_mm_srli_epi64(even, 32),
+				_mm_and_si128(odd, _mm_set_epi32(-1, 0, -1, 0))), 1);
+		}
+		
+		static __attribute__((target("sse4.1")))
+		void pass_sse41(FixFFTComplex *z, unsigned int STEP, unsigned int n)
+		{
+			const __m128i sign = _mm_set_epi32(1, -1, 1, -1);
+			const FixFFTSample *w = sincos_lookup0;
+			unsigned int k;
+			
+			if (n < 8) {
+				pass_c(z, STEP, n);
+				return;
+			}
+			
+			TRANSFORM_ZERO(z, n);
+			TRANSFORM_W10(z + 1, n, w + STEP);
+			for (k = 2; k < n; k += 2) {
+				__m128i *z0 = (__m128i *)(z + k);
+				__m128i *z1 = (__m128i *)(z + k + n);
+				__m128i *z2 = (__m128i *)(z + k + n*2);
+				__m128i *z3 = (__m128i *)(z + k + n*3);
+				__m128i wre, wim, a, ai, b, bi, t12, t56, s, d, a0, a1;
+				
+				if (k < n/2) {
+					wim = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(w + k*STEP)),
+						_mm_loadl_epi64((const __m128i *)(w + (k+1)*STEP)));
+					wre = _mm_srli_epi64(wim, 32);
+				} else {
+					wre = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(w + (n-k)*STEP)),
+						_mm_loadl_epi64((const __m128i *)(w + (n-k-1)*STEP)));
+					wim = _mm_srli_epi64(wre, 32);
+				}
+				
+				/* t1 = re*wre + im*wim, t2 = im*wre - re*wim */
+				a  = _mm_loadu_si128(z2);
+				ai = _mm_srli_epi64(a, 32);
+				t12 = pack_hi31_sse(_mm_add_epi64(_mm_mul_epi32(a, wre), _mm_mul_epi32(ai, wim)),
+					_mm_sub_epi64(_mm_mul_epi32(ai, wre), _mm_mul_epi32(a, wim)));
+				/* t5 = re*wre - im*wim, t6 = im*wre + re*wim */
+				b  = _mm_loadu_si128(z3);
+				bi = _mm_srli_epi64(b, 32);
+				t56 = pack_hi31_sse(_mm_sub_epi64(_mm_mul_epi32(b, wre), _mm_mul_epi32(bi, wim)),
+					_mm_add_epi64(_mm_mul_epi32(bi, wre), _mm_mul_epi32(b, wim)));
+				
+				/* [t5+t1, t6+t2] and [t2-t6, t5-t1] */
+				s = _mm_add_epi32(t56, t12);
+				d = _mm_sign_epi32(_mm_shuffle_epi32(_mm_sub_epi32(t56, t12),
+					_MM_SHUFFLE(2, 3, 0, 1)), sign);
+				
+				a0 = _mm_loadu_si128(z0);
+				a1 = _mm_loadu_si128(z1);
+				_mm_storeu_si128(z0, _mm_add_epi32(a0, s));
+				_mm_storeu_si128(z2, _mm_sub_epi32(a0, s));
+				_mm_storeu_si128(z1, _mm_add_epi32(a1, d));
+				_mm_storeu_si128(z3, _mm_sub_epi32(a1, d));
+			}
+		}
+		
+		/* the (sin, cos) pairs at p0..p3 in the 64 bit lanes 0..3 */
+		static INLINE __attribute__((target("avx2")))
+		__m256i load_twiddles_avx2(const FixFFTSample *p0, const FixFFTSample *p1,
+			const FixFFTSample *p2, const FixFFTSample *p3)
+		{
+			__m128i lo = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p0),
+				_mm_loadl_epi64((const __m128i *)p1));
+			__m128i hi = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p2),
+				_mm_loadl_epi64((const __m128i *)p3));
+			return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		}
+		
+		/* the same four TRANSFORMs at a time */
+		static __attribute__((target("avx2")))
+		void pass_avx2(FixFFTComplex *z, unsigned int STEP, unsigned int n)
+		{
+			const __m256i sign = _mm256_set_epi32(1, -1, 1, -1, 1, -1, 1, -1);
+			const FixFFTSample *w = sincos_lookup0;
+			unsigned int k;
+			
+			if (n < 8) {
+				pass_sse41(z, STEP, n);
+				return;
+			}
+			
+			TRANSFORM_ZERO(z, n);
+			TRANSFORM_W10(z + 1, n, w + STEP);
+			TRANSFORM_W10(z + 2, n, w + 2*STEP);
+			TRANSFORM_W10(z + 3, n, w + 3*STEP);
+			for (k = 4; k < n; k += 4) {
+				__m256i *z0 = (__m256i *)(z + k);
+				__m256i *z1 = (__m256i *)(z + k + n);
+				__m256i *z2 = (__m256i *)(z + k + n*2);
+				__m256i *z3 = (__m256i *)(z + k + n*3);
+				__m256i wre, wim, a, ai, b, bi, t12, t56, s, d, a0, a1;
+				
+				if (k < n/2) {
+					wim = load_twiddles_avx2(w + k*STEP, w + (k+1)*STEP,
+						w + (k+2)*STEP, w + (k+3)*STEP);
+					wre = _mm256_srli_epi64(wim, 32);
+				} else {
+					wre = load_twiddles_avx2(w + (n-k)*STEP, w + (n-k-1)*STEP,
+						w + (n-k-2)*STEP, w + (n-k-3)*STEP);
+					wim = _mm256_srli_epi64(wre, 32);
+				}
+				
+				a  = _mm256_loadu_si256(z2);
+				ai = _mm256_srli_epi64(a, 32);
+				t12 = _mm256_slli_epi32(_mm256_blend_epi32(_mm256_srli_epi64(
+					_mm256_add_epi64(_mm256_mul_epi32(a, wre), _mm256_mul_epi32(ai, wim)), 32),
+					_mm256_sub_epi64(_mm256_mul_epi32(ai, wre), _mm256_mul_epi32(a, wim)), 0xAA), 1);
+				b  = _mm256_loadu_si256(z3);
+				bi = _mm256_srli_epi64(b, 32);
+				t56 = _mm256_slli_epi32(_mm256_blend_epi32(_mm256_srli_epi64(
+					_mm256_sub_epi64(_mm256_mul_epi32(b, wre), _mm256_mul_epi32(bi, wim)), 32),
+					_mm256_add_epi64(_mm256_mul_epi32(bi, wre), _mm256_mul_epi32(b, wim)), 0xAA), 1);
+				
+				s = _mm256_add_epi32(t56, t12);
+				d = _mm256_sign_epi32(_mm256_shuffle_epi32(_mm256_sub_epi32(t56, t12),
+					_MM_SHUFFLE(2, 3, 0, 1)), sign);
+				
+				a0 = _mm256_loadu_si256(z0);
+				a1 = _mm256_loadu_si256(z1);
+				_mm256_storeu_si256(z0, _mm256_add_epi32(a0, s));
+				_mm256_storeu_si256(z2, _mm256_sub_epi32(a0, s));
+				_mm256_storeu_si256(z1, _mm256_add_epi32(a1, d));
+				_mm256_storeu_si256(z3, _mm256_sub_epi32(a1, d));
+			}
+			_mm256_zeroupper();
+		}
+#endif
+		
+		static void (*fft_pass)(FixFFTComplex *z, unsigned int STEP, unsigned int n) = pass_c;
+		
 #define DECL_FFT(n,n2,n4)\
 	static void fft##n(FixFFTComplex *z)\
 		{\
 		fft##n2(z);\
 		fft##n4(z+n4*2);\
 		fft##n4(z+n4*3);\
-		pass(z,8192/n,n4);\
+		fft_pass(z,8192/n,n4);\
 		}
 		
 		static INLINE void fft4(FixFFTComplex *z)
@@ -1784,6 +2011,7 @@ static const uint16_t revtab[1<<12] = {
 			{
 				fix_imdct_init(&s->fixmdct_ctx[i], WMAPRO_BLOCK_MIN_BITS+1+i);
 			}
+			wmapro_dsp_init();
 			
 			/** init MDCT windows: simple sinus window */
 			for (i = 0; i < WMAPRO_BLOCK_SIZES; i++) {
@@ -2428,6 +2656,303 @@ static INLINE void vector_fmul_scalar64(int64_t *src64, int len)
 }
 
 
+/**
+*@brief Multiply the coefficients [start, end) of a channel group with the
+*       decorrelation matrix.
+*/
+static void channel_transform_c(int64_t** fixch_data, const int32_t* matrix,
+                                int num_channels, int start, int end)
+{
+    int32_t fixdata[WMAPRO_MAX_CHANNELS];
+    int64_t** fixch_end = fixch_data + num_channels;
+    const int32_t* fixdata_end = fixdata + num_channels;
+    int y;
+
+    for (y = start; y < end; y++) {
+        const int32_t* mat = matrix;
+        int32_t* fixdata_ptr = fixdata;
+        int64_t** fixch;
+
+        for (fixch = fixch_data; fixch < fixch_end; fixch++)
+        {
+            I64 *tmp64;
+            tmp64 = (I64*)&(*fixch)[y];
+            *fixdata_ptr++ = tmp64->r.hi32;
+        }
+
+        for (fixch = fixch_data; fixch < fixch_end; fixch++) {
+            I64 sum64;
+            fixdata_ptr = fixdata;
+            sum64.w64 = 0;
+            while (fixdata_ptr < fixdata_end)
+                sum64.w64 = MADD64(sum64.w64, (*fixdata_ptr++), *mat++);
+
+            (*fixch)[y] = (sum64.w64)<<1;
+        }
+    }
+}
+
+static void wmapro_vector_fmul_window_c(int32_t *dst, const int32_t *src1, const int32_t *win, int len)
+{
+    int i,j;
+    dst += len;
+    win += len;
+    for(i=-len, j=len-1; i<0; i++, j--) {
+        int32_t s0 = (src1[i]);
+        int32_t s1 = (src1[j]);
+        int32_t wi = (win[i]);
+        int32_t wj = (win[j]);
+        dst[i] = (MSUB64(FIX64_MUL(s0, wj), s1, wi)>>32)<<1;
+        dst[j] = (MADD64(FIX64_MUL(s0, wi), s1, wj)>>32)<<1;
+    }
+}
+
+/* Vector versions of the two functions above. They keep the 64 bit products
+   and sums of the C code, so the output is bit-identical. Windowing works on
+   four samples from each end at a time; the rest, which is the window with
+   the outer samples removed, is left to the C version. */
+#ifdef WMAPRO_NEON
+static INLINE int32x4_t reverse_neon(int32x4_t v)
+{
+    v = vrev64q_s32(v);
+    return vcombine_s32(vget_high_s32(v), vget_low_s32(v));
+}
+
+static INLINE int32x4_t narrow_hi31_neon(int64x2_t lo, int64x2_t hi)
+{
+    return vshlq_n_s32(vcombine_s32(vshrn_n_s64(lo, 32), vshrn_n_s64(hi, 32)), 1);
+}
+
+static void channel_transform_neon(int64_t** fixch_data, const int32_t* matrix,
+                                   int num_channels, int start, int end)
+{
+    int32x2_t lo[WMAPRO_MAX_CHANNELS], hi[WMAPRO_MAX_CHANNELS];
+    int c, j, y = start;
+
+    for (; y + 4 <= end; y += 4) {
+        const int32_t* mat = matrix;
+
+        for (c = 0; c < num_channels; c++) {
+            lo[c] = vshrn_n_s64(vld1q_s64(fixch_data[c] + y), 32);
+            hi[c] = vshrn_n_s64(vld1q_s64(fixch_data[c] + y + 2), 32);
+        }
+
+        for (c = 0; c < num_channels; c++) {
+            int64x2_t sum_lo = vmull_n_s32(lo[0], mat[0]);
+            int64x2_t sum_hi = vmull_n_s32(hi[0], mat[0]);
+            for (j = 1; j < num_channels; j++) {
+                sum_lo = vmlal_n_s32(sum_lo, lo[j], mat[j]);
+                sum_hi = vmlal_n_s32(sum_hi, hi[j], mat[j]);
+            }
+            mat += num_channels;
+            vst1q_s64(fixch_data[c] + y, vshlq_n_s64(sum_lo, 1));
+            vst1q_s64(fixch_data[c] + y + 2, vshlq_n_s64(sum_hi, 1));
+        }
+    }
+    if (y < end)
+        channel_transform_c(fixch_data, matrix, num_channels, y, end);
+}
+
+static void wmapro_vector_fmul_window_neon(int32_t *dst, const int32_t *src1, const int32_t *win, int len)
+{
+    int i;
+
+    for (i = 0; i + 4 <= len; i += 4) {
+        int j = 2*len - 4 - i;
+        int32x4_t s0 = vld1q_s32(src1 - len + i);
+        int32x4_t s1 = reverse_neon(vld1q_s32(src1 + len - 4 - i));
+        int32x4_t wi = vld1q_s32(win + i);
+        int32x4_t wj = reverse_neon(vld1q_s32(win + j));
+        int64x2_t d0_lo, d0_hi, d1_lo, d1_hi;
+
+        /* dst[i] = s0*wj - s1*wi, dst[j] = s0*wi + s1*wj */
+        d0_lo = vmlsl_s32(vmull_s32(vget_low_s32(s0), vget_low_s32(wj)),
+                          vget_low_s32(s1), vget_low_s32(wi));
+        d0_hi = vmlsl_s32(vmull_s32(vget_high_s32(s0), vget_high_s32(wj)),
+                          vget_high_s32(s1), vget_high_s32(wi));
+        d1_lo = vmlal_s32(vmull_s32(vget_low_s32(s0), vget_low_s32(wi)),
+                          vget_low_s32(s1), vget_low_s32(wj));
+        d1_hi = vmlal_s32(vmull_s32(vget_high_s32(s0), vget_high_s32(wi)),
+                          vget_high_s32(s1), vget_high_s32(wj));
+
+        vst1q_s32(dst + i, narrow_hi31_neon(d0_lo, d0_hi));
+        vst1q_s32(dst + j, reverse_neon(narrow_hi31_neon(d1_lo, d1_hi)));
+    }
+    if (i < len)
+        wmapro_vector_fmul_window_c(dst + i, src1, win + i, len - i);
+}
+#endif
+
+#ifdef WMAPRO_SSE2
+/* 64 bit products of the signed 32 bit lanes 0 and 2. SSE2 only has the
+   unsigned multiply, the sign is fixed up in the high halves. */
+static INLINE __m128i mul_epi32_sse2(__m128i a, __m128i b)
+{
+    __m128i fix = _mm_add_epi32(_mm_and_si128(_mm_srai_epi32(a, 31), b),
+                                _mm_and_si128(_mm_srai_epi32(b, 31), a));
+    return _mm_sub_epi64(_mm_mul_epu32(a, b), _mm_slli_epi64(fix, 32));
+}
+
+/* The high half of each coefficient is shifted down into lane 0 or 2 and
+   multiplied with the broadcast matrix entries, two coefficients at a time. */
+#define CHANNEL_TRANSFORM_SSE(name, target, mul)                               \
+static target void name(int64_t** fixch_data, const int32_t* matrix,           \
+                        int num_channels, int start, int end)                  \
+{                                                                               \
+    __m128i mat[WMAPRO_MAX_CHANNELS * WMAPRO_MAX_CHANNELS];                     \
+    __m128i in[WMAPRO_MAX_CHANNELS];                                            \
+    int c, j, y = start;                                                        \
+                                                                                \
+    for (j = 0; j < num_channels * num_channels; j++)                           \
+        mat[j] = _mm_set1_epi32(matrix[j]);                                     \
+                                                                                \
+    for (; y + 2 <= end; y += 2) {                                              \
+        const __m128i* m = mat;                                                 \
+                                                                                \
+        for (c = 0; c < num_channels; c++)                                      \
+            in[c] = _mm_srli_epi64(                                             \
+                _mm_loadu_si128((const __m128i *)(fixch_data[c] + y)), 32);     \
+                                                                                \
+        for (c = 0; c < num_channels; c++) {                                    \
+            __m128i sum = mul(in[0], *m++);                                     \
+            for (j = 1; j < num_channels; j++)                                  \
+                sum = _mm_add_epi64(sum, mul(in[j], *m++));                     \
+            _mm_storeu_si128((__m128i *)(fixch_data[c] + y),                    \
+                             _mm_slli_epi64(sum, 1));                           \
+        }                                                                       \
+    }                                                                           \
+    if (y < end)                                                                \
+        channel_transform_c(fixch_data, matrix, num_channels, y, end);          \
+}
+
+CHANNEL_TRANSFORM_SSE(channel_transform_sse2, , mul_epi32_sse2)
+
+#ifdef WMAPRO_SSE41_AVX2
+CHANNEL_TRANSFORM_SSE(channel_transform_sse41,
+                      __attribute__((target("sse4.1"))), _mm_mul_epi32)
+
+#define REVERSE_EPI32(v) _mm_shuffle_epi32((v), _MM_SHUFFLE(0, 1, 2, 3))
+
+static __attribute__((target("sse4.1")))
+void wmapro_vector_fmul_window_sse41(int32_t *dst, const int32_t *src1,
+                                     const int32_t *win, int len)
+{
+    int i;
+
+    for (i = 0; i + 4 <= len; i += 4) {
+        int j = 2*len - 4 - i;
+        __m128i s0 = _mm_loadu_si128((const __m128i *)(src1 - len + i));
+        __m128i s1 = REVERSE_EPI32(
+            _mm_loadu_si128((const __m128i *)(src1 + len - 4 - i)));
+        __m128i wi = _mm_loadu_si128((const __m128i *)(win + i));
+        __m128i wj = REVERSE_EPI32(_mm_loadu_si128((const __m128i *)(win + j)));
+        __m128i s0o = _mm_srli_epi64(s0, 32), s1o = _mm_srli_epi64(s1, 32);
+        __m128i wio = _mm_srli_epi64(wi, 32), wjo = _mm_srli_epi64(wj, 32);
+        __m128i d0, d1;
+
+        /* dst[i] = s0*wj - s1*wi, dst[j] = s0*wi + s1*wj */
+        d0 = pack_hi31_sse(_mm_sub_epi64(_mm_mul_epi32(s0, wj), _mm_mul_epi32(s1, wi)),
+                           _mm_sub_epi64(_mm_mul_epi32(s0o, wjo), _mm_mul_epi32(s1o, wio)));
+        d1 = pack_hi31_sse(_mm_add_epi64(_mm_mul_epi32(s0, wi), _mm_mul_epi32(s1, wj)),
+                           _mm_add_epi64(_mm_mul_epi32(s0o, wio), _mm_mul_epi32(s1o, wjo)));
+
+        _mm_storeu_si128((__m128i *)(dst + i), d0);
+        _mm_storeu_si128((__m128i *)(dst + j), REVERSE_EPI32(d1));
+    }
+    if (i < len)
+        wmapro_vector_fmul_window_c(dst + i, src1, win + i, len - i);
+}
+#endif
+#endif
+
+static void (*channel_transform)(int64_t** fixch_data, const int32_t* matrix,
+                                 int num_channels, int start, int end) = channel_transform_c;
+static void (*wmapro_vector_fmul_window)(int32_t *dst, const int32_t *src1,
+                                         const int32_t *win, int len) = wmapro_vector_fmul_window_c;
+
+static pthread_once_t wmapro_dsp_once = PTHREAD_ONCE_INIT;
+
+/**
+*@brief Point the FFT, channel transform and windowing kernels at one version.
+*@param name "c", "neon", "sse2", "sse4.1" or "avx2"
+*@return 0, or -1 if that version is not built in or the CPU lacks it
+*/
+static int wmapro_dsp_set(const char *name)
+{
+    void (*pass)(FixFFTComplex *z, unsigned int STEP, unsigned int n) = pass_c;
+    void (*transform)(int64_t** fixch_data, const int32_t* matrix,
+                      int num_channels, int start, int end) = channel_transform_c;
+    void (*fmul_window)(int32_t *dst, const int32_t *src1,
+                        const int32_t *win, int len) = wmapro_vector_fmul_window_c;
+
+    if (!strcmp(name, "c")) {
+#ifdef WMAPRO_NEON
+    } else if (!strcmp(name, "neon")) {
+        pass        = pass_neon;
+        transform   = channel_transform_neon;
+        fmul_window = wmapro_vector_fmul_window_neon;
+#elif defined(WMAPRO_SSE2)
+    } else if (!strcmp(name, "sse2")) {
+        transform   = channel_transform_sse2;
+#ifdef WMAPRO_SSE41_AVX2
+    } else if (!strcmp(name, "sse4.1") && (__builtin_cpu_init(),
+                                           __builtin_cpu_supports("sse4.1"))) {
+        pass        = pass_sse41;
+        transform   = channel_transform_sse41;
+        fmul_window = wmapro_vector_fmul_window_sse41;
+    } else if (!strcmp(name, "avx2") && (__builtin_cpu_init(),
+                                         __builtin_cpu_supports("avx2"))) {
+        pass        = pass_avx2;
+        transform   = channel_transform_sse41;
+        fmul_window = wmapro_vector_fmul_window_sse41;
+#endif
+#endif
+    } else {
+        return -1;
+    }
+
+    fft_pass                  = pass;
+    channel_transform         = transform;
+    wmapro_vector_fmul_window = fmul_window;
+    return 0;
+}
+
+/**
+*@brief Pick the best kernels for this CPU.
+*/
+static void wmapro_dsp_select(void)
+{
+    static const char *const names[] = { "neon", "avx2", "sse4.1", "sse2" };
+    unsigned int i;
+
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (!wmapro_dsp_set(names[i]))
+            break;
+    }
+}
+
+/**
+*@brief Select the FFT, channel transform and windowing kernels for this CPU,
+*       once for all decoder instances.
+*/
+static void wmapro_dsp_init(void)
+{
+    pthread_once(&wmapro_dsp_once, wmapro_dsp_select);
+}
+
+/**
+*@brief Replace the kernels picked for this CPU, for testing. Must not be
+*       called while a decoder runs.
+*@param name "c", "neon", "sse2", "sse4.1" or "avx2"
+*@return 0, or -1 if that version is not built in or the CPU lacks it
+*/
+int select_dsp(const char *name)
+{
+    wmapro_dsp_init();
+    return wmapro_dsp_set(name);
+}
+
+
 /**
 *@brief Reconstruct the individual channel data.
 *@param s codec context
@@ -2438,42 +2963,18 @@ static void inverse_channel_transform(WMAProDecodeCtx *s)
 	
     for (i = 0; i < s->num_chgroups; i++) {
         if (s->chgroup[i].transform) {
-            int32_t fixdata[WMAPRO_MAX_CHANNELS];
             const int num_channels = s->chgroup[i].num_channels;
             int64_t** fixch_data = s->chgroup[i].fixchannel_data;
-            int64_t** fixch_end = fixch_data + num_channels;
             const int8_t* tb = s->chgroup[i].transform_band;
             int16_t* sfb;
 			
             /** multichannel decorrelation */
             for (sfb = s->cur_sfb_offsets;
 			sfb < s->cur_sfb_offsets + s->num_bands; sfb++) {
-                int y;
                 if (*tb++ == 1) {
                     /** multiply values with the decorrelation_matrix */
-                    for (y = sfb[0]; y < FFMIN(sfb[1], s->subframe_len); y++) {
-                        const int32_t* mat = s->chgroup[i].decorrelation_matrix;
-                        const int32_t* fixdata_end = fixdata + num_channels;
-                        int32_t* fixdata_ptr = fixdata;
-                        int64_t** fixch;
-						
-                        for (fixch = fixch_data; fixch < fixch_end; fixch++)
-                        {
-                            I64 *tmp64;
-                            tmp64 = (I64*)&(*fixch)[y];
-                            *fixdata_ptr++ = tmp64->r.hi32;
-                        }
-						
-                        for (fixch = fixch_data; fixch < fixch_end; fixch++) {
-                            I64 sum64;
-                            fixdata_ptr = fixdata;
-                            sum64.w64 = 0;
-                            while (fixdata_ptr < fixdata_end)
-                                sum64.w64 = MADD64(sum64.w64, (*fixdata_ptr++), *mat++);
-							
-                            (*fixch)[y] = (sum64.w64)<<1;
-                        }
-                    }
+                    channel_transform(fixch_data, s->chgroup[i].decorrelation_matrix,
+                                      num_channels, sfb[0], FFMIN(sfb[1], s->subframe_len));
                 } else if (s->num_channels == 2) {
                     int len = FFMIN(sfb[1], s->subframe_len) - sfb[0];
                     vector_fmul_scalar64(fixch_data[0] + sfb[0], len);
@@ -2485,21 +2986,6 @@ static void inverse_channel_transform(WMAProDecodeCtx *s)
 	
 }
 
-static void wmapro_vector_fmul_window(int32_t *dst, const int32_t *src1, const int32_t *win, int len)
-{
-    int i,j;
-    dst += len;
-    win += len;
-    for(i=-len, j=len-1; i<0; i++, j--) {
-        int32_t s0 = (src1[i]);
-        int32_t s1 = (src1[j]);
-        int32_t wi = (win[i]);
-        int32_t wj = (win[j]);
-        dst[i] = (MSUB64(FIX64_MUL(s0, wj), s1, wi)>>32)<<1;
-        dst[j] = (MADD64(FIX64_MUL(s0, wi), s1, wj)>>32)<<1;
-    }
-}
-
 static void wmapro_window(WMAProDecodeCtx *s)
 {
     int i;
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "NU-ABRController"
+#include <utils/Log.h>
+
+#include "AmABRController.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+
+#include <inttypes.h>
+#include <math.h>
+
+namespace android {
+
+// Half-lives of the two averages, in seconds of download time.
+static const double kFastHalfLifeSecs = 2.0;
+static const double kSlowHalfLifeSecs = 5.0;
+
+// Smaller downloads are dominated by latency and underestimate throughput.
+static const size_t kMinMeasurementBytes = 16384;
+
+// Fraction of the estimate a variant may use; less when switching up.
+static const double kBandwidthSafetyFactor = 0.8;
+static const double kSwitchUpSafetyFactor = 0.7;
+
+// Below this much buffered media only throughput counts.
+static const int64_t kLowBufferUs = 5000000ll;
+
+// What AmPlaylistFetcher tries to keep buffered.
+static const int64_t kBufferTargetUs = 10000000ll;
+
+// BOLA's gamma * p, trading rebuffering against bitrate.
+static const double kBolaGammaP = 5.0;
+
+static const int64_t kMinSwitchIntervalUs = 10000000ll;
+static const int64_t kDefaultSegmentDurationUs = 10000000ll;
+
+// Downloads do not overlap with anything older than this.
+static const int64_t kBusyHistoryUs = 120000000ll;
+
+// Downloads are pooled until they cover this much new wall-clock time,
+// so one finishing right after another still gets its bytes counted.
+static const int64_t kMinSampleUs = 500000ll;
+
+static void UpdateEstimate(
+        double *estimate, double *totalWeight, double halfLifeSecs,
+        double weight, double bandwidthBps) {
+    double alpha = pow(0.5, weight / halfLifeSecs);
+    *estimate = bandwidthBps * (1.0 - alpha) + *estimate * alpha;
+    *totalWeight += weight;
+}
+
+static double GetEstimate(
+        double estimate, double totalWeight, double halfLifeSecs) {
+    // The average starts out at zero, scale that bias away.
+    double zeroFactor = 1.0 - pow(0.5, totalWeight / halfLifeSecs);
+    return estimate / zeroFactor;
+}
+
+AmABRController::AmABRController()
+    : mFastEstimateBps(0.0),
+      mSlowEstimateBps(0.0),
+      mFastWeight(0.0),
+      mSlowWeight(0.0),
+      mSegmentDurationUs(kDefaultSegmentDurationUs),
+      mNumMeasurements(0),
+      mLastIndex(-1),
+      mLastSwitchUs(-1ll),
+      mPendingBytes(0),
+      mPendingUs(0) {
+}
+
+AmABRController::~AmABRController() {
+}
+
+// Returns how much of [startUs, endUs) is not covered by mBusyIntervals
+// yet, then adds it.
+int64_t AmABRController::addBusyInterval_l(int64_t startUs, int64_t endUs) {
+    int64_t newUs = endUs - startUs;
+    int64_t mergedStartUs = startUs;
+    int64_t mergedEndUs = endUs;
+
+    size_t i = 0;
+    while (i < mBusyIntervals.size()) {
+        const Interval &interval = mBusyIntervals.itemAt(i);
+
+        if (interval.mEndUs < endUs - kBusyHistoryUs) {
+            mBusyIntervals.removeAt(i);
+            continue;
+        }
+
+        if (interval.mEndUs < startUs || interval.mStartUs > endUs) {
+            ++i;
+            continue;
+        }
+
+        int64_t overlapStartUs =
+            interval.mStartUs > startUs ? interval.mStartUs : startUs;
+        int64_t overlapEndUs =
+            interval.mEndUs < endUs ? interval.mEndUs : endUs;
+        newUs -= overlapEndUs - overlapStartUs;
+
+        if (interval.mStartUs < mergedStartUs) {
+            mergedStartUs = interval.mStartUs;
+        }
+        if (interval.mEndUs > mergedEndUs) {
+            mergedEndUs = interval.mEndUs;
+        }
+        mBusyIntervals.removeAt(i);
+    }
+
+    Interval merged;
+    merged.mStartUs = mergedStartUs;
+    merged.mEndUs = mergedEndUs;
+
+    i = 0;
+    while (i < mBusyIntervals.size()
+            && mBusyIntervals.itemAt(i).mStartUs < mergedStartUs) {
+        ++i;
+    }
+    mBusyIntervals.insertAt(merged, i);
+
+    return newUs;
+}
+
+void AmABRController::addSegmentMeasurement(
+        size_t numBytes, int64_t startUs, int64_t endUs,
+        int64_t segmentDurationUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (segmentDurationUs > 0) {
+        mSegmentDurationUs = segmentDurationUs;
+    }
+
+    if (numBytes < kMinMeasurementBytes || endUs <= startUs) {
+        return;
+    }
+
+    // Overlapping downloads shared the link: count all their bytes but
+    // only the wall-clock time no earlier download was measured over.
+    mPendingBytes += numBytes;
+    mPendingUs += addBusyInterval_l(startUs, endUs);
+    if (mPendingUs < kMinSampleUs) {
+        return;
+    }
+
+    numBytes = mPendingBytes;
+    int64_t downloadTimeUs = mPendingUs;
+    mPendingBytes = 0;
+    mPendingUs = 0;
+
+    double weight = downloadTimeUs / 1E6;
+    double bandwidthBps = numBytes * 8E6 / downloadTimeUs;
+
+    UpdateEstimate(&mFastEstimateBps, &mFastWeight, kFastHalfLifeSecs,
+            weight, bandwidthBps);
+    UpdateEstimate(&mSlowEstimateBps, &mSlowWeight, kSlowHalfLifeSecs,
+            weight, bandwidthBps);
+    ++mNumMeasurements;
+
+    ALOGV("%zu bytes in %" PRId64 " us (%.0f bps), estimate %" PRId64 " bps",
+          numBytes, downloadTimeUs, bandwidthBps, estimatedBandwidthBps_l());
+}
+
+int64_t AmABRController::estimatedBandwidthBps() const {
+    Mutex::Autolock autoLock(mLock);
+    return estimatedBandwidthBps_l();
+}
+
+int64_t AmABRController::estimatedBandwidthBps_l() const {
+    if (mNumMeasurements == 0) {
+        return -1;
+    }
+
+    // The fast average reacts to drops, the slow one ignores short bursts.
+    double fast = GetEstimate(mFastEstimateBps, mFastWeight, kFastHalfLifeSecs);
+    double slow = GetEstimate(mSlowEstimateBps, mSlowWeight, kSlowHalfLifeSecs);
+    return (int64_t)(fast < slow ? fast : slow);
+}
+
+size_t AmABRController::selectByThroughput(
+        const Vector<size_t> &bandwidths, ssize_t curIndex,
+        int64_t bandwidthBps) const {
+    size_t index = bandwidths.size() - 1;
+    while (index > 0) {
+        double factor = (ssize_t)index > curIndex
+                ? kSwitchUpSafetyFactor : kBandwidthSafetyFactor;
+        if (bandwidths.itemAt(index) <= bandwidthBps * factor) {
+            break;
+        }
+        --index;
+    }
+    return index;
+}
+
+size_t AmABRController::selectByBufferLevel(
+        const Vector<size_t> &bandwidths, int64_t bufferedDurationUs) const {
+    // BOLA: with the buffer level Q and the utility v = ln(S / S_min) of
+    // each variant S, pick the one maximizing (V * (v + gp) - Q) / S.
+    // V is chosen so that the top variant wins once the buffer is full.
+    double segmentSecs = mSegmentDurationUs / 1E6;
+    double bufferLevel = bufferedDurationUs / 1E6 / segmentSecs;
+    double maxBufferLevel = kBufferTargetUs / 1E6 / segmentSecs;
+    if (maxBufferLevel < 2.0) {
+        maxBufferLevel = 2.0;
+    }
+
+    double minBandwidth = bandwidths.itemAt(0) > 0 ? bandwidths.itemAt(0) : 1;
+    double maxUtility = log(bandwidths.top() / minBandwidth);
+    double V = (maxBufferLevel - 1.0) / (maxUtility + kBolaGammaP);
+
+    size_t best = 0;
+    double bestScore = 0.0;
+    for (size_t i = 0; i < bandwidths.size(); ++i) {
+        double bandwidth = bandwidths.itemAt(i) > 0 ? bandwidths.itemAt(i) : 1;
+        double utility = log(bandwidth / minBandwidth);
+        double score = (V * (utility + kBolaGammaP) - bufferLevel) / bandwidth;
+        if (i == 0 || score >= bestScore) {
+            best = i;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+size_t AmABRController::selectIndex(
+        const Vector<size_t> &bandwidths, ssize_t curIndex,
+        int64_t bufferedDurationUs, int64_t bandwidthBps, int64_t nowUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    CHECK(!bandwidths.isEmpty());
+
+    if (curIndex != mLastIndex) {
+        mLastIndex = curIndex;
+        mLastSwitchUs = nowUs;
+    }
+
+    size_t throughputIndex =
+            selectByThroughput(bandwidths, curIndex, bandwidthBps);
+
+    if (curIndex < 0 || (size_t)curIndex >= bandwidths.size()
+            || bufferedDurationUs < kLowBufferUs) {
+        ALOGV("buffered %" PRId64 " us, %" PRId64 " bps -> index %zu",
+              bufferedDurationUs, bandwidthBps, throughputIndex);
+        return throughputIndex;
+    }
+
+    size_t index = selectByBufferLevel(bandwidths, bufferedDurationUs);
+
+    // Never go above what the connection sustains, unless we already are.
+    size_t maxIndex = throughputIndex > (size_t)curIndex
+            ? throughputIndex : (size_t)curIndex;
+    if (index > maxIndex) {
+        index = maxIndex;
+    }
+
+    if (index < (size_t)curIndex && throughputIndex >= (size_t)curIndex) {
+        // The buffer is above the low mark and still being filled faster
+        // than it drains, dropping quality would not buy anything.
+        index = curIndex;
+    } else if (index > (size_t)curIndex) {
+        // One step at a time, and not right after the previous switch.
+        if (mLastSwitchUs >= 0 && nowUs - mLastSwitchUs < kMinSwitchIntervalUs) {
+            index = curIndex;
+        } else {
+            index = curIndex + 1;
+        }
+    }
+
+    ALOGV("buffered %" PRId64 " us, %" PRId64 " bps -> index %zu (throughput %zu)",
+          bufferedDurationUs, bandwidthBps, index, throughputIndex);
+
+    return index;
+}
+
+}  // namespace android
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+#ifndef ABR_CONTROLLER_H_
+
+#define ABR_CONTROLLER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Picks the variant to download for AmLiveSession.
+//
+// Throughput is estimated from per-segment download timing with two
+// exponentially weighted moving averages (a fast and a slow one, weighted
+// by download time); the lower of the two is used. Overlapping downloads
+// (prefetching) share the link, so their bytes are measured together over
+// the wall-clock time at least one of them was running.
+//
+// Below a low buffer mark the variant is picked from the throughput
+// estimate alone, which can drop several steps at once. Above it the
+// variant is chosen BOLA style from the buffer level: the fuller the
+// buffer, the more a higher bitrate is worth. There up-switches are
+// capped by the throughput estimate, go one step at a time and are rate
+// limited, and down-switches only happen once the estimate no longer
+// sustains the current variant.
+//
+// The controller has no dependencies on the session, so it can be driven
+// offline with recorded throughput traces and a simulated buffer.
+struct AmABRController : public RefBase {
+    AmABRController();
+
+    // Called after each segment download, from any thread. The download
+    // ran from "startUs" to "endUs" (ALooper::GetNowUs() time base).
+    void addSegmentMeasurement(
+            size_t numBytes, int64_t startUs, int64_t endUs,
+            int64_t segmentDurationUs);
+
+    // Returns the current throughput estimate, or -1 without measurements.
+    int64_t estimatedBandwidthBps() const;
+
+    // "bandwidths" are the variant bitrates in increasing order.
+    // "curIndex" is the variant currently played (< 0 if none yet),
+    // "bufferedDurationUs" how much media is buffered ahead of playback and
+    // "bandwidthBps" the throughput to plan with, usually the estimate above.
+    size_t selectIndex(
+            const Vector<size_t> &bandwidths, ssize_t curIndex,
+            int64_t bufferedDurationUs, int64_t bandwidthBps, int64_t nowUs);
+
+protected:
+    virtual ~AmABRController();
+
+private:
+    mutable Mutex mLock;
+
+    double mFastEstimateBps;
+    double mSlowEstimateBps;
+    double mFastWeight;
+    double mSlowWeight;
+    int64_t mSegmentDurationUs;
+    size_t mNumMeasurements;
+
+    // Last variant seen in selectIndex() and when it changed.
+    ssize_t mLastIndex;
+    int64_t mLastSwitchUs;
+
+    struct Interval {
+        int64_t mStartUs;
+        int64_t mEndUs;
+    };
+
+    // Recent download time already measured, sorted and disjoint.
+    Vector<Interval> mBusyIntervals;
+
+    // Bytes and new wall-clock time not turned into a sample yet.
+    size_t mPendingBytes;
+    int64_t mPendingUs;
+
+    int64_t estimatedBandwidthBps_l() const;
+    int64_t addBusyInterval_l(int64_t startUs, int64_t endUs);
+
+    size_t selectByThroughput(
+            const Vector<size_t> &bandwidths, ssize_t curIndex,
+            int64_t bandwidthBps) const;
+    size_t selectByBufferLevel(
+            const Vector<size_t> &bandwidths,
+            int64_t bufferedDurationUs) const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(AmABRController);
+};
+
+}  // namespace android
+
+#endif  // ABR_CONTROLLER_H_
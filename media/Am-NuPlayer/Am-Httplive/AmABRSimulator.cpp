@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Plays a throughput trace against AmABRController: segments are fetched
+// over a simulated link, up to "-p" of them at once sharing it like the
+// prefetcher does, and played out of a simulated buffer. Reports startup
+// delay, stalls, the average bitrate played, switches and how far the
+// bandwidth estimate was off from the link.
+//
+// The trace has one "<seconds> <kbps>" line per change of link capacity.
+//
+// usage: amabrsimulator [-d segment_secs] [-p parallel] [-b buffer_secs]
+//                       [-t duration_secs] [-v] trace.txt kbps...
+
+#include "AmABRController.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace android {
+
+static const int64_t kTickUs = 10000ll;
+
+struct TracePoint {
+    int64_t mTimeUs;
+    double mBps;
+};
+
+struct Download {
+    size_t mSeqNumber;
+    size_t mIndex;
+    double mTotalBytes;
+    double mBytesDone;
+    int64_t mStartUs;
+};
+
+struct Options {
+    int64_t mSegmentDurationUs;
+    size_t mParallel;
+    int64_t mMaxBufferUs;
+    int64_t mDurationUs;
+    bool mVerbose;
+};
+
+struct Stats {
+    Stats()
+        : mStartupUs(-1ll),
+          mNumStalls(0),
+          mStallUs(0),
+          mNumSegments(0),
+          mSumBandwidth(0.0),
+          mNumSwitches(0),
+          mNumEstimates(0),
+          mSumEstimateError(0.0) {
+    }
+
+    int64_t mStartupUs;
+    size_t mNumStalls;
+    int64_t mStallUs;
+    size_t mNumSegments;
+    double mSumBandwidth;
+    size_t mNumSwitches;
+    size_t mNumEstimates;
+    double mSumEstimateError;
+};
+
+static bool readTrace(const char *path, Vector<TracePoint> *trace) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "unable to open '%s'\n", path);
+        return false;
+    }
+
+    double secs, kbps;
+    while (fscanf(file, "%lf %lf", &secs, &kbps) == 2) {
+        TracePoint point;
+        point.mTimeUs = (int64_t)(secs * 1E6);
+        point.mBps = kbps * 1000.0;
+        trace->push(point);
+    }
+    fclose(file);
+
+    if (trace->isEmpty()) {
+        fprintf(stderr, "'%s' has no \"<seconds> <kbps>\" lines\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Link capacity at "nowUs", the last point at or before it.
+static double linkBps(const Vector<TracePoint> &trace, int64_t nowUs) {
+    size_t i = 0;
+    while (i + 1 < trace.size() && trace.itemAt(i + 1).mTimeUs <= nowUs) {
+        ++i;
+    }
+    return trace.itemAt(i).mBps;
+}
+
+static void simulate(
+        const Vector<TracePoint> &trace, const Vector<size_t> &bandwidths,
+        const Options &options, Stats *stats) {
+    sp<AmABRController> controller = new AmABRController;
+
+    Vector<Download> downloads;
+    Vector<bool> fetched;
+    size_t nextSeqNumber = 0;
+    size_t nextToPlay = 0;
+    ssize_t curIndex = -1;
+
+    int64_t bufferedUs = 0;
+    bool playing = false;
+    int64_t stallStartUs = 0;
+
+    for (int64_t nowUs = 0; nowUs < options.mDurationUs; nowUs += kTickUs) {
+        int64_t inFlightUs = downloads.size() * options.mSegmentDurationUs;
+        while (downloads.size() < options.mParallel
+                && bufferedUs + inFlightUs < options.mMaxBufferUs) {
+            int64_t estimateBps = controller->estimatedBandwidthBps();
+            if (estimateBps < 0) {
+                estimateBps = bandwidths.itemAt(0);
+            }
+
+            size_t index = controller->selectIndex(
+                    bandwidths, curIndex, bufferedUs, estimateBps, nowUs);
+            if (curIndex >= 0 && (size_t)curIndex != index) {
+                ++stats->mNumSwitches;
+            }
+            curIndex = index;
+
+            Download download;
+            download.mSeqNumber = nextSeqNumber++;
+            download.mIndex = index;
+            download.mTotalBytes = bandwidths.itemAt(index)
+                    * (options.mSegmentDurationUs / 1E6) / 8.0;
+            download.mBytesDone = 0.0;
+            download.mStartUs = nowUs;
+            downloads.push(download);
+            fetched.push(false);
+
+            inFlightUs += options.mSegmentDurationUs;
+        }
+
+        // The link is shared evenly by the downloads in flight.
+        double bps = linkBps(trace, nowUs);
+        if (!downloads.isEmpty()) {
+            double share = bps * (kTickUs / 1E6) / 8.0 / downloads.size();
+            for (size_t i = 0; i < downloads.size();) {
+                Download *download = &downloads.editItemAt(i);
+                download->mBytesDone += share;
+                if (download->mBytesDone < download->mTotalBytes) {
+                    ++i;
+                    continue;
+                }
+
+                controller->addSegmentMeasurement(
+                        (size_t)download->mTotalBytes, download->mStartUs,
+                        nowUs + kTickUs, options.mSegmentDurationUs);
+
+                fetched.editItemAt(download->mSeqNumber) = true;
+                stats->mSumBandwidth += bandwidths.itemAt(download->mIndex);
+                ++stats->mNumSegments;
+
+                if (options.mVerbose) {
+                    printf("%8.2f s  segment %zu  index %zu  buffered %.2f s  "
+                           "link %.0f kbps  estimate %lld kbps\n",
+                           (nowUs + kTickUs) / 1E6, download->mSeqNumber,
+                           download->mIndex, bufferedUs / 1E6, bps / 1000.0,
+                           (long long)controller->estimatedBandwidthBps() / 1000);
+                }
+                downloads.removeAt(i);
+            }
+        }
+
+        // Segments are played in order, whichever finished first.
+        while (nextToPlay < fetched.size() && fetched.itemAt(nextToPlay)) {
+            bufferedUs += options.mSegmentDurationUs;
+            ++nextToPlay;
+        }
+
+        int64_t estimateBps = controller->estimatedBandwidthBps();
+        if (estimateBps >= 0 && bps > 0) {
+            double error = (estimateBps - bps) / bps;
+            stats->mSumEstimateError += error < 0 ? -error : error;
+            ++stats->mNumEstimates;
+        }
+
+        if (playing) {
+            bufferedUs -= kTickUs;
+            if (bufferedUs <= 0) {
+                bufferedUs = 0;
+                playing = false;
+                stallStartUs = nowUs;
+                ++stats->mNumStalls;
+            }
+        } else if (bufferedUs >= options.mSegmentDurationUs) {
+            playing = true;
+            if (stats->mStartupUs < 0) {
+                stats->mStartupUs = nowUs;
+            } else {
+                stats->mStallUs += nowUs - stallStartUs;
+            }
+        }
+    }
+
+    if (!playing && stats->mStartupUs >= 0) {
+        stats->mStallUs += options.mDurationUs - stallStartUs;
+    }
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-d segment_secs] [-p parallel] "
+            "[-b buffer_secs] [-t duration_secs] [-v] trace.txt kbps...\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    Options options;
+    options.mSegmentDurationUs = 4000000ll;
+    options.mParallel = 1;
+    options.mMaxBufferUs = 30000000ll;
+    options.mDurationUs = 600000000ll;
+    options.mVerbose = false;
+
+    int res;
+    while ((res = getopt(argc, argv, "d:p:b:t:vh")) >= 0) {
+        switch (res) {
+            case 'd':
+                options.mSegmentDurationUs = (int64_t)(atof(optarg) * 1E6);
+                break;
+            case 'p':
+                options.mParallel = atoi(optarg);
+                break;
+            case 'b':
+                options.mMaxBufferUs = (int64_t)(atof(optarg) * 1E6);
+                break;
+            case 't':
+                options.mDurationUs = (int64_t)(atof(optarg) * 1E6);
+                break;
+            case 'v':
+                options.mVerbose = true;
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 2 || options.mSegmentDurationUs <= 0 || options.mParallel == 0
+            || options.mMaxBufferUs < options.mSegmentDurationUs
+            || options.mDurationUs <= 0) {
+        usage(me);
+    }
+
+    Vector<TracePoint> trace;
+    if (!readTrace(argv[0], &trace)) {
+        return 1;
+    }
+
+    // Variants in increasing order, as AmLiveSession sorts them.
+    Vector<size_t> bandwidths;
+    for (int i = 1; i < argc; ++i) {
+        size_t bandwidth = (size_t)atol(argv[i]) * 1000;
+        if (bandwidth == 0
+                || (!bandwidths.isEmpty() && bandwidth <= bandwidths.top())) {
+            fprintf(stderr, "variant bitrates must be increasing kbps\n");
+            return 1;
+        }
+        bandwidths.push(bandwidth);
+    }
+
+    Stats stats;
+    simulate(trace, bandwidths, options, &stats);
+
+    printf("startup: %.2f s\n", stats.mStartupUs / 1E6);
+    printf("stalls: %zu, %.2f s\n", stats.mNumStalls, stats.mStallUs / 1E6);
+    printf("segments: %zu, average bitrate %.0f kbps, %zu switches\n",
+           stats.mNumSegments,
+           stats.mNumSegments > 0
+                ? stats.mSumBandwidth / stats.mNumSegments / 1000.0 : 0.0,
+           stats.mNumSwitches);
+    if (stats.mNumEstimates > 0) {
+        printf("bandwidth estimate off by %.1f%% on average\n",
+               100.0 * stats.mSumEstimateError / stats.mNumEstimates);
+    }
+
+    return 0;
+}
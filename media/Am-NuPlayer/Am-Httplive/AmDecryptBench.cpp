@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Decrypts a synthetic AES-128-CBC segment the way AmPlaylistFetcher does,
+// in download blocks of kDownloadBlockSize, once with the EVP context kept
+// per key URI and once with the AES_set_decrypt_key/AES_cbc_encrypt loop
+// it replaced, which expanded the key again for every block. Checks both
+// give back the plaintext and reports the throughput and the time it
+// takes to decrypt a whole segment.
+//
+// usage: amdecryptbench [-n iterations] [-s segment_kb]
+
+#include <openssl/aes.h>
+#include <openssl/evp.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace android {
+
+// AmPlaylistFetcher::kDownloadBlockSize
+static const size_t kBlockSize = 47 * 1024;
+
+static int64_t NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+struct Segment {
+    uint8_t mKey[16];
+    uint8_t mIV[16];
+    uint8_t *mPlain;
+    uint8_t *mCipher;
+    size_t mSize;
+};
+
+static bool MakeSegment(size_t size, Segment *segment) {
+    segment->mSize = size & ~(size_t)15;
+    segment->mPlain = (uint8_t *)malloc(segment->mSize);
+    segment->mCipher = (uint8_t *)malloc(segment->mSize);
+    for (size_t i = 0; i < sizeof(segment->mKey); ++i) {
+        segment->mKey[i] = rand();
+        segment->mIV[i] = rand();
+    }
+    for (size_t i = 0; i < segment->mSize; ++i) {
+        segment->mPlain[i] = rand();
+    }
+
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    int outLength = 0;
+    bool ok = ctx != NULL
+            && EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), NULL,
+                                  segment->mKey, segment->mIV)
+            && EVP_CIPHER_CTX_set_padding(ctx, 0)
+            && EVP_EncryptUpdate(ctx, segment->mCipher, &outLength,
+                                 segment->mPlain, segment->mSize)
+            && (size_t)outLength == segment->mSize;
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+// The loop decryptBuffer used to run.
+static bool DecryptOld(const Segment &segment, uint8_t *data) {
+    uint8_t iv[16];
+    memcpy(iv, segment.mIV, sizeof(iv));
+
+    for (size_t offset = 0; offset < segment.mSize; offset += kBlockSize) {
+        size_t n = segment.mSize - offset;
+        if (n > kBlockSize) {
+            n = kBlockSize;
+        }
+
+        AES_KEY key;
+        if (AES_set_decrypt_key(segment.mKey, 128, &key) != 0) {
+            return false;
+        }
+        AES_cbc_encrypt(data + offset, data + offset, n, &key, iv, AES_DECRYPT);
+    }
+    return true;
+}
+
+// The one it runs now: the key is expanded once per key URI, each segment
+// only sets the IV.
+static bool DecryptEvp(EVP_CIPHER_CTX *ctx, const Segment &segment, uint8_t *data) {
+    if (!EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, segment.mIV)) {
+        return false;
+    }
+
+    for (size_t offset = 0; offset < segment.mSize; offset += kBlockSize) {
+        size_t n = segment.mSize - offset;
+        if (n > kBlockSize) {
+            n = kBlockSize;
+        }
+
+        int outLength;
+        if (!EVP_DecryptUpdate(ctx, data + offset, &outLength, data + offset, n)
+                || (size_t)outLength != n) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Stats {
+    Stats()
+        : mTotalUs(0),
+          mMaxUs(0) {
+    }
+
+    void add(int64_t us) {
+        mTotalUs += us;
+        if (us > mMaxUs) {
+            mMaxUs = us;
+        }
+    }
+
+    int64_t mTotalUs;
+    int64_t mMaxUs;
+};
+
+static bool Run(const Segment &segment, bool evp, int iterations, Stats *stats) {
+    EVP_CIPHER_CTX *ctx = NULL;
+    if (evp) {
+        ctx = EVP_CIPHER_CTX_new();
+        if (ctx == NULL
+                || !EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, segment.mKey, NULL)) {
+            EVP_CIPHER_CTX_free(ctx);
+            return false;
+        }
+        EVP_CIPHER_CTX_set_padding(ctx, 0);
+    }
+
+    uint8_t *data = (uint8_t *)malloc(segment.mSize);
+    bool ok = true;
+    for (int n = 0; n < iterations && ok; ++n) {
+        memcpy(data, segment.mCipher, segment.mSize);
+
+        int64_t startUs = NowUs();
+        ok = evp ? DecryptEvp(ctx, segment, data) : DecryptOld(segment, data);
+        stats->add(NowUs() - startUs);
+
+        if (ok && memcmp(data, segment.mPlain, segment.mSize) != 0) {
+            fprintf(stderr, "%s: wrong plaintext\n", evp ? "evp" : "aes_cbc");
+            ok = false;
+        }
+    }
+
+    free(data);
+    EVP_CIPHER_CTX_free(ctx);
+    return ok;
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n iterations] [-s segment_kb]\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int iterations = 20;
+    // About 10 seconds of a 3 Mbps variant.
+    size_t size = 4096 * 1024;
+
+    int res;
+    while ((res = getopt(argc, argv, "n:s:h")) >= 0) {
+        switch (res) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 's':
+                size = (size_t)atoi(optarg) * 1024;
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    if (argc != optind || iterations <= 0 || size < 16) {
+        usage(me);
+    }
+
+    srand(1);
+
+    Segment segment;
+    if (!MakeSegment(size, &segment)) {
+        fprintf(stderr, "unable to encrypt the segment\n");
+        return 1;
+    }
+
+    Stats old, evp;
+    if (!Run(segment, false, iterations, &old) || !Run(segment, true, iterations, &evp)) {
+        return 1;
+    }
+
+    double mb = (double)segment.mSize * iterations / (1024 * 1024);
+    printf("%zu KB segments in %zu KB blocks\n", segment.mSize / 1024, kBlockSize / 1024);
+    printf("aes_cbc: %7.1f MB/s  segment %7.2f ms avg %7.2f ms max\n",
+           mb * 1E6 / (old.mTotalUs > 0 ? old.mTotalUs : 1),
+           old.mTotalUs / 1000.0 / iterations, old.mMaxUs / 1000.0);
+    printf("evp:     %7.1f MB/s  segment %7.2f ms avg %7.2f ms max  (%.2fx)\n",
+           mb * 1E6 / (evp.mTotalUs > 0 ? evp.mTotalUs : 1),
+           evp.mTotalUs / 1000.0 / iterations, evp.mMaxUs / 1000.0,
+           evp.mTotalUs > 0 ? (double)old.mTotalUs / evp.mTotalUs : 0.0);
+
+    free(segment.mPlain);
+    free(segment.mCipher);
+    return 0;
+}
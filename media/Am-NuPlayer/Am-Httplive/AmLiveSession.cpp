@@ -20,6 +20,7 @@
 
 #include "AmLiveSession.h"
 
+#include "AmABRController.h"
 #include "AmM3UParser.h"
 #include "AmPlaylistFetcher.h"
 #include "include/HEVC_utils.h"
@@ -35,6 +36,7 @@
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
 #include <media/stagefright/MediaErrors.h>
@@ -86,6 +88,7 @@ AmLiveSession::AmLiveSession(
       mNewStreamMask(0),
       mSwapMask(0),
       mEstimatedBWbps(0),
+      mABRController(new AmABRController),
       mCheckBandwidthGeneration(0),
       mSwitchGeneration(0),
       mSubtitleGeneration(0),
@@ -163,6 +166,7 @@ sp<ABuffer> AmLiveSession::createFormatChangeBuffer(bool swap) {
 }
 
 void AmLiveSession::swapPacketSource(StreamType stream) {
+    Mutex::Autolock autoLock(mDumpLock);
     sp<AmAnotherPacketSource> &aps = mPacketSources.editValueFor(stream);
     sp<AmAnotherPacketSource> &aps2 = mPacketSources2.editValueFor(stream);
     sp<AmAnotherPacketSource> tmp = aps;
@@ -631,6 +635,31 @@ status_t AmLiveSession::disconnect() {
     return err;
 }
 
+void AmLiveSession::dump(AString *out) {
+    // The looper may sit in a download retry loop for a long time, so
+    // collect the fetchers here instead of asking it.
+    Vector<sp<AmPlaylistFetcher> > fetchers;
+    Vector<sp<AmAnotherPacketSource> > sources;
+    {
+        Mutex::Autolock autoLock(mDumpLock);
+        for (size_t i = 0; i < mFetcherInfos.size(); ++i) {
+            fetchers.push(mFetcherInfos.valueAt(i).mFetcher);
+        }
+        for (size_t i = 0; i < mPacketSources.size(); ++i) {
+            sources.push(mPacketSources.valueAt(i));
+        }
+    }
+
+    out->append(AStringPrintf("AmLiveSession: %zu fetchers\n", fetchers.size()));
+    for (size_t i = 0; i < fetchers.size(); ++i) {
+        fetchers[i]->dump(out);
+    }
+
+    for (size_t i = 0; i < sources.size(); ++i) {
+        sources[i]->dump(out);
+    }
+}
+
 status_t AmLiveSession::seekTo(int64_t timeUs) {
 
     {
@@ -745,7 +774,10 @@ void AmLiveSession::onMessageReceived(const sp<AMessage> &msg) {
                     if (what == AmPlaylistFetcher::kWhatStopped) {
                         AString uri;
                         CHECK(msg->findString("uri", &uri));
-                        mFetcherInfos.removeItem(uri);
+                        {
+                            Mutex::Autolock autoLock(mDumpLock);
+                            mFetcherInfos.removeItem(uri);
+                        }
                         void * ptr;
                         CHECK(msg->findPointer("looper", &ptr));
                         sp<ALooper> looper = static_cast<ALooper *>(ptr);
@@ -1227,7 +1259,10 @@ sp<AmPlaylistFetcher> AmLiveSession::addFetcher(const char *uri) {
     info.mToBeRemoved = false;
     fetcherLooper->registerHandler(info.mFetcher);
 
-    mFetcherInfos.add(uri, info);
+    {
+        Mutex::Autolock autoLock(mDumpLock);
+        mFetcherInfos.add(uri, info);
+    }
     mFetcherLooper.push(fetcherLooper);
 
     return info.mFetcher;
@@ -1549,7 +1584,8 @@ ssize_t AmLiveSession::fetchFile(
 }
 
 sp<AmM3UParser> AmLiveSession::fetchPlaylist(
-        const char *url, uint8_t *curPlaylistHash, bool *unchanged, status_t &err_ret, CFContext ** cfc, bool isMasterPlaylist) {
+        const char *url, uint8_t *curPlaylistHash, bool *unchanged, status_t &err_ret, CFContext ** cfc, bool isMasterPlaylist,
+        const sp<AmM3UParser> &previous) {
     ALOGI("fetchPlaylist '%s'", url);
 
     *unchanged = false;
@@ -1595,7 +1631,7 @@ sp<AmM3UParser> AmLiveSession::fetchPlaylist(
 PASS_THROUGH:
     mLastPlayListURL.setTo(url);
     sp<AmM3UParser> playlist =
-        new AmM3UParser(actualUrl.string(), buffer->data(), buffer->size());
+        new AmM3UParser(actualUrl.string(), buffer->data(), buffer->size(), previous);
 
     if (playlist->initCheck() != OK) {
         ALOGE("failed to parse .m3u8 playlist");
@@ -1637,7 +1673,11 @@ size_t AmLiveSession::getBandwidthIndex() {
     }
 
     if (index < 0) {
-        int32_t bandwidthBps = mEstimatedBWbps;
+        int64_t bandwidthBps = mABRController->estimatedBandwidthBps();
+        if (bandwidthBps < 0) {
+            // No segment measured yet, go with what curl saw last.
+            bandwidthBps = mEstimatedBWbps;
+        }
         ALOGI("bandwidth estimated at %.2f kbps", bandwidthBps / 1024.0f);
 
         char value[PROPERTY_VALUE_MAX];
@@ -1652,24 +1692,32 @@ size_t AmLiveSession::getBandwidthIndex() {
             }
         }
 
-        // Pick the highest bandwidth stream below or equal to estimated bandwidth.
+        Vector<size_t> bandwidths;
+        for (size_t i = 0; i < mBandwidthItems.size(); ++i) {
+            bandwidths.push(mBandwidthItems.itemAt(i).mBandwidth);
+        }
 
-        index = mBandwidthItems.size() - 1;
-        while (index > 0) {
-            // consider only 80% of the available bandwidth, but if we are switching up,
-            // be even more conservative (70%) to avoid overestimating and immediately
-            // switching back.
-            size_t adjustedBandwidthBps = bandwidthBps;
-            if (index > mCurBandwidthIndex) {
-                adjustedBandwidthBps = adjustedBandwidthBps * 7 / 10;
-            } else {
-                adjustedBandwidthBps = adjustedBandwidthBps * 8 / 10;
+        // Buffer level of the stream closest to running dry.
+        int64_t bufferedDurationUs = -1;
+        for (size_t i = 0; i < mPacketSources.size(); ++i) {
+            StreamType type = mPacketSources.keyAt(i);
+            if (type != STREAMTYPE_AUDIO && type != STREAMTYPE_VIDEO) {
+                continue;
             }
-            if (mBandwidthItems.itemAt(index).mBandwidth <= adjustedBandwidthBps) {
-                break;
+            if (mStreamMask != 0 && !(mStreamMask & type)) {
+                continue;
+            }
+            status_t err = OK;
+            int64_t durationUs =
+                    mPacketSources.valueAt(i)->getBufferedDurationUs(&err);
+            if (bufferedDurationUs < 0 || durationUs < bufferedDurationUs) {
+                bufferedDurationUs = durationUs;
             }
-            --index;
         }
+
+        index = mABRController->selectIndex(
+                bandwidths, mCurBandwidthIndex, bufferedDurationUs,
+                bandwidthBps, ALooper::GetNowUs());
     }
 #elif 0
     // Change bandwidth at random()
@@ -2401,6 +2449,7 @@ void AmLiveSession::cancelBandwidthSwitch() {
 
             const FetcherInfo &info = mFetcherInfos.valueAt(j);
             info.mFetcher->stopAsync();
+            Mutex::Autolock autoLock(mDumpLock);
             mFetcherInfos.removeItemsAt(j);
             mStreams[i].mNewUri.clear();
         }
@@ -2520,6 +2569,7 @@ void AmLiveSession::reconfigFetcher(size_t bandwidthIndex) {
     if (i < streamNum) {  // need to add fetchers
         // TODO: fetcher add logic.
     }
+    Mutex::Autolock autoLock(mDumpLock);
     mFetcherInfos.clear();
     mFetcherInfos = newFetcherInfos;
 }
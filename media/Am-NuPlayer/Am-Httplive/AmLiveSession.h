@@ -28,6 +28,7 @@
 namespace android {
 
 struct ABuffer;
+struct AmABRController;
 struct AmAnotherPacketSource;
 struct DataSource;
 struct HTTPBase;
@@ -85,6 +86,10 @@ struct AmLiveSession : public AHandler {
     // Blocks until seek is complete.
     status_t seekTo(int64_t timeUs);
 
+    // Appends the state of the fetchers and packet sources to "out", for
+    // dumpsys.
+    void dump(AString *out);
+
     status_t getDuration(int64_t *durationUs) const;
     size_t getTrackCount() const;
     sp<AMessage> getTrackInfo(size_t trackIndex) const;
@@ -127,6 +132,7 @@ protected:
 
 private:
     friend struct AmPlaylistFetcher;
+    friend struct AmSegmentPrefetcher;
 
     enum {
         kWhatConnect                    = 'conn',
@@ -233,6 +239,9 @@ private:
     Mutex mFetcherPlaylistMutex;
 
     KeyedVector<AString, FetcherInfo> mFetcherInfos;
+    // Held while adding or removing mFetcherInfos entries or swapping
+    // mPacketSources, and by dump().
+    Mutex mDumpLock;
     uint32_t mStreamMask;
 
     // Masks used during reconfiguration:
@@ -255,6 +264,7 @@ private:
     Mutex mSwapMutex;
 
     int32_t mEstimatedBWbps;
+    sp<AmABRController> mABRController;
     int32_t mCheckBandwidthGeneration;
     int32_t mSwitchGeneration;
     int32_t mSubtitleGeneration;
@@ -320,8 +330,11 @@ private:
             CFContext ** cfc = NULL,
             String8 *actualUrl = NULL, bool isPlaylist = false);
 
+    // "previous" is the last version of the playlist when refreshing, its
+    // segments are reused where the new version has the same ones.
     sp<AmM3UParser> fetchPlaylist(
-            const char *url, uint8_t *curPlaylistHash, bool *unchanged, status_t &err, CFContext ** cfc = NULL, bool isMasterPlaylist = false);
+            const char *url, uint8_t *curPlaylistHash, bool *unchanged, status_t &err, CFContext ** cfc = NULL, bool isMasterPlaylist = false,
+            const sp<AmM3UParser> &previous = NULL);
 
     size_t getBandwidthIndex();
     int64_t latestMediaSegmentStartTimeUs();
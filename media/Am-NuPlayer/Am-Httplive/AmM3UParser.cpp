@@ -28,6 +28,8 @@
 #include <media/stagefright/Utils.h>
 #include <media/mediaplayer.h>
 
+#include <inttypes.h>
+
 namespace android {
 
 struct AmM3UParser::MediaGroup : public RefBase {
@@ -242,8 +244,67 @@ bool AmM3UParser::MediaGroup::getActiveURI(AString *uri) const {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+static const uint64_t kHashInit = 0xcbf29ce484222325ull;
+static const uint64_t kHashPrime = 0x100000001b3ull;
+
+struct AmM3UParser::PendingItem {
+    PendingItem()
+        : mDurationUs(-1),
+          mRangeOffset(0),
+          mRangeLength(-1),
+          mFlags(0),
+          mHash(kHashInit),
+          mLinesOffset(-1),
+          mHasByteRange(false) {
+    }
+
+    sp<AMessage> mMeta;
+    int64_t mDurationUs;
+    int64_t mRangeOffset;
+    int64_t mRangeLength;
+    uint32_t mFlags;
+
+    // FNV-1a over the item's lines.
+    uint64_t mHash;
+
+    // Where the lines not parsed yet start, -1 if there are none.
+    ssize_t mLinesOffset;
+    bool mHasByteRange;
+};
+
+static uint64_t HashBytes(uint64_t hash, const char *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= kHashPrime;
+    }
+    return hash;
+}
+
+static uint64_t HashLine(uint64_t hash, const char *line, size_t length) {
+    hash = HashBytes(hash, line, length);
+    hash ^= '\n';
+    hash *= kHashPrime;
+    return hash;
+}
+
+static bool LineStartsWith(const char *line, size_t length, const char *prefix) {
+    size_t prefixLength = strlen(prefix);
+    return length >= prefixLength && !strncmp(line, prefix, prefixLength);
+}
+
+// Lines that describe a single item rather than the whole playlist:
+// the URI itself and the tags that apply to the next URI.
+static bool IsItemLine(const char *line, size_t length) {
+    return line[0] != '#'
+            || LineStartsWith(line, length, "#EXTINF")
+            || LineStartsWith(line, length, "#EXT-X-KEY")
+            || LineStartsWith(line, length, "#EXT-X-DISCONTINUITY")
+            || LineStartsWith(line, length, "#EXT-X-BYTERANGE");
+}
+
 AmM3UParser::AmM3UParser(
-        const char *baseURI, const void *data, size_t size)
+        const char *baseURI, const void *data, size_t size,
+        const sp<AmM3UParser> &previous)
     : mInitCheck(NO_INIT),
       mBaseURI(baseURI),
       mIsExtM3U(false),
@@ -251,8 +312,13 @@ AmM3UParser::AmM3UParser(
       mIsComplete(false),
       mIsEvent(false),
       mDiscontinuitySeq(0),
-      mSelectedIndex(-1) {
-    mInitCheck = parse(data, size);
+      mSelectedIndex(-1),
+      mBodySize(0),
+      mBodyHash(kHashInit),
+      mNumLines(0),
+      mEndRangeOffset(0),
+      mCanAppend(false) {
+    mInitCheck = parse(data, size, previous);
 }
 
 AmM3UParser::~AmM3UParser() {
@@ -287,7 +353,7 @@ sp<AMessage> AmM3UParser::meta() {
 }
 
 size_t AmM3UParser::size() {
-    return mItems.size();
+    return mItemURIOffsets.size();
 }
 
 bool AmM3UParser::itemAt(size_t index, AString *uri, sp<AMessage> *meta) {
@@ -299,21 +365,102 @@ bool AmM3UParser::itemAt(size_t index, AString *uri, sp<AMessage> *meta) {
         *meta = NULL;
     }
 
-    if (index >= mItems.size()) {
+    if (index >= mItemURIOffsets.size()) {
         return false;
     }
 
     if (uri) {
-        *uri = mItems.itemAt(index).mURI;
+        uri->setTo(mURIPool.array() + mItemURIOffsets.itemAt(index));
     }
 
     if (meta) {
-        *meta = mItems.itemAt(index).mMeta;
+        // Put the item meta back together from the columns, callers may
+        // hold on to it and the next refresh shares mItemMetas.
+        const sp<AMessage> &itemMeta = mItemMetas.itemAt(index);
+        sp<AMessage> out;
+        if (itemMeta != NULL) {
+            out = itemMeta->dup();
+        }
+
+        int64_t durationUs = mItemDurationsUs.itemAt(index);
+        uint32_t flags = mItemFlags.itemAt(index);
+        int64_t rangeLength = mItemRangeLengths.itemAt(index);
+        if (out == NULL
+                && (durationUs >= 0 || flags != 0 || rangeLength >= 0)) {
+            out = new AMessage;
+        }
+
+        if (durationUs >= 0) {
+            out->setInt64("durationUs", durationUs);
+        }
+        if (flags & kItemDiscontinuity) {
+            out->setInt32("discontinuity", true);
+        }
+        if (rangeLength >= 0) {
+            out->setInt64("range-offset", mItemRangeOffsets.itemAt(index));
+            out->setInt64("range-length", rangeLength);
+        }
+
+        *meta = out;
     }
 
     return true;
 }
 
+int64_t AmM3UParser::itemDurationUs(size_t index) const {
+    CHECK_LT(index, mItemDurationsUs.size());
+    return mItemDurationsUs.itemAt(index);
+}
+
+int64_t AmM3UParser::itemStartTimeUs(size_t index) const {
+    if (index == mItemStartTimesUs.size()) {
+        return getTotalDurationUs();
+    }
+
+    CHECK_LT(index, mItemStartTimesUs.size());
+    return mItemStartTimesUs.itemAt(index);
+}
+
+int64_t AmM3UParser::getTotalDurationUs() const {
+    if (mItemStartTimesUs.isEmpty()) {
+        return 0ll;
+    }
+
+    int64_t durationUs = mItemDurationsUs.top();
+    return mItemStartTimesUs.top() + (durationUs > 0 ? durationUs : 0);
+}
+
+size_t AmM3UParser::findItemForTime(int64_t timeUs) const {
+    // Item end times never decrease, look for the first one past timeUs.
+    size_t lo = 0;
+    size_t hi = mItemStartTimesUs.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (itemStartTimeUs(mid + 1) > timeUs) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+sp<AMessage> AmM3UParser::findCipherMeta(size_t index) const {
+    if (index >= mItemMetas.size()) {
+        return NULL;
+    }
+
+    AString method;
+    for (ssize_t i = index; i >= 0; --i) {
+        const sp<AMessage> &itemMeta = mItemMetas.itemAt(i);
+        if (itemMeta != NULL && itemMeta->findString("cipher-method", &method)) {
+            return itemMeta;
+        }
+    }
+
+    return NULL;
+}
+
 void AmM3UParser::pickRandomMediaItems() {
     for (size_t i = 0; i < mMediaGroups.size(); ++i) {
         mMediaGroups.valueAt(i)->pickRandomMediaItems();
@@ -401,13 +548,13 @@ bool AmM3UParser::getTypeURI(size_t index, const char *key, AString *uri) const
         return !strcmp("audio", key) || !strcmp("video", key);
     }
 
-    CHECK_LT(index, mItems.size());
+    CHECK_LT(index, mItemMetas.size());
 
-    sp<AMessage> meta = mItems.itemAt(index).mMeta;
+    sp<AMessage> meta = mItemMetas.itemAt(index);
 
     AString groupID;
     if (!meta->findString(key, &groupID)) {
-        *uri = mItems.itemAt(index).mURI;
+        uri->setTo(mURIPool.array() + mItemURIOffsets.itemAt(index));
 
         AString codecs;
         if (!meta->findString("codecs", &codecs)) {
@@ -439,12 +586,47 @@ bool AmM3UParser::getTypeURI(size_t index, const char *key, AString *uri) const
     }
 
     if ((*uri).empty()) {
-        *uri = mItems.itemAt(index).mURI;
+        uri->setTo(mURIPool.array() + mItemURIOffsets.itemAt(index));
     }
 
     return true;
 }
 
+void AmM3UParser::dump(AString *out) const {
+    int32_t seq = 0;
+    if (mMeta != NULL) {
+        mMeta->findInt32("media-sequence", &seq);
+    }
+
+    out->append(AStringPrintf(
+            "AmM3UParser: %zu items, %.3f secs, media sequence %d, "
+            "discontinuity sequence %zu%s\n",
+            mItemURIOffsets.size(), getTotalDurationUs() / 1E6, seq,
+            mDiscontinuitySeq, mIsComplete ? ", complete" : ""));
+
+    size_t discontinuitySeq = mDiscontinuitySeq;
+    for (size_t i = 0; i < mItemURIOffsets.size(); ++i) {
+        if (mItemFlags.itemAt(i) & kItemDiscontinuity) {
+            ++discontinuitySeq;
+        }
+
+        out->append(AStringPrintf(
+                "  #%d start %.3f duration %.3f discontinuity %zu",
+                seq + (int32_t)i,
+                mItemStartTimesUs.itemAt(i) / 1E6,
+                mItemDurationsUs.itemAt(i) / 1E6,
+                discontinuitySeq));
+
+        if (mItemRangeLengths.itemAt(i) >= 0) {
+            out->append(AStringPrintf(
+                    " range %" PRId64 "@%" PRId64,
+                    mItemRangeLengths.itemAt(i), mItemRangeOffsets.itemAt(i)));
+        }
+
+        out->append("\n");
+    }
+}
+
 static bool MakeURL(const char *baseURL, const char *url, AString *out) {
     out->clear();
 
@@ -515,34 +697,267 @@ static bool MakeURL(const char *baseURL, const char *url, AString *out) {
     return true;
 }
 
-status_t AmM3UParser::parse(const void *_data, size_t size) {
+bool AmM3UParser::canReuseItems(
+        const sp<AmM3UParser> &previous, const char *data, size_t size) const {
+    if (previous == NULL
+            || previous->mInitCheck != OK
+            || previous->mIsVariantPlaylist
+            || previous->size() == 0
+            || !(previous->mBaseURI == mBaseURI)) {
+        return false;
+    }
+
+    // Item lines are looked at before the playlist tags around them, which
+    // is fine for a media playlist but not if this turns out to be a
+    // variant playlist.
+    static const char kStreamInf[] = "#EXT-X-STREAM-INF";
+    return memmem(data, size, kStreamInf, strlen(kStreamInf)) == NULL;
+}
+
+bool AmM3UParser::appendsTo(
+        const sp<AmM3UParser> &previous, const char *data, size_t size) const {
+    if (previous == NULL
+            || previous->mInitCheck != OK
+            || !previous->mCanAppend
+            || size <= previous->mBodySize
+            || !(previous->mBaseURI == mBaseURI)) {
+        return false;
+    }
+
+    return HashBytes(kHashInit, data, previous->mBodySize) == previous->mBodyHash;
+}
+
+void AmM3UParser::copyFrom(const sp<AmM3UParser> &previous) {
+    mIsExtM3U = previous->mIsExtM3U;
+    mIsComplete = previous->mIsComplete;
+    mIsEvent = previous->mIsEvent;
+    mDiscontinuitySeq = previous->mDiscontinuitySeq;
+
+    // Tags in the new lines may still add to it.
+    if (previous->mMeta != NULL) {
+        mMeta = previous->mMeta->dup();
+    }
+
+    // Shared until either side adds items.
+    mURIPool = previous->mURIPool;
+    mItemURIOffsets = previous->mItemURIOffsets;
+    mItemStartTimesUs = previous->mItemStartTimesUs;
+    mItemDurationsUs = previous->mItemDurationsUs;
+    mItemRangeOffsets = previous->mItemRangeOffsets;
+    mItemRangeLengths = previous->mItemRangeLengths;
+    mItemFlags = previous->mItemFlags;
+    mItemMetas = previous->mItemMetas;
+    mItemHashes = previous->mItemHashes;
+}
+
+bool AmM3UParser::reuseItem(
+        const sp<AmM3UParser> &previous, int32_t seqDelta, uint64_t hash) {
+    ssize_t index = (ssize_t)mItemURIOffsets.size() + seqDelta;
+    if (index < 0 || (size_t)index >= previous->size()
+            || previous->mItemHashes.itemAt(index) != hash) {
+        return false;
+    }
+
+    const char *uri =
+        previous->mURIPool.array() + previous->mItemURIOffsets.itemAt(index);
+    mItemURIOffsets.push(mURIPool.size());
+    mURIPool.appendArray(uri, strlen(uri) + 1);
+
+    pushItemTiming(previous->mItemDurationsUs.itemAt(index));
+    mItemRangeOffsets.push(previous->mItemRangeOffsets.itemAt(index));
+    mItemRangeLengths.push(previous->mItemRangeLengths.itemAt(index));
+    mItemFlags.push(previous->mItemFlags.itemAt(index));
+    mItemMetas.push(previous->mItemMetas.itemAt(index));
+    mItemHashes.push(hash);
+
+    return true;
+}
+
+status_t AmM3UParser::parseItemTag(
+        const AString &line, PendingItem *item,
+        uint64_t *segmentRangeOffset) {
+    if (mIsVariantPlaylist) {
+        return ERROR_MALFORMED;
+    }
+
+    status_t err = OK;
+
+    if (line.startsWith("#EXT-X-KEY")) {
+        err = parseCipherInfo(line, &item->mMeta, mBaseURI);
+    } else if (line.startsWith("#EXTINF")) {
+        err = parseMetaDataDuration(line, &item->mDurationUs);
+    } else if (line.startsWith("#EXT-X-DISCONTINUITY")) {
+        item->mFlags |= kItemDiscontinuity;
+    } else if (line.startsWith("#EXT-X-BYTERANGE")) {
+        uint64_t length, offset;
+        err = parseByteRange(line, *segmentRangeOffset, &length, &offset);
+
+        if (err == OK) {
+            item->mRangeOffset = offset;
+            item->mRangeLength = length;
+
+            *segmentRangeOffset = offset + length;
+        }
+    }
+
+    return err;
+}
+
+status_t AmM3UParser::addItem(const AString &line, PendingItem *item) {
+    if (!mIsVariantPlaylist && item->mDurationUs < 0) {
+        return ERROR_MALFORMED;
+    }
+
+    AString uri;
+    CHECK(MakeURL(mBaseURI.c_str(), line.c_str(), &uri));
+
+    mItemURIOffsets.push(mURIPool.size());
+    mURIPool.appendArray(uri.c_str(), uri.size() + 1);
+
+    pushItemTiming(item->mDurationUs);
+    mItemRangeOffsets.push(item->mRangeOffset);
+    mItemRangeLengths.push(item->mRangeLength);
+    mItemFlags.push(item->mFlags);
+    mItemMetas.push(item->mMeta);
+    mItemHashes.push(item->mHash);
+
+    *item = PendingItem();
+
+    return OK;
+}
+
+void AmM3UParser::pushItemTiming(int64_t durationUs) {
+    mItemStartTimesUs.push(getTotalDurationUs());
+    mItemDurationsUs.push(durationUs);
+}
+
+status_t AmM3UParser::parseItemLines(
+        const char *data, size_t offset, size_t end,
+        PendingItem *item, uint64_t *segmentRangeOffset) {
+    while (offset < end) {
+        const char *lf = (const char *)memchr(&data[offset], '\n', end - offset);
+        size_t offsetLF = lf != NULL ? lf - data : end;
+
+        size_t length = offsetLF - offset;
+        if (length > 0 && data[offsetLF - 1] == '\r') {
+            --length;
+        }
+
+        if (length > 0 && IsItemLine(&data[offset], length)) {
+            AString line(&data[offset], length);
+
+            status_t err = OK;
+            if (!line.startsWith("#")) {
+                err = addItem(line, item);
+            } else if (mIsExtM3U) {
+                err = parseItemTag(line, item, segmentRangeOffset);
+            }
+
+            if (err != OK) {
+                return err;
+            }
+        }
+
+        offset = offsetLF + 1;
+    }
+
+    return OK;
+}
+
+status_t AmM3UParser::parse(
+        const void *_data, size_t size, const sp<AmM3UParser> &previous) {
     int32_t lineNo = 0;
 
-    sp<AMessage> itemMeta;
+    PendingItem item;
 
     const char *data = (const char *)_data;
     size_t offset = 0;
     uint64_t segmentRangeOffset = 0;
+
+    // EVENT playlists and live ones refreshed before the oldest segment
+    // expired only grow at the end, take the previous version's state
+    // and carry on from where it stopped.
+    bool appended = appendsTo(previous, data, size);
+    if (appended) {
+        copyFrom(previous);
+        offset = previous->mBodySize;
+        lineNo = previous->mNumLines;
+        segmentRangeOffset = previous->mEndRangeOffset;
+    }
+
+    // When refreshing a live playlist, item lines are only hashed until
+    // the item's URI shows up. Items the previous version had with the
+    // same lines are copied over, the others are parsed after all.
+    bool deferItems = !appended && canReuseItems(previous, data, size);
+    bool haveSeqDelta = false;
+    int32_t seqDelta = 0;
+    size_t numReused = 0;
+
     while (offset < size) {
-        size_t offsetLF = offset;
-        while (offsetLF < size && data[offsetLF] != '\n') {
-            ++offsetLF;
+        const char *lf = (const char *)memchr(&data[offset], '\n', size - offset);
+        size_t offsetLF = lf != NULL ? lf - data : size;
+
+        size_t length = offsetLF - offset;
+        if (length > 0 && data[offsetLF - 1] == '\r') {
+            --length;
         }
 
-        AString line;
-        if (offsetLF > offset && data[offsetLF - 1] == '\r') {
-            line.setTo(&data[offset], offsetLF - offset - 1);
-        } else {
-            line.setTo(&data[offset], offsetLF - offset);
+        if (length == 0) {
+            offset = offsetLF + 1;
+            continue;
         }
 
-        // ALOGI("#%s#", line.c_str());
+        bool isItemLine = IsItemLine(&data[offset], length);
+        if (isItemLine) {
+            item.mHash = HashLine(item.mHash, &data[offset], length);
+        }
+
+        if (deferItems && lineNo > 0 && isItemLine) {
+            if (item.mLinesOffset < 0) {
+                item.mLinesOffset = offset;
+            }
+
+            if (data[offset] == '#') {
+                // Byte ranges without an offset depend on the items before.
+                if (LineStartsWith(&data[offset], length, "#EXT-X-BYTERANGE")) {
+                    item.mHasByteRange = true;
+                }
+            } else {
+                if (!haveSeqDelta) {
+                    int32_t seq = 0, previousSeq = 0;
+                    if (mMeta != NULL) {
+                        mMeta->findInt32("media-sequence", &seq);
+                    }
+                    if (previous->mMeta != NULL) {
+                        previous->mMeta->findInt32("media-sequence", &previousSeq);
+                    }
+                    seqDelta = seq - previousSeq;
+                    haveSeqDelta = true;
+                }
+
+                if (!item.mHasByteRange
+                        && reuseItem(previous, seqDelta, item.mHash)) {
+                    item = PendingItem();
+                    ++numReused;
+                } else {
+                    status_t err = parseItemLines(
+                            data, item.mLinesOffset, offsetLF,
+                            &item, &segmentRangeOffset);
+                    if (err != OK) {
+                        return err;
+                    }
+                }
+            }
 
-        if (line.empty()) {
             offset = offsetLF + 1;
+            ++lineNo;
             continue;
         }
 
+        AString line(&data[offset], length);
+
+        // ALOGI("#%s#", line.c_str());
+
         if (lineNo == 0 && line == "#EXTM3U") {
             mIsExtM3U = true;
         }
@@ -560,52 +975,18 @@ status_t AmM3UParser::parse(const void *_data, size_t size) {
                     return ERROR_MALFORMED;
                 }
                 err = parseMetaData(line, &mMeta, "media-sequence");
-            } else if (line.startsWith("#EXT-X-KEY")) {
-                if (mIsVariantPlaylist) {
-                    return ERROR_MALFORMED;
-                }
-                err = parseCipherInfo(line, &itemMeta, mBaseURI);
+            } else if (isItemLine && line.startsWith("#")) {
+                err = parseItemTag(line, &item, &segmentRangeOffset);
             } else if (line.startsWith("#EXT-X-ENDLIST")) {
                 mIsComplete = true;
             } else if (line.startsWith("#EXT-X-PLAYLIST-TYPE:EVENT")) {
                 mIsEvent = true;
-            } else if (line.startsWith("#EXTINF")) {
-                if (mIsVariantPlaylist) {
-                    return ERROR_MALFORMED;
-                }
-                err = parseMetaDataDuration(line, &itemMeta, "durationUs");
-            } else if (line.startsWith("#EXT-X-DISCONTINUITY")) {
-                if (mIsVariantPlaylist) {
-                    return ERROR_MALFORMED;
-                }
-                if (itemMeta == NULL) {
-                    itemMeta = new AMessage;
-                }
-                itemMeta->setInt32("discontinuity", true);
             } else if (line.startsWith("#EXT-X-STREAM-INF")) {
                 if (mMeta != NULL) {
                     return ERROR_MALFORMED;
                 }
                 mIsVariantPlaylist = true;
-                err = parseStreamInf(line, &itemMeta);
-            } else if (line.startsWith("#EXT-X-BYTERANGE")) {
-                if (mIsVariantPlaylist) {
-                    return ERROR_MALFORMED;
-                }
-
-                uint64_t length, offset;
-                err = parseByteRange(line, segmentRangeOffset, &length, &offset);
-
-                if (err == OK) {
-                    if (itemMeta == NULL) {
-                        itemMeta = new AMessage;
-                    }
-
-                    itemMeta->setInt64("range-offset", offset);
-                    itemMeta->setInt64("range-length", length);
-
-                    segmentRangeOffset = offset + length;
-                }
+                err = parseStreamInf(line, &item.mMeta);
             } else if (line.startsWith("#EXT-X-MEDIA")) {
                 err = parseMedia(line);
             } else if (line.startsWith("#EXT-X-DISCONTINUITY-SEQUENCE")) {
@@ -622,28 +1003,37 @@ status_t AmM3UParser::parse(const void *_data, size_t size) {
         }
 
         if (!line.startsWith("#")) {
-            if (!mIsVariantPlaylist) {
-                int64_t durationUs;
-                if (itemMeta == NULL
-                        || !itemMeta->findInt64("durationUs", &durationUs)) {
-                    return ERROR_MALFORMED;
-                }
+            status_t err = addItem(line, &item);
+            if (err != OK) {
+                return err;
             }
-
-            mItems.push();
-            Item *item = &mItems.editItemAt(mItems.size() - 1);
-
-            CHECK(MakeURL(mBaseURI.c_str(), line.c_str(), &item->mURI));
-
-            item->mMeta = itemMeta;
-
-            itemMeta.clear();
         }
 
         offset = offsetLF + 1;
         ++lineNo;
     }
 
+    if (appended) {
+        ALOGV("parsed %zu appended bytes, %zu items",
+              size - previous->mBodySize, mItemURIOffsets.size());
+        mBodyHash = HashBytes(previous->mBodyHash,
+                data + previous->mBodySize, size - previous->mBodySize);
+    } else {
+        if (deferItems) {
+            ALOGV("reused %zu of %zu items", numReused, mItemURIOffsets.size());
+        }
+        mBodyHash = HashBytes(kHashInit, data, size);
+    }
+
+    // Appending is only safe after a complete line that left no item
+    // half parsed.
+    mBodySize = size;
+    mNumLines = lineNo;
+    mEndRangeOffset = segmentRangeOffset;
+    mCanAppend = !mIsVariantPlaylist
+            && size > 0 && data[size - 1] == '\n'
+            && item.mHash == kHashInit && item.mMeta == NULL;
+
     return OK;
 }
 
@@ -673,7 +1063,7 @@ status_t AmM3UParser::parseMetaData(
 
 // static
 status_t AmM3UParser::parseMetaDataDuration(
-        const AString &line, sp<AMessage> *meta, const char *key) {
+        const AString &line, int64_t *durationUs) {
     ssize_t colonPos = line.find(":");
 
     if (colonPos < 0) {
@@ -687,10 +1077,7 @@ status_t AmM3UParser::parseMetaDataDuration(
         return err;
     }
 
-    if (meta->get() == NULL) {
-        *meta = new AMessage;
-    }
-    (*meta)->setInt64(key, (int64_t)(x * 1E6));
+    *durationUs = (int64_t)(x * 1E6);
 
     return OK;
 }
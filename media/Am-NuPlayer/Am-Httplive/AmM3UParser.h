@@ -27,7 +27,12 @@
 namespace android {
 
 struct AmM3UParser : public RefBase {
-    AmM3UParser(const char *baseURI, const void *data, size_t size);
+    // "previous" may be the last version of the same media playlist, the
+    // segments both have in common are then copied instead of parsed. If
+    // the new version only appends to it, only the new lines are parsed.
+    AmM3UParser(
+            const char *baseURI, const void *data, size_t size,
+            const sp<AmM3UParser> &previous = NULL);
 
     status_t initCheck() const;
 
@@ -42,6 +47,23 @@ struct AmM3UParser : public RefBase {
     size_t size();
     bool itemAt(size_t index, AString *uri, sp<AMessage> *meta = NULL);
 
+    // Shortcut for itemAt() that does not build the item meta, returns -1
+    // for items without EXTINF.
+    int64_t itemDurationUs(size_t index) const;
+
+    // Start of the item relative to the first one in the playlist. "index"
+    // may be size(), which gives the end of the last item.
+    int64_t itemStartTimeUs(size_t index) const;
+    int64_t getTotalDurationUs() const;
+
+    // Returns the index of the first item that ends after "timeUs", i.e.
+    // the one playing at that time, or size() if all end before it.
+    size_t findItemForTime(int64_t timeUs) const;
+
+    // Returns the EXT-X-KEY attributes in effect for the item, i.e. those
+    // of the closest item at or before "index" that has any, or NULL.
+    sp<AMessage> findCipherMeta(size_t index) const;
+
     void pickRandomMediaItems();
     status_t selectTrack(size_t index, bool select);
     size_t getTrackCount() const;
@@ -51,15 +73,18 @@ struct AmM3UParser : public RefBase {
 
     bool getTypeURI(size_t index, const char *key, AString *uri) const;
 
+    void dump(AString *out) const;
+
 protected:
     virtual ~AmM3UParser();
 
 private:
     struct MediaGroup;
 
-    struct Item {
-        AString mURI;
-        sp<AMessage> mMeta;
+    struct PendingItem;
+
+    enum ItemFlags {
+        kItemDiscontinuity = 1,
     };
 
     status_t mInitCheck;
@@ -72,19 +97,63 @@ private:
     size_t mDiscontinuitySeq;
 
     sp<AMessage> mMeta;
-    Vector<Item> mItems;
     ssize_t mSelectedIndex;
 
+    // The items, one entry per item in each of the vectors below. All
+    // URIs share mURIPool, NUL terminated. mItemStartTimesUs are the
+    // running sums of mItemDurationsUs. mItemMetas only holds what has
+    // no column of its own (EXT-X-KEY, EXT-X-STREAM-INF attributes) and
+    // is NULL for most segments. mItemHashes identify the playlist lines
+    // an item was parsed from, for reuse by the next refresh.
+    Vector<char> mURIPool;
+    Vector<size_t> mItemURIOffsets;
+    Vector<int64_t> mItemStartTimesUs;
+    Vector<int64_t> mItemDurationsUs;
+    Vector<int64_t> mItemRangeOffsets;
+    Vector<int64_t> mItemRangeLengths;
+    Vector<uint32_t> mItemFlags;
+    Vector<sp<AMessage> > mItemMetas;
+    Vector<uint64_t> mItemHashes;
+
     // Media groups keyed by group ID.
     KeyedVector<AString, sp<MediaGroup> > mMediaGroups;
 
-    status_t parse(const void *data, size_t size);
+    // What a refresh needs to tell whether it merely appends to this
+    // playlist and to pick up parsing where this one stopped.
+    size_t mBodySize;
+    uint64_t mBodyHash;
+    int32_t mNumLines;
+    uint64_t mEndRangeOffset;
+    bool mCanAppend;
+
+    status_t parse(
+            const void *data, size_t size, const sp<AmM3UParser> &previous);
+
+    bool appendsTo(
+            const sp<AmM3UParser> &previous,
+            const char *data, size_t size) const;
+    void copyFrom(const sp<AmM3UParser> &previous);
+
+    bool canReuseItems(
+            const sp<AmM3UParser> &previous,
+            const char *data, size_t size) const;
+    bool reuseItem(
+            const sp<AmM3UParser> &previous, int32_t seqDelta, uint64_t hash);
+
+    status_t parseItemTag(
+            const AString &line, PendingItem *item,
+            uint64_t *segmentRangeOffset);
+    status_t parseItemLines(
+            const char *data, size_t offset, size_t end,
+            PendingItem *item, uint64_t *segmentRangeOffset);
+    status_t addItem(const AString &line, PendingItem *item);
+    void pushItemTiming(int64_t durationUs);
 
     static status_t parseMetaData(
             const AString &line, sp<AMessage> *meta, const char *key);
 
     static status_t parseMetaDataDuration(
-            const AString &line, sp<AMessage> *meta, const char *key);
+            const AString &line, int64_t *durationUs);
 
     status_t parseStreamInf(
             const AString &line, sp<AMessage> *meta) const;
@@ -21,21 +21,25 @@
 
 #include "AmPlaylistFetcher.h"
 
+#include "AmABRController.h"
 #include "AmLiveDataSource.h"
 #include "AmHLSDataSource.h"
 #include "AmLiveSession.h"
 #include "AmM3UParser.h"
+#include "AmSegmentPrefetcher.h"
 
 #include "include/avc_utils.h"
 #include "include/HTTPBase.h"
 #include "include/ID3.h"
 #include "AmAnotherPacketSource.h"
+#include "AmSyncScan.h"
 
 #include <cutils/properties.h>
 #include <media/IStreamSource.h>
 #include <media/stagefright/foundation/ABitReader.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/FileSource.h>
 #include <media/stagefright/MediaDefs.h>
@@ -48,7 +52,7 @@
 
 #include <ctype.h>
 #include <inttypes.h>
-#include <openssl/aes.h>
+#include <openssl/evp.h>
 #include <openssl/md5.h>
 
 #include <curl/curl.h>
@@ -61,6 +65,11 @@ const int64_t AmPlaylistFetcher::kMinBufferedDurationUs = 10000000ll;
 const int64_t AmPlaylistFetcher::kMaxMonitorDelayUs = 3000000ll;
 // LCM of 188 (size of a TS packet) & 1k works well
 const int32_t AmPlaylistFetcher::kDownloadBlockSize = 47 * 1024;
+
+// Number of segments downloaded ahead of the current one in parallel.
+static const int32_t kDefaultPrefetchSegments = 2;
+// Expanded AES keys kept around, enough for every variant of a stream.
+static const size_t kMaxCipherContexts = 8;
 const int32_t AmPlaylistFetcher::kNumSkipFrames = 5;
 // use 12 frames to calculate frame rate
 const size_t  AmPlaylistFetcher::kFrameNum = 12;
@@ -110,6 +119,7 @@ AmPlaylistFetcher::AmPlaylistFetcher(
       mMonitorQueueGeneration(0),
       mSubtitleGeneration(subtitleGeneration),
       mRefreshState(INITIAL_MINIMUM_RELOAD_DELAY),
+      mTSProgram(AmATSParser::kAllPrograms),
       mExtractor(NULL),
       mAudioTrack(NULL),
       mVideoTrack(NULL),
@@ -119,7 +129,8 @@ AmPlaylistFetcher::AmPlaylistFetcher(
       mFirstPTSValid(false),
       mHasMetadata(false),
       mAbsoluteTimeAnchorUs(0ll),
-      mVideoBuffer(new AmAnotherPacketSource(NULL)) {
+      mVideoBuffer(new AmAnotherPacketSource(NULL)),
+      mCipherCtx(NULL) {
     memset(mPlaylistHash, 0, sizeof(mPlaylistHash));
     mStartTimeUsNotify->setInt32("what", kWhatStartedAt);
     mStartTimeUsNotify->setInt32("streamMask", 0);
@@ -137,12 +148,28 @@ AmPlaylistFetcher::AmPlaylistFetcher(
     if (property_get("media.hls.retry_timeover_s", value, "3600")) {
         mRetryTimeOverS = atoi(value);
     }
+    if (property_get("media.hls.ts-program", value, NULL)) {
+        mTSProgram = atoi(value);
+    }
+
+    int32_t prefetchSegments = kDefaultPrefetchSegments;
+    if (property_get("media.hls.prefetch-segments", value, NULL)) {
+        prefetchSegments = atoi(value);
+    }
+    if (prefetchSegments > 0) {
+        // Prefetched data never exceeds what we try to keep buffered anyway.
+        mPrefetcher = new AmSegmentPrefetcher(
+                session, prefetchSegments, kMinBufferedDurationUs);
+    }
 }
 
 AmPlaylistFetcher::~AmPlaylistFetcher() {
     if (mDumpHandle) {
         fclose(mDumpHandle);
     }
+    for (size_t i = 0; i < mCipherCtxForURI.size(); ++i) {
+        EVP_CIPHER_CTX_free(mCipherCtxForURI.valueAt(i));
+    }
 }
 
 int64_t AmPlaylistFetcher::getSegmentStartTimeUs(int32_t seqNumber) const {
@@ -165,20 +192,7 @@ int64_t AmPlaylistFetcher::getSegmentStartTimeUs(int32_t seqNumber) const {
     //CHECK_GE(seqNumber, firstSeqNumberInPlaylist);
     //CHECK_LE(seqNumber, lastSeqNumberInPlaylist);
 
-    int64_t segmentStartUs = 0ll;
-    for (int32_t index = 0;
-            index < seqNumber - firstSeqNumberInPlaylist; ++index) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(
-                    index, NULL /* uri */, &itemMeta));
-
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-        segmentStartUs += itemDurationUs;
-    }
-
-    return segmentStartUs;
+    return mPlaylist->itemStartTimeUs(seqNumber - firstSeqNumberInPlaylist);
 }
 
 int64_t AmPlaylistFetcher::getSeekedTimeUs() const {
@@ -209,11 +223,8 @@ int64_t AmPlaylistFetcher::delayUsToRefreshPlaylist() const {
         {
             size_t n = mPlaylist->size();
             if (n > 0) {
-                sp<AMessage> itemMeta;
-                CHECK(mPlaylist->itemAt(n - 1, NULL /* uri */, &itemMeta));
-
-                int64_t itemDurationUs;
-                CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
+                int64_t itemDurationUs = mPlaylist->itemDurationUs(n - 1);
+                CHECK_GE(itemDurationUs, 0ll);
 
                 minPlaylistAgeUs = itemDurationUs;
                 break;
@@ -252,21 +263,9 @@ int64_t AmPlaylistFetcher::delayUsToRefreshPlaylist() const {
 status_t AmPlaylistFetcher::decryptBuffer(
         size_t playlistIndex, const sp<ABuffer> &buffer,
         bool first) {
-    sp<AMessage> itemMeta;
-    bool found = false;
     AString method;
-
-    for (ssize_t i = playlistIndex; i >= 0; --i) {
-        AString uri;
-        CHECK(mPlaylist->itemAt(i, &uri, &itemMeta));
-
-        if (itemMeta->findString("cipher-method", &method)) {
-            found = true;
-            break;
-        }
-    }
-
-    if (!found) {
+    sp<AMessage> itemMeta = mPlaylist->findCipherMeta(playlistIndex);
+    if (itemMeta == NULL || !itemMeta->findString("cipher-method", &method)) {
         method = "NONE";
     }
     buffer->meta()->setString("cipher-method", method.c_str());
@@ -311,16 +310,45 @@ status_t AmPlaylistFetcher::decryptBuffer(
         mAESKeyForURI.add(keyURI, key);
     }
 
-    AES_KEY aes_key;
-    if (AES_set_decrypt_key(key->data(), 128, &aes_key) != 0) {
-        ALOGE("failed to set AES decryption key.");
-        return UNKNOWN_ERROR;
+    if (mCipherCtx == NULL || !(mCipherKeyURI == keyURI)) {
+        // Expand the key schedule only the first time a key is used, the
+        // IV is (re)set separately below.
+        mCipherCtx = NULL;
+        mCipherKeyURI.clear();
+
+        ssize_t ctxIndex = mCipherCtxForURI.indexOfKey(keyURI);
+        if (ctxIndex >= 0) {
+            mCipherCtx = mCipherCtxForURI.valueAt(ctxIndex);
+        } else {
+            if (mCipherCtxForURI.size() >= kMaxCipherContexts) {
+                // Rotating keys, the old ones will not come back.
+                for (size_t i = 0; i < mCipherCtxForURI.size(); ++i) {
+                    EVP_CIPHER_CTX_free(mCipherCtxForURI.valueAt(i));
+                }
+                mCipherCtxForURI.clear();
+            }
+
+            EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+            if (ctx == NULL
+                    || !EVP_DecryptInit_ex(
+                            ctx, EVP_aes_128_cbc(), NULL, key->data(), NULL)) {
+                ALOGE("failed to set AES decryption key.");
+                if (ctx != NULL) {
+                    EVP_CIPHER_CTX_free(ctx);
+                }
+                return UNKNOWN_ERROR;
+            }
+            // checkDecryptPadding strips the PKCS7 padding of the last block.
+            EVP_CIPHER_CTX_set_padding(ctx, 0);
+            mCipherCtxForURI.add(keyURI, ctx);
+            mCipherCtx = ctx;
+        }
+
+        mCipherKeyURI = keyURI;
+        first = true;
     }
 
     size_t n = buffer->size();
-    if (!n) {
-        return OK;
-    }
     CHECK(n % 16 == 0);
 
     if (first) {
@@ -357,9 +385,25 @@ status_t AmPlaylistFetcher::decryptBuffer(
         }
     }
 
-    AES_cbc_encrypt(
-            buffer->data(), buffer->data(), buffer->size(),
-            &aes_key, mAESInitVec, AES_DECRYPT);
+    // Set the IV even if there is nothing to decrypt yet, the next call
+    // continues the chain from here.
+    if (first && !EVP_DecryptInit_ex(mCipherCtx, NULL, NULL, NULL, mAESInitVec)) {
+        ALOGE("failed to set AES initialization vector.");
+        return UNKNOWN_ERROR;
+    }
+
+    if (!n) {
+        return OK;
+    }
+
+    int outLength;
+    if (!EVP_DecryptUpdate(
+                mCipherCtx, buffer->data(), &outLength,
+                buffer->data(), buffer->size())
+            || (size_t)outLength != n) {
+        ALOGE("failed to decrypt %zu bytes.", n);
+        return UNKNOWN_ERROR;
+    }
 
     return OK;
 }
@@ -665,6 +709,10 @@ void AmPlaylistFetcher::onStop(const sp<AMessage> &msg) {
 
     mPacketSources.clear();
     mStreamTypeMask = 0;
+
+    if (mPrefetcher != NULL) {
+        mPrefetcher->clear();
+    }
 }
 
 void AmPlaylistFetcher::onSeek(const sp<AMessage> &msg) {
@@ -704,6 +752,7 @@ void AmPlaylistFetcher::onSeek(const sp<AMessage> &msg) {
         }
         sp<AMessage> extra = new AMessage;
         extra->setInt64(IStreamListener::kKeyMediaTimeUs, 0);
+        Mutex::Autolock autoLock(mTSParserLock);
         mTSParser->signalDiscontinuity(AmATSParser::DISCONTINUITY_TIME, extra);
     }
     msg->findInt64("seekTimeUs", &mStartTimeUs);
@@ -887,7 +936,8 @@ status_t AmPlaylistFetcher::refreshPlaylist() {
         status_t err = OK;
         CFContext * cfc_handle = NULL;
         sp<AmM3UParser> playlist = mSession->fetchPlaylist(
-                mURI.c_str(), mPlaylistHash, &unchanged, err, &cfc_handle);
+                mURI.c_str(), mPlaylistHash, &unchanged, err, &cfc_handle,
+                false /* isMasterPlaylist */, mPlaylist);
         int httpCode = 0;
         if (cfc_handle) {
             httpCode = -cfc_handle->http_code;
@@ -925,6 +975,8 @@ status_t AmPlaylistFetcher::refreshPlaylist() {
             }
         } else {
             mRefreshState = INITIAL_MINIMUM_RELOAD_DELAY;
+
+            Mutex::Autolock autoLock(mPlaylistLock);
             mPlaylist = playlist;
         }
 
@@ -1129,8 +1181,16 @@ void AmPlaylistFetcher::onDownloadNext() {
 
     sp<DataSource> source;
     sp<ABuffer> buffer, tsBuffer;
-    // decrypt a junk buffer to prefetch key; since a session uses only one http connection,
-    // this avoids interleaved connections to the key and segment file.
+
+    // The whole segment if it was prefetched, handed out block by block
+    // below so decryption and extraction work the same as for a download.
+    sp<ABuffer> prefetched;
+    size_t prefetchedSize = 0;
+
+    // decrypt a junk buffer to prefetch key; the fetcher itself uses one http connection
+    // at a time, and the key is fetched before segment downloads of the prefetcher
+    // (one more connection each, up to media.hls.prefetch-segments) are scheduled, so
+    // the key request never queues behind them.
     {
         sp<ABuffer> junk = new ABuffer(16);
         junk->setRange(0, 16);
@@ -1142,10 +1202,25 @@ void AmPlaylistFetcher::onDownloadNext() {
         }
     }
 
+    if (mPrefetcher != NULL) {
+        mPrefetcher->discardBefore(mSeqNumber);
+
+        // Byte-range seeks below change the range, so fetch those directly.
+        if (!mSeeked && mPrefetcher->take(
+                    mSeqNumber, uri, range_offset, range_length, &prefetched)) {
+            prefetchedSize = prefetched->size();
+        }
+
+        schedulePrefetch(firstSeqNumberInPlaylist, lastSeqNumberInPlaylist);
+    }
+
     // block-wise download
     bool startup = mStartup;
     ssize_t bytesRead, total_size = 0;
     CFContext * cfc_handle = NULL;
+    // time spent in fetchFile only, parsing in between does not count
+    // against the connection.
+    int64_t fetchTimeUs = 0;
 
     FILE * dumpHandle = NULL;
     if (mDumpMode == 1 && !mDumpHandle) {
@@ -1212,8 +1287,22 @@ void AmPlaylistFetcher::onDownloadNext() {
 FETCH:
 
     do {
-        bytesRead = mSession->fetchFile(
-                uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize, &cfc_handle);
+        if (prefetched != NULL) {
+            if (buffer == NULL) {
+                buffer = prefetched;
+                buffer->setRange(0, 0);
+            }
+            bytesRead = prefetchedSize - buffer->size();
+            if (bytesRead > kDownloadBlockSize) {
+                bytesRead = kDownloadBlockSize;
+            }
+            buffer->setRange(0, buffer->size() + bytesRead);
+        } else {
+            int64_t fetchStartUs = ALooper::GetNowUs();
+            bytesRead = mSession->fetchFile(
+                    uri.c_str(), &buffer, range_offset, range_length, kDownloadBlockSize, &cfc_handle);
+            fetchTimeUs += ALooper::GetNowUs() - fetchStartUs;
+        }
 
         if (bytesRead > 0 && mDumpMode > 0) {
             if (mDumpMode == 1 && mDumpHandle) {
@@ -1369,6 +1458,7 @@ FETCH:
         if (err == -EAGAIN) {
             // starting sequence number too low/high
             if (mTSParser != NULL) {
+                Mutex::Autolock autoLock(mTSParserLock);
                 mTSParser.clear();
             } else if (mExtractor != NULL) {
                 mExtractor.clear();
@@ -1382,6 +1472,7 @@ FETCH:
         } else if (err == ERROR_MALFORMED) {
             // try to reset ts parser.
             if (mTSParser != NULL) {
+                Mutex::Autolock autoLock(mTSParserLock);
                 mTSParser.clear();
             } else if (mExtractor != NULL) {
                 mExtractor.clear();
@@ -1419,6 +1510,15 @@ FETCH:
         ALOGI("segment duration : %lld us, size : %d bytes, bytes per second : %lld", item_durationUs, total_size, mSegmentBytesPerSec);
     }
 
+    // prefetched segments were measured by the prefetcher already. The
+    // fetch time is taken as ending now, close enough to line it up with
+    // prefetches running at the same time.
+    if (total_size && prefetched == NULL) {
+        int64_t nowUs = ALooper::GetNowUs();
+        mSession->mABRController->addSegmentMeasurement(
+                total_size, nowUs - fetchTimeUs, nowUs, item_durationUs);
+    }
+
     if (mPlaylist->isComplete() && mSeqNumber == lastSeqNumberInPlaylist && !total_size) {
         ALOGE("Last segment is empty, need to notify EOS!");
         notifyError(ERROR_END_OF_STREAM);
@@ -1526,6 +1626,32 @@ FAIL:
     }
 }
 
+void AmPlaylistFetcher::schedulePrefetch(
+        int32_t firstSeqNumberInPlaylist, int32_t lastSeqNumberInPlaylist) {
+    for (int32_t seqNumber = mSeqNumber + 1;
+            seqNumber <= lastSeqNumberInPlaylist; ++seqNumber) {
+        AString uri;
+        sp<AMessage> itemMeta;
+        CHECK(mPlaylist->itemAt(
+                    seqNumber - firstSeqNumberInPlaylist, &uri, &itemMeta));
+
+        int64_t durationUs = 0;
+        itemMeta->findInt64("durationUs", &durationUs);
+
+        int64_t range_offset, range_length;
+        if (!itemMeta->findInt64("range-offset", &range_offset)
+                || !itemMeta->findInt64("range-length", &range_length)) {
+            range_offset = 0;
+            range_length = -1;
+        }
+
+        if (!mPrefetcher->schedule(
+                    seqNumber, uri, range_offset, range_length, durationUs)) {
+            break;
+        }
+    }
+}
+
 int32_t AmPlaylistFetcher::getSeqNumberWithAnchorTime(int64_t anchorTimeUs) const {
     int32_t firstSeqNumberInPlaylist, lastSeqNumberInPlaylist;
     if (mPlaylist->meta() == NULL
@@ -1534,16 +1660,16 @@ int32_t AmPlaylistFetcher::getSeqNumberWithAnchorTime(int64_t anchorTimeUs) cons
     }
     lastSeqNumberInPlaylist = firstSeqNumberInPlaylist + mPlaylist->size() - 1;
 
+    // Step back from the segment before mSeqNumber, one whole segment at a
+    // time, until anchorTimeUs no longer lies past mStartTimeUs.
     int32_t index = mSeqNumber - firstSeqNumberInPlaylist - 1;
-    while (index >= 0 && anchorTimeUs > mStartTimeUs) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(index, NULL /* uri */, &itemMeta));
-
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-        anchorTimeUs -= itemDurationUs;
-        --index;
+    if (index >= 0 && anchorTimeUs > mStartTimeUs) {
+        int64_t endUs = mPlaylist->itemStartTimeUs(index + 1);
+        int32_t firstKept =
+            mPlaylist->findItemForTime(endUs - anchorTimeUs + mStartTimeUs);
+        if (firstKept < index + 1) {
+            index = firstKept - 1;
+        }
     }
 
     int32_t newSeqNumber = firstSeqNumberInPlaylist + index + 1;
@@ -1593,24 +1719,7 @@ int32_t AmPlaylistFetcher::getSeqNumberForTime(int64_t timeUs) const {
         firstSeqNumberInPlaylist = 0;
     }
 
-    size_t index = 0;
-    int64_t segmentStartUs = 0;
-    while (index < mPlaylist->size()) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(
-                    index, NULL /* uri */, &itemMeta));
-
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-        if (timeUs < segmentStartUs + itemDurationUs) {
-            break;
-        }
-
-        segmentStartUs += itemDurationUs;
-        ++index;
-    }
-
+    size_t index = mPlaylist->findItemForTime(timeUs);
     if (index >= mPlaylist->size()) {
         index = mPlaylist->size() - 1;
     }
@@ -1646,8 +1755,16 @@ static status_t int64cmp(const int64_t *a, const int64_t *b )
 }
 
 size_t AmPlaylistFetcher::resyncTs(const uint8_t * data, size_t size) {
+    static const uint8_t kSyncByte = 0x47;
+
     size_t offset = 0;
     while (offset < size) {
+        ssize_t pos = AmFindAnyByte(&data[offset], size - offset, &kSyncByte, 1);
+        if (pos < 0) {
+            return size;
+        }
+        offset += pos;
+
         if (size - offset == 188 && data[offset] == 0x47) {
             ALOGI("[%s:%d] found ts sync byte!", __FUNCTION__, __LINE__);
             return offset;
@@ -1661,45 +1778,87 @@ size_t AmPlaylistFetcher::resyncTs(const uint8_t * data, size_t size) {
 }
 
 status_t AmPlaylistFetcher::extractAndQueueAccessUnitsFromTs(const sp<ABuffer> &buffer) {
-    if (mTSParser == NULL) {
-        // Use TS_TIMESTAMPS_ARE_ABSOLUTE so pts carry over between fetchers.
-        mTSParser = new AmATSParser(AmATSParser::TS_TIMESTAMPS_ARE_ABSOLUTE);
-    }
+    {
+        Mutex::Autolock autoLock(mTSParserLock);
 
-    if (mNextPTSTimeUs >= 0ll) {
-        sp<AMessage> extra = new AMessage;
-        // Since we are using absolute timestamps, signal an offset of 0 to prevent
-        // AmATSParser from skewing the timestamps of access units.
-        extra->setInt64(IStreamListener::kKeyMediaTimeUs, 0);
+        if (mTSParser == NULL) {
+            // Use TS_TIMESTAMPS_ARE_ABSOLUTE so pts carry over between fetchers.
+            mTSParser = new AmATSParser(AmATSParser::TS_TIMESTAMPS_ARE_ABSOLUTE);
+            // A program chosen up front is the only one ever reassembled.
+            mTSParser->selectProgram(mTSProgram);
+        }
 
-        mTSParser->signalDiscontinuity(
-                AmATSParser::DISCONTINUITY_TIME, extra);
+        if (mNextPTSTimeUs >= 0ll) {
+            sp<AMessage> extra = new AMessage;
+            // Since we are using absolute timestamps, signal an offset of 0 to prevent
+            // AmATSParser from skewing the timestamps of access units.
+            extra->setInt64(IStreamListener::kKeyMediaTimeUs, 0);
 
-        mAbsoluteTimeAnchorUs = mNextPTSTimeUs;
-        mNextPTSTimeUs = -1ll;
-        mFirstPTSValid = false;
-    }
+            mTSParser->signalDiscontinuity(
+                    AmATSParser::DISCONTINUITY_TIME, extra);
 
-    size_t offset = 0;
-    while (offset + 188 <= buffer->size()) {
-        status_t err = mTSParser->feedTSPacket(buffer->data() + offset, 188);
+            mAbsoluteTimeAnchorUs = mNextPTSTimeUs;
+            mNextPTSTimeUs = -1ll;
+            mFirstPTSValid = false;
+        }
 
-        if (err == BAD_VALUE) {
-            size_t sync_offset = resyncTs(buffer->data() + offset, buffer->size() - offset);
-            offset += sync_offset;
-            continue;
-        } else if (err != OK) {
-            return err;
+        size_t offset = 0;
+        while (offset + 188 <= buffer->size()) {
+            size_t numBytesParsed;
+            status_t err = mTSParser->feedTSPackets(
+                    buffer->data() + offset, buffer->size() - offset,
+                    &numBytesParsed);
+            offset += numBytesParsed;
+
+            if (err == BAD_VALUE) {
+                size_t sync_offset = resyncTs(buffer->data() + offset, buffer->size() - offset);
+                offset += sync_offset;
+                continue;
+            } else if (err != OK) {
+                return err;
+            }
         }
+        // setRange to indicate consumed bytes.
+        buffer->setRange(buffer->offset() + offset, buffer->size() - offset);
 
-        offset += 188;
+        selectTSProgram();
     }
-    // setRange to indicate consumed bytes.
-    buffer->setRange(buffer->offset() + offset, buffer->size() - offset);
 
     return queueAccessUnits();
 }
 
+// Segments carrying several programs (restreamed broadcasts) would have
+// the PES of every program reassembled, while queueAccessUnits() only
+// ever reads the sources of the first one. Stick to one program once the
+// PAT is known, the streams of the others are signalled EOS and dropped.
+void AmPlaylistFetcher::selectTSProgram() {
+    Vector<unsigned> programs;
+    mTSParser->getProgramNumbers(&programs);
+
+    unsigned selected = mTSParser->selectedProgram();
+    if (selected != AmATSParser::kAllPrograms) {
+        for (size_t i = 0; i < programs.size(); ++i) {
+            if (programs[i] == selected) {
+                return;
+            }
+        }
+
+        if (programs.empty()) {
+            return;
+        }
+
+        ALOGW("[%s:%d] program %u not in segment, playing program %u",
+                __FUNCTION__, __LINE__, selected, programs[0]);
+    } else if (programs.size() < 2) {
+        return;
+    } else {
+        ALOGI("[%s:%d] %zu programs in segment, playing program %u",
+                __FUNCTION__, __LINE__, programs.size(), programs[0]);
+    }
+
+    mTSParser->selectProgram(programs[0]);
+}
+
 status_t AmPlaylistFetcher::extractAndQueueAccessUnitsFromNonTs() {
     if (mNextPTSTimeUs >= 0ll) {
         sp<AMessage> extra = new AMessage;
@@ -2344,17 +2503,7 @@ status_t AmPlaylistFetcher::extractAndQueueAccessUnits(
 }
 
 void AmPlaylistFetcher::updateDuration() {
-    int64_t durationUs = 0ll;
-    for (size_t index = 0; index < mPlaylist->size(); ++index) {
-        sp<AMessage> itemMeta;
-        CHECK(mPlaylist->itemAt(
-                    index, NULL /* uri */, &itemMeta));
-
-        int64_t itemDurationUs;
-        CHECK(itemMeta->findInt64("durationUs", &itemDurationUs));
-
-        durationUs += itemDurationUs;
-    }
+    int64_t durationUs = mPlaylist->getTotalDurationUs();
 
     sp<AMessage> msg = mNotify->dup();
     msg->setInt32("what", kWhatDurationUpdate);
@@ -2395,5 +2544,24 @@ void AmPlaylistFetcher::setBufferingStatus(bool buffing) {
     mBuffering =  buffing;
 }
 
+void AmPlaylistFetcher::dump(AString *out) {
+    sp<AmM3UParser> playlist;
+    {
+        Mutex::Autolock autoLock(mPlaylistLock);
+        playlist = mPlaylist;
+    }
+
+    out->append(AStringPrintf(
+            "AmPlaylistFetcher: sequence number %d\n", mSeqNumber));
+    if (playlist != NULL) {
+        playlist->dump(out);
+    }
+
+    Mutex::Autolock autoLock(mTSParserLock);
+    if (mTSParser != NULL) {
+        mTSParser->dump(out);
+    }
+}
+
 
 }  // namespace android
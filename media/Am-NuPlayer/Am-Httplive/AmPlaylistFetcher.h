@@ -19,6 +19,8 @@
 #define PLAYLIST_FETCHER_H_
 
 #include <media/stagefright/foundation/AHandler.h>
+#include <openssl/base.h>
+#include <utils/threads.h>
 
 #include "AmATSParser.h"
 #include "AmLiveSession.h"
@@ -31,6 +33,7 @@ struct DataSource;
 struct HTTPBase;
 struct AmLiveDataSource;
 struct AmM3UParser;
+struct AmSegmentPrefetcher;
 struct MediaExtractor;
 struct MediaBuffer;
 struct String8;
@@ -100,6 +103,10 @@ struct AmPlaylistFetcher : public AHandler {
     int64_t getSeekedTimeUs() const;
 
     void setBufferingStatus(bool buffing) ;
+
+    // Appends the media playlist and the state of the TS parser (if any)
+    // to "out", safe to call from any thread.
+    void dump(AString *out);
 protected:
     virtual ~AmPlaylistFetcher();
     virtual void onMessageReceived(const sp<AMessage> &msg);
@@ -160,6 +167,10 @@ private:
     KeyedVector<AString, sp<ABuffer> > mAESKeyForURI;
 
     int64_t mLastPlaylistFetchTimeUs;
+
+    // Held by dump() and while mPlaylist is replaced, the fetcher's own
+    // reads need no lock.
+    Mutex mPlaylistLock;
     sp<AmM3UParser> mPlaylist;
     int32_t mSeqNumber;
     int32_t mDownloadedNum;
@@ -192,8 +203,18 @@ private:
 
     uint8_t mPlaylistHash[16];
 
+    // Guards mTSParser against dump() while the fetcher feeds or
+    // replaces it.
+    Mutex mTSParserLock;
     sp<AmATSParser> mTSParser;
 
+    // Program to play from multi-program segments (media.hls.ts-program),
+    // AmATSParser::kAllPrograms picks the first program of the PAT.
+    unsigned mTSProgram;
+
+    // NULL unless media.hls.prefetch-segments is > 0.
+    sp<AmSegmentPrefetcher> mPrefetcher;
+
     sp<MediaExtractor> mExtractor;
     sp<MediaSource> mAudioTrack;
     sp<MediaSource> mVideoTrack;
@@ -211,15 +232,24 @@ private:
     int64_t mAbsoluteTimeAnchorUs;
     sp<AmAnotherPacketSource> mVideoBuffer;
 
-    // Stores the initialization vector to decrypt the next block of cipher text, which can
-    // either be derived from the sequence number, read from the manifest, or copied from
-    // the last block of cipher text (cipher-block chaining).
+    // Stores the initialization vector of the current segment, which can
+    // either be derived from the sequence number or read from the manifest.
     unsigned char mAESInitVec[16];
 
+    // AES-128-CBC decryption contexts holding the expanded key schedule of
+    // each key URI, so switching back and forth between keys (e.g. between
+    // variants) does not expand them again. Goes through EVP so AES-NI/ARMv8
+    // crypto extensions are used when available. mCipherCtx is the one for
+    // mCipherKeyURI, it also carries the cipher-block chaining state from
+    // one downloaded block to the next.
+    KeyedVector<AString, EVP_CIPHER_CTX *> mCipherCtxForURI;
+    EVP_CIPHER_CTX *mCipherCtx;
+    AString mCipherKeyURI;
+
     // Set first to true if decrypting the first segment of a playlist segment. When
     // first is true, reset the initialization vector based on the available
-    // information in the manifest; otherwise, use the initialization vector as
-    // updated by the last call to AES_cbc_encrypt.
+    // information in the manifest; otherwise, continue the chain from the
+    // last block decrypted.
     //
     // For the input to decrypt correctly, decryptBuffer must be called on
     // consecutive byte ranges on block boundaries, e.g. 0..15, 16..47, 48..63,
@@ -229,6 +259,9 @@ private:
             bool first = true);
     status_t checkDecryptPadding(const sp<ABuffer> &buffer);
 
+    void schedulePrefetch(
+            int32_t firstSeqNumberInPlaylist, int32_t lastSeqNumberInPlaylist);
+
     void postMonitorQueue(int64_t delayUs = 0, int64_t minDelayUs = 0);
     void cancelMonitorQueue();
 
@@ -251,6 +284,7 @@ private:
             bool discard = false);
     size_t resyncTs(const uint8_t *data, size_t size);
     status_t extractAndQueueAccessUnitsFromTs(const sp<ABuffer> &buffer);
+    void selectTSProgram();
     status_t extractAndQueueAccessUnitsFromNonTs();
     status_t queueAccessUnits();
     status_t extractAndQueueAccessUnits(
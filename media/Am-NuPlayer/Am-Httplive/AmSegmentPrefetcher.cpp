@@ -0,0 +1,350 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "NU-SegmentPrefetcher"
+#include <utils/Log.h>
+
+#include "AmSegmentPrefetcher.h"
+
+#include "AmABRController.h"
+#include "AmLiveSession.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <utils/Thread.h>
+
+#include <inttypes.h>
+
+#include <curl/curl.h>
+#include "curl_fetch.h"
+
+namespace android {
+
+// Downloads are done block-wise, so a cancelled one stops soon even where
+// the HTTP layer does not poll the interrupt callback.
+static const uint32_t kPrefetchBlockSize = 47 * 1024;
+
+// take() waits at least this long for a running download.
+static const int64_t kMinTakeTimeoutUs = 2000000ll;
+
+struct AmSegmentPrefetcher::Entry : public RefBase {
+    enum State {
+        PENDING,
+        FETCHING,
+        DONE,
+        FAILED,
+    };
+
+    Entry()
+        : mSeqNumber(-1),
+          mRangeOffset(0),
+          mRangeLength(-1),
+          mDurationUs(0),
+          mState(PENDING),
+          mCancelled(false),
+          mInterruptCallback(NULL),
+          mParentThreadId(NULL) {
+    }
+
+    bool matches(
+            int32_t seqNumber, const AString &uri,
+            int64_t rangeOffset, int64_t rangeLength) const {
+        return mSeqNumber == seqNumber
+                && mRangeOffset == rangeOffset
+                && mRangeLength == rangeLength
+                && mURI == uri;
+    }
+
+    int32_t mSeqNumber;
+    AString mURI;
+    int64_t mRangeOffset;
+    int64_t mRangeLength;
+    int64_t mDurationUs;
+    State mState;
+    sp<ABuffer> mBuffer;
+
+    // Set under mLock, polled by InterruptCallback() while downloading.
+    volatile bool mCancelled;
+
+    // The session's interrupt, still honoured while downloading.
+    interruptcallback mInterruptCallback;
+    android_thread_id_t mParentThreadId;
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(Entry);
+};
+
+struct AmSegmentPrefetcher::WorkerThread : public Thread {
+    WorkerThread(AmSegmentPrefetcher *prefetcher)
+        : Thread(false /* canCallJava */),
+          mPrefetcher(prefetcher) {
+    }
+
+private:
+    AmSegmentPrefetcher *mPrefetcher;
+
+    virtual bool threadLoop() {
+        return mPrefetcher->threadLoop();
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(WorkerThread);
+};
+
+AmSegmentPrefetcher::AmSegmentPrefetcher(
+        const sp<AmLiveSession> &session,
+        size_t maxInFlight, int64_t maxBufferedDurationUs)
+    : mSession(session),
+      mMaxBufferedDurationUs(maxBufferedDurationUs),
+      mExiting(false) {
+    for (size_t i = 0; i < maxInFlight; ++i) {
+        sp<WorkerThread> worker = new WorkerThread(this);
+        worker->run("HLSPrefetch");
+        mWorkers.push(worker);
+    }
+}
+
+AmSegmentPrefetcher::~AmSegmentPrefetcher() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        mExiting = true;
+        for (size_t i = 0; i < mEntries.size(); ++i) {
+            cancel_l(mEntries.itemAt(i));
+        }
+        mEntries.clear();
+        mCondition.broadcast();
+    }
+
+    // Running downloads are cancelled, so this only waits for the workers
+    // to notice, not for whole segments.
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers.editItemAt(i)->requestExitAndWait();
+    }
+    mWorkers.clear();
+}
+
+// static
+int32_t AmSegmentPrefetcher::InterruptCallback(android_thread_id_t id) {
+    Entry *entry = static_cast<Entry *>(id);
+    if (entry->mCancelled) {
+        return 1;
+    }
+    // Not every session has an interrupt callback installed.
+    return entry->mInterruptCallback != NULL
+            ? entry->mInterruptCallback(entry->mParentThreadId) : 0;
+}
+
+void AmSegmentPrefetcher::cancel_l(const sp<Entry> &entry) {
+    if (entry->mState == Entry::FETCHING) {
+        ALOGV("cancelling download of segment %d", entry->mSeqNumber);
+    }
+    entry->mCancelled = true;
+}
+
+int64_t AmSegmentPrefetcher::bufferedDurationUs_l() const {
+    int64_t durationUs = 0;
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        durationUs += mEntries.itemAt(i)->mDurationUs;
+    }
+    return durationUs;
+}
+
+bool AmSegmentPrefetcher::schedule(
+        int32_t seqNumber, const AString &uri,
+        int64_t rangeOffset, int64_t rangeLength, int64_t durationUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        if (mEntries.itemAt(i)->matches(seqNumber, uri, rangeOffset, rangeLength)) {
+            return true;
+        }
+    }
+
+    if (bufferedDurationUs_l() + durationUs > mMaxBufferedDurationUs) {
+        return false;
+    }
+
+    sp<Entry> entry = new Entry;
+    entry->mSeqNumber = seqNumber;
+    entry->mURI = uri;
+    entry->mRangeOffset = rangeOffset;
+    entry->mRangeLength = rangeLength;
+    entry->mDurationUs = durationUs;
+    mEntries.push(entry);
+
+    ALOGV("scheduled segment %d", seqNumber);
+    mCondition.broadcast();
+
+    return true;
+}
+
+bool AmSegmentPrefetcher::take(
+        int32_t seqNumber, const AString &uri,
+        int64_t rangeOffset, int64_t rangeLength, sp<ABuffer> *buffer) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        sp<Entry> entry = mEntries.itemAt(i);
+        if (!entry->matches(seqNumber, uri, rangeOffset, rangeLength)) {
+            continue;
+        }
+
+        // A running download is further along than a new request would be,
+        // unless it stalls for longer than the segment lasts.
+        int64_t timeoutUs = entry->mDurationUs > kMinTakeTimeoutUs
+                ? entry->mDurationUs : kMinTakeTimeoutUs;
+        int64_t deadlineUs = ALooper::GetNowUs() + timeoutUs;
+        while (entry->mState == Entry::FETCHING && !mExiting) {
+            int64_t waitUs = deadlineUs - ALooper::GetNowUs();
+            if (waitUs <= 0) {
+                ALOGW("prefetch of segment %d timed out", seqNumber);
+                cancel_l(entry);
+                break;
+            }
+            mCondition.waitRelative(mLock, waitUs * 1000ll);
+        }
+
+        // Entries may have been dropped while we were waiting.
+        for (size_t j = 0; j < mEntries.size(); ++j) {
+            if (mEntries.itemAt(j) == entry) {
+                mEntries.removeAt(j);
+                break;
+            }
+        }
+
+        if (entry->mState != Entry::DONE) {
+            return false;
+        }
+
+        ALOGV("segment %d was prefetched (%zu bytes)",
+              seqNumber, entry->mBuffer->size());
+
+        *buffer = entry->mBuffer;
+        return true;
+    }
+
+    return false;
+}
+
+void AmSegmentPrefetcher::discardBefore(int32_t seqNumber) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = mEntries.size(); i-- > 0;) {
+        if (mEntries.itemAt(i)->mSeqNumber < seqNumber) {
+            cancel_l(mEntries.itemAt(i));
+            mEntries.removeAt(i);
+        }
+    }
+}
+
+void AmSegmentPrefetcher::clear() {
+    Mutex::Autolock autoLock(mLock);
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+        cancel_l(mEntries.itemAt(i));
+    }
+    mEntries.clear();
+}
+
+bool AmSegmentPrefetcher::threadLoop() {
+    sp<Entry> entry;
+    {
+        Mutex::Autolock autoLock(mLock);
+
+        for (;;) {
+            if (mExiting) {
+                return false;
+            }
+
+            for (size_t i = 0; i < mEntries.size(); ++i) {
+                if (mEntries.itemAt(i)->mState == Entry::PENDING) {
+                    entry = mEntries.itemAt(i);
+                    break;
+                }
+            }
+
+            if (entry != NULL) {
+                break;
+            }
+
+            mCondition.wait(mLock);
+        }
+
+        entry->mState = Entry::FETCHING;
+    }
+
+    sp<AmLiveSession> session = mSession.promote();
+    if (session == NULL) {
+        Mutex::Autolock autoLock(mLock);
+        entry->mState = Entry::FAILED;
+        mCondition.broadcast();
+        return true;
+    }
+
+    entry->mInterruptCallback = session->mInterruptCallback;
+    entry->mParentThreadId = session->mParentThreadId;
+
+    int64_t startUs = ALooper::GetNowUs();
+
+    // Same read loop as AmPlaylistFetcher::onDownloadNext: fetchFile
+    // returns 0 once the whole range is in.
+    sp<ABuffer> buffer;
+    CFContext *cfc = NULL;
+    bool interruptRegistered = false;
+    ssize_t bytesRead;
+    do {
+        bytesRead = session->fetchFile(
+                entry->mURI.c_str(), &buffer,
+                entry->mRangeOffset, entry->mRangeLength,
+                kPrefetchBlockSize, &cfc);
+
+        if (cfc != NULL && !interruptRegistered) {
+            // From now on the HTTP layer also gives up on a blocked read
+            // once the entry is cancelled.
+            curl_fetch_register_interrupt_pid(cfc, InterruptCallback);
+            curl_fetch_set_parent_pid(cfc, entry.get());
+            interruptRegistered = true;
+        }
+    } while (bytesRead > 0 && !entry->mCancelled);
+
+    // Closing the handle drops the connection of a cancelled download.
+    if (cfc) {
+        curl_fetch_close(cfc);
+    }
+
+    // fetchFile also stops early when the session is shutting down or the
+    // entry was cancelled, do not mistake the partial data for a complete
+    // segment.
+    bool interrupted = entry->mCancelled || session->mNeedExit
+            || (session->mInterruptCallback != NULL
+                    && session->mInterruptCallback(session->mParentThreadId));
+
+    if (bytesRead == 0 && buffer != NULL && !interrupted) {
+        session->mABRController->addSegmentMeasurement(
+                buffer->size(), startUs, ALooper::GetNowUs(),
+                entry->mDurationUs);
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    if (bytesRead == 0 && buffer != NULL && !interrupted) {
+        ALOGV("prefetched segment %d, %zu bytes in %" PRId64 " us",
+              entry->mSeqNumber, buffer->size(),
+              ALooper::GetNowUs() - startUs);
+        entry->mBuffer = buffer;
+        entry->mState = Entry::DONE;
+    } else if (entry->mCancelled) {
+        ALOGV("prefetching segment %d cancelled", entry->mSeqNumber);
+        entry->mState = Entry::FAILED;
+    } else {
+        ALOGW("prefetching segment %d failed (%zd)",
+              entry->mSeqNumber, bytesRead);
+        entry->mState = Entry::FAILED;
+    }
+    mCondition.broadcast();
+
+    return true;
+}
+
+}  // namespace android
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+#ifndef SEGMENT_PREFETCHER_H_
+
+#define SEGMENT_PREFETCHER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+#include <utils/threads.h>
+
+namespace android {
+
+struct ABuffer;
+struct AmLiveSession;
+
+// Downloads the segments following the one a AmPlaylistFetcher is working
+// on, so their time to first byte overlaps with the current download.
+// Up to "maxInFlight" segments are downloaded at the same time, and no
+// more segments are scheduled once the prefetched ones (downloading or
+// done) cover "maxBufferedDurationUs".
+// Only holds a weak reference to the session, which owns the fetcher
+// that owns this object.
+struct AmSegmentPrefetcher : public RefBase {
+    AmSegmentPrefetcher(
+            const sp<AmLiveSession> &session,
+            size_t maxInFlight, int64_t maxBufferedDurationUs);
+
+    // Queues the segment for download unless it is already known or the
+    // duration budget is used up. Returns false in the latter case, so the
+    // caller can stop scheduling further segments.
+    bool schedule(
+            int32_t seqNumber, const AString &uri,
+            int64_t rangeOffset, int64_t rangeLength, int64_t durationUs);
+
+    // Hands out the complete segment if it was prefetched. Waits for a
+    // download that is already running, for at most the segment duration
+    // (after which the download is cancelled), returns false if the segment
+    // was never scheduled, has not been started yet, failed or timed out.
+    bool take(
+            int32_t seqNumber, const AString &uri,
+            int64_t rangeOffset, int64_t rangeLength, sp<ABuffer> *buffer);
+
+    // Drops all segments before "seqNumber", e.g. after a seek. Running
+    // downloads of dropped segments are cancelled.
+    void discardBefore(int32_t seqNumber);
+
+    void clear();
+
+protected:
+    virtual ~AmSegmentPrefetcher();
+
+private:
+    struct Entry;
+    struct WorkerThread;
+
+    wp<AmLiveSession> mSession;
+    int64_t mMaxBufferedDurationUs;
+
+    Mutex mLock;
+    Condition mCondition;
+    Vector<sp<Entry> > mEntries;
+    Vector<sp<WorkerThread> > mWorkers;
+    bool mExiting;
+
+    int64_t bufferedDurationUs_l() const;
+    void cancel_l(const sp<Entry> &entry);
+    bool threadLoop();
+
+    static int32_t InterruptCallback(android_thread_id_t id);
+
+    DISALLOW_EVIL_CONSTRUCTORS(AmSegmentPrefetcher);
+};
+
+}  // namespace android
+
+#endif  // SEGMENT_PREFETCHER_H_
@@ -0,0 +1,465 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Runs AmSegmentPrefetcher against a local HTTP server that holds back
+// the first byte of every response for a while, like a far away CDN:
+// - segments come back whole and in order, and with several downloads in
+//   flight the wait for time to first byte overlaps, compared against a
+//   single one in flight;
+// - the duration budget stops scheduling;
+// - take() gives up on a stalled download after its timeout;
+// - discardBefore() and the destructor cancel stalled downloads quickly;
+// - the session interrupt callback stops running downloads.
+//
+// usage: amsegmentprefetchertest [-l latency_ms] [-n segments] [-p parallel]
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AmSegmentPrefetcherTest"
+#include <utils/Log.h>
+
+#include "AmLiveSession.h"
+#include "AmSegmentPrefetcher.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace android {
+
+static const size_t kSegmentSize = 256 * 1024;
+static const int64_t kSegmentDurationUs = 4000000ll;
+
+// Responses for "/stall..." never start within a test.
+static const int64_t kStallUs = 30000000ll;
+
+static uint8_t SegmentByte(int32_t seqNumber, size_t offset) {
+    return (uint8_t)(seqNumber * 131 + offset * 7 + (offset >> 9));
+}
+
+// Serves "/seg<N>.ts" after "latencyUs", "/stall<N>.ts" after kStallUs or
+// when stopped, one thread per connection.
+struct LatencyServer {
+    LatencyServer(int64_t latencyUs)
+        : mLatencyUs(latencyUs),
+          mSocket(-1),
+          mPort(0),
+          mStopping(false),
+          mNumRequests(0) {
+        pthread_mutex_init(&mLock, NULL);
+    }
+
+    ~LatencyServer() {
+        stop();
+        pthread_mutex_destroy(&mLock);
+    }
+
+    bool start() {
+        mSocket = socket(AF_INET, SOCK_STREAM, 0);
+        if (mSocket < 0) {
+            return false;
+        }
+
+        int on = 1;
+        setsockopt(mSocket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t addrLen = sizeof(addr);
+        if (bind(mSocket, (struct sockaddr *)&addr, sizeof(addr)) < 0
+                || listen(mSocket, 16) < 0
+                || getsockname(mSocket, (struct sockaddr *)&addr, &addrLen) < 0) {
+            close(mSocket);
+            mSocket = -1;
+            return false;
+        }
+        mPort = ntohs(addr.sin_port);
+
+        return pthread_create(&mThread, NULL, AcceptLoop, this) == 0;
+    }
+
+    void stop() {
+        if (mSocket < 0) {
+            return;
+        }
+        mStopping = true;
+        shutdown(mSocket, SHUT_RDWR);
+        pthread_join(mThread, NULL);
+        close(mSocket);
+        mSocket = -1;
+    }
+
+    AString uri(const char *name, int32_t seqNumber) const {
+        return AStringPrintf("http://127.0.0.1:%d/%s%d.ts", mPort, name, seqNumber);
+    }
+
+    int numRequests() {
+        pthread_mutex_lock(&mLock);
+        int n = mNumRequests;
+        pthread_mutex_unlock(&mLock);
+        return n;
+    }
+
+private:
+    struct Connection {
+        LatencyServer *mServer;
+        int mSocket;
+    };
+
+    int64_t mLatencyUs;
+    int mSocket;
+    int mPort;
+    volatile bool mStopping;
+    pthread_t mThread;
+    pthread_mutex_t mLock;
+    int mNumRequests;
+
+    static void *AcceptLoop(void *me) {
+        LatencyServer *server = static_cast<LatencyServer *>(me);
+        while (!server->mStopping) {
+            int s = accept(server->mSocket, NULL, NULL);
+            if (s < 0) {
+                continue;
+            }
+
+            Connection *connection = new Connection;
+            connection->mServer = server;
+            connection->mSocket = s;
+
+            pthread_t thread;
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+            if (pthread_create(&thread, &attr, Serve, connection) != 0) {
+                close(s);
+                delete connection;
+            }
+            pthread_attr_destroy(&attr);
+        }
+        return NULL;
+    }
+
+    // Sleeps up to "us", returns false if the server stops first.
+    bool wait(int64_t us) {
+        int64_t deadlineUs = ALooper::GetNowUs() + us;
+        while (!mStopping) {
+            int64_t leftUs = deadlineUs - ALooper::GetNowUs();
+            if (leftUs <= 0) {
+                return true;
+            }
+            usleep(leftUs < 10000 ? leftUs : 10000);
+        }
+        return false;
+    }
+
+    static bool SendAll(int s, const void *data, size_t size) {
+        const uint8_t *p = (const uint8_t *)data;
+        while (size > 0) {
+            ssize_t n = send(s, p, size, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            p += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    static void *Serve(void *me) {
+        Connection *connection = static_cast<Connection *>(me);
+        LatencyServer *server = connection->mServer;
+        int s = connection->mSocket;
+        delete connection;
+
+        char request[4096];
+        size_t size = 0;
+        while (size + 1 < sizeof(request)) {
+            ssize_t n = recv(s, request + size, sizeof(request) - 1 - size, 0);
+            if (n <= 0) {
+                break;
+            }
+            size += n;
+            request[size] = '\0';
+            if (strstr(request, "\r\n\r\n") != NULL) {
+                break;
+            }
+        }
+        request[size] = '\0';
+
+        pthread_mutex_lock(&server->mLock);
+        ++server->mNumRequests;
+        pthread_mutex_unlock(&server->mLock);
+
+        char name[16];
+        int seqNumber;
+        bool head = !strncmp(request, "HEAD ", 5);
+        const char *path = strchr(request, '/');
+        if (path == NULL || sscanf(path, "/%15[a-z]%d.ts", name, &seqNumber) != 2) {
+            const char *notFound = "HTTP/1.1 404 Not Found\r\n"
+                    "Content-Length: 0\r\nConnection: close\r\n\r\n";
+            SendAll(s, notFound, strlen(notFound));
+            close(s);
+            return NULL;
+        }
+
+        int64_t latencyUs = !strcmp(name, "stall") ? kStallUs : server->mLatencyUs;
+        if (server->wait(latencyUs)) {
+            char header[256];
+            snprintf(header, sizeof(header),
+                     "HTTP/1.1 200 OK\r\n"
+                     "Content-Type: video/mp2t\r\n"
+                     "Content-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n", kSegmentSize);
+            bool ok = SendAll(s, header, strlen(header));
+
+            uint8_t block[16384];
+            for (size_t offset = 0; ok && !head && offset < kSegmentSize;
+                    offset += sizeof(block)) {
+                for (size_t i = 0; i < sizeof(block); ++i) {
+                    block[i] = SegmentByte(seqNumber, offset + i);
+                }
+                ok = SendAll(s, block, sizeof(block));
+            }
+        }
+
+        close(s);
+        return NULL;
+    }
+};
+
+static volatile int32_t gInterrupt = 0;
+
+static int32_t Interrupt(android_thread_id_t /* id */) {
+    return gInterrupt;
+}
+
+static sp<AmLiveSession> MakeSession() {
+    sp<AmLiveSession> session =
+        new AmLiveSession(new AMessage, 0 /* flags */, NULL, Interrupt);
+    session->setParentThreadId(NULL);
+    return session;
+}
+
+static bool CheckSegment(int32_t seqNumber, const sp<ABuffer> &buffer) {
+    if (buffer->size() != kSegmentSize) {
+        fprintf(stderr, "segment %d: %zu bytes, expected %zu\n",
+                seqNumber, buffer->size(), kSegmentSize);
+        return false;
+    }
+    for (size_t i = 0; i < kSegmentSize; ++i) {
+        if (buffer->data()[i] != SegmentByte(seqNumber, i)) {
+            fprintf(stderr, "segment %d: wrong byte at %zu\n", seqNumber, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool Report(const char *name, bool ok, const char *detail) {
+    printf("%s %-12s %s\n", ok ? "ok  " : "FAIL", name, detail);
+    return ok;
+}
+
+// Schedules "numSegments" at once and takes them in order, as a fetcher
+// does. Returns how long it took, or -1 if a segment was missing.
+static int64_t FetchAll(
+        LatencyServer *server, size_t maxInFlight, int numSegments) {
+    sp<AmLiveSession> session = MakeSession();
+    sp<AmSegmentPrefetcher> prefetcher = new AmSegmentPrefetcher(
+            session, maxInFlight, numSegments * kSegmentDurationUs);
+
+    int64_t startUs = ALooper::GetNowUs();
+    for (int32_t i = 0; i < numSegments; ++i) {
+        prefetcher->schedule(i, server->uri("seg", i), 0, -1, kSegmentDurationUs);
+    }
+
+    for (int32_t i = 0; i < numSegments; ++i) {
+        sp<ABuffer> buffer;
+        if (!prefetcher->take(i, server->uri("seg", i), 0, -1, &buffer)) {
+            fprintf(stderr, "segment %d was not prefetched\n", i);
+            return -1;
+        }
+        if (!CheckSegment(i, buffer)) {
+            return -1;
+        }
+    }
+    return ALooper::GetNowUs() - startUs;
+}
+
+static bool TestOverlap(
+        LatencyServer *server, int64_t latencyUs, size_t parallel, int numSegments) {
+    int64_t serialUs = FetchAll(server, 1, numSegments);
+    int64_t parallelUs = FetchAll(server, parallel, numSegments);
+
+    // One in flight pays the latency for every segment, "parallel" of them
+    // once per batch, the transfers themselves are quick on loopback.
+    int64_t batches = (numSegments + parallel - 1) / parallel;
+    bool ok = serialUs >= numSegments * latencyUs
+            && parallelUs >= 0
+            && parallelUs < batches * latencyUs + numSegments * latencyUs / 4;
+
+    AString detail = AStringPrintf(
+            "%d segments, %" PRId64 " ms latency: 1 in flight %" PRId64 " ms, "
+            "%zu in flight %" PRId64 " ms",
+            numSegments, latencyUs / 1000, serialUs / 1000,
+            parallel, parallelUs / 1000);
+    return Report("overlap", ok, detail.c_str());
+}
+
+static bool TestBudget(LatencyServer *server) {
+    sp<AmLiveSession> session = MakeSession();
+    sp<AmSegmentPrefetcher> prefetcher = new AmSegmentPrefetcher(
+            session, 1, 3 * kSegmentDurationUs);
+
+    int scheduled = 0;
+    for (int32_t i = 0; i < 6; ++i) {
+        if (!prefetcher->schedule(
+                    i, server->uri("stall", i), 0, -1, kSegmentDurationUs)) {
+            break;
+        }
+        ++scheduled;
+    }
+
+    // Scheduling the same segment again is not an error.
+    bool again = prefetcher->schedule(
+            0, server->uri("stall", 0), 0, -1, kSegmentDurationUs);
+
+    AString detail = AStringPrintf("%d of 6 scheduled with a 3 segment budget", scheduled);
+    return Report("budget", scheduled == 3 && again, detail.c_str());
+}
+
+static bool TestTakeTimeout(LatencyServer *server) {
+    sp<AmLiveSession> session = MakeSession();
+    sp<AmSegmentPrefetcher> prefetcher = new AmSegmentPrefetcher(
+            session, 1, kSegmentDurationUs);
+
+    // Shorter than the minimum wait of take(), which applies then.
+    int64_t durationUs = 500000ll;
+    prefetcher->schedule(0, server->uri("stall", 0), 0, -1, durationUs);
+    usleep(200000);
+
+    int64_t startUs = ALooper::GetNowUs();
+    sp<ABuffer> buffer;
+    bool taken = prefetcher->take(0, server->uri("stall", 0), 0, -1, &buffer);
+    int64_t waitedUs = ALooper::GetNowUs() - startUs;
+
+    AString detail = AStringPrintf("gave up after %" PRId64 " ms", waitedUs / 1000);
+    return Report("take-timeout",
+                  !taken && waitedUs >= 1500000ll && waitedUs < 4000000ll,
+                  detail.c_str());
+}
+
+static bool TestCancel(LatencyServer *server) {
+    sp<AmLiveSession> session = MakeSession();
+    sp<AmSegmentPrefetcher> prefetcher = new AmSegmentPrefetcher(
+            session, 3, 6 * kSegmentDurationUs);
+
+    for (int32_t i = 0; i < 3; ++i) {
+        prefetcher->schedule(i, server->uri("stall", i), 0, -1, kSegmentDurationUs);
+    }
+    usleep(300000);
+
+    // Dropped segments are not handed out, the others still are.
+    prefetcher->discardBefore(2);
+    sp<ABuffer> buffer;
+    bool dropped = !prefetcher->take(0, server->uri("stall", 0), 0, -1, &buffer);
+
+    int64_t startUs = ALooper::GetNowUs();
+    prefetcher.clear();
+    int64_t destroyUs = ALooper::GetNowUs() - startUs;
+
+    AString detail = AStringPrintf(
+            "stalled downloads stopped in %" PRId64 " ms", destroyUs / 1000);
+    return Report("cancel", dropped && destroyUs < 1500000ll, detail.c_str());
+}
+
+static bool TestInterrupt(LatencyServer *server) {
+    sp<AmLiveSession> session = MakeSession();
+    sp<AmSegmentPrefetcher> prefetcher = new AmSegmentPrefetcher(
+            session, 1, kSegmentDurationUs);
+
+    prefetcher->schedule(0, server->uri("stall", 0), 0, -1, kSegmentDurationUs);
+    usleep(300000);
+
+    int64_t startUs = ALooper::GetNowUs();
+    gInterrupt = 1;
+    sp<ABuffer> buffer;
+    bool taken = prefetcher->take(0, server->uri("stall", 0), 0, -1, &buffer);
+    int64_t waitedUs = ALooper::GetNowUs() - startUs;
+    gInterrupt = 0;
+
+    AString detail = AStringPrintf("stopped after %" PRId64 " ms", waitedUs / 1000);
+    return Report("interrupt", !taken && waitedUs < 1500000ll, detail.c_str());
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-l latency_ms] [-n segments] [-p parallel]\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int64_t latencyUs = 300000ll;
+    int numSegments = 8;
+    int parallel = 3;
+
+    int res;
+    while ((res = getopt(argc, argv, "l:n:p:h")) >= 0) {
+        switch (res) {
+            case 'l':
+                latencyUs = atoi(optarg) * 1000ll;
+                break;
+            case 'n':
+                numSegments = atoi(optarg);
+                break;
+            case 'p':
+                parallel = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    if (argc != optind || latencyUs <= 0 || numSegments <= 0 || parallel <= 1) {
+        usage(me);
+    }
+
+    LatencyServer server(latencyUs);
+    if (!server.start()) {
+        fprintf(stderr, "unable to start the HTTP server\n");
+        return 1;
+    }
+
+    int result = 0;
+    if (!TestOverlap(&server, latencyUs, parallel, numSegments)
+            | !TestBudget(&server)
+            | !TestTakeTimeout(&server)
+            | !TestCancel(&server)
+            | !TestInterrupt(&server)) {
+        result = 1;
+    }
+
+    printf("%d requests served\n", server.numRequests());
+    server.stop();
+
+    return result;
+}
@@ -3,11 +3,13 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:=               \
+        AmABRController.cpp       \
         AmLiveDataSource.cpp      \
         AmHLSDataSource.cpp       \
         AmLiveSession.cpp         \
         AmM3UParser.cpp           \
         AmPlaylistFetcher.cpp     \
+        AmSegmentPrefetcher.cpp   \
         StreamSniffer.cpp
 
 LOCAL_C_INCLUDES:= \
@@ -27,3 +29,78 @@ ifeq ($(TARGET_ARCH),arm)
 endif
 
 include $(BUILD_STATIC_LIBRARY)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        AmABRSimulator.cpp        \
+        AmABRController.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+        libutils \
+        liblog
+
+LOCAL_MODULE:= amabrsimulator
+
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        AmDecryptBench.cpp
+
+LOCAL_C_INCLUDES:= \
+	$(TOP)/external/boringssl/src/include
+
+LOCAL_SHARED_LIBRARIES := \
+        libcrypto
+
+LOCAL_MODULE:= amdecryptbench
+
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=               \
+        AmSegmentPrefetcherTest.cpp
+
+LOCAL_C_INCLUDES:= \
+	$(TOP)/frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax \
+    $(TOP)/vendor/amlogic/frameworks/av/media/Am-NuPlayer/Am-mpeg2ts \
+
+LOCAL_SHARED_LIBRARIES := \
+        libbinder \
+        libcrypto \
+        libcutils \
+        libmedia \
+        libstagefright \
+        libstagefright_foundation \
+        libutils \
+        liblog \
+        libamffmpeg \
+        libcurl \
+        libamavutils
+
+LOCAL_STATIC_LIBRARIES := \
+        libamhttplive \
+        libammpeg2ts \
+        libstagefright_hevcutils \
+        libcurl_base \
+        libcurl_common
+
+LOCAL_MODULE:= amsegmentprefetchertest
+
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
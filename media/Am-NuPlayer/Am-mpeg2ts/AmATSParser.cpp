@@ -29,6 +29,7 @@
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
@@ -47,17 +48,17 @@ namespace android {
 
 static const size_t kTSPacketSize = 188;
 
+struct StreamInfo {
+    unsigned mType;
+    unsigned mPID;
+};
+
 struct AmATSParser::Program : public RefBase {
     Program(AmATSParser *parser, unsigned programNumber, unsigned programMapPID);
 
     bool parsePSISection(
             unsigned pid, ABitReader *br, status_t *err);
 
-    bool parsePID(
-            unsigned pid, unsigned continuity_counter,
-            unsigned payload_unit_start_indicator,
-            ABitReader *br, status_t *err, unsigned LastPESLength);
-
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -82,10 +83,29 @@ struct AmATSParser::Program : public RefBase {
         return mProgramMapPID;
     }
 
+    unsigned PCRPID() const {
+        return mPCR_PID;
+    }
+
+    // A program that is not selected keeps track of its PMT but has no
+    // streams, so its elementary PIDs never reach the PID table.
+    void setSelected(bool selected);
+
+    void dump(AString *out) const;
+
+    size_t countStreams() const { return mStreams.size(); }
+    const sp<Stream> &streamAt(size_t index) const {
+        return mStreams.valueAt(index);
+    }
+
     uint32_t parserFlags() const {
         return mParser->mFlags;
     }
 
+    const sp<BufferPool> &bufferPool() const {
+        return mParser->mBufferPool;
+    }
+
 private:
     AmATSParser *mParser;
     unsigned mProgramNumber;
@@ -94,7 +114,12 @@ private:
     bool mFirstPTSValid;
     uint64_t mFirstPTS;
 
+    // From the most recent PMT.
+    Vector<StreamInfo> mStreamInfos;
+    unsigned mPCR_PID;
+
     status_t parseProgramMap(ABitReader *br);
+    void createStreams();
     unsigned checkStreamType(unsigned type);
 
     DISALLOW_EVIL_CONSTRUCTORS(Program);
@@ -126,6 +151,8 @@ struct AmATSParser::Stream : public RefBase {
     bool isVideo() const;
     bool isMeta() const;
 
+    void dump(AString *out) const;
+
 protected:
     virtual ~Stream();
 
@@ -137,7 +164,10 @@ private:
     int32_t mExpectedContinuityCounter;
     unsigned mLastPESLength;
 
+    sp<BufferPool> mBufferPool;
     sp<ABuffer> mBuffer;
+    size_t mHighWaterMark;
+    size_t mNumBufferResizes;
     sp<AmAnotherPacketSource> mSource;
     bool mPayloadStarted;
 
@@ -178,6 +208,45 @@ private:
     DISALLOW_EVIL_CONSTRUCTORS(PSISection);
 };
 
+// Recycles PES reassembly buffers across streams of one parser. Buffers
+// come in 64K size classes, and new streams start out with the largest PES
+// packet seen so far for their stream type, so after a discontinuity or a
+// stream switch reassembly does not have to grow its buffer again.
+struct AmATSParser::BufferPool : public RefBase {
+    BufferPool();
+
+    sp<ABuffer> acquire(size_t minSize);
+    void release(const sp<ABuffer> &buffer);
+
+    size_t initialSize(unsigned streamType) const;
+    void notePESSize(unsigned streamType, size_t size);
+
+    void dump(AString *out) const;
+
+protected:
+    virtual ~BufferPool();
+
+private:
+    enum {
+        kSizeClassBytes   = 64 * 1024,
+        kNumSizeClasses   = 64,
+        kMaxFreePerClass  = 4,
+        kDefaultInitialSize = 192 * 1024,
+    };
+
+    Vector<sp<ABuffer> > mFreeBuffers[kNumSizeClasses];
+
+    // Keyed by stream type
+    KeyedVector<unsigned, size_t> mLargestPESSize;
+
+    size_t mNumAllocations;
+    size_t mNumReuses;
+
+    static size_t SizeClassOf(size_t size);
+
+    DISALLOW_EVIL_CONSTRUCTORS(BufferPool);
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 
 AmATSParser::Program::Program(
@@ -186,36 +255,44 @@ AmATSParser::Program::Program(
       mProgramNumber(programNumber),
       mProgramMapPID(programMapPID),
       mFirstPTSValid(false),
-      mFirstPTS(0) {
+      mFirstPTS(0),
+      mPCR_PID(0) {
     ALOGV("new program number %u", programNumber);
 }
 
-bool AmATSParser::Program::parsePSISection(
-        unsigned pid, ABitReader *br, status_t *err) {
-    *err = OK;
+void AmATSParser::Program::dump(AString *out) const {
+    out->append(AStringPrintf(
+            " program %u, PMT PID 0x%04x, %zu streams\n",
+            mProgramNumber, mProgramMapPID, mStreams.size()));
 
-    if (pid != mProgramMapPID) {
-        return false;
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+        mStreams.valueAt(i)->dump(out);
     }
+}
 
-    *err = parseProgramMap(br);
+void AmATSParser::Program::setSelected(bool selected) {
+    if (!selected) {
+        // Sources may already have been handed out, tell their readers
+        // that nothing more is coming before dropping the streams.
+        for (size_t i = 0; i < mStreams.size(); ++i) {
+            mStreams.editValueAt(i)->signalEOS(ERROR_END_OF_STREAM);
+        }
+        mStreams.clear();
+        return;
+    }
 
-    return true;
+    createStreams();
 }
 
-bool AmATSParser::Program::parsePID(
-        unsigned pid, unsigned continuity_counter,
-        unsigned payload_unit_start_indicator,
-        ABitReader *br, status_t *err, unsigned LastPESLength) {
+bool AmATSParser::Program::parsePSISection(
+        unsigned pid, ABitReader *br, status_t *err) {
     *err = OK;
 
-    ssize_t index = mStreams.indexOfKey(pid);
-    if (index < 0) {
+    if (pid != mProgramMapPID) {
         return false;
     }
 
-    *err = mStreams.editValueAt(index)->parse(
-            continuity_counter, payload_unit_start_indicator, br, LastPESLength);
+    *err = parseProgramMap(br);
 
     return true;
 }
@@ -241,11 +318,6 @@ void AmATSParser::Program::signalEOS(status_t finalResult) {
     }
 }
 
-struct StreamInfo {
-    unsigned mType;
-    unsigned mPID;
-};
-
 unsigned AmATSParser::Program::checkStreamType(unsigned type) {
     switch (type) {
         // must keep sync with .h
@@ -371,6 +443,13 @@ status_t AmATSParser::Program::parseProgramMap(ABitReader *br) {
     CHECK_EQ(infoBytesRemaining, 0u);
     MY_LOGV("  CRC = 0x%08x", br->getBits(32));
 
+    mStreamInfos = infos;
+    mPCR_PID = PCR_PID;
+
+    if (!mParser->isProgramSelected(mProgramNumber)) {
+        return OK;
+    }
+
     bool PIDsChanged = false;
     for (size_t i = 0; i < infos.size(); ++i) {
         StreamInfo &info = infos.editItemAt(i);
@@ -441,14 +520,20 @@ status_t AmATSParser::Program::parseProgramMap(ABitReader *br) {
         }
     }
 
-    for (size_t i = 0; i < infos.size(); ++i) {
-        StreamInfo &info = infos.editItemAt(i);
+    createStreams();
+
+    return OK;
+}
+
+void AmATSParser::Program::createStreams() {
+    for (size_t i = 0; i < mStreamInfos.size(); ++i) {
+        const StreamInfo &info = mStreamInfos.itemAt(i);
 
         ssize_t index = mStreams.indexOfKey(info.mPID);
 
         if (index < 0) {
             sp<Stream> stream = new Stream(
-                    this, info.mPID, info.mType, PCR_PID);
+                    this, info.mPID, info.mType, mPCR_PID);
 
             if (((stream->isAudio() || info.mType == 0x06) && AmATSParser::mNoAudio)
                 || (stream->isVideo() && AmATSParser::mNoVideo)) {
@@ -460,8 +545,6 @@ status_t AmATSParser::Program::parseProgramMap(ABitReader *br) {
             mStreams.add(info.mPID, stream);
         }
     }
-
-    return OK;
 }
 
 sp<MediaSource> AmATSParser::Program::getSource(SourceType type) {
@@ -534,6 +617,9 @@ AmATSParser::Stream::Stream(
       mPCR_PID(PCR_PID),
       mExpectedContinuityCounter(-1),
       mLastPESLength(0),
+      mBufferPool(program->bufferPool()),
+      mHighWaterMark(0),
+      mNumBufferResizes(0),
       mPayloadStarted(false),
       mPrevPTS(0),
       mQueue(NULL) {
@@ -605,14 +691,18 @@ AmATSParser::Stream::Stream(
     ALOGV("new stream PID 0x%02x, type 0x%02x", elementaryPID, streamType);
 
     if (mQueue != NULL) {
-        mBuffer = new ABuffer(192 * 1024);
-        mBuffer->setRange(0, 0);
+        mBuffer = mBufferPool->acquire(mBufferPool->initialSize(mStreamType));
     }
 }
 
 AmATSParser::Stream::~Stream() {
     delete mQueue;
     mQueue = NULL;
+
+    if (mBuffer != NULL) {
+        mBufferPool->release(mBuffer);
+        mBuffer.clear();
+    }
 }
 
 status_t AmATSParser::Stream::parse(
@@ -681,15 +771,21 @@ status_t AmATSParser::Stream::parse(
 
         ALOGI("resizing buffer to %zu bytes", neededSize);
 
-        sp<ABuffer> newBuffer = new ABuffer(neededSize);
+        sp<ABuffer> newBuffer = mBufferPool->acquire(neededSize);
         memcpy(newBuffer->data(), mBuffer->data(), mBuffer->size());
         newBuffer->setRange(0, mBuffer->size());
+        mBufferPool->release(mBuffer);
         mBuffer = newBuffer;
+        ++mNumBufferResizes;
     }
 
     memcpy(mBuffer->data() + mBuffer->size(), br->data(), payloadSizeBits / 8);
     mBuffer->setRange(0, mBuffer->size() + payloadSizeBits / 8);
 
+    if (mBuffer->size() > mHighWaterMark) {
+        mHighWaterMark = mBuffer->size();
+    }
+
     if (mLastPESLength && mBuffer->size() == (mLastPESLength + 6)) { // need to flush.
         ALOGV("flush last pes packet, length(%d), buffer size(%d)", mLastPESLength, mBuffer->size());
         status_t err = flush();
@@ -994,6 +1090,8 @@ status_t AmATSParser::Stream::flush() {
 
     ALOGV("flushing stream 0x%04x size = %zu", mElementaryPID, mBuffer->size());
 
+    mBufferPool->notePESSize(mStreamType, mBuffer->size());
+
     ABitReader br(mBuffer->data(), mBuffer->size());
 
     status_t err = parsePES(&br);
@@ -1003,6 +1101,16 @@ status_t AmATSParser::Stream::flush() {
     return err;
 }
 
+void AmATSParser::Stream::dump(AString *out) const {
+    out->append(AStringPrintf(
+            "  stream PID 0x%04x type 0x%02x: buffer %zu/%zu bytes, "
+            "high-water %zu bytes, %zu resizes\n",
+            mElementaryPID, mStreamType,
+            mBuffer == NULL ? 0 : mBuffer->size(),
+            mBuffer == NULL ? 0 : mBuffer->capacity(),
+            mHighWaterMark, mNumBufferResizes));
+}
+
 void AmATSParser::Stream::onPayloadData(
         unsigned PTS_DTS_flags, uint64_t PTS, uint64_t /* DTS */,
         const uint8_t *data, size_t size) {
@@ -1090,8 +1198,12 @@ AmATSParser::AmATSParser(uint32_t flags)
       mTimeOffsetValid(false),
       mTimeOffsetUs(0ll),
       mNumTSPacketsParsed(0),
+      mSelectedProgram(kAllPrograms),
+      mPIDTableDirty(true),
       mNumPCRs(0) {
+    mBufferPool = new BufferPool;
     mPSISections.add(0 /* PID */, new PSISection);
+    memset(mPIDSlots, 0, sizeof(mPIDSlots));
     char value[PROPERTY_VALUE_MAX];
     if (property_get("media.hls.no_audio", value, NULL)) {
         mNoAudio = atoi(value);
@@ -1107,8 +1219,61 @@ AmATSParser::~AmATSParser() {
 status_t AmATSParser::feedTSPacket(const void *data, size_t size) {
     CHECK_EQ(size, kTSPacketSize);
 
-    ABitReader br((const uint8_t *)data, kTSPacketSize);
-    return parseTS(&br);
+    return parseTS((const uint8_t *)data);
+}
+
+status_t AmATSParser::feedTSPackets(
+        const void *data, size_t size, size_t *numBytesParsed) {
+    const uint8_t *ptr = (const uint8_t *)data;
+
+    status_t err = OK;
+    size_t offset = 0;
+    while (offset + kTSPacketSize <= size) {
+        err = parseTS(&ptr[offset]);
+        if (err != OK) {
+            break;
+        }
+
+        offset += kTSPacketSize;
+    }
+
+    if (numBytesParsed != NULL) {
+        *numBytesParsed = offset;
+    }
+
+    return err;
+}
+
+void AmATSParser::selectProgram(unsigned programNumber) {
+    if (programNumber == mSelectedProgram) {
+        return;
+    }
+
+    ALOGI("selecting program %u", programNumber);
+    mSelectedProgram = programNumber;
+
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        const sp<Program> &program = mPrograms.editItemAt(i);
+        program->setSelected(isProgramSelected(program->number()));
+    }
+
+    mPIDTableDirty = true;
+}
+
+unsigned AmATSParser::selectedProgram() const {
+    return mSelectedProgram;
+}
+
+bool AmATSParser::isProgramSelected(unsigned programNumber) const {
+    return mSelectedProgram == kAllPrograms
+            || mSelectedProgram == programNumber;
+}
+
+void AmATSParser::getProgramNumbers(Vector<unsigned> *programNumbers) const {
+    programNumbers->clear();
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        programNumbers->push(mPrograms.itemAt(i)->number());
+    }
 }
 
 void AmATSParser::signalDiscontinuity(
@@ -1140,6 +1305,18 @@ void AmATSParser::signalDiscontinuity(
     }
 }
 
+void AmATSParser::dump(AString *out) const {
+    out->append(AStringPrintf(
+            "AmATSParser: %zu packets parsed, selected program %u\n",
+            mNumTSPacketsParsed, mSelectedProgram));
+
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        mPrograms.itemAt(i)->dump(out);
+    }
+
+    mBufferPool->dump(out);
+}
+
 void AmATSParser::signalEOS(status_t finalResult) {
     CHECK_NE(finalResult, (status_t)OK);
 
@@ -1218,10 +1395,11 @@ status_t AmATSParser::parsePID(
         ABitReader *br, unsigned PID,
         unsigned continuity_counter,
         unsigned payload_unit_start_indicator, unsigned LastPESLength) {
-    ssize_t sectionIndex = mPSISections.indexOfKey(PID);
+    // parseTS only hands us PIDs that have a slot.
+    const PIDEntry &entry = mPIDEntries.itemAt(mPIDSlots[PID] - 1);
 
-    if (sectionIndex >= 0) {
-        sp<PSISection> section = mPSISections.valueAt(sectionIndex);
+    if (entry.mSection != NULL) {
+        sp<PSISection> section = entry.mSection;
 
         if (payload_unit_start_indicator) {
             if (!section->isEmpty()) {
@@ -1245,6 +1423,9 @@ status_t AmATSParser::parsePID(
 
         ABitReader sectionBits(section->data(), section->size());
 
+        // Programs and streams may come and go with this section.
+        mPIDTableDirty = true;
+
         if (PID == 0) {
             parseProgramAssociationTable(&sectionBits);
         } else {
@@ -1277,26 +1458,68 @@ status_t AmATSParser::parsePID(
         return OK;
     }
 
-    bool handled = false;
+    if (entry.mStream == NULL) {
+        // PCR only PID, the adaptation field was all we needed.
+        return OK;
+    }
+
+    sp<Stream> stream = entry.mStream;
+    return stream->parse(
+            continuity_counter, payload_unit_start_indicator, br,
+            LastPESLength);
+}
+
+void AmATSParser::rebuildPIDTable() {
+    for (size_t i = 0; i < mPIDEntries.size(); ++i) {
+        mPIDSlots[mPIDEntries.itemAt(i).mPID] = 0;
+    }
+    mPIDEntries.clear();
+
+    // PSI sections take precedence over streams, and the first program
+    // carrying a PID owns it, same as the order parsePID used to search in.
+    for (size_t i = 0; i < mPSISections.size(); ++i) {
+        PIDEntry entry;
+        entry.mPID = mPSISections.keyAt(i);
+        entry.mSection = mPSISections.valueAt(i);
+        mPIDEntries.push(entry);
+        mPIDSlots[mPSISections.keyAt(i)] = mPIDEntries.size();
+    }
+
     for (size_t i = 0; i < mPrograms.size(); ++i) {
-        status_t err;
-        if (mPrograms.editItemAt(i)->parsePID(
-                    PID, continuity_counter, payload_unit_start_indicator,
-                    br, &err, LastPESLength)) {
-            if (err != OK) {
-                return err;
+        const sp<Program> &program = mPrograms.itemAt(i);
+        for (size_t j = 0; j < program->countStreams(); ++j) {
+            const sp<Stream> &stream = program->streamAt(j);
+            if (mPIDSlots[stream->pid()] != 0) {
+                continue;
             }
 
-            handled = true;
-            break;
+            PIDEntry entry;
+            entry.mPID = stream->pid();
+            entry.mStream = stream;
+            mPIDEntries.push(entry);
+            mPIDSlots[stream->pid()] = mPIDEntries.size();
         }
     }
 
-    if (!handled) {
-        ALOGV("PID 0x%04x not handled.", PID);
+    // The PCR may travel on a PID of its own, without any PES payload.
+    // Such PIDs get an entry without section or stream so that their
+    // adaptation fields are still parsed.
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        const sp<Program> &program = mPrograms.itemAt(i);
+        unsigned PCR_PID = program->PCRPID();
+        if (!isProgramSelected(program->number())
+                || PCR_PID == 0 || PCR_PID >= kNullPID
+                || mPIDSlots[PCR_PID] != 0) {
+            continue;
+        }
+
+        PIDEntry entry;
+        entry.mPID = PCR_PID;
+        mPIDEntries.push(entry);
+        mPIDSlots[PCR_PID] = mPIDEntries.size();
     }
 
-    return OK;
+    mPIDTableDirty = false;
 }
 
 status_t AmATSParser::parseAdaptationField(ABitReader *br, unsigned PID) {
@@ -1327,11 +1550,12 @@ status_t AmATSParser::parseAdaptationField(ABitReader *br, unsigned PID) {
             br->skipBits(6);
             unsigned PCR_ext = br->getBits(9);
 
-            // The number of bytes from the start of the current
-            // MPEG2 transport stream packet up and including
-            // the final byte of this PCR_ext field.
-            size_t byteOffsetFromStartOfTSPacket =
-                (188 - br->numBitsLeft() / 8);
+            // The number of bytes from the start of the payload of the
+            // current MPEG2 transport stream packet up and including
+            // the final byte of this PCR_ext field. The bit reader
+            // starts right after the 4 byte TS header.
+            size_t byteOffsetFromStartOfPayload =
+                (kTSPacketSize - 4 - br->numBitsLeft() / 8);
 
             uint64_t PCR = PCR_base * 300 + PCR_ext;
 
@@ -1341,7 +1565,8 @@ status_t AmATSParser::parseAdaptationField(ABitReader *br, unsigned PID) {
             // The number of bytes received by this parser up to and
             // including the final byte of this PCR_ext field.
             size_t byteOffsetFromStart =
-                mNumTSPacketsParsed * 188 + byteOffsetFromStartOfTSPacket;
+                mNumTSPacketsParsed * kTSPacketSize
+                    + 4 + byteOffsetFromStartOfPayload;
 
             for (size_t i = 0; i < mPrograms.size(); ++i) {
                 updatePCR(PID, PCR, byteOffsetFromStart);
@@ -1358,36 +1583,47 @@ status_t AmATSParser::parseAdaptationField(ABitReader *br, unsigned PID) {
     return OK;
 }
 
-status_t AmATSParser::parseTS(ABitReader *br) {
+status_t AmATSParser::parseTS(const uint8_t *packet) {
     ALOGV("---");
 
-    unsigned sync_byte = br->getBits(8);
+    // The 4 byte header has a fixed layout, no need for a bit reader.
+    unsigned sync_byte = packet[0];
     if (sync_byte != 0x47u) {
         ALOGE("[error] parseTS: return error as sync_byte=0x%x", sync_byte);
         return BAD_VALUE;
     }
 
-    if (br->getBits(1)) {  // transport_error_indicator
+    if (packet[1] & 0x80) {  // transport_error_indicator
         // silently ignore.
         return OK;
     }
 
-    unsigned payload_unit_start_indicator = br->getBits(1);
+    unsigned payload_unit_start_indicator = (packet[1] >> 6) & 1;
     ALOGV("payload_unit_start_indicator = %u", payload_unit_start_indicator);
 
-    MY_LOGV("transport_priority = %u", br->getBits(1));
-
-    unsigned PID = br->getBits(13);
+    unsigned PID = ((packet[1] & 0x1f) << 8) | packet[2];
     ALOGV("PID = 0x%04x", PID);
 
-    MY_LOGV("transport_scrambling_control = %u", br->getBits(2));
-
-    unsigned adaptation_field_control = br->getBits(2);
+    unsigned adaptation_field_control = (packet[3] >> 4) & 3;
     ALOGV("adaptation_field_control = %u", adaptation_field_control);
 
-    unsigned continuity_counter = br->getBits(4);
+    unsigned continuity_counter = packet[3] & 0x0f;
     ALOGV("PID = 0x%04x, continuity_counter = %u", PID, continuity_counter);
 
+    if (mPIDTableDirty) {
+        rebuildPIDTable();
+    }
+
+    if (PID == kNullPID || mPIDSlots[PID] == 0) {
+        // Nobody is interested in this PID, skip the payload entirely.
+        ALOGV("PID 0x%04x not handled.", PID);
+        ++mNumTSPacketsParsed;
+        return OK;
+    }
+
+    ABitReader bits(&packet[4], kTSPacketSize - 4);
+    ABitReader *br = &bits;
+
     // ALOGI("PID = 0x%04x, continuity_counter = %u", PID, continuity_counter);
 
     status_t err = OK;
@@ -1491,6 +1727,98 @@ unsigned AmATSParser::peekPESLength(ABitReader * br) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+AmATSParser::BufferPool::BufferPool()
+    : mNumAllocations(0),
+      mNumReuses(0) {
+}
+
+AmATSParser::BufferPool::~BufferPool() {
+}
+
+// static
+size_t AmATSParser::BufferPool::SizeClassOf(size_t size) {
+    return (size + kSizeClassBytes - 1) / kSizeClassBytes;
+}
+
+sp<ABuffer> AmATSParser::BufferPool::acquire(size_t minSize) {
+    size_t sizeClass = SizeClassOf(minSize);
+    if (sizeClass == 0) {
+        sizeClass = 1;
+    }
+
+    // Accept a free buffer of up to twice the requested size.
+    for (size_t i = sizeClass; i < kNumSizeClasses && i <= 2 * sizeClass; ++i) {
+        if (!mFreeBuffers[i].isEmpty()) {
+            sp<ABuffer> buffer = mFreeBuffers[i].top();
+            mFreeBuffers[i].pop();
+            buffer->setRange(0, 0);
+            ++mNumReuses;
+            return buffer;
+        }
+    }
+
+    sp<ABuffer> buffer = new ABuffer(sizeClass * kSizeClassBytes);
+    buffer->setRange(0, 0);
+    ++mNumAllocations;
+
+    return buffer;
+}
+
+void AmATSParser::BufferPool::release(const sp<ABuffer> &buffer) {
+    size_t capacity = buffer->capacity();
+    if (capacity % kSizeClassBytes) {
+        return;
+    }
+
+    size_t sizeClass = SizeClassOf(capacity);
+    if (sizeClass >= kNumSizeClasses
+            || mFreeBuffers[sizeClass].size() >= kMaxFreePerClass) {
+        return;
+    }
+
+    mFreeBuffers[sizeClass].push(buffer);
+}
+
+size_t AmATSParser::BufferPool::initialSize(unsigned streamType) const {
+    ssize_t index = mLargestPESSize.indexOfKey(streamType);
+    if (index < 0) {
+        return kDefaultInitialSize;
+    }
+
+    return mLargestPESSize.valueAt(index);
+}
+
+void AmATSParser::BufferPool::notePESSize(unsigned streamType, size_t size) {
+    ssize_t index = mLargestPESSize.indexOfKey(streamType);
+    if (index < 0) {
+        mLargestPESSize.add(streamType, size);
+    } else if (mLargestPESSize.valueAt(index) < size) {
+        mLargestPESSize.editValueAt(index) = size;
+    }
+}
+
+void AmATSParser::BufferPool::dump(AString *out) const {
+    size_t numFree = 0;
+    size_t freeBytes = 0;
+    for (size_t i = 0; i < kNumSizeClasses; ++i) {
+        numFree += mFreeBuffers[i].size();
+        freeBytes += mFreeBuffers[i].size() * i * kSizeClassBytes;
+    }
+
+    out->append(AStringPrintf(
+            " buffer pool: %zu allocations, %zu reuses, "
+            "%zu free buffers (%zu bytes)\n",
+            mNumAllocations, mNumReuses, numFree, freeBytes));
+
+    for (size_t i = 0; i < mLargestPESSize.size(); ++i) {
+        out->append(AStringPrintf(
+                "  largest PES for type 0x%02x: %zu bytes\n",
+                mLargestPESSize.keyAt(i), mLargestPESSize.valueAt(i)));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 AmATSParser::PSISection::PSISection() {
 }
 
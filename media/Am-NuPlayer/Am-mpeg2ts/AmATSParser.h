@@ -30,6 +30,7 @@ namespace android {
 
 struct ABitReader;
 struct ABuffer;
+struct AString;
 struct MediaSource;
 
 struct AmATSParser : public RefBase {
@@ -66,6 +67,33 @@ struct AmATSParser : public RefBase {
 
     status_t feedTSPacket(const void *data, size_t size);
 
+    // Parses all whole TS packets in "data". Stops at the first packet that
+    // fails to parse, "numBytesParsed" (if not NULL) receives the offset of
+    // that packet, e.g. to resync after BAD_VALUE.
+    status_t feedTSPackets(
+            const void *data, size_t size, size_t *numBytesParsed = NULL);
+
+    enum {
+        // program_number 0 is reserved for the network PID in the PAT.
+        kAllPrograms = 0,
+    };
+
+    // Only the elementary streams of the selected program are reassembled,
+    // packets of all other elementary PIDs are dropped after the TS header.
+    // PMTs of all programs are still tracked, so switching programs takes
+    // effect immediately. Sources of a deselected program are signalled
+    // ERROR_END_OF_STREAM and released, callers need to getSource() again
+    // after a switch.
+    void selectProgram(unsigned programNumber);
+    unsigned selectedProgram() const;
+
+    // Program numbers announced in the PAT so far.
+    void getProgramNumbers(Vector<unsigned> *programNumbers) const;
+
+    // Appends per-stream PES buffer usage (including high-water marks)
+    // and buffer pool statistics to "out".
+    void dump(AString *out) const;
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -110,6 +138,18 @@ private:
     struct Program;
     struct Stream;
     struct PSISection;
+    struct BufferPool;
+
+    enum {
+        kNumPIDs = 8192,
+        kNullPID = 0x1fff,
+    };
+
+    struct PIDEntry {
+        unsigned mPID;
+        sp<PSISection> mSection;
+        sp<Stream> mStream;
+    };
 
     uint32_t mFlags;
     Vector<sp<Program> > mPrograms;
@@ -117,6 +157,8 @@ private:
     // Keyed by PID
     KeyedVector<unsigned, sp<PSISection> > mPSISections;
 
+    sp<BufferPool> mBufferPool;
+
     int64_t mAbsoluteTimeAnchorUs;
 
     bool mTimeOffsetValid;
@@ -124,6 +166,14 @@ private:
 
     size_t mNumTSPacketsParsed;
 
+    unsigned mSelectedProgram;
+
+    // Dense PID lookup rebuilt after every PAT/PMT update. A slot holds
+    // 1 + the index into mPIDEntries, or 0 if nobody wants that PID.
+    uint16_t mPIDSlots[kNumPIDs];
+    Vector<PIDEntry> mPIDEntries;
+    bool mPIDTableDirty;
+
     void parseProgramAssociationTable(ABitReader *br);
     void parseProgramMap(ABitReader *br);
     void parsePES(ABitReader *br);
@@ -135,7 +185,10 @@ private:
         unsigned LastPESLength);
 
     status_t parseAdaptationField(ABitReader *br, unsigned PID);
-    status_t parseTS(ABitReader *br);
+    status_t parseTS(const uint8_t *packet);
+
+    void rebuildPIDTable();
+    bool isProgramSelected(unsigned programNumber) const;
 
     void updatePCR(unsigned PID, uint64_t PCR, size_t byteOffsetFromStart);
     unsigned peekPESLength(ABitReader *br);
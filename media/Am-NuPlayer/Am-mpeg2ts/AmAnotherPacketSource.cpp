@@ -37,8 +37,180 @@ namespace android {
 
 const int64_t kNearEOSMarkUs = 2000000ll; // 2 secs
 
+// Like Mutex::Autolock, but counts how often the lock was already taken.
+struct AmAnotherPacketSource::AutoLock {
+    AutoLock(AmAnotherPacketSource *source)
+        : mSource(source) {
+        if (mSource->mLock.tryLock() != NO_ERROR) {
+            mSource->mLock.lock();
+            ++mSource->mNumContendedLocks;
+        }
+        ++mSource->mNumLocks;
+    }
+
+    ~AutoLock() {
+        mSource->mLock.unlock();
+    }
+
+private:
+    AmAnotherPacketSource *mSource;
+
+    DISALLOW_EVIL_CONSTRUCTORS(AutoLock);
+};
+
+// Double-ended queue of timestamps in a ring of slots that doubles when
+// full, like AmBufferRing, so once a span has seen its largest reordering
+// window pushing and popping no longer allocates.
+struct TimeQueue {
+    TimeQueue()
+        : mHead(0),
+          mCount(0) {
+        mSlots.insertAt(0, 0, kInitialCapacity);
+    }
+
+    bool empty() const { return mCount == 0; }
+
+    int64_t front() const { return mSlots.itemAt(mHead); }
+    int64_t back() const { return mSlots.itemAt(slotIndex(mCount - 1)); }
+
+    void pushBack(int64_t timeUs) {
+        if (mCount == mSlots.size()) {
+            grow();
+        }
+        mSlots.editItemAt(slotIndex(mCount)) = timeUs;
+        ++mCount;
+    }
+
+    void pushFront(int64_t timeUs) {
+        if (mCount == mSlots.size()) {
+            grow();
+        }
+        mHead = (mHead + mSlots.size() - 1) & (mSlots.size() - 1);
+        mSlots.editItemAt(mHead) = timeUs;
+        ++mCount;
+    }
+
+    void popFront() {
+        mHead = (mHead + 1) & (mSlots.size() - 1);
+        --mCount;
+    }
+
+    void popBack() {
+        --mCount;
+    }
+
+    void clear() {
+        mHead = 0;
+        mCount = 0;
+    }
+
+private:
+    enum {
+        kInitialCapacity = 16,
+    };
+
+    // Always a power of two.
+    Vector<int64_t> mSlots;
+    size_t mHead;
+    size_t mCount;
+
+    size_t slotIndex(size_t index) const {
+        return (mHead + index) & (mSlots.size() - 1);
+    }
+
+    void grow() {
+        size_t capacity = mSlots.size();
+
+        Vector<int64_t> slots;
+        slots.setCapacity(capacity * 2);
+        for (size_t i = 0; i < mCount; ++i) {
+            slots.push(mSlots.itemAt(slotIndex(i)));
+        }
+        slots.insertAt(0, mCount, capacity * 2 - mCount);
+
+        mSlots = slots;
+        mHead = 0;
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(TimeQueue);
+};
+
+// The timestamps of the access units between two discontinuities.
+// mMinQueue holds the timestamps that are the smallest of all access
+// units queued from them on, in queue order and so non-decreasing;
+// mMaxQueue the same for the largest ones. The fronts are the span's
+// smallest and largest timestamps, and dequeuing the oldest access unit
+// drops at most the front entries.
+struct AmAnotherPacketSource::TimeSpan : public RefBase {
+    TimeSpan()
+        : mCount(0) {
+    }
+
+    size_t mCount;
+    TimeQueue mMinQueue;
+    TimeQueue mMaxQueue;
+
+    void pushBack(int64_t timeUs) {
+        while (!mMinQueue.empty() && mMinQueue.back() > timeUs) {
+            mMinQueue.popBack();
+        }
+        mMinQueue.pushBack(timeUs);
+
+        while (!mMaxQueue.empty() && mMaxQueue.back() < timeUs) {
+            mMaxQueue.popBack();
+        }
+        mMaxQueue.pushBack(timeUs);
+
+        ++mCount;
+    }
+
+    void popFront(int64_t timeUs) {
+        CHECK_GT(mCount, 0u);
+
+        // If the oldest access unit is not at the front it was dropped
+        // already by a newer one that is smaller (or larger).
+        if (mMinQueue.front() == timeUs) {
+            mMinQueue.popFront();
+        }
+        if (mMaxQueue.front() == timeUs) {
+            mMaxQueue.popFront();
+        }
+
+        --mCount;
+    }
+
+    void pushFront(int64_t timeUs) {
+        // An older access unit only matters while nothing newer beats it.
+        if (mMinQueue.empty() || timeUs <= mMinQueue.front()) {
+            mMinQueue.pushFront(timeUs);
+        }
+        if (mMaxQueue.empty() || timeUs >= mMaxQueue.front()) {
+            mMaxQueue.pushFront(timeUs);
+        }
+
+        ++mCount;
+    }
+
+    void clear() {
+        mCount = 0;
+        mMinQueue.clear();
+        mMaxQueue.clear();
+    }
+
+    int64_t durationUs() const {
+        if (mCount == 0) {
+            return 0;
+        }
+        return mMaxQueue.front() - mMinQueue.front();
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(TimeSpan);
+};
+
 AmAnotherPacketSource::AmAnotherPacketSource(const sp<MetaData> &meta)
-    : mIsAudio(false),
+    : mNumWaiters(0),
+      mIsAudio(false),
       mIsVideo(false),
       mIsValid(true),
       mFormat(NULL),
@@ -47,7 +219,11 @@ AmAnotherPacketSource::AmAnotherPacketSource(const sp<MetaData> &meta)
       mLatestEnqueuedMeta(NULL),
       mLatestDequeuedMeta(NULL),
       mQueuedDiscontinuityCount(0),
-      mEstimatedBytePerSec(0) {
+      mEstimatedBytePerSec(0),
+      mBufferedBytes(0),
+      mNumLocks(0),
+      mNumContendedLocks(0) {
+    resetTotals_l();
     setFormat(meta);
 }
 
@@ -86,14 +262,13 @@ status_t AmAnotherPacketSource::stop() {
 }
 
 sp<MetaData> AmAnotherPacketSource::getFormat() {
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
     if (mFormat != NULL) {
         return mFormat;
     }
 
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    while (it != mBuffers.end()) {
-        sp<ABuffer> buffer = *it;
+    for (size_t i = 0; i < mBuffers.size(); ++i) {
+        const sp<ABuffer> &buffer = mBuffers.itemAt(i);
         int32_t discontinuity;
         if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
             break;
@@ -103,8 +278,6 @@ sp<MetaData> AmAnotherPacketSource::getFormat() {
         if (buffer->meta()->findObject("format", &object)) {
             return mFormat = static_cast<MetaData*>(object.get());
         }
-
-        ++it;
     }
     return NULL;
 }
@@ -112,14 +285,12 @@ sp<MetaData> AmAnotherPacketSource::getFormat() {
 status_t AmAnotherPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
     buffer->clear();
 
-    Mutex::Autolock autoLock(mLock);
-    while (mEOSResult == OK && mBuffers.empty()) {
-        mCondition.wait(mLock);
-    }
+    AutoLock autoLock(this);
+    waitForBuffer_l();
 
     if (!mBuffers.empty()) {
-        *buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+        *buffer = mBuffers.popFront();
+        onDequeued_l(*buffer);
 
         int32_t discontinuity;
         if ((*buffer)->meta()->findInt32("discontinuity", &discontinuity)) {
@@ -145,24 +316,27 @@ status_t AmAnotherPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
 }
 
 void AmAnotherPacketSource::requeueAccessUnit(const sp<ABuffer> &buffer) {
-    // TODO: update corresponding book keeping info.
-    Mutex::Autolock autoLock(mLock);
-    mBuffers.push_front(buffer);
+    AutoLock autoLock(this);
+    mBuffers.pushFront(buffer);
+    onRequeued_l(buffer);
+
+    int32_t discontinuity;
+    if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
+        ++mQueuedDiscontinuityCount;
+    }
 }
 
 status_t AmAnotherPacketSource::read(
         MediaBuffer **out, const ReadOptions *) {
     *out = NULL;
 
-    Mutex::Autolock autoLock(mLock);
-    while (mEOSResult == OK && mBuffers.empty()) {
-        mCondition.wait(mLock);
-    }
+    AutoLock autoLock(this);
+    waitForBuffer_l();
 
     if (!mBuffers.empty()) {
 
-        const sp<ABuffer> buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+        const sp<ABuffer> buffer = mBuffers.popFront();
+        onDequeued_l(buffer);
         mLatestDequeuedMeta = buffer->meta()->dup();
 
         int32_t discontinuity;
@@ -206,6 +380,21 @@ bool AmAnotherPacketSource::wasFormatChange(
     return false;
 }
 
+void AmAnotherPacketSource::waitForBuffer_l() {
+    while (mEOSResult == OK && mBuffers.empty()) {
+        ++mNumWaiters;
+        mCondition.wait(mLock);
+        --mNumWaiters;
+    }
+}
+
+void AmAnotherPacketSource::signalBuffer_l() {
+    // A reader only waits on an empty queue, skip the wakeup otherwise.
+    if (mNumWaiters > 0) {
+        mCondition.signal();
+    }
+}
+
 void AmAnotherPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
     int32_t damaged;
     if (buffer->meta()->findInt32("damaged", &damaged) && damaged) {
@@ -218,9 +407,10 @@ void AmAnotherPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
     mLastQueuedTimeUs = lastQueuedTimeUs;
     ALOGV("queueAccessUnit timeUs=%" PRIi64 " us (%.2f secs)", mLastQueuedTimeUs, mLastQueuedTimeUs / 1E6);
 
-    Mutex::Autolock autoLock(mLock);
-    mBuffers.push_back(buffer);
-    mCondition.signal();
+    AutoLock autoLock(this);
+    mBuffers.pushBack(buffer);
+    onQueued_l(buffer);
+    signalBuffer_l();
 
     int32_t discontinuity;
     if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
@@ -246,9 +436,10 @@ void AmAnotherPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
 }
 
 void AmAnotherPacketSource::clear() {
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
 
     mBuffers.clear();
+    resetTotals_l();
     mEOSResult = OK;
     mQueuedDiscontinuityCount = 0;
 
@@ -260,23 +451,21 @@ void AmAnotherPacketSource::queueDiscontinuity(
         AmATSParser::DiscontinuityType type,
         const sp<AMessage> &extra,
         bool discard) {
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
 
     if (discard) {
         // Leave only discontinuities in the queue.
-        List<sp<ABuffer> >::iterator it = mBuffers.begin();
-        while (it != mBuffers.end()) {
-            sp<ABuffer> oldBuffer = *it;
+        for (size_t n = mBuffers.size(); n > 0; --n) {
+            sp<ABuffer> oldBuffer = mBuffers.popFront();
 
             int32_t oldDiscontinuityType;
-            if (!oldBuffer->meta()->findInt32(
+            if (oldBuffer->meta()->findInt32(
                         "discontinuity", &oldDiscontinuityType)) {
-                it = mBuffers.erase(it);
-                continue;
+                mBuffers.pushBack(oldBuffer);
             }
-
-            ++it;
         }
+
+        rebuildTotals_l();
     }
 
     mEOSResult = OK;
@@ -292,20 +481,21 @@ void AmAnotherPacketSource::queueDiscontinuity(
     buffer->meta()->setInt32("discontinuity", static_cast<int32_t>(type));
     buffer->meta()->setMessage("extra", extra);
 
-    mBuffers.push_back(buffer);
-    mCondition.signal();
+    mBuffers.pushBack(buffer);
+    onQueued_l(buffer);
+    signalBuffer_l();
 }
 
 void AmAnotherPacketSource::signalEOS(status_t result) {
     //CHECK(result != OK);
 
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
     mEOSResult = result;
     mCondition.signal();
 }
 
 bool AmAnotherPacketSource::hasBufferAvailable(status_t *finalResult) {
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
     if (!mBuffers.empty()) {
         return true;
     }
@@ -315,27 +505,17 @@ bool AmAnotherPacketSource::hasBufferAvailable(status_t *finalResult) {
 }
 
 int64_t AmAnotherPacketSource::getBufferedDurationUs(status_t *finalResult) {
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
     return getBufferedDurationUs_l(finalResult);
 }
 
 int64_t AmAnotherPacketSource::getBufferedDataSize() {
-    Mutex::Autolock autoLock(mLock);
-    if (mBuffers.empty()) {
-        return 0;
-    }
-    int64_t data_size_bytes = 0;
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    while (it != mBuffers.end()) {
-        const sp<ABuffer> &buffer = *it;
-        data_size_bytes += buffer->size();
-        ++it;
-    }
-    return data_size_bytes;
+    AutoLock autoLock(this);
+    return mBufferedBytes;
 }
 
 int64_t AmAnotherPacketSource::getEstimatedBytesPerSec() {
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
     return mEstimatedBytePerSec;
 }
 
@@ -346,39 +526,17 @@ int64_t AmAnotherPacketSource::getBufferedDurationUs_l(status_t *finalResult, in
         return 0;
     }
 
-    int64_t time1 = -1;
-    int64_t time2 = -1;
-    int64_t durationUs = 0;
-    int64_t dataSize = 0;
-
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    while (it != mBuffers.end()) {
-        const sp<ABuffer> &buffer = *it;
-
-        dataSize += buffer->size();
-
-        int64_t timeUs;
-        if (buffer->meta()->findInt64("timeUs", &timeUs)) {
-            if (time1 < 0 || timeUs < time1) {
-                time1 = timeUs;
-            }
-
-            if (time2 < 0 || timeUs > time2) {
-                time2 = timeUs;
-            }
-        } else {
-            // This is a discontinuity, reset everything.
-            durationUs += time2 - time1;
-            time1 = time2 = -1;
-        }
-
-        ++it;
+    // There is one span per queued discontinuity plus one, rarely more
+    // than two.
+    int64_t result_dur = 0;
+    for (List<sp<TimeSpan> >::iterator it = mTimeSpans.begin();
+            it != mTimeSpans.end(); ++it) {
+        result_dur += (*it)->durationUs();
     }
 
-    int64_t result_dur = durationUs + (time2 - time1);
     if (estimateBytePerSec) {
         if (result_dur > 2000000) {
-            *estimateBytePerSec = dataSize / 2;
+            *estimateBytePerSec = mBufferedBytes / 2;
         } else {
             *estimateBytePerSec = 0;
         }
@@ -387,10 +545,68 @@ int64_t AmAnotherPacketSource::getBufferedDurationUs_l(status_t *finalResult, in
     return result_dur;
 }
 
+void AmAnotherPacketSource::onQueued_l(const sp<ABuffer> &buffer) {
+    mBufferedBytes += buffer->size();
+
+    // Anything without a timestamp is a discontinuity and starts a new span.
+    int64_t timeUs;
+    if (buffer->meta()->findInt64("timeUs", &timeUs)) {
+        (*(--mTimeSpans.end()))->pushBack(timeUs);
+    } else {
+        mTimeSpans.push_back(new TimeSpan);
+    }
+}
+
+void AmAnotherPacketSource::onDequeued_l(const sp<ABuffer> &buffer) {
+    mBufferedBytes -= buffer->size();
+
+    int64_t timeUs;
+    if (buffer->meta()->findInt64("timeUs", &timeUs)) {
+        (*mTimeSpans.begin())->popFront(timeUs);
+    } else {
+        // Everything before the discontinuity is gone by now.
+        CHECK_EQ((*mTimeSpans.begin())->mCount, 0u);
+        mTimeSpans.erase(mTimeSpans.begin());
+    }
+}
+
+void AmAnotherPacketSource::onRequeued_l(const sp<ABuffer> &buffer) {
+    mBufferedBytes += buffer->size();
+
+    int64_t timeUs;
+    if (buffer->meta()->findInt64("timeUs", &timeUs)) {
+        (*mTimeSpans.begin())->pushFront(timeUs);
+    } else {
+        mTimeSpans.push_front(new TimeSpan);
+    }
+}
+
+void AmAnotherPacketSource::resetTotals_l() {
+    mBufferedBytes = 0;
+
+    // Keep one span and its slots, a flush should not cost allocations.
+    while (mTimeSpans.size() > 1) {
+        mTimeSpans.erase(--mTimeSpans.end());
+    }
+    if (mTimeSpans.empty()) {
+        mTimeSpans.push_back(new TimeSpan);
+    } else {
+        (*mTimeSpans.begin())->clear();
+    }
+}
+
+void AmAnotherPacketSource::rebuildTotals_l() {
+    resetTotals_l();
+
+    for (size_t i = 0; i < mBuffers.size(); ++i) {
+        onQueued_l(mBuffers.itemAt(i));
+    }
+}
+
 // A cheaper but less precise version of getBufferedDurationUs that we would like to use in
 // AmLiveSession::dequeueAccessUnit to trigger downwards adaptation.
 int64_t AmAnotherPacketSource::getEstimatedDurationUs() {
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
     if (mBuffers.empty()) {
         return 0;
     }
@@ -400,8 +616,7 @@ int64_t AmAnotherPacketSource::getEstimatedDurationUs() {
         return getBufferedDurationUs_l(&finalResult);
     }
 
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    sp<ABuffer> buffer = *it;
+    sp<ABuffer> buffer = mBuffers.front();
 
     int64_t startTimeUs;
     buffer->meta()->findInt64("timeUs", &startTimeUs);
@@ -409,9 +624,7 @@ int64_t AmAnotherPacketSource::getEstimatedDurationUs() {
         return 0;
     }
 
-    it = mBuffers.end();
-    --it;
-    buffer = *it;
+    buffer = mBuffers.back();
 
     int64_t endTimeUs;
     buffer->meta()->findInt64("timeUs", &endTimeUs);
@@ -431,35 +644,33 @@ int64_t AmAnotherPacketSource::getEstimatedDurationUs() {
 status_t AmAnotherPacketSource::nextBufferTime(int64_t *timeUs) {
     *timeUs = 0;
 
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
 
     if (mBuffers.empty()) {
         return mEOSResult != OK ? mEOSResult : -EWOULDBLOCK;
     }
 
-    sp<ABuffer> buffer = *mBuffers.begin();
+    sp<ABuffer> buffer = mBuffers.front();
     CHECK(buffer->meta()->findInt64("timeUs", timeUs));
 
     return OK;
 }
 
 int64_t AmAnotherPacketSource::peekFirstVideoTimeUs() {
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
     if (mIsAudio || mBuffers.size() < PEEK_TIMEUS_THRESHOLD) {
         return -1;
     }
     int32_t count = 0;
     int64_t timeUs = 0, min_timeUs = -1;
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    while (it != mBuffers.end() && count++ < PEEK_TIMEUS_THRESHOLD) {
-        const sp<ABuffer> &buffer = *it;
+    while (count < PEEK_TIMEUS_THRESHOLD) {
+        const sp<ABuffer> &buffer = mBuffers.itemAt(count++);
         buffer->meta()->findInt64("timeUs", &timeUs);
         if (min_timeUs < 0) {
             min_timeUs = timeUs;
         } else {
             min_timeUs = (timeUs < min_timeUs) ? timeUs : min_timeUs;
         }
-        ++it;
     }
     return min_timeUs;
 }
@@ -476,23 +687,48 @@ bool AmAnotherPacketSource::isFinished(int64_t duration) const {
 }
 
 sp<AMessage> AmAnotherPacketSource::getLatestEnqueuedMeta() {
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
     return mLatestEnqueuedMeta;
 }
 
 sp<AMessage> AmAnotherPacketSource::getLatestDequeuedMeta() {
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
     return mLatestDequeuedMeta;
 }
 
 void AmAnotherPacketSource::setValid(bool valid) {
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
     mIsValid = valid;
 }
 
 bool AmAnotherPacketSource::getValid() {
-    Mutex::Autolock autoLock(mLock);
+    AutoLock autoLock(this);
     return mIsValid;
 }
 
+void AmAnotherPacketSource::dump(AString *out) {
+    AutoLock autoLock(this);
+
+    status_t finalResult;
+    int64_t durationUs = getBufferedDurationUs_l(&finalResult);
+
+    out->append(AStringPrintf(
+            "AmAnotherPacketSource(%s): %.3f secs, %" PRId64 " bytes, "
+            "%zu discontinuities queued, result %d\n",
+            mIsAudio ? "audio" : (mIsVideo ? "video" : "other"),
+            durationUs / 1E6, mBufferedBytes,
+            mQueuedDiscontinuityCount, finalResult));
+
+    out->append(AStringPrintf(
+            "  lock taken %" PRIu64 " times, %" PRIu64 " times contended\n",
+            mNumLocks, mNumContendedLocks));
+}
+
+void AmAnotherPacketSource::getLockCounts(
+        uint64_t *numLocks, uint64_t *numContendedLocks) {
+    AutoLock autoLock(this);
+    *numLocks = mNumLocks;
+    *numContendedLocks = mNumContendedLocks;
+}
+
 }  // namespace android
@@ -24,10 +24,12 @@
 #include <utils/List.h>
 
 #include "AmATSParser.h"
+#include "AmBufferRing.h"
 
 namespace android {
 
 struct ABuffer;
+struct AString;
 
 struct AmAnotherPacketSource : public MediaSource {
     AmAnotherPacketSource(const sp<MetaData> &meta);
@@ -78,19 +80,30 @@ struct AmAnotherPacketSource : public MediaSource {
     void setValid(bool valid);
     bool getValid();
 
+    void dump(AString *out);
+
+    // How often the lock was taken, and how often another thread held it.
+    void getLockCounts(uint64_t *numLocks, uint64_t *numContendedLocks);
+
 protected:
     virtual ~AmAnotherPacketSource();
 
 private:
+    struct AutoLock;
+    struct TimeSpan;
+
     Mutex mLock;
     Condition mCondition;
 
+    // Readers blocked on mCondition; queueing only signals when nonzero.
+    size_t mNumWaiters;
+
     bool mIsAudio;
     bool mIsVideo;
     bool mIsValid;
     sp<MetaData> mFormat;
     int64_t mLastQueuedTimeUs;
-    List<sp<ABuffer> > mBuffers;
+    AmBufferRing mBuffers;
     status_t mEOSResult;
     sp<AMessage> mLatestEnqueuedMeta;
     sp<AMessage> mLatestDequeuedMeta;
@@ -98,9 +111,27 @@ private:
     size_t  mQueuedDiscontinuityCount;
     int64_t  mEstimatedBytePerSec;
 
+    // Running totals over mBuffers, so the buffering queries polled by
+    // the sources do not have to walk the queue. mTimeSpans has one entry
+    // per run of access units between discontinuities, in queue order.
+    int64_t mBufferedBytes;
+    List<sp<TimeSpan> > mTimeSpans;
+
+    // How often mLock was taken, and how often somebody else had it.
+    uint64_t mNumLocks;
+    uint64_t mNumContendedLocks;
+
     bool wasFormatChange(int32_t discontinuityType) const;
+    void waitForBuffer_l();
+    void signalBuffer_l();
     int64_t getBufferedDurationUs_l(status_t *finalResult, int64_t *estimateBytePerUs = NULL);
 
+    void onQueued_l(const sp<ABuffer> &buffer);
+    void onDequeued_l(const sp<ABuffer> &buffer);
+    void onRequeued_l(const sp<ABuffer> &buffer);
+    void resetTotals_l();
+    void rebuildTotals_l();
+
     DISALLOW_EVIL_CONSTRUCTORS(AmAnotherPacketSource);
 };
 
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "NU-BufferRing"
+#include <utils/Log.h>
+
+#include "AmBufferRing.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+AmBufferRing::AmBufferRing()
+    : mHead(0),
+      mCount(0) {
+    mSlots.insertAt(sp<ABuffer>(), 0, kInitialCapacity);
+}
+
+AmBufferRing::~AmBufferRing() {
+}
+
+const sp<ABuffer> &AmBufferRing::itemAt(size_t index) const {
+    CHECK_LT(index, mCount);
+    return mSlots.itemAt(slotIndex(index));
+}
+
+void AmBufferRing::pushBack(const sp<ABuffer> &buffer) {
+    if (mCount == mSlots.size()) {
+        grow();
+    }
+
+    mSlots.editItemAt(slotIndex(mCount)) = buffer;
+    ++mCount;
+}
+
+void AmBufferRing::pushFront(const sp<ABuffer> &buffer) {
+    if (mCount == mSlots.size()) {
+        grow();
+    }
+
+    mHead = (mHead + mSlots.size() - 1) & (mSlots.size() - 1);
+    mSlots.editItemAt(mHead) = buffer;
+    ++mCount;
+}
+
+sp<ABuffer> AmBufferRing::popFront() {
+    CHECK_GT(mCount, 0u);
+
+    sp<ABuffer> &slot = mSlots.editItemAt(mHead);
+    sp<ABuffer> buffer = slot;
+    slot.clear();
+
+    mHead = (mHead + 1) & (mSlots.size() - 1);
+    --mCount;
+
+    return buffer;
+}
+
+void AmBufferRing::clear() {
+    while (mCount > 0) {
+        popFront();
+    }
+    mHead = 0;
+}
+
+void AmBufferRing::grow() {
+    size_t capacity = mSlots.size();
+
+    // Unwrap into the new slots, oldest buffer first.
+    Vector<sp<ABuffer> > slots;
+    slots.setCapacity(capacity * 2);
+    for (size_t i = 0; i < mCount; ++i) {
+        slots.push(mSlots.itemAt(slotIndex(i)));
+    }
+    slots.insertAt(sp<ABuffer>(), mCount, capacity * 2 - mCount);
+
+    ALOGV("growing to %zu slots", capacity * 2);
+
+    mSlots = slots;
+    mHead = 0;
+}
+
+}  // namespace android
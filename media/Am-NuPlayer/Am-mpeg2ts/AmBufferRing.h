@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+#ifndef AM_BUFFER_RING_H_
+
+#define AM_BUFFER_RING_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ABuffer;
+
+// FIFO of access units for AmAnotherPacketSource. The slots form a ring
+// that doubles when full and is kept across clear(), so once a stream
+// reached its steady state queueing and dequeueing no longer allocate,
+// unlike List which allocates a node per buffer. Not thread safe.
+struct AmBufferRing {
+    AmBufferRing();
+    ~AmBufferRing();
+
+    bool empty() const { return mCount == 0; }
+    size_t size() const { return mCount; }
+
+    // Index 0 is the oldest buffer.
+    const sp<ABuffer> &itemAt(size_t index) const;
+    const sp<ABuffer> &front() const { return itemAt(0); }
+    const sp<ABuffer> &back() const { return itemAt(mCount - 1); }
+
+    void pushBack(const sp<ABuffer> &buffer);
+    void pushFront(const sp<ABuffer> &buffer);
+    sp<ABuffer> popFront();
+
+    void clear();
+
+private:
+    enum {
+        kInitialCapacity = 64,
+    };
+
+    // Always a power of two.
+    Vector<sp<ABuffer> > mSlots;
+    size_t mHead;
+    size_t mCount;
+
+    size_t slotIndex(size_t index) const {
+        return (mHead + index) & (mSlots.size() - 1);
+    }
+
+    void grow();
+
+    DISALLOW_EVIL_CONSTRUCTORS(AmBufferRing);
+};
+
+}  // namespace android
+
+#endif  // AM_BUFFER_RING_H_
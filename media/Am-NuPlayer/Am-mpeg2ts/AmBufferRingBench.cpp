@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Checks AmBufferRing against List<sp<ABuffer> > with random pushes, pops
+// and clears, then times a steady stream of queue/dequeue pairs at a few
+// queue depths and counts the heap allocations each makes.
+//
+// Then runs AmAnotherPacketSource the way a player does: a demuxer thread
+// queues access units and holds the queue at a given duration, a decoder
+// thread dequeues them, and optionally a third thread polls the buffered
+// duration like the sources polling for buffering. Reports the access
+// units per second and how often the source lock was contended.
+//
+// usage: ambufferringbench [-n operations] [-a access_units]
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AmBufferRingBench"
+#include <utils/Log.h>
+
+#include "AmAnotherPacketSource.h"
+#include "AmBufferRing.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/List.h>
+
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static volatile int32_t gNumMallocs;
+
+// Counts every malloc() in the process, List nodes included.
+extern "C" void *malloc(size_t size) {
+    static void *(*realMalloc)(size_t) = NULL;
+    if (realMalloc == NULL) {
+        realMalloc = (void *(*)(size_t))dlsym(RTLD_NEXT, "malloc");
+    }
+    __sync_fetch_and_add(&gNumMallocs, 1);
+    return realMalloc(size);
+}
+
+namespace android {
+
+static bool verify() {
+    AmBufferRing ring;
+    List<sp<ABuffer> > list;
+
+    for (int n = 0; n < 200000; ++n) {
+        int op = rand() % 8;
+        if (op < 3) {
+            sp<ABuffer> buffer = new ABuffer(0);
+            ring.pushBack(buffer);
+            list.push_back(buffer);
+        } else if (op == 3) {
+            sp<ABuffer> buffer = new ABuffer(0);
+            ring.pushFront(buffer);
+            list.push_front(buffer);
+        } else if (op < 7) {
+            if (!list.empty()) {
+                if (ring.popFront() != *list.begin()) {
+                    fprintf(stderr, "operation %d: wrong buffer dequeued\n", n);
+                    return false;
+                }
+                list.erase(list.begin());
+            }
+        } else if (rand() % 64 == 0) {
+            ring.clear();
+            list.clear();
+        }
+
+        if (ring.size() != list.size()) {
+            fprintf(stderr, "operation %d: %zu buffers queued, expected %zu\n",
+                    n, ring.size(), list.size());
+            return false;
+        }
+
+        size_t index = 0;
+        for (List<sp<ABuffer> >::iterator it = list.begin();
+                it != list.end(); ++it, ++index) {
+            if (ring.itemAt(index) != *it) {
+                fprintf(stderr, "operation %d: wrong buffer at %zu\n", n, index);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static int64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+struct Result {
+    double mNsPerOp;
+    double mMallocsPerOp;
+};
+
+// Keeps "depth" buffers queued while "numOps" more go through, the way a
+// packet source sits between the demuxer and the decoder.
+static Result runRing(
+        const Vector<sp<ABuffer> > &buffers, size_t depth, int numOps) {
+    AmBufferRing ring;
+    for (size_t i = 0; i < depth; ++i) {
+        ring.pushBack(buffers.itemAt(i));
+    }
+
+    int32_t mallocsBefore = gNumMallocs;
+    int64_t startNs = nowNs();
+    for (int n = 0; n < numOps; ++n) {
+        ring.pushBack(buffers.itemAt(n % buffers.size()));
+        ring.popFront();
+    }
+
+    Result result;
+    result.mNsPerOp = (nowNs() - startNs) / (double)numOps;
+    result.mMallocsPerOp = (gNumMallocs - mallocsBefore) / (double)numOps;
+    return result;
+}
+
+static Result runList(
+        const Vector<sp<ABuffer> > &buffers, size_t depth, int numOps) {
+    List<sp<ABuffer> > list;
+    for (size_t i = 0; i < depth; ++i) {
+        list.push_back(buffers.itemAt(i));
+    }
+
+    int32_t mallocsBefore = gNumMallocs;
+    int64_t startNs = nowNs();
+    for (int n = 0; n < numOps; ++n) {
+        list.push_back(buffers.itemAt(n % buffers.size()));
+        list.erase(list.begin());
+    }
+
+    Result result;
+    result.mNsPerOp = (nowNs() - startNs) / (double)numOps;
+    result.mMallocsPerOp = (gNumMallocs - mallocsBefore) / (double)numOps;
+    return result;
+}
+
+// Timestamp step of the access units, 25 fps video.
+static const int64_t kFrameDurationUs = 40000ll;
+
+struct Contention {
+    Contention(int numAccessUnits, int64_t maxBufferedUs, int64_t pollIntervalUs)
+        : mNumAccessUnits(numAccessUnits),
+          mMaxBufferedUs(maxBufferedUs),
+          mPollIntervalUs(pollIntervalUs),
+          mDone(false),
+          mNumDequeued(0),
+          mNumPolls(0) {
+        sp<MetaData> meta = new MetaData;
+        meta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_VIDEO_AVC);
+        mSource = new AmAnotherPacketSource(meta);
+    }
+
+    int mNumAccessUnits;
+    int64_t mMaxBufferedUs;
+    int64_t mPollIntervalUs;  // < 0: no poller
+    sp<AmAnotherPacketSource> mSource;
+
+    volatile bool mDone;
+    int mNumDequeued;
+    int mNumPolls;
+
+    // The demuxer: one new buffer per access unit, as AmESQueue makes
+    // them, and waits while the queue is full as the fetchers do.
+    static void *Produce(void *me) {
+        Contention *c = static_cast<Contention *>(me);
+        for (int n = 0; n < c->mNumAccessUnits; ++n) {
+            sp<ABuffer> buffer = new ABuffer(188);
+            buffer->meta()->setInt64("timeUs", n * kFrameDurationUs);
+
+            status_t finalResult;
+            while (c->mSource->getBufferedDurationUs(&finalResult)
+                    >= c->mMaxBufferedUs) {
+                sched_yield();
+            }
+            c->mSource->queueAccessUnit(buffer);
+        }
+        c->mSource->signalEOS(ERROR_END_OF_STREAM);
+        return NULL;
+    }
+
+    // The decoder.
+    static void *Consume(void *me) {
+        Contention *c = static_cast<Contention *>(me);
+        sp<ABuffer> buffer;
+        while (c->mSource->dequeueAccessUnit(&buffer) == OK) {
+            ++c->mNumDequeued;
+        }
+        c->mDone = true;
+        return NULL;
+    }
+
+    static void *Poll(void *me) {
+        Contention *c = static_cast<Contention *>(me);
+        while (!c->mDone) {
+            status_t finalResult;
+            c->mSource->hasBufferAvailable(&finalResult);
+            c->mSource->getBufferedDurationUs(&finalResult);
+            ++c->mNumPolls;
+            if (c->mPollIntervalUs > 0) {
+                usleep(c->mPollIntervalUs);
+            } else {
+                sched_yield();
+            }
+        }
+        return NULL;
+    }
+};
+
+static bool runContention(
+        int numAccessUnits, int64_t maxBufferedUs, int64_t pollIntervalUs) {
+    Contention c(numAccessUnits, maxBufferedUs, pollIntervalUs);
+
+    int64_t startNs = nowNs();
+    pthread_t producer, consumer, poller;
+    pthread_create(&consumer, NULL, Contention::Consume, &c);
+    pthread_create(&producer, NULL, Contention::Produce, &c);
+    if (pollIntervalUs >= 0) {
+        pthread_create(&poller, NULL, Contention::Poll, &c);
+    }
+
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    if (pollIntervalUs >= 0) {
+        pthread_join(poller, NULL);
+    }
+    int64_t elapsedNs = nowNs() - startNs;
+
+    if (c.mNumDequeued != numAccessUnits) {
+        fprintf(stderr, "%d access units dequeued, expected %d\n",
+                c.mNumDequeued, numAccessUnits);
+        return false;
+    }
+
+    uint64_t numLocks, numContendedLocks;
+    c.mSource->getLockCounts(&numLocks, &numContendedLocks);
+
+    char poll[32];
+    if (pollIntervalUs < 0) {
+        snprintf(poll, sizeof(poll), "none");
+    } else {
+        snprintf(poll, sizeof(poll), "%" PRId64 " us", pollIntervalUs);
+    }
+
+    printf("queue %4" PRId64 " ms  poll %-8s  %8.0f AU/s %6.0f ns/AU  "
+           "%5.2f locks/AU  %9" PRIu64 " contended (%5.2f%%)  %d polls\n",
+           maxBufferedUs / 1000, poll,
+           numAccessUnits * 1E9 / elapsedNs, elapsedNs / (double)numAccessUnits,
+           numLocks / (double)numAccessUnits, numContendedLocks,
+           numLocks > 0 ? numContendedLocks * 100.0 / numLocks : 0.0,
+           c.mNumPolls);
+    return true;
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n operations] [-a access_units]\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int numOps = 10000000;
+    int numAccessUnits = 1000000;
+
+    int res;
+    while ((res = getopt(argc, argv, "n:a:h")) >= 0) {
+        switch (res) {
+            case 'n':
+                numOps = atoi(optarg);
+                break;
+            case 'a':
+                numAccessUnits = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    if (numOps <= 0 || numAccessUnits <= 0) {
+        usage(me);
+    }
+
+    srand(1);
+
+    if (!verify()) {
+        return 1;
+    }
+
+    static const size_t kDepths[] = { 8, 64, 512, 4096 };
+
+    Vector<sp<ABuffer> > buffers;
+    for (size_t i = 0; i < kDepths[NELEM(kDepths) - 1] * 2; ++i) {
+        buffers.push(new ABuffer(0));
+    }
+
+    for (size_t i = 0; i < NELEM(kDepths); ++i) {
+        Result list = runList(buffers, kDepths[i], numOps);
+        Result ring = runRing(buffers, kDepths[i], numOps);
+
+        printf("depth %4zu  list: %6.1f ns/op %4.2f mallocs/op  "
+               "ring: %6.1f ns/op %4.2f mallocs/op\n",
+               kDepths[i], list.mNsPerOp, list.mMallocsPerOp,
+               ring.mNsPerOp, ring.mMallocsPerOp);
+    }
+
+    // A short and a long queue, each without a poller, with one polling
+    // every millisecond and with one polling back to back.
+    static const int64_t kBufferedUs[] = { 200000ll, 4000000ll };
+    static const int64_t kPollIntervalsUs[] = { -1, 1000, 0 };
+
+    for (size_t i = 0; i < NELEM(kBufferedUs); ++i) {
+        for (size_t j = 0; j < NELEM(kPollIntervalsUs); ++j) {
+            if (!runContention(numAccessUnits, kBufferedUs[i], kPollIntervalsUs[j])) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -19,6 +19,7 @@
 #include <media/stagefright/foundation/ADebug.h>
 
 #include "AmESQueue.h"
+#include "AmSyncScan.h"
 
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/foundation/ABitReader.h>
@@ -37,6 +38,12 @@
 
 namespace android {
 
+// H.264/H.265 access units are handed out as slices of the queue storage.
+// A slice keeps its whole block alive, so blocks are kept moderately sized
+// and access units below kMinSliceSize are copied out instead of sliced.
+static const size_t kMinVideoBufferSize = 256 * 1024;
+static const size_t kMinSliceSize = 16 * 1024;
+
 AmElementaryStreamQueue::AmElementaryStreamQueue(Mode mode, uint32_t flags)
     : mMode(mode),
       mFlags(flags),
@@ -55,7 +62,7 @@ int32_t AmElementaryStreamQueue::getStreamType() {
 
 void AmElementaryStreamQueue::clear(bool clearFormat) {
     if (mBuffer != NULL) {
-        mBuffer->setRange(0, 0);
+        consumeData(mBuffer->size());
     }
 
     mRangeInfos.clear();
@@ -65,6 +72,77 @@ void AmElementaryStreamQueue::clear(bool clearFormat) {
     }
 }
 
+void AmElementaryStreamQueue::reserveBuffer(size_t neededSize) {
+    if (mBuffer != NULL && mBuffer->getStrongCount() == 1
+            && neededSize <= mBuffer->capacity()) {
+        // Nobody else references the storage, compact it in place.
+        memmove(mBuffer->base(), mBuffer->data(), mBuffer->size());
+        mBuffer->setRange(0, mBuffer->size());
+        return;
+    }
+
+    // Dequeued access units may still point into the current storage,
+    // carry the unconsumed bytes over to another block instead.
+    sp<ABuffer> buffer;
+    if (mSpareBuffer != NULL && mSpareBuffer->getStrongCount() == 1
+            && neededSize <= mSpareBuffer->capacity()) {
+        buffer = mSpareBuffer;
+        mSpareBuffer.clear();
+    } else {
+        size_t capacity = (neededSize + 65535) & ~65535;
+        if ((mMode == H264 || mMode == H265)
+                && capacity < kMinVideoBufferSize) {
+            capacity = kMinVideoBufferSize;
+        }
+
+        ALOGV("resizing buffer to size %zu", capacity);
+
+        buffer = new ABuffer(capacity);
+    }
+
+    if (mBuffer != NULL) {
+        memcpy(buffer->base(), mBuffer->data(), mBuffer->size());
+        buffer->setRange(0, mBuffer->size());
+
+        if (mBuffer->getStrongCount() > 1) {
+            mSpareBuffer = mBuffer;
+        }
+    } else {
+        buffer->setRange(0, 0);
+    }
+
+    mBuffer = buffer;
+}
+
+void AmElementaryStreamQueue::consumeData(size_t size) {
+    CHECK_LE(size, mBuffer->size());
+
+    size_t remaining = mBuffer->size() - size;
+    if (remaining == 0 && mBuffer->getStrongCount() == 1) {
+        mBuffer->setRange(0, 0);
+    } else {
+        mBuffer->setRange(mBuffer->offset() + size, remaining);
+    }
+}
+
+sp<ABuffer> AmElementaryStreamQueue::sliceBuffer(size_t offset, size_t size) {
+    CHECK_LE(offset + size, mBuffer->size());
+
+    if (size < kMinSliceSize) {
+        sp<ABuffer> copy = new ABuffer(size);
+        memcpy(copy->data(), mBuffer->data() + offset, size);
+        return copy;
+    }
+
+    sp<ABuffer> slice = new ABuffer(mBuffer->data() + offset, size);
+
+    // Keeps the storage alive, reserveBuffer() never writes over bytes
+    // that are still referenced.
+    slice->meta()->setBuffer("storage", mBuffer);
+
+    return slice;
+}
+
 // Parse AC3 header assuming the current ptr is start position of syncframe,
 // update metadata only applicable, and return the payload size
 static unsigned parseAC3SyncFrame(
@@ -294,6 +372,85 @@ static bool IsSeeminglyValidDTSAudioHeader(const uint8_t *ptr, size_t size)
     return false;
 }
 
+// The finders below let the sync scanner skip to the next plausible sync
+// word and only run the full header check on those candidates.
+
+static ssize_t FindADTSHeader(
+        const uint8_t *ptr, size_t size, size_t *frameLength) {
+    size_t offset = 0;
+    for (;;) {
+        // syncword 0xfff, layer 0
+        ssize_t pos = AmFindSyncWord(
+                &ptr[offset], size - offset, 0xff, 0xf6, 0xf0);
+        if (pos < 0) {
+            return -1;
+        }
+        offset += pos;
+        if (IsSeeminglyValidADTSHeader(
+                &ptr[offset], size - offset, frameLength)) {
+            return offset;
+        }
+        ++offset;
+    }
+}
+
+static ssize_t FindMPEGAudioHeader(const uint8_t *ptr, size_t size) {
+    size_t offset = 0;
+    for (;;) {
+        ssize_t pos = AmFindSyncWord(
+                &ptr[offset], size - offset, 0xff, 0xe0, 0xe0);
+        if (pos < 0) {
+            return -1;
+        }
+        offset += pos;
+        if (IsSeeminglyValidMPEGAudioHeader(&ptr[offset], size - offset)) {
+            return offset;
+        }
+        ++offset;
+    }
+}
+
+static ssize_t FindDDPAudioHeader(const uint8_t *ptr, size_t size) {
+    static const uint8_t kFirstBytes[] = { 0x0b, 0x77 };
+
+    size_t offset = 0;
+    for (;;) {
+        ssize_t pos = AmFindAnyByte(
+                &ptr[offset], size - offset,
+                kFirstBytes, sizeof(kFirstBytes));
+        if (pos < 0) {
+            return -1;
+        }
+        offset += pos;
+        if (IsSeeminglyValidDDPAudioHeader(&ptr[offset], size - offset)) {
+            return offset;
+        }
+        ++offset;
+    }
+}
+
+static ssize_t FindDTSAudioHeader(const uint8_t *ptr, size_t size) {
+    // First bytes of all the sync words IsSeeminglyValidDTSAudioHeader accepts.
+    static const uint8_t kFirstBytes[] = {
+        0x7f, 0x1f, 0xfe, 0xff, 0x80, 0x64, 0x58
+    };
+
+    size_t offset = 0;
+    for (;;) {
+        ssize_t pos = AmFindAnyByte(
+                &ptr[offset], size - offset,
+                kFirstBytes, sizeof(kFirstBytes));
+        if (pos < 0) {
+            return -1;
+        }
+        offset += pos;
+        if (IsSeeminglyValidDTSAudioHeader(&ptr[offset], size - offset)) {
+            return offset;
+        }
+        ++offset;
+    }
+}
+
 status_t AmElementaryStreamQueue::appendData(
         const void *data, size_t size, int64_t timeUs) {
     if (mBuffer == NULL || mBuffer->size() == 0) {
@@ -302,24 +459,15 @@ status_t AmElementaryStreamQueue::appendData(
         // so we check audio only.
         // maybe need to change.
         if (mMode == UNKNOWN_MODE) {
-            uint8_t *ptr = (uint8_t *)data;
-            for (size_t i = 0; i < size; ++i) {
-                if (IsSeeminglyValidDTSAudioHeader(&ptr[i], size - i)) {
-                    mMode = DTS;
-                    mStreamType = 1;
-                    ALOGI("We got DTS type here!");
-                    break;
-                }
-            }
-            if (mMode == UNKNOWN_MODE) {
-                for (size_t i = 0; i < size; ++i) {
-                    if (IsSeeminglyValidDDPAudioHeader(&ptr[i], size - i)) {
-                        mMode = DDP_AC3_AUDIO;
-                        mStreamType = 1;
-                        ALOGI("We got AC3 type here!");
-                        break;
-                    }
-                }
+            const uint8_t *ptr = (const uint8_t *)data;
+            if (FindDTSAudioHeader(ptr, size) >= 0) {
+                mMode = DTS;
+                mStreamType = 1;
+                ALOGI("We got DTS type here!");
+            } else if (FindDDPAudioHeader(ptr, size) >= 0) {
+                mMode = DDP_AC3_AUDIO;
+                mStreamType = 1;
+                ALOGI("We got AC3 type here!");
             }
         }
 
@@ -339,13 +487,7 @@ status_t AmElementaryStreamQueue::appendData(
 #else
                 uint8_t *ptr = (uint8_t *)data;
 
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i + 2 < size; ++i) {
-                    if (!memcmp("\x00\x00\x01", &ptr[i], 3)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
+                ssize_t startOffset = AmFindStartCode(ptr, size);
 
                 if (startOffset < 0) {
                     return ERROR_MALFORMED;
@@ -372,13 +514,7 @@ status_t AmElementaryStreamQueue::appendData(
 #else
                 uint8_t *ptr = (uint8_t *)data;
 
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i + 2 < size; ++i) {
-                    if (!memcmp("\x00\x00\x01", &ptr[i], 3)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
+                ssize_t startOffset = AmFindStartCode(ptr, size);
 
                 if (startOffset < 0) {
                     return ERROR_MALFORMED;
@@ -405,15 +541,8 @@ status_t AmElementaryStreamQueue::appendData(
                     return ERROR_MALFORMED;
                 }
 #else
-                ssize_t startOffset = -1;
                 size_t frameLength;
-                for (size_t i = 0; i < size; ++i) {
-                    if (IsSeeminglyValidADTSHeader(
-                            &ptr[i], size - i, &frameLength)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
+                ssize_t startOffset = FindADTSHeader(ptr, size, &frameLength);
 
                 if (startOffset < 0) {
                     return ERROR_MALFORMED;
@@ -441,13 +570,7 @@ status_t AmElementaryStreamQueue::appendData(
             {
                 uint8_t *ptr = (uint8_t *)data;
 
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i < size; ++i) {
-                    if (IsSeeminglyValidMPEGAudioHeader(&ptr[i], size - i)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
+                ssize_t startOffset = FindMPEGAudioHeader(ptr, size);
 
                 if (startOffset < 0) {
                     return ERROR_MALFORMED;
@@ -476,13 +599,7 @@ status_t AmElementaryStreamQueue::appendData(
             {
                 uint8_t *ptr = (uint8_t *)data;
 
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i < size; ++i) {
-                    if (IsSeeminglyValidDDPAudioHeader(&ptr[i], size - i)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
+                ssize_t startOffset = FindDDPAudioHeader(ptr, size);
 
                 if (startOffset < 0) {
                     return ERROR_MALFORMED;
@@ -504,13 +621,7 @@ status_t AmElementaryStreamQueue::appendData(
             case DTS:
             {
                 uint8_t *ptr = (uint8_t *)data;
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i < size; ++i) {
-                    if (IsSeeminglyValidDTSAudioHeader(&ptr[i], size - i)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
+                ssize_t startOffset = FindDTSAudioHeader(ptr, size);
 
                 if (startOffset < 0) {
                     return ERROR_MALFORMED;
@@ -534,24 +645,13 @@ status_t AmElementaryStreamQueue::appendData(
     }
 
     size_t neededSize = (mBuffer == NULL ? 0 : mBuffer->size()) + size;
-    if (mBuffer == NULL || neededSize > mBuffer->capacity()) {
-        neededSize = (neededSize + 65535) & ~65535;
-
-        ALOGV("resizing buffer to size %zu", neededSize);
-
-        sp<ABuffer> buffer = new ABuffer(neededSize);
-        if (mBuffer != NULL) {
-            memcpy(buffer->data(), mBuffer->data(), mBuffer->size());
-            buffer->setRange(0, mBuffer->size());
-        } else {
-            buffer->setRange(0, 0);
-        }
-
-        mBuffer = buffer;
+    if (mBuffer == NULL
+            || mBuffer->offset() + neededSize > mBuffer->capacity()) {
+        reserveBuffer(neededSize);
     }
 
     memcpy(mBuffer->data() + mBuffer->size(), data, size);
-    mBuffer->setRange(0, mBuffer->size() + size);
+    mBuffer->setRange(mBuffer->offset(), mBuffer->size() + size);
 
     RangeInfo info;
     info.mLength = size;
@@ -577,15 +677,10 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnit() {
         RangeInfo info = *mRangeInfos.begin();
         mRangeInfos.erase(mRangeInfos.begin());
 
-        sp<ABuffer> accessUnit = new ABuffer(info.mLength);
-        memcpy(accessUnit->data(), mBuffer->data(), info.mLength);
+        sp<ABuffer> accessUnit = sliceBuffer(0, info.mLength);
         accessUnit->meta()->setInt64("timeUs", info.mTimestampUs);
 
-        memmove(mBuffer->data(),
-                mBuffer->data() + info.mLength,
-                mBuffer->size() - info.mLength);
-
-        mBuffer->setRange(0, mBuffer->size() - info.mLength);
+        consumeData(info.mLength);
 
         if (mFormat == NULL) {
             mFormat = MakeAVCCodecSpecificData(accessUnit);
@@ -675,12 +770,7 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitPCMAudio() {
         ptr[i] = ntohs(ptr[i]);
     }
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + 4 + payloadSize,
-            mBuffer->size() - 4 - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - 4 - payloadSize);
+    consumeData(4 + payloadSize);
 
     return accessUnit;
 }
@@ -814,9 +904,7 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitAAC() {
     sp<ABuffer> accessUnit = new ABuffer(offset);
     memcpy(accessUnit->data(), mBuffer->data(), offset);
 
-    memmove(mBuffer->data(), mBuffer->data() + offset,
-            mBuffer->size() - offset);
-    mBuffer->setRange(0, mBuffer->size() - offset);
+    consumeData(offset);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
     return accessUnit;
@@ -902,8 +990,7 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitDDP() {
     // Put data into buffer
     memcpy(accessUnit->data(), mBuffer->data(), frame_size);
 
-    memmove(mBuffer->data(), mBuffer->data() + frame_size, mBuffer->size() - frame_size);
-    mBuffer->setRange(0, mBuffer->size() - frame_size);
+    consumeData(frame_size);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
     if (timeUs >= 0) {
@@ -985,8 +1072,7 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitDTS() {
         if (flush) {
             sp<ABuffer> accessUnit = new ABuffer(offset);
             memcpy(accessUnit->data(), buf, offset);
-            memmove(mBuffer->data(), mBuffer->data() + offset, mBuffer->size() - offset);
-            mBuffer->setRange(0, mBuffer->size() - offset);
+            consumeData(offset);
             int64_t timeUs = fetchTimestamp(offset);
             accessUnit->meta()->setInt64("timeUs", timeUs);
             if (mFormat == NULL) {
@@ -1084,6 +1170,31 @@ struct NALPosition {
     size_t nalSize;
 };
 */
+
+// Returns true if the NAL units are laid out back to back in "data", each
+// preceded by a 4-byte startcode, i.e. the access unit already exists in
+// its final form and does not need to be reassembled.
+static bool IsContiguousAccessUnit(
+        const uint8_t *data, const Vector<NALPosition> &nals) {
+    size_t expectedOffset = 4;
+    for (size_t i = 0; i < nals.size(); ++i) {
+        const NALPosition &pos = nals.itemAt(i);
+
+        if (i == 0 && pos.nalOffset < 4) {
+            return false;
+        }
+
+        if ((i > 0 && pos.nalOffset != expectedOffset)
+                || memcmp(data + pos.nalOffset - 4, "\x00\x00\x00\x01", 4)) {
+            return false;
+        }
+
+        expectedOffset = pos.nalOffset + pos.nalSize + 4;
+    }
+
+    return true;
+}
+
 sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitH265() {
     const uint8_t *data = mBuffer->data();
     size_t size = mBuffer->size();
@@ -1133,22 +1244,24 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitH265() {
         }
         if (flush) {
             size_t auSize = 4 * nals.size() + totalSize;
-            sp<ABuffer> accessUnit = new ABuffer(auSize);
-            size_t dstOffset = 0;
-            for (size_t i = 0; i < nals.size(); ++i) {
-                const NALPosition &pos = nals.itemAt(i);
-                memcpy(accessUnit->data() + dstOffset, "\x00\x00\x00\x01", 4);
-                memcpy(accessUnit->data() + dstOffset + 4,
-                       mBuffer->data() + pos.nalOffset,
-                       pos.nalSize);
-                dstOffset += pos.nalSize + 4;
+            sp<ABuffer> accessUnit;
+            if (IsContiguousAccessUnit(mBuffer->data(), nals)) {
+                accessUnit = sliceBuffer(nals.itemAt(0).nalOffset - 4, auSize);
+            } else {
+                accessUnit = new ABuffer(auSize);
+                size_t dstOffset = 0;
+                for (size_t i = 0; i < nals.size(); ++i) {
+                    const NALPosition &pos = nals.itemAt(i);
+                    memcpy(accessUnit->data() + dstOffset, "\x00\x00\x00\x01", 4);
+                    memcpy(accessUnit->data() + dstOffset + 4,
+                           mBuffer->data() + pos.nalOffset,
+                           pos.nalSize);
+                    dstOffset += pos.nalSize + 4;
+                }
             }
             const NALPosition &pos = nals.itemAt(nals.size() - 1);
             size_t nextScan = pos.nalOffset + pos.nalSize;
-            memmove(mBuffer->data(),
-                    mBuffer->data() + nextScan,
-                    mBuffer->size() - nextScan);
-            mBuffer->setRange(0, mBuffer->size() - nextScan);
+            consumeData(nextScan);
             int64_t timeUs = fetchTimestamp(nextScan);
             int keyframe = (nalType >= 16 && nalType <= 23);
             accessUnit->meta()->setInt64("timeUs", timeUs);
@@ -1207,8 +1320,18 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitH264() {
             // The access unit will contain all nal units up to, but excluding
             // the current one, separated by 0x00 0x00 0x00 0x01 startcodes.
 
+            // If the NAL units are already separated by 4-byte startcodes
+            // the access unit references the queued data instead of being
+            // copied out of it.
+
             size_t auSize = 4 * nals.size() + totalSize;
-            sp<ABuffer> accessUnit = new ABuffer(auSize);
+            bool contiguous = IsContiguousAccessUnit(mBuffer->data(), nals);
+            sp<ABuffer> accessUnit;
+            if (contiguous) {
+                accessUnit = sliceBuffer(nals.itemAt(0).nalOffset - 4, auSize);
+            } else {
+                accessUnit = new ABuffer(auSize);
+            }
 
 #if !LOG_NDEBUG
             AString out;
@@ -1221,8 +1344,7 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitH264() {
                 unsigned nalType = mBuffer->data()[pos.nalOffset] & 0x1f;
 
                 if (nalType == 6) {
-                    sp<ABuffer> sei = new ABuffer(pos.nalSize);
-                    memcpy(sei->data(), mBuffer->data() + pos.nalOffset, pos.nalSize);
+                    sp<ABuffer> sei = sliceBuffer(pos.nalOffset, pos.nalSize);
                     accessUnit->meta()->setBuffer("sei", sei);
                 }
 
@@ -1235,6 +1357,10 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitH264() {
                 out.append(tmp);
 #endif
 
+                if (contiguous) {
+                    continue;
+                }
+
                 memcpy(accessUnit->data() + dstOffset, "\x00\x00\x00\x01", 4);
 
                 memcpy(accessUnit->data() + dstOffset + 4,
@@ -1251,11 +1377,7 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitH264() {
             const NALPosition &pos = nals.itemAt(nals.size() - 1);
             size_t nextScan = pos.nalOffset + pos.nalSize;
 
-            memmove(mBuffer->data(),
-                    mBuffer->data() + nextScan,
-                    mBuffer->size() - nextScan);
-
-            mBuffer->setRange(0, mBuffer->size() - nextScan);
+            consumeData(nextScan);
 
             int64_t timeUs = fetchTimestamp(nextScan);
             CHECK_GE(timeUs, 0ll);
@@ -1314,11 +1436,7 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitMPEGAudio() {
     sp<ABuffer> accessUnit = new ABuffer(frameSize);
     memcpy(accessUnit->data(), data, frameSize);
 
-    memmove(mBuffer->data(),
-            mBuffer->data() + frameSize,
-            mBuffer->size() - frameSize);
-
-    mBuffer->setRange(0, mBuffer->size() - frameSize);
+    consumeData(frameSize);
 
     int64_t timeUs = fetchTimestamp(frameSize);
     CHECK_GE(timeUs, 0ll);
@@ -1403,21 +1521,23 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
 
     size_t offset = 0;
     while (offset + 3 < size) {
-        if (memcmp(&data[offset], "\x00\x00\x01", 3)) {
-            ++offset;
-            continue;
+        // the startcode must leave room for the byte following it
+        ssize_t pos = AmFindStartCode(&data[offset], size - 1 - offset);
+        if (pos < 0) {
+            break;
         }
+        offset += pos;
 
         pprevStartCode = prevStartCode;
         prevStartCode = currentStartCode;
         currentStartCode = data[offset + 3];
 
         if (currentStartCode == 0xb3 && mFormat == NULL) {
-            memmove(mBuffer->data(), mBuffer->data() + offset, size - offset);
+            consumeData(offset);
+            data = mBuffer->data();
             size -= offset;
             (void)fetchTimestamp(offset);
             offset = 0;
-            mBuffer->setRange(0, size);
         }
 
         if ((prevStartCode == 0xb3 && currentStartCode != 0xb5)
@@ -1446,11 +1566,7 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
                 sp<ABuffer> csd = new ABuffer(offset);
                 memcpy(csd->data(), data, offset);
 
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                consumeData(offset);
                 size -= offset;
                 (void)fetchTimestamp(offset);
                 offset = 0;
@@ -1474,11 +1590,7 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
                 sp<ABuffer> accessUnit = new ABuffer(offset);
                 memcpy(accessUnit->data(), data, offset);
 
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                consumeData(offset);
 
                 int64_t timeUs = fetchTimestamp(offset);
                 CHECK_GE(timeUs, 0ll);
@@ -1514,13 +1626,9 @@ static ssize_t getNextChunkSize(
         TRESPASS();
     }
 
-    size_t offset = 3;
-    while (offset + 2 < size) {
-        if (!memcmp(&data[offset], kStartCode, 3)) {
-            return offset;
-        }
-
-        ++offset;
+    ssize_t offset = AmFindStartCode(&data[3], size - 3);
+    if (offset >= 0) {
+        return offset + 3;
     }
 
     return -EAGAIN;
@@ -1647,9 +1755,9 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
                     sp<ABuffer> accessUnit = new ABuffer(offset);
                     memcpy(accessUnit->data(), data, offset);
 
-                    memmove(data, &data[offset], size - offset);
+                    consumeData(offset);
+                    data = mBuffer->data();
                     size -= offset;
-                    mBuffer->setRange(0, size);
 
                     int64_t timeUs = fetchTimestamp(offset);
                     CHECK_GE(timeUs, 0ll);
@@ -1678,10 +1786,10 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
         if (discard) {
             (void)fetchTimestamp(offset);
-            memmove(data, &data[offset], size - offset);
+            consumeData(offset);
+            data = mBuffer->data();
             size -= offset;
             offset = 0;
-            mBuffer->setRange(0, size);
         } else {
             offset += chunkSize;
         }
@@ -1701,7 +1809,7 @@ sp<ABuffer> AmElementaryStreamQueue::dequeueAccessUnitMetadata() {
     accessUnit->meta()->setInt64("timeUs", timeUs);
 
     memcpy(accessUnit->data(), mBuffer->data(), size);
-    mBuffer->setRange(0, 0);
+    consumeData(size);
 
     if (mFormat == NULL) {
         mFormat = new MetaData;
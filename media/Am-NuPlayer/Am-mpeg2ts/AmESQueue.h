@@ -86,6 +86,9 @@ private:
     bool mHevcFindKey;
 
     sp<ABuffer> mBuffer;
+    // Previous storage block, kept for reuse once no dequeued access unit
+    // references it anymore.
+    sp<ABuffer> mSpareBuffer;
     List<RangeInfo> mRangeInfos;
 
     sp<MetaData> mFormat;
@@ -103,6 +106,17 @@ private:
     sp<ABuffer> dequeueAccessUnitDTS();
     sp<ABuffer> dequeueAccessUnitMetadata();
 
+    // make room for "neededSize" bytes of queued data, moving the
+    // unconsumed bytes to the front or into another storage block.
+    void reserveBuffer(size_t neededSize);
+
+    // drop "size" bytes from the front of the queued data.
+    void consumeData(size_t size);
+
+    // returns an access unit referencing queued data in place, small
+    // access units are copied so they do not pin the storage block.
+    sp<ABuffer> sliceBuffer(size_t offset, size_t size);
+
     // consume a logical (compressed) access unit of size "size",
     // returns its timestamp in us (or -1 if no time information).
     int64_t fetchTimestamp(size_t size);
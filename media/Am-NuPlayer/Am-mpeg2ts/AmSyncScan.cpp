@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "NU-SyncScan"
+#include <media/stagefright/foundation/ADebug.h>
+
+#include "AmSyncScan.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON) || defined(__aarch64__)
+#define AM_SCAN_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define AM_SCAN_SSE2 1
+#include <emmintrin.h>
+// The AVX2 loops are built for every x86 target and only used when the CPU
+// has it, see SelectScanner().
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define AM_SCAN_AVX2 1
+#include <immintrin.h>
+#include <pthread.h>
+#endif
+#endif
+
+namespace android {
+
+// All vector variants test a whole block of candidate positions at once
+// and return a bitmask with one bit (x86) or one nibble (NEON) per
+// position. The scalar loops below finish whatever is left over.
+
+#if defined(AM_SCAN_NEON)
+
+enum {
+    kScanBlock = 16,
+};
+
+// Packs a 16 byte compare result into 4 bits per lane.
+static inline uint64_t NeonMask(uint8x16_t cmp) {
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+static inline size_t MaskToOffset(uint64_t mask) {
+    return __builtin_ctzll(mask) >> 2;
+}
+
+static inline uint64_t StartCodeMask(const uint8_t *ptr) {
+    uint8x16_t b0 = vceqq_u8(vld1q_u8(ptr), vdupq_n_u8(0));
+    uint8x16_t b1 = vceqq_u8(vld1q_u8(ptr + 1), vdupq_n_u8(0));
+    uint8x16_t b2 = vceqq_u8(vld1q_u8(ptr + 2), vdupq_n_u8(1));
+    return NeonMask(vandq_u8(vandq_u8(b0, b1), b2));
+}
+
+static inline uint64_t SyncWordMask(
+        const uint8_t *ptr, uint8_t first, uint8_t mask, uint8_t second) {
+    uint8x16_t b0 = vceqq_u8(vld1q_u8(ptr), vdupq_n_u8(first));
+    uint8x16_t b1 = vceqq_u8(
+            vandq_u8(vld1q_u8(ptr + 1), vdupq_n_u8(mask)),
+            vdupq_n_u8(second));
+    return NeonMask(vandq_u8(b0, b1));
+}
+
+static inline uint64_t AnyByteMask(
+        const uint8_t *ptr, const uint8_t *values, size_t count) {
+    uint8x16_t block = vld1q_u8(ptr);
+    uint8x16_t hits = vdupq_n_u8(0);
+    for (size_t i = 0; i < count; ++i) {
+        hits = vorrq_u8(hits, vceqq_u8(block, vdupq_n_u8(values[i])));
+    }
+    return NeonMask(hits);
+}
+
+#elif defined(AM_SCAN_SSE2)
+
+enum {
+    kScanBlock = 16,
+};
+
+static inline size_t MaskToOffset(uint64_t mask) {
+    return __builtin_ctzll(mask);
+}
+
+static inline __m128i Load(const uint8_t *ptr) {
+    return _mm_loadu_si128((const __m128i *)ptr);
+}
+
+static inline uint64_t StartCodeMask(const uint8_t *ptr) {
+    __m128i b0 = _mm_cmpeq_epi8(Load(ptr), _mm_setzero_si128());
+    __m128i b1 = _mm_cmpeq_epi8(Load(ptr + 1), _mm_setzero_si128());
+    __m128i b2 = _mm_cmpeq_epi8(Load(ptr + 2), _mm_set1_epi8(1));
+    return (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(b0, b1), b2));
+}
+
+static inline uint64_t SyncWordMask(
+        const uint8_t *ptr, uint8_t first, uint8_t mask, uint8_t second) {
+    __m128i b0 = _mm_cmpeq_epi8(Load(ptr), _mm_set1_epi8(first));
+    __m128i b1 = _mm_cmpeq_epi8(
+            _mm_and_si128(Load(ptr + 1), _mm_set1_epi8(mask)),
+            _mm_set1_epi8(second));
+    return (uint32_t)_mm_movemask_epi8(_mm_and_si128(b0, b1));
+}
+
+static inline uint64_t AnyByteMask(
+        const uint8_t *ptr, const uint8_t *values, size_t count) {
+    __m128i block = Load(ptr);
+    __m128i hits = _mm_setzero_si128();
+    for (size_t i = 0; i < count; ++i) {
+        hits = _mm_or_si128(
+                hits, _mm_cmpeq_epi8(block, _mm_set1_epi8(values[i])));
+    }
+    return (uint32_t)_mm_movemask_epi8(hits);
+}
+
+#endif
+
+#if defined(AM_SCAN_AVX2)
+
+enum {
+    kAvx2Block = 32,
+};
+
+static inline __attribute__((target("avx2")))
+__m256i Load32(const uint8_t *ptr) {
+    return _mm256_loadu_si256((const __m256i *)ptr);
+}
+
+static inline __attribute__((target("avx2")))
+uint32_t StartCodeMaskAvx2(const uint8_t *ptr) {
+    __m256i b0 = _mm256_cmpeq_epi8(Load32(ptr), _mm256_setzero_si256());
+    __m256i b1 = _mm256_cmpeq_epi8(Load32(ptr + 1), _mm256_setzero_si256());
+    __m256i b2 = _mm256_cmpeq_epi8(Load32(ptr + 2), _mm256_set1_epi8(1));
+    return (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_and_si256(b0, b1), b2));
+}
+
+static inline __attribute__((target("avx2")))
+uint32_t SyncWordMaskAvx2(
+        const uint8_t *ptr, uint8_t first, uint8_t mask, uint8_t second) {
+    __m256i b0 = _mm256_cmpeq_epi8(Load32(ptr), _mm256_set1_epi8(first));
+    __m256i b1 = _mm256_cmpeq_epi8(
+            _mm256_and_si256(Load32(ptr + 1), _mm256_set1_epi8(mask)),
+            _mm256_set1_epi8(second));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(b0, b1));
+}
+
+static inline __attribute__((target("avx2")))
+uint32_t AnyByteMaskAvx2(
+        const uint8_t *ptr, const uint8_t *values, size_t count) {
+    __m256i block = Load32(ptr);
+    __m256i hits = _mm256_setzero_si256();
+    for (size_t i = 0; i < count; ++i) {
+        hits = _mm256_or_si256(
+                hits, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(values[i])));
+    }
+    return (uint32_t)_mm256_movemask_epi8(hits);
+}
+
+// These stop where less than a block is left, with "*pos" at the first
+// position not looked at, and leave the rest to the SSE2 and C loops.
+
+static __attribute__((target("avx2")))
+ssize_t FindStartCodeAvx2(const uint8_t *data, size_t size, size_t *pos) {
+    size_t i = *pos;
+    while (i + kAvx2Block + 2 <= size) {
+        uint32_t mask = StartCodeMaskAvx2(&data[i]);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+        i += kAvx2Block;
+    }
+    *pos = i;
+    return -1;
+}
+
+static __attribute__((target("avx2")))
+ssize_t FindSyncWordAvx2(
+        const uint8_t *data, size_t size, size_t *pos,
+        uint8_t first, uint8_t mask, uint8_t second) {
+    size_t i = *pos;
+    while (i + kAvx2Block + 1 <= size) {
+        uint32_t hits = SyncWordMaskAvx2(&data[i], first, mask, second);
+        if (hits != 0) {
+            return i + __builtin_ctz(hits);
+        }
+        i += kAvx2Block;
+    }
+    *pos = i;
+    return -1;
+}
+
+static __attribute__((target("avx2")))
+ssize_t FindAnyByteAvx2(
+        const uint8_t *data, size_t size, size_t *pos,
+        const uint8_t *values, size_t count) {
+    size_t i = *pos;
+    while (i + kAvx2Block <= size) {
+        uint32_t hits = AnyByteMaskAvx2(&data[i], values, count);
+        if (hits != 0) {
+            return i + __builtin_ctz(hits);
+        }
+        i += kAvx2Block;
+    }
+    *pos = i;
+    return -1;
+}
+
+static pthread_once_t sScannerOnce = PTHREAD_ONCE_INIT;
+static bool sUseAvx2 = false;
+
+static void SelectScanner() {
+    __builtin_cpu_init();
+    sUseAvx2 = __builtin_cpu_supports("avx2");
+    ALOGV("scanners use %s", sUseAvx2 ? "avx2" : "sse2");
+}
+
+static inline bool UseAvx2() {
+    pthread_once(&sScannerOnce, SelectScanner);
+    return sUseAvx2;
+}
+
+#endif
+
+ssize_t AmFindStartCode(const uint8_t *data, size_t size) {
+    size_t i = 0;
+
+#if defined(AM_SCAN_AVX2)
+    if (UseAvx2()) {
+        ssize_t found = FindStartCodeAvx2(data, size, &i);
+        if (found >= 0) {
+            return found;
+        }
+    }
+#endif
+
+#if defined(AM_SCAN_NEON) || defined(AM_SCAN_SSE2)
+    // Each block reads two bytes past the last candidate position.
+    while (i + kScanBlock + 2 <= size) {
+        uint64_t mask = StartCodeMask(&data[i]);
+        if (mask != 0) {
+            return i + MaskToOffset(mask);
+        }
+        i += kScanBlock;
+    }
+#endif
+
+    for (; i + 2 < size; ++i) {
+        if (data[i] == 0x00 && data[i + 1] == 0x00 && data[i + 2] == 0x01) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+ssize_t AmFindSyncWord(
+        const uint8_t *data, size_t size,
+        uint8_t first, uint8_t mask, uint8_t second) {
+    size_t i = 0;
+
+#if defined(AM_SCAN_AVX2)
+    if (UseAvx2()) {
+        ssize_t found = FindSyncWordAvx2(data, size, &i, first, mask, second);
+        if (found >= 0) {
+            return found;
+        }
+    }
+#endif
+
+#if defined(AM_SCAN_NEON) || defined(AM_SCAN_SSE2)
+    while (i + kScanBlock + 1 <= size) {
+        uint64_t hits = SyncWordMask(&data[i], first, mask, second);
+        if (hits != 0) {
+            return i + MaskToOffset(hits);
+        }
+        i += kScanBlock;
+    }
+#endif
+
+    for (; i + 1 < size; ++i) {
+        if (data[i] == first && (data[i + 1] & mask) == second) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+ssize_t AmFindAnyByte(
+        const uint8_t *data, size_t size,
+        const uint8_t *values, size_t count) {
+    CHECK_LE(count, (size_t)kMaxScanValues);
+
+    size_t i = 0;
+
+#if defined(AM_SCAN_AVX2)
+    if (UseAvx2()) {
+        ssize_t found = FindAnyByteAvx2(data, size, &i, values, count);
+        if (found >= 0) {
+            return found;
+        }
+    }
+#endif
+
+#if defined(AM_SCAN_NEON) || defined(AM_SCAN_SSE2)
+    while (i + kScanBlock <= size) {
+        uint64_t hits = AnyByteMask(&data[i], values, count);
+        if (hits != 0) {
+            return i + MaskToOffset(hits);
+        }
+        i += kScanBlock;
+    }
+#endif
+
+    for (; i < size; ++i) {
+        for (size_t j = 0; j < count; ++j) {
+            if (data[i] == values[j]) {
+                return i;
+            }
+        }
+    }
+
+    return -1;
+}
+
+}  // namespace android
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+#ifndef AM_SYNC_SCAN_H_
+
+#define AM_SYNC_SCAN_H_
+
+#include <sys/types.h>
+#include <stdint.h>
+
+namespace android {
+
+// Startcode and sync word scanners shared by the TS/ES demux path.
+// They only locate candidates, callers still validate the header found.
+// NEON and SSE2 versions are used when built for them, the AVX2 one when
+// the CPU supports it, with a plain C loop as fallback.
+
+// Returns the offset of the first "00 00 01" startcode in "data", or -1.
+ssize_t AmFindStartCode(const uint8_t *data, size_t size);
+
+// Returns the offset of the first byte pair matching
+// data[i] == first && (data[i + 1] & mask) == second, or -1.
+ssize_t AmFindSyncWord(
+        const uint8_t *data, size_t size,
+        uint8_t first, uint8_t mask, uint8_t second);
+
+// Returns the offset of the first byte equal to any of the "count"
+// (at most kMaxScanValues) "values", or -1.
+enum {
+    kMaxScanValues = 8,
+};
+ssize_t AmFindAnyByte(
+        const uint8_t *data, size_t size,
+        const uint8_t *values, size_t count);
+
+}  // namespace android
+
+#endif  // AM_SYNC_SCAN_H_
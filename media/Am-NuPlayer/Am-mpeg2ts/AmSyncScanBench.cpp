@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Checks the AmSyncScan scanners against plain byte loops on random data
+// with sparse matches at every alignment, then reports the throughput of
+// both.
+//
+// usage: amsyncscanbench [-n iterations] [-s size_kb]
+
+#include "AmSyncScan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace android {
+
+static ssize_t RefFindStartCode(const uint8_t *data, size_t size) {
+    for (size_t i = 0; i + 2 < size; ++i) {
+        if (data[i] == 0x00 && data[i + 1] == 0x00 && data[i + 2] == 0x01) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static ssize_t RefFindSyncWord(
+        const uint8_t *data, size_t size,
+        uint8_t first, uint8_t mask, uint8_t second) {
+    for (size_t i = 0; i + 1 < size; ++i) {
+        if (data[i] == first && (data[i + 1] & mask) == second) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static ssize_t RefFindAnyByte(
+        const uint8_t *data, size_t size,
+        const uint8_t *values, size_t count) {
+    for (size_t i = 0; i < size; ++i) {
+        for (size_t j = 0; j < count; ++j) {
+            if (data[i] == values[j]) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+// ADTS sync word, and the PES stream ids AmESQueue looks for.
+static const uint8_t kSyncFirst = 0xff;
+static const uint8_t kSyncMask = 0xf6;
+static const uint8_t kSyncSecond = 0xf0;
+static const uint8_t kAnyValues[] = { 0xb3, 0xb5, 0xb8 };
+
+enum Scanner {
+    kStartCode,
+    kSyncWord,
+    kAnyByte,
+    kNumScanners,
+};
+
+static const char *const kScannerNames[kNumScanners] = {
+    "startcode", "syncword", "anybyte",
+};
+
+static ssize_t Scan(Scanner scanner, bool ref, const uint8_t *data, size_t size) {
+    switch (scanner) {
+        case kStartCode:
+            return ref ? RefFindStartCode(data, size)
+                       : AmFindStartCode(data, size);
+        case kSyncWord:
+            return ref
+                ? RefFindSyncWord(data, size, kSyncFirst, kSyncMask, kSyncSecond)
+                : AmFindSyncWord(data, size, kSyncFirst, kSyncMask, kSyncSecond);
+        default:
+            return ref
+                ? RefFindAnyByte(data, size, kAnyValues, sizeof(kAnyValues))
+                : AmFindAnyByte(data, size, kAnyValues, sizeof(kAnyValues));
+    }
+}
+
+// Random bytes that never match "scanner", so every hit is a planted one.
+static void FillNoise(Scanner scanner, uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        uint8_t b;
+        do {
+            b = rand() & 0xff;
+        } while ((scanner == kStartCode && b == 0x00)
+                || (scanner == kSyncWord && b == kSyncFirst)
+                || (scanner == kAnyByte && memchr(kAnyValues, b, sizeof(kAnyValues))));
+        data[i] = b;
+    }
+}
+
+static void Plant(Scanner scanner, uint8_t *data, size_t offset) {
+    switch (scanner) {
+        case kStartCode:
+            data[offset] = 0x00;
+            data[offset + 1] = 0x00;
+            data[offset + 2] = 0x01;
+            break;
+        case kSyncWord:
+            data[offset] = kSyncFirst;
+            data[offset + 1] = kSyncSecond | 0x09;
+            break;
+        default:
+            data[offset] = kAnyValues[offset % sizeof(kAnyValues)];
+            break;
+    }
+}
+
+// Every match position and buffer length up to a few vector blocks,
+// including matches that straddle the end of a block or the buffer.
+static bool Verify(Scanner scanner) {
+    uint8_t buf[160];
+    for (size_t size = 0; size <= sizeof(buf); ++size) {
+        for (size_t pos = 0; pos <= size; ++pos) {
+            FillNoise(scanner, buf, sizeof(buf));
+            if (pos + 3 <= sizeof(buf)) {
+                Plant(scanner, buf, pos);
+            }
+
+            ssize_t expected = Scan(scanner, true, buf, size);
+            ssize_t actual = Scan(scanner, false, buf, size);
+            if (expected != actual) {
+                fprintf(stderr, "%s: size %zu, match at %zu: "
+                        "expected %zd, got %zd\n",
+                        kScannerNames[scanner], size, pos, expected, actual);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static int64_t NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+// Scans "data" match by match, like the demuxer walking a PES payload.
+static int64_t Run(
+        Scanner scanner, bool ref, const uint8_t *data, size_t size,
+        int iterations, size_t *numMatches) {
+    int64_t startUs = NowUs();
+    *numMatches = 0;
+    for (int n = 0; n < iterations; ++n) {
+        size_t offset = 0;
+        ssize_t found;
+        while ((found = Scan(scanner, ref, data + offset, size - offset)) >= 0) {
+            ++*numMatches;
+            offset += found + 1;
+        }
+    }
+    return NowUs() - startUs;
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n iterations] [-s size_kb]\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int iterations = 20;
+    size_t size = 4096 * 1024;
+
+    int res;
+    while ((res = getopt(argc, argv, "n:s:h")) >= 0) {
+        switch (res) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 's':
+                size = (size_t)atoi(optarg) * 1024;
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    if (iterations <= 0 || size < 1024) {
+        usage(me);
+    }
+
+    srand(1);
+
+    uint8_t *data = (uint8_t *)malloc(size);
+    if (data == NULL) {
+        return 1;
+    }
+
+    int result = 0;
+    for (int s = 0; s < kNumScanners; ++s) {
+        Scanner scanner = (Scanner)s;
+
+        if (!Verify(scanner)) {
+            result = 1;
+            continue;
+        }
+
+        // About one match per 4 KB, roughly a startcode per small NAL unit.
+        FillNoise(scanner, data, size);
+        for (size_t offset = 4093; offset + 3 <= size; offset += 4099) {
+            Plant(scanner, data, offset);
+        }
+
+        size_t refMatches, matches;
+        int64_t refUs = Run(scanner, true, data, size, iterations, &refMatches);
+        int64_t us = Run(scanner, false, data, size, iterations, &matches);
+
+        if (refMatches != matches) {
+            fprintf(stderr, "%s: expected %zu matches, got %zu\n",
+                    kScannerNames[s], refMatches, matches);
+            result = 1;
+            continue;
+        }
+
+        double mb = (double)size * iterations / (1024 * 1024);
+        printf("%-10s c: %8.1f MB/s  scan: %8.1f MB/s  (%.2fx)\n",
+               kScannerNames[s],
+               mb * 1e6 / (refUs > 0 ? refUs : 1),
+               mb * 1e6 / (us > 0 ? us : 1),
+               us > 0 ? (double)refUs / us : 0.0);
+    }
+
+    free(data);
+
+    return result;
+}
@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Feeds a transport stream capture through AmATSParser and reports the
+// parsing throughput, the heap allocations per access unit and how much
+// queue storage the access units held by a simulated decoder keep alive.
+// -b feeds whole chunks through feedTSPackets() instead of one packet at a
+// time, -p only reassembles the given program of a multi-program capture,
+// -d prints the parser and packet source dumps halfway through the file
+// and at its end.
+//
+// usage: amtsparserbench [-n iterations] [-q depth] [-b] [-p program] [-d]
+//                        file.ts
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AmTSParserBench"
+#include <utils/Log.h>
+
+#include "AmATSParser.h"
+#include "AmAnotherPacketSource.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaSource.h>
+#include <utils/KeyedVector.h>
+#include <utils/List.h>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static volatile int32_t gNumMallocs;
+
+// Counts every malloc() in the process, including the ones made by
+// libstagefright_foundation for ABuffer payloads.
+extern "C" void *malloc(size_t size) {
+    static void *(*realMalloc)(size_t) = NULL;
+    if (realMalloc == NULL) {
+        realMalloc = (void *(*)(size_t))dlsym(RTLD_NEXT, "malloc");
+    }
+    __sync_fetch_and_add(&gNumMallocs, 1);
+    return realMalloc(size);
+}
+
+namespace android {
+
+// One UDP datagram worth of TS packets, the unit most sources deliver.
+static const size_t kPacketsPerChunk = 7;
+static const size_t kTSPacketSize = 188;
+
+struct Stats {
+    Stats()
+        : mNumAccessUnits(0),
+          mNumBytes(0),
+          mNumMallocs(0),
+          mMaxPinnedBytes(0),
+          mParseUs(0) {
+    }
+
+    size_t mNumAccessUnits;
+    size_t mNumBytes;
+    size_t mNumMallocs;
+    size_t mMaxPinnedBytes;
+    int64_t mParseUs;
+};
+
+// Bytes of queue storage kept alive by "held", counting every block once.
+static size_t getPinnedBytes(const List<sp<ABuffer> > &held) {
+    KeyedVector<ABuffer *, size_t> blocks;
+    size_t pinned = 0;
+    for (List<sp<ABuffer> >::const_iterator it = held.begin();
+            it != held.end(); ++it) {
+        sp<ABuffer> storage;
+        if ((*it)->meta()->findBuffer("storage", &storage)) {
+            if (blocks.indexOfKey(storage.get()) < 0) {
+                blocks.add(storage.get(), storage->capacity());
+                pinned += storage->capacity();
+            }
+        } else {
+            pinned += (*it)->capacity();
+        }
+    }
+    return pinned;
+}
+
+static void drainSources(
+        const sp<AmATSParser> &parser, size_t depth,
+        List<sp<ABuffer> > *held, Stats *stats) {
+    static const AmATSParser::SourceType kTypes[] = {
+        AmATSParser::VIDEO, AmATSParser::AUDIO,
+    };
+
+    for (size_t i = 0; i < NELEM(kTypes); ++i) {
+        sp<MediaSource> source = parser->getSource(kTypes[i]);
+        if (source == NULL) {
+            continue;
+        }
+
+        sp<AmAnotherPacketSource> packetSource =
+            static_cast<AmAnotherPacketSource *>(source.get());
+
+        status_t finalResult;
+        while (packetSource->hasBufferAvailable(&finalResult)) {
+            sp<ABuffer> accessUnit;
+            if (packetSource->dequeueAccessUnit(&accessUnit) != OK) {
+                // discontinuity
+                continue;
+            }
+
+            ++stats->mNumAccessUnits;
+
+            // The decoder keeps the last "depth" access units around.
+            held->push_back(accessUnit);
+            while (held->size() > depth) {
+                held->erase(held->begin());
+            }
+        }
+    }
+
+    size_t pinned = getPinnedBytes(*held);
+    if (pinned > stats->mMaxPinnedBytes) {
+        stats->mMaxPinnedBytes = pinned;
+    }
+}
+
+struct Options {
+    size_t mDepth;
+    bool mBatch;
+    unsigned mProgram;
+    bool mDump;
+};
+
+static void dumpState(const sp<AmATSParser> &parser) {
+    static const AmATSParser::SourceType kTypes[] = {
+        AmATSParser::VIDEO, AmATSParser::AUDIO,
+    };
+
+    AString out;
+    parser->dump(&out);
+
+    for (size_t i = 0; i < NELEM(kTypes); ++i) {
+        sp<MediaSource> source = parser->getSource(kTypes[i]);
+        if (source != NULL) {
+            static_cast<AmAnotherPacketSource *>(source.get())->dump(&out);
+        }
+    }
+
+    printf("%s", out.c_str());
+}
+
+static void parseOnce(
+        const uint8_t *data, size_t size, const Options &options,
+        bool dump, Stats *stats) {
+    sp<AmATSParser> parser = new AmATSParser;
+    parser->selectProgram(options.mProgram);
+    List<sp<ABuffer> > held;
+
+    int32_t mallocsBefore = gNumMallocs;
+    int64_t startUs = ALooper::GetNowUs();
+
+    size_t offset = 0;
+    bool dumped = false;
+    while (offset + kTSPacketSize <= size) {
+        size_t chunkSize = kPacketsPerChunk * kTSPacketSize;
+        if (chunkSize > size - offset) {
+            chunkSize = (size - offset) / kTSPacketSize * kTSPacketSize;
+        }
+
+        if (options.mBatch) {
+            size_t parsed = 0;
+            while (parsed < chunkSize) {
+                size_t n;
+                if (parser->feedTSPackets(
+                            data + offset + parsed, chunkSize - parsed,
+                            &n) == OK) {
+                    break;
+                }
+                // Skip the packet that failed to parse.
+                parsed += n + kTSPacketSize;
+            }
+        } else {
+            for (size_t i = 0; i < chunkSize; i += kTSPacketSize) {
+                parser->feedTSPacket(data + offset + i, kTSPacketSize);
+            }
+        }
+        offset += chunkSize;
+
+        if (dump && !dumped && offset >= size / 2) {
+            // Before draining, so the queues still hold something.
+            dumpState(parser);
+            dumped = true;
+        }
+
+        drainSources(parser, options.mDepth, &held, stats);
+    }
+
+    parser->signalEOS(ERROR_END_OF_STREAM);
+    drainSources(parser, options.mDepth, &held, stats);
+
+    if (dump) {
+        dumpState(parser);
+    }
+
+    stats->mParseUs += ALooper::GetNowUs() - startUs;
+    stats->mNumMallocs += gNumMallocs - mallocsBefore;
+    stats->mNumBytes += offset;
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n iterations] [-q depth] [-b] "
+            "[-p program] [-d] file.ts\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    int iterations = 10;
+    int depth = 8;
+
+    Options options;
+    options.mBatch = false;
+    options.mProgram = AmATSParser::kAllPrograms;
+    options.mDump = false;
+
+    int res;
+    while ((res = getopt(argc, argv, "n:q:bp:dh")) >= 0) {
+        switch (res) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 'q':
+                depth = atoi(optarg);
+                break;
+            case 'b':
+                options.mBatch = true;
+                break;
+            case 'p':
+                options.mProgram = atoi(optarg);
+                break;
+            case 'd':
+                options.mDump = true;
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 1 || iterations <= 0 || depth <= 0) {
+        usage(me);
+    }
+
+    int fd = open(argv[0], O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open '%s'\n", argv[0]);
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        fprintf(stderr, "unable to stat '%s'\n", argv[0]);
+        close(fd);
+        return 1;
+    }
+
+    size_t size = st.st_size;
+    uint8_t *data = (uint8_t *)malloc(size);
+    CHECK(data != NULL);
+
+    size_t filled = 0;
+    while (filled < size) {
+        ssize_t n = read(fd, data + filled, size - filled);
+        if (n <= 0) {
+            break;
+        }
+        filled += n;
+    }
+    close(fd);
+
+    options.mDepth = depth;
+
+    Stats stats;
+    for (int i = 0; i < iterations; ++i) {
+        // Only the last run dumps, so the printing barely shows in the
+        // throughput.
+        parseOnce(data, filled, options,
+                options.mDump && i == iterations - 1, &stats);
+    }
+
+    free(data);
+
+    printf("%d iterations, %zu bytes, %zu access units\n",
+           iterations, stats.mNumBytes, stats.mNumAccessUnits);
+
+    if (stats.mParseUs > 0) {
+        printf("throughput: %.2f MB/s\n",
+               stats.mNumBytes / (double)stats.mParseUs);
+    }
+
+    if (stats.mNumAccessUnits > 0) {
+        printf("allocations per access unit: %.2f\n",
+               stats.mNumMallocs / (double)stats.mNumAccessUnits);
+    }
+
+    printf("storage pinned by %d held access units: max %zu KB\n",
+           depth, stats.mMaxPinnedBytes / 1024);
+
+    return 0;
+}
@@ -5,7 +5,9 @@ include $(CLEAR_VARS)
 LOCAL_SRC_FILES:=                 \
         AmAnotherPacketSource.cpp   \
         AmATSParser.cpp             \
+        AmBufferRing.cpp            \
         AmESQueue.cpp               \
+        AmSyncScan.cpp              \
 
 LOCAL_C_INCLUDES:= \
 	$(TOP)/frameworks/av/media/libstagefright \
@@ -23,3 +25,82 @@ ifeq ($(TARGET_ARCH),arm)
 endif
 
 include $(BUILD_STATIC_LIBRARY)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+        AmTSParserBench.cpp         \
+
+LOCAL_C_INCLUDES:= \
+	$(TOP)/frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_STATIC_LIBRARIES := \
+        libammpeg2ts
+
+LOCAL_SHARED_LIBRARIES := \
+        libcutils \
+        libmedia \
+        libstagefright \
+        libstagefright_foundation \
+        libutils
+
+LOCAL_MODULE:= amtsparserbench
+
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+        AmSyncScanBench.cpp         \
+
+LOCAL_C_INCLUDES:= \
+	$(TOP)/frameworks/av/media/libstagefright
+
+LOCAL_STATIC_LIBRARIES := \
+        libammpeg2ts
+
+LOCAL_SHARED_LIBRARIES := \
+        liblog \
+        libstagefright_foundation \
+        libutils
+
+LOCAL_MODULE:= amsyncscanbench
+
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+        AmBufferRingBench.cpp       \
+
+LOCAL_C_INCLUDES:= \
+	$(TOP)/frameworks/av/media/libstagefright \
+	$(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_STATIC_LIBRARIES := \
+        libammpeg2ts
+
+LOCAL_SHARED_LIBRARIES := \
+        libcutils \
+        liblog \
+        libmedia \
+        libstagefright \
+        libstagefright_foundation \
+        libutils
+
+LOCAL_MODULE:= ambufferringbench
+
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
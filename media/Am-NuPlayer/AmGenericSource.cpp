@@ -20,10 +20,12 @@
 #include "AmGenericSource.h"
 
 #include "AmAnotherPacketSource.h"
+#include "AmFFmpegExtractor.h"
 
 #include <media/IMediaHTTPService.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/FileSource.h>
@@ -38,6 +40,8 @@
 #include "../../libstagefright/include/WVMExtractor.h"
 #include "../../libstagefright/include/HTTPBase.h"
 
+#include <inttypes.h>
+
 namespace android {
 
 static int64_t kLowWaterMarkUs = 2000000ll;  // 2secs
@@ -45,6 +49,51 @@ static int64_t kHighWaterMarkUs = 5000000ll;  // 5secs
 static const ssize_t kLowWaterMarkBytes = 40000;
 static const ssize_t kHighWaterMarkBytes = 200000;
 
+// With a bandwidth estimate, the low watermark scales with how close the
+// network is to the bitrate of the content, see getWaterMarksUs().
+static const int64_t kMinLowWaterMarkUs = 1000000ll;
+static const int64_t kMaxLowWaterMarkUs = 4000000ll;
+
+// How much media the audio and video queues are filled up to. The slower
+// the source is compared to the bitrate of the content, the longer it takes
+// to refill the queues after a seek or a stall, so the more is read ahead.
+// kMinReadAheadUs is enough for a source kReadAheadHeadroom times faster
+// than the content.
+static const int64_t kMinReadAheadUs = 500000ll;
+static const int64_t kMaxReadAheadUs = 5000000ll;
+static const int64_t kDefaultReadAheadUs = 1000000ll;
+static const int64_t kReadAheadHeadroom = 16;
+static const int64_t kMaxReadAheadBytes = 16 * 1024 * 1024;
+
+// A single kWhatReadBuffer reads for no longer than this, so that seeks and
+// track changes queued behind it are not held up.
+static const int64_t kMaxReadBatchUs = 20000ll;
+
+// Windows over which the bitrate (in media time) and the read throughput
+// (in time spent in MediaSource::read()) are measured. The latter is only
+// used for sources without a network bandwidth estimate.
+static const int64_t kBitrateWindowUs = 1000000ll;
+static const int64_t kReadWindowUs = 10000ll;
+
+// Keeps a MediaBuffer alive for as long as an ABuffer wraps its data, and
+// releases it from whichever thread drops the last reference.
+struct MediaBufferHolder : public RefBase {
+    MediaBufferHolder(MediaBuffer *mediaBuffer)
+        : mMediaBuffer(mediaBuffer) {
+    }
+
+protected:
+    virtual ~MediaBufferHolder() {
+        mMediaBuffer->release();
+        mMediaBuffer = NULL;
+    }
+
+private:
+    MediaBuffer *mMediaBuffer;
+
+    DISALLOW_EVIL_CONSTRUCTORS(MediaBufferHolder);
+};
+
 AmNuPlayer::GenericSource::GenericSource(
         const sp<AMessage> &notify,
         bool uidValid,
@@ -70,7 +119,15 @@ AmNuPlayer::GenericSource::GenericSource(
       mPollBufferingGeneration(0),
       mPendingReadBufferTypes(0),
       mBuffering(false),
-      mPrepareBuffering(false) {
+      mPrepareBuffering(false),
+      mReadAheadEnabled(true),
+      mReadBytesPerSec(-1ll),
+      mReadWindowBytes(0ll),
+      mReadWindowUs(0ll),
+      mReadAheadUs(kDefaultReadAheadUs),
+      mCopyWindowStartUs(-1),
+      mCopyWindowBytes(0),
+      mCopiedBytesPerSec(0) {
     resetDataSource();
     DataSource::RegisterDefaultSniffers();
 }
@@ -124,6 +181,17 @@ status_t AmNuPlayer::GenericSource::setDataSource(
     return OK;
 }
 
+status_t AmNuPlayer::GenericSource::setDataSource(
+        const sp<DataSource> &dataSource) {
+    resetDataSource();
+    mDataSource = dataSource;
+    return OK;
+}
+
+void AmNuPlayer::GenericSource::setReadAheadEnabled(bool enabled) {
+    mReadAheadEnabled = enabled;
+}
+
 sp<MetaData> AmNuPlayer::GenericSource::getFileFormatMeta() const {
     return mFileMeta;
 }
@@ -683,7 +751,7 @@ void AmNuPlayer::GenericSource::stopBufferingIfNecessary() {
     }
 }
 
-void AmNuPlayer::GenericSource::sendCacheStats() {
+status_t AmNuPlayer::GenericSource::getEstimatedBandwidthBps(int64_t *bps) {
     int32_t kbps = 0;
     status_t err = UNKNOWN_ERROR;
 
@@ -691,14 +759,74 @@ void AmNuPlayer::GenericSource::sendCacheStats() {
         err = mCachedSource->getEstimatedBandwidthKbps(&kbps);
     } else if (mWVMExtractor != NULL) {
         err = mWVMExtractor->getEstimatedBandwidthKbps(&kbps);
+    } else if (mHttpSource != NULL) {
+        int32_t bandwidthBps;
+        if (static_cast<HTTPBase *>(mHttpSource.get())->estimateBandwidth(
+                    &bandwidthBps)) {
+            kbps = bandwidthBps / 1000;
+            err = OK;
+        }
     }
 
-    if (err == OK) {
-        sp<AMessage> notify = dupNotify();
-        notify->setInt32("what", kWhatCacheStats);
-        notify->setInt32("bandwidth", kbps);
-        notify->post();
+    if (err != OK || kbps <= 0) {
+        return UNKNOWN_ERROR;
+    }
+    *bps = kbps * 1000ll;
+    return OK;
+}
+
+void AmNuPlayer::GenericSource::sendCacheStats() {
+    sp<AMessage> notify = dupNotify();
+    notify->setInt32("what", kWhatCacheStats);
+
+    int64_t bandwidthBps;
+    if (getEstimatedBandwidthBps(&bandwidthBps) == OK) {
+        notify->setInt32("bandwidth", bandwidthBps / 1000);
+    }
+
+    status_t finalResult;
+    if (mAudioTrack.mSource != NULL) {
+        notify->setInt64("audioQueuedUs",
+                mAudioTrack.mPackets->getBufferedDurationUs(&finalResult));
+        notify->setInt64("audioQueuedBytes",
+                mAudioTrack.mPackets->getBufferedDataSize());
+    }
+    if (mVideoTrack.mSource != NULL) {
+        notify->setInt64("videoQueuedUs",
+                mVideoTrack.mPackets->getBufferedDurationUs(&finalResult));
+        notify->setInt64("videoQueuedBytes",
+                mVideoTrack.mPackets->getBufferedDataSize());
     }
+    {
+        Mutex::Autolock _l(mReadBufferLock);
+        notify->setInt64("readAheadUs", mReadAheadUs);
+    }
+    notify->setInt64("readBytesPerSec", mReadBytesPerSec);
+    notify->post();
+}
+
+void AmNuPlayer::GenericSource::getWaterMarksUs(
+        int64_t bitrate, int64_t *lowUs, int64_t *highUs) {
+    *lowUs = kLowWaterMarkUs;
+    *highUs = kHighWaterMarkUs;
+
+    int64_t bandwidthBps;
+    if (bitrate <= 0 || getEstimatedBandwidthBps(&bandwidthBps) != OK) {
+        return;
+    }
+
+    // The fixed watermarks suit a network twice as fast as the content. A
+    // slower one needs more cached to ride out a dip, a faster one refills
+    // quickly enough to resume early.
+    int64_t lowWaterMarkUs = kLowWaterMarkUs * 2 * bitrate / bandwidthBps;
+    if (lowWaterMarkUs < kMinLowWaterMarkUs) {
+        lowWaterMarkUs = kMinLowWaterMarkUs;
+    } else if (lowWaterMarkUs > kMaxLowWaterMarkUs) {
+        lowWaterMarkUs = kMaxLowWaterMarkUs;
+    }
+
+    *lowUs = lowWaterMarkUs;
+    *highUs = lowWaterMarkUs + (kHighWaterMarkUs - kLowWaterMarkUs);
 }
 
 void AmNuPlayer::GenericSource::ensureCacheIsFetching() {
@@ -711,6 +839,7 @@ void AmNuPlayer::GenericSource::onPollBuffering() {
     status_t finalStatus = UNKNOWN_ERROR;
     int64_t cachedDurationUs = -1ll;
     ssize_t cachedDataRemaining = -1;
+    int64_t bitrate = 0ll;
 
     if (mCachedSource != NULL) {
         cachedDataRemaining =
@@ -718,7 +847,6 @@ void AmNuPlayer::GenericSource::onPollBuffering() {
 
         if (finalStatus == OK) {
             off64_t size;
-            int64_t bitrate = 0ll;
             if (mDurationUs > 0 && mCachedSource->getSize(&size) == OK) {
                 bitrate = size * 8000000ll / mDurationUs;
             } else if (mBitrate > 0) {
@@ -753,12 +881,16 @@ void AmNuPlayer::GenericSource::onPollBuffering() {
             notifyBufferingUpdate(percentage);
         }
 
-        ALOGV("onPollBuffering: cachedDurationUs %.1f sec",
-                cachedDurationUs / 1000000.0f);
+        int64_t lowWaterMarkUs, highWaterMarkUs;
+        getWaterMarksUs(bitrate, &lowWaterMarkUs, &highWaterMarkUs);
+
+        ALOGV("onPollBuffering: cachedDurationUs %.1f sec (%.1f/%.1f)",
+                cachedDurationUs / 1000000.0f,
+                lowWaterMarkUs / 1000000.0f, highWaterMarkUs / 1000000.0f);
 
-        if (cachedDurationUs < kLowWaterMarkUs) {
+        if (cachedDurationUs < lowWaterMarkUs) {
             startBufferingIfNecessary();
-        } else if (cachedDurationUs > kHighWaterMarkUs) {
+        } else if (cachedDurationUs > highWaterMarkUs) {
             stopBufferingIfNecessary();
         }
     } else if (cachedDataRemaining >= 0) {
@@ -839,6 +971,9 @@ void AmNuPlayer::GenericSource::onMessageReceived(const sp<AMessage> &msg) {
           track->mSource = source;
           track->mSource->start();
           track->mIndex = trackIndex;
+          track->mBytesPerSec = -1ll;
+          track->mRateWindowStartUs = -1ll;
+          updateReadAhead();
 
           int64_t timeUs, actualTimeUs;
           const bool formatChange = true;
@@ -1060,7 +1195,9 @@ status_t AmNuPlayer::GenericSource::dequeueAccessUnit(
 
     status_t result = track->mPackets->dequeueAccessUnit(accessUnit);
 
-    if (!track->mPackets->hasBufferAvailable(&finalResult)) {
+    // Top the queue up before it runs dry.
+    if (!track->mPackets->hasBufferAvailable(&finalResult)
+            || needsReadAhead(track)) {
         postReadBuffer(audio? MEDIA_TRACK_TYPE_AUDIO : MEDIA_TRACK_TYPE_VIDEO);
     }
 
@@ -1404,17 +1541,33 @@ sp<ABuffer> AmNuPlayer::GenericSource::mediaBufferToABuffer(
         outLength += sizeof(int32_t);
     }
 
+    // A MediaBuffer without a group has no references and is simply
+    // deleted on release(), so it can be handed on without a copy as long
+    // as the vorbis sample count fits behind the payload. Group owned
+    // buffers are only held if the source says so: most extractors have a
+    // single buffer, and holding it would stall the next read() until the
+    // decoder consumed the access unit.
+    bool wrap = (mb->refcount() == 0 || canHoldBuffers(trackType))
+            && mb->range_offset() + outLength <= mb->size()
+            && !(mIsSecure && !audio);
+
     sp<ABuffer> ab;
+    bool held = false;
     if (mIsSecure && !audio) {
         // data is already provided in the buffer
         ab = new ABuffer(NULL, mb->range_length());
         mb->add_ref();
         ab->setMediaBufferBase(mb);
+    } else if (wrap) {
+        ab = new ABuffer((uint8_t *)mb->data() + mb->range_offset(), outLength);
+        ab->meta()->setObject("mediaBufferHolder", new MediaBufferHolder(mb));
+        held = true;
     } else {
         ab = new ABuffer(outLength);
         memcpy(ab->data(),
                (const uint8_t *)mb->data() + mb->range_offset(),
                mb->range_length());
+        onBytesCopied(mb->range_length());
     }
 
     if (audio && mAudioIsVorbis) {
@@ -1463,12 +1616,60 @@ sp<ABuffer> AmNuPlayer::GenericSource::mediaBufferToABuffer(
         *actualTimeUs = timeUs;
     }
 
-    mb->release();
+    if (!held) {
+        mb->release();
+    }
     mb = NULL;
 
     return ab;
 }
 
+bool AmNuPlayer::GenericSource::canHoldBuffers(media_track_type trackType) const {
+    const Track *track;
+    switch (trackType) {
+        case MEDIA_TRACK_TYPE_AUDIO:
+            track = &mAudioTrack;
+            break;
+        case MEDIA_TRACK_TYPE_VIDEO:
+            track = &mVideoTrack;
+            break;
+        default:
+            return false;
+    }
+
+    int32_t holdable;
+    return track->mSource != NULL
+            && track->mSource->getFormat()->findInt32(
+                    kKeyAmHoldableBuffers, &holdable)
+            && holdable;
+}
+
+void AmNuPlayer::GenericSource::onBytesCopied(size_t numBytes) {
+    Mutex::Autolock autoLock(mCopyStatsLock);
+
+    int64_t nowUs = ALooper::GetNowUs();
+    if (mCopyWindowStartUs < 0) {
+        mCopyWindowStartUs = nowUs;
+    } else if (nowUs - mCopyWindowStartUs >= 1000000ll) {
+        mCopiedBytesPerSec =
+                mCopyWindowBytes * 1000000ll / (nowUs - mCopyWindowStartUs);
+        mCopyWindowStartUs = nowUs;
+        mCopyWindowBytes = 0;
+    }
+    mCopyWindowBytes += numBytes;
+}
+
+int64_t AmNuPlayer::GenericSource::getCopiedBytesPerSec() {
+    Mutex::Autolock autoLock(mCopyStatsLock);
+
+    // Nothing was copied for a while if the window is still open.
+    if (mCopyWindowStartUs >= 0
+            && ALooper::GetNowUs() - mCopyWindowStartUs >= 2000000ll) {
+        return 0;
+    }
+    return mCopiedBytesPerSec;
+}
+
 void AmNuPlayer::GenericSource::postReadBuffer(media_track_type trackType) {
     Mutex::Autolock _l(mReadBufferLock);
 
@@ -1491,6 +1692,124 @@ void AmNuPlayer::GenericSource::onReadBuffer(sp<AMessage> msg) {
         Mutex::Autolock _l(mReadBufferLock);
         mPendingReadBufferTypes &= ~(1 << trackType);
     }
+
+    // readBuffer() stops after kMaxReadBatchUs, continue behind whatever
+    // else is queued on the looper.
+    if ((trackType == MEDIA_TRACK_TYPE_AUDIO && needsReadAhead(&mAudioTrack))
+            || (trackType == MEDIA_TRACK_TYPE_VIDEO
+                    && needsReadAhead(&mVideoTrack))) {
+        postReadBuffer(trackType);
+    }
+}
+
+bool AmNuPlayer::GenericSource::needsReadAhead(const Track *track) const {
+    // Widevine reads are non-blocking and paced by dequeueAccessUnit().
+    if (!mReadAheadEnabled || mIsWidevine || mStopRead || track->mSource == NULL) {
+        return false;
+    }
+
+    status_t finalResult;
+    int64_t bufferedUs = track->mPackets->getBufferedDurationUs(&finalResult);
+    if (finalResult != OK
+            || track->mPackets->getBufferedDataSize() >= kMaxReadAheadBytes) {
+        return false;
+    }
+
+    Mutex::Autolock _l(mReadBufferLock);
+    if (track->mReadBlocked) {
+        return false;
+    }
+
+    // If the other track waits for this one, read past the target until
+    // it can go on.
+    const Track *other = (track == &mAudioTrack) ? &mVideoTrack : &mAudioTrack;
+    return bufferedUs < mReadAheadUs || other->mReadBlocked;
+}
+
+void AmNuPlayer::GenericSource::onBufferRead(
+        Track *track, int64_t timeUs, size_t size, int64_t readUs) {
+    bool changed = false;
+
+    mReadWindowBytes += size;
+    mReadWindowUs += readUs;
+    if (mReadWindowUs >= kReadWindowUs) {
+        int64_t bytesPerSec = mReadWindowBytes * 1000000ll / mReadWindowUs;
+        if (mReadBytesPerSec < 0) {
+            mReadBytesPerSec = bytesPerSec;
+        } else {
+            mReadBytesPerSec = (mReadBytesPerSec * 7 + bytesPerSec) / 8;
+        }
+        mReadWindowBytes = 0;
+        mReadWindowUs = 0;
+        changed = true;
+    }
+
+    // Reordered frames go back a little, only a seek goes back further.
+    if (track->mRateWindowStartUs < 0
+            || timeUs + kBitrateWindowUs < track->mRateWindowStartUs) {
+        track->mRateWindowStartUs = timeUs;
+        track->mRateWindowBytes = 0;
+    }
+    track->mRateWindowBytes += size;
+
+    int64_t spanUs = timeUs - track->mRateWindowStartUs;
+    if (spanUs >= kBitrateWindowUs) {
+        int64_t bytesPerSec = track->mRateWindowBytes * 1000000ll / spanUs;
+        if (track->mBytesPerSec < 0) {
+            track->mBytesPerSec = bytesPerSec;
+        } else {
+            track->mBytesPerSec = (track->mBytesPerSec * 3 + bytesPerSec) / 4;
+        }
+        track->mRateWindowStartUs = timeUs;
+        track->mRateWindowBytes = 0;
+        changed = true;
+    }
+
+    if (changed) {
+        updateReadAhead();
+    }
+}
+
+void AmNuPlayer::GenericSource::updateReadAhead() {
+    int64_t mediaBytesPerSec = 0;
+    if (mAudioTrack.mSource != NULL && mAudioTrack.mBytesPerSec > 0) {
+        mediaBytesPerSec += mAudioTrack.mBytesPerSec;
+    }
+    if (mVideoTrack.mSource != NULL && mVideoTrack.mBytesPerSec > 0) {
+        mediaBytesPerSec += mVideoTrack.mBytesPerSec;
+    }
+
+    // When streaming, read() mostly returns what the cache already holds
+    // and its throughput says little about how fast the queues refill
+    // after the cache runs dry. The network bandwidth does.
+    int64_t sourceBytesPerSec = mReadBytesPerSec;
+    int64_t bandwidthBps;
+    if (getEstimatedBandwidthBps(&bandwidthBps) == OK) {
+        sourceBytesPerSec = bandwidthBps / 8;
+    }
+
+    int64_t readAheadUs = kDefaultReadAheadUs;
+    if (sourceBytesPerSec > 0 && mediaBytesPerSec > 0) {
+        readAheadUs = kMinReadAheadUs * kReadAheadHeadroom
+                * mediaBytesPerSec / sourceBytesPerSec;
+        if (readAheadUs < kMinReadAheadUs) {
+            readAheadUs = kMinReadAheadUs;
+        } else if (readAheadUs > kMaxReadAheadUs) {
+            readAheadUs = kMaxReadAheadUs;
+        }
+
+        int64_t maxUs = kMaxReadAheadBytes * 1000000ll / mediaBytesPerSec;
+        if (readAheadUs > maxUs) {
+            readAheadUs = maxUs;
+        }
+    }
+
+    Mutex::Autolock _l(mReadBufferLock);
+    if (readAheadUs != mReadAheadUs) {
+        ALOGV("read-ahead %" PRId64 " us (source %" PRId64 " B/s, media %"
+              PRId64 " B/s)", readAheadUs, sourceBytesPerSec, mediaBytesPerSec);
+        mReadAheadUs = readAheadUs;
+    }
 }
 
 void AmNuPlayer::GenericSource::readBuffer(
@@ -1501,11 +1820,15 @@ void AmNuPlayer::GenericSource::readBuffer(
     }
     Track *track;
     size_t maxBuffers = 1;
+    bool readAhead = false;
     switch (trackType) {
         case MEDIA_TRACK_TYPE_VIDEO:
             track = &mVideoTrack;
             if (mIsWidevine) {
                 maxBuffers = 2;
+            } else if (mReadAheadEnabled) {
+                maxBuffers = 16;
+                readAhead = true;
             }
             break;
         case MEDIA_TRACK_TYPE_AUDIO:
@@ -1514,6 +1837,7 @@ void AmNuPlayer::GenericSource::readBuffer(
                 maxBuffers = 8;
             } else {
                 maxBuffers = 64;
+                readAhead = mReadAheadEnabled;
             }
             break;
         case MEDIA_TRACK_TYPE_SUBTITLE:
@@ -1541,15 +1865,28 @@ void AmNuPlayer::GenericSource::readBuffer(
     if (seekTimeUs >= 0) {
         options.setSeekTo(seekTimeUs, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
         seeking = true;
+        track->mRateWindowStartUs = -1ll;
     }
 
-    if (mIsWidevine) {
+    // Read-ahead must not block on the other track: the FFmpeg extractor
+    // returns WOULD_BLOCK then and that track is read first.
+    if (mIsWidevine || readAhead) {
         options.setNonBlocking();
     }
 
-    for (size_t numBuffers = 0; numBuffers < maxBuffers; ) {
+    int64_t batchStartUs = ALooper::GetNowUs();
+    size_t numBuffers = 0;
+    while (numBuffers < maxBuffers) {
+        if (readAhead && numBuffers > 0
+                && (!needsReadAhead(track)
+                    || ALooper::GetNowUs() - batchStartUs >= kMaxReadBatchUs)) {
+            break;
+        }
+
         MediaBuffer *mbuf;
+        int64_t readStartUs = ALooper::GetNowUs();
         status_t err = track->mSource->read(&mbuf, &options);
+        int64_t readUs = ALooper::GetNowUs() - readStartUs;
 
         options.clearSeekTo();
 
@@ -1562,6 +1899,10 @@ void AmNuPlayer::GenericSource::readBuffer(
                 mVideoTimeUs = timeUs;
             }
 
+            if (readAhead) {
+                onBufferRead(track, timeUs, mbuf->range_length(), readUs);
+            }
+
             // formatChange && seeking: track whose source is changed during selection
             // formatChange && !seeking: track whose source is not changed during selection
             // !formatChange: normal seek
@@ -1581,6 +1922,15 @@ void AmNuPlayer::GenericSource::readBuffer(
             seeking = false;
             ++numBuffers;
         } else if (err == WOULD_BLOCK) {
+            if (readAhead) {
+                // The source waits for the other track to be read first.
+                {
+                    Mutex::Autolock _l(mReadBufferLock);
+                    track->mReadBlocked = true;
+                }
+                postReadBuffer(trackType == MEDIA_TRACK_TYPE_AUDIO
+                        ? MEDIA_TRACK_TYPE_VIDEO : MEDIA_TRACK_TYPE_AUDIO);
+            }
             break;
         } else if (err == INFO_FORMAT_CHANGED) {
 #if 0
@@ -1594,6 +1944,32 @@ void AmNuPlayer::GenericSource::readBuffer(
             break;
         }
     }
+
+    if (numBuffers == 0) {
+        return;
+    }
+
+    // Reading this track may have made room for the other one.
+    Track *other = NULL;
+    if (trackType == MEDIA_TRACK_TYPE_AUDIO) {
+        other = &mVideoTrack;
+    } else if (trackType == MEDIA_TRACK_TYPE_VIDEO) {
+        other = &mAudioTrack;
+    }
+
+    bool unblocked = false;
+    {
+        Mutex::Autolock _l(mReadBufferLock);
+        track->mReadBlocked = false;
+        if (other != NULL && other->mReadBlocked) {
+            other->mReadBlocked = false;
+            unblocked = true;
+        }
+    }
+    if (unblocked) {
+        postReadBuffer(trackType == MEDIA_TRACK_TYPE_AUDIO
+                ? MEDIA_TRACK_TYPE_VIDEO : MEDIA_TRACK_TYPE_AUDIO);
+    }
 }
 
 }  // namespace android
@@ -48,6 +48,13 @@ struct AmNuPlayer::GenericSource : public AmNuPlayer::Source {
 
     status_t setDataSource(int fd, int64_t offset, int64_t length);
 
+    status_t setDataSource(const sp<DataSource> &dataSource);
+
+    // Read-ahead is on by default. Without it a read is only posted once a
+    // queue runs dry and reads a single video access unit, as it used to.
+    // Must be called before prepareAsync().
+    void setReadAheadEnabled(bool enabled);
+
     virtual void prepareAsync();
 
     virtual void start();
@@ -63,6 +70,8 @@ struct AmNuPlayer::GenericSource : public AmNuPlayer::Source {
 
     virtual status_t dequeueAccessUnit(bool audio, sp<ABuffer> *accessUnit);
 
+    virtual int64_t getCopiedBytesPerSec();
+
     virtual status_t getDuration(int64_t *durationUs);
     virtual size_t getTrackCount() const;
     virtual sp<AMessage> getTrackInfo(size_t trackIndex) const;
@@ -100,9 +109,27 @@ private:
     };
 
     struct Track {
+        Track()
+            : mIndex(0),
+              mBytesPerSec(-1ll),
+              mRateWindowStartUs(-1ll),
+              mRateWindowBytes(0ll),
+              mReadBlocked(false) {
+        }
+
         size_t mIndex;
         sp<MediaSource> mSource;
         sp<AmAnotherPacketSource> mPackets;
+
+        // Bitrate of the track, measured over windows of media time.
+        int64_t mBytesPerSec;
+        int64_t mRateWindowStartUs;
+        int64_t mRateWindowBytes;
+
+        // read() returned WOULD_BLOCK because the source waits for another
+        // track to be read. No read-ahead until then, guarded by
+        // mReadBufferLock.
+        bool mReadBlocked;
     };
 
     Vector<sp<MediaSource> > mSources;
@@ -150,6 +177,22 @@ private:
     bool mPrepareBuffering;
     mutable Mutex mReadBufferLock;
 
+    // How fast MediaSource::read() delivers data, and how much media the
+    // audio and video queues are filled up to as a result of it or of the
+    // network bandwidth when streaming. mReadAheadUs is
+    // guarded by mReadBufferLock, the rest is only used on the looper.
+    bool mReadAheadEnabled;
+    int64_t mReadBytesPerSec;
+    int64_t mReadWindowBytes;
+    int64_t mReadWindowUs;
+    int64_t mReadAheadUs;
+
+    // Payload bytes copied out of MediaBuffers, per second.
+    Mutex mCopyStatsLock;
+    int64_t mCopyWindowStartUs;
+    int64_t mCopyWindowBytes;
+    int64_t mCopiedBytesPerSec;
+
     sp<ALooper> mLooper;
 
     void resetDataSource();
@@ -188,6 +231,9 @@ private:
             uint32_t what, media_track_type type,
             int32_t curGen, sp<AmAnotherPacketSource> packets, sp<AMessage> msg);
 
+    void onBytesCopied(size_t numBytes);
+    bool canHoldBuffers(media_track_type trackType) const;
+
     sp<ABuffer> mediaBufferToABuffer(
             MediaBuffer *mbuf,
             media_track_type trackType,
@@ -199,6 +245,9 @@ private:
     void readBuffer(
             media_track_type trackType,
             int64_t seekTimeUs = -1ll, int64_t *actualTimeUs = NULL, bool formatChange = false);
+    bool needsReadAhead(const Track *track) const;
+    void onBufferRead(Track *track, int64_t timeUs, size_t size, int64_t readUs);
+    void updateReadAhead();
 
     void schedulePollBuffering();
     void cancelPollBuffering();
@@ -207,6 +256,8 @@ private:
     void notifyBufferingUpdate(int percentage);
     void startBufferingIfNecessary();
     void stopBufferingIfNecessary();
+    status_t getEstimatedBandwidthBps(int64_t *bps);
+    void getWaterMarksUs(int64_t bitrate, int64_t *lowUs, int64_t *highUs);
     void sendCacheStats();
     void ensureCacheIsFetching();
 
@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Plays a local file through GenericSource over a DataSource throttled to
+// a multiple of the file's bitrate, with read-ahead on and off. The audio
+// and video access units are taken out at the pace of their timestamps,
+// the way the decoders would, and the clock stops while one that is due
+// is missing. Reports how long it took from start() and from a seek until
+// both tracks had their first access unit, and how often and for how long
+// playback stalled.
+//
+// usage: amgenericsourcebench [-x rate_factor] [-r kbps] [-l latency_ms]
+//                             [-d seconds] file
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AmGenericSourceBench"
+#include <utils/Log.h>
+
+#include "AmGenericSource.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaErrors.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace android {
+
+// Hands out the data no faster than "bytesPerSec", and each read no
+// sooner than "latencyUs" after it was issued, like a network share.
+struct ThrottledSource : public DataSource {
+    ThrottledSource(const sp<DataSource> &source,
+                    int64_t bytesPerSec, int64_t latencyUs)
+        : mSource(source),
+          mBytesPerSec(bytesPerSec),
+          mLatencyUs(latencyUs),
+          mNextUs(-1ll) {
+    }
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        ssize_t n = mSource->readAt(offset, data, size);
+
+        int64_t nowUs = ALooper::GetNowUs();
+        int64_t dueUs;
+        {
+            Mutex::Autolock autoLock(mLock);
+            if (mNextUs < nowUs) {
+                mNextUs = nowUs;
+            }
+            if (n > 0) {
+                mNextUs += n * 1000000ll / mBytesPerSec;
+            }
+            dueUs = mNextUs;
+        }
+        if (dueUs < nowUs + mLatencyUs) {
+            dueUs = nowUs + mLatencyUs;
+        }
+        if (dueUs > nowUs) {
+            usleep(dueUs - nowUs);
+        }
+        return n;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        return mSource->getSize(size);
+    }
+
+protected:
+    virtual ~ThrottledSource() {}
+
+private:
+    sp<DataSource> mSource;
+    int64_t mBytesPerSec;
+    int64_t mLatencyUs;
+
+    Mutex mLock;
+    int64_t mNextUs;
+
+    DISALLOW_EVIL_CONSTRUCTORS(ThrottledSource);
+};
+
+// Stands in for AmNuPlayer, only waits for the source to be prepared.
+struct Listener : public AHandler {
+    Listener()
+        : mPrepared(false),
+          mPrepareResult(OK) {
+    }
+
+    status_t waitForPrepared() {
+        Mutex::Autolock autoLock(mLock);
+        while (!mPrepared) {
+            mCondition.wait(mLock);
+        }
+        return mPrepareResult;
+    }
+
+protected:
+    virtual ~Listener() {}
+
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        int32_t what;
+        CHECK(msg->findInt32("what", &what));
+        if (what == AmNuPlayer::Source::kWhatPrepared) {
+            int32_t err;
+            CHECK(msg->findInt32("err", &err));
+            Mutex::Autolock autoLock(mLock);
+            mPrepared = true;
+            mPrepareResult = err;
+            mCondition.signal();
+        }
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    bool mPrepared;
+    status_t mPrepareResult;
+
+    DISALLOW_EVIL_CONSTRUCTORS(Listener);
+};
+
+// A track stalls once nothing is queued and its last access unit is this
+// far behind the clock, longer than any audio or video frame lasts.
+static const int64_t kStallSlackUs = 100000ll;
+
+static const int64_t kPollIntervalUs = 5000ll;
+
+struct Playback {
+    Playback()
+        : mNumStalls(0),
+          mStalledUs(0) {
+    }
+
+    int mNumStalls;
+    int64_t mStalledUs;
+};
+
+struct Track {
+    Track(bool audio)
+        : mAudio(audio),
+          mPresent(false),
+          mEOS(false),
+          mHasPending(false),
+          mPendingTimeUs(0),
+          mLastTimeUs(-1ll) {
+    }
+
+    bool mAudio;
+    bool mPresent;
+    bool mEOS;
+    bool mHasPending;
+    int64_t mPendingTimeUs;
+    int64_t mLastTimeUs;
+
+    // Takes out the next access unit unless one is already waiting.
+    void fetch(const sp<AmNuPlayer::GenericSource> &source) {
+        while (mPresent && !mEOS && !mHasPending) {
+            sp<ABuffer> accessUnit;
+            status_t err = source->dequeueAccessUnit(mAudio, &accessUnit);
+            if (err == -EWOULDBLOCK) {
+                return;
+            } else if (err == INFO_DISCONTINUITY) {
+                continue;
+            } else if (err != OK) {
+                mEOS = true;
+                return;
+            }
+            CHECK(accessUnit->meta()->findInt64("timeUs", &mPendingTimeUs));
+            mHasPending = true;
+        }
+    }
+
+    // Whether the track can start or go on from "mediaTimeUs".
+    bool ready(int64_t mediaTimeUs) const {
+        if (!mPresent || mEOS || mHasPending) {
+            return true;
+        }
+        return mLastTimeUs >= 0 && mediaTimeUs < mLastTimeUs + kStallSlackUs;
+    }
+
+    void consume(const sp<AmNuPlayer::GenericSource> &source, int64_t mediaTimeUs) {
+        for (;;) {
+            fetch(source);
+            if (!mHasPending || mPendingTimeUs > mediaTimeUs) {
+                return;
+            }
+            mLastTimeUs = mPendingTimeUs;
+            mHasPending = false;
+        }
+    }
+
+    void reset() {
+        mEOS = false;
+        mHasPending = false;
+        mLastTimeUs = -1ll;
+    }
+};
+
+// Waits until both tracks have an access unit, returns how long it took.
+static int64_t waitForFirst(
+        const sp<AmNuPlayer::GenericSource> &source, Track *audio, Track *video) {
+    int64_t startUs = ALooper::GetNowUs();
+    for (;;) {
+        audio->fetch(source);
+        video->fetch(source);
+        if ((!audio->mPresent || audio->mHasPending || audio->mEOS)
+                && (!video->mPresent || video->mHasPending || video->mEOS)) {
+            return ALooper::GetNowUs() - startUs;
+        }
+        usleep(1000);
+    }
+}
+
+static int64_t firstTimeUs(const Track &audio, const Track &video) {
+    int64_t timeUs = -1ll;
+    if (audio.mHasPending) {
+        timeUs = audio.mPendingTimeUs;
+    }
+    if (video.mHasPending && (timeUs < 0 || video.mPendingTimeUs < timeUs)) {
+        timeUs = video.mPendingTimeUs;
+    }
+    return timeUs < 0 ? 0 : timeUs;
+}
+
+// Plays "durationUs" of media from where the tracks are.
+static void play(
+        const sp<AmNuPlayer::GenericSource> &source,
+        Track *audio, Track *video, int64_t durationUs, Playback *playback) {
+    int64_t startMediaUs = firstTimeUs(*audio, *video);
+    int64_t clockStartUs = ALooper::GetNowUs();
+    int64_t stalledUs = 0;
+    int64_t stallStartUs = -1ll;
+
+    for (;;) {
+        int64_t nowUs = ALooper::GetNowUs();
+        int64_t mediaTimeUs = startMediaUs + nowUs - clockStartUs - stalledUs;
+        if (stallStartUs >= 0) {
+            mediaTimeUs -= nowUs - stallStartUs;
+        }
+
+        if (mediaTimeUs >= startMediaUs + durationUs
+                || ((!audio->mPresent || audio->mEOS)
+                        && (!video->mPresent || video->mEOS))) {
+            break;
+        }
+
+        if (stallStartUs < 0) {
+            audio->consume(source, mediaTimeUs);
+            video->consume(source, mediaTimeUs);
+            if (!audio->ready(mediaTimeUs) || !video->ready(mediaTimeUs)) {
+                ALOGV("stall at %" PRId64 " us", mediaTimeUs);
+                stallStartUs = nowUs;
+                ++playback->mNumStalls;
+            }
+        } else {
+            audio->fetch(source);
+            video->fetch(source);
+            if (audio->ready(mediaTimeUs) && video->ready(mediaTimeUs)) {
+                stalledUs += nowUs - stallStartUs;
+                stallStartUs = -1ll;
+            }
+        }
+
+        usleep(kPollIntervalUs);
+    }
+
+    if (stallStartUs >= 0) {
+        stalledUs += ALooper::GetNowUs() - stallStartUs;
+    }
+    playback->mStalledUs += stalledUs;
+}
+
+static bool run(
+        const char *path, bool readAhead, double rateFactor, int64_t kbps,
+        int64_t latencyUs, int64_t playUs) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open %s\n", path);
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+
+    sp<DataSource> file = new FileSource(fd, 0, st.st_size);
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("bench");
+    looper->start();
+    sp<Listener> listener = new Listener;
+    looper->registerHandler(listener);
+
+    // The bitrate is only known once prepared, so the throttled source is
+    // set up after a first unthrottled prepare.
+    int64_t durationUs = 0;
+    {
+        sp<AmNuPlayer::GenericSource> probe =
+            new AmNuPlayer::GenericSource(new AMessage(0, listener), false, 0);
+        probe->setDataSource(file);
+        probe->prepareAsync();
+        if (listener->waitForPrepared() != OK
+                || probe->getDuration(&durationUs) != OK || durationUs <= 0) {
+            fprintf(stderr, "unable to prepare %s\n", path);
+            looper->stop();
+            return false;
+        }
+        probe->stop();
+    }
+
+    int64_t bytesPerSec = kbps > 0 ? kbps * 1000 / 8
+            : (int64_t)(st.st_size * 1E6 / durationUs * rateFactor);
+
+    sp<Listener> listener2 = new Listener;
+    looper->registerHandler(listener2);
+    sp<AmNuPlayer::GenericSource> source =
+        new AmNuPlayer::GenericSource(new AMessage(0, listener2), false, 0);
+    source->setDataSource(new ThrottledSource(file, bytesPerSec, latencyUs));
+    source->setReadAheadEnabled(readAhead);
+
+    int64_t prepareStartUs = ALooper::GetNowUs();
+    source->prepareAsync();
+    if (listener2->waitForPrepared() != OK) {
+        fprintf(stderr, "unable to prepare %s\n", path);
+        looper->stop();
+        return false;
+    }
+    int64_t prepareUs = ALooper::GetNowUs() - prepareStartUs;
+
+    Track audio(true), video(false);
+    audio.mPresent = source->getFormat(true /* audio */) != NULL;
+    video.mPresent = source->getFormat(false /* audio */) != NULL;
+
+    Playback playback;
+    source->start();
+    int64_t startUs = waitForFirst(source, &audio, &video);
+    play(source, &audio, &video, playUs, &playback);
+
+    // Half way into what is left, where nothing was read yet.
+    int64_t seekTimeUs = (firstTimeUs(audio, video) + durationUs) / 2;
+    int64_t seekStartUs = ALooper::GetNowUs();
+    source->seekTo(seekTimeUs);
+    audio.reset();
+    video.reset();
+    int64_t seekUs = ALooper::GetNowUs() - seekStartUs
+            + waitForFirst(source, &audio, &video);
+    play(source, &audio, &video, playUs, &playback);
+
+    source->stop();
+    looper->stop();
+
+    printf("read-ahead %-3s  source %6" PRId64 " kbps  prepare %6.1f ms  "
+           "start %6.1f ms  seek %6.1f ms  %3d stalls %8.1f ms stalled\n",
+           readAhead ? "on" : "off", bytesPerSec * 8 / 1000,
+           prepareUs / 1E3, startUs / 1E3, seekUs / 1E3,
+           playback.mNumStalls, playback.mStalledUs / 1E3);
+    return true;
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-x rate_factor] [-r kbps] [-l latency_ms] "
+                    "[-d seconds] file\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    // Just faster than the content, as on a busy network share.
+    double rateFactor = 1.2;
+    int64_t kbps = 0;
+    int64_t latencyUs = 20000ll;
+    int64_t playUs = 20000000ll;
+
+    int res;
+    while ((res = getopt(argc, argv, "x:r:l:d:h")) >= 0) {
+        switch (res) {
+            case 'x':
+                rateFactor = atof(optarg);
+                break;
+            case 'r':
+                kbps = atoi(optarg);
+                break;
+            case 'l':
+                latencyUs = atoi(optarg) * 1000ll;
+                break;
+            case 'd':
+                playUs = atoi(optarg) * 1000000ll;
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    if (argc != optind + 1 || rateFactor <= 0 || kbps < 0 || latencyUs < 0
+            || playUs <= 0) {
+        usage(me);
+    }
+
+    DataSource::RegisterDefaultSniffers();
+
+    if (!run(argv[optind], false, rateFactor, kbps, latencyUs, playUs)
+            || !run(argv[optind], true, rateFactor, kbps, latencyUs, playUs)) {
+        return 1;
+    }
+
+    return 0;
+}
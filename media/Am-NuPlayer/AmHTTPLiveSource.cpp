@@ -192,6 +192,13 @@ status_t AmNuPlayer::HTTPLiveSource::dequeueAccessUnit(
             accessUnit);
 }
 
+void AmNuPlayer::HTTPLiveSource::dump(AString *out) {
+    sp<AmLiveSession> session = mLiveSession;
+    if (session != NULL) {
+        session->dump(out);
+    }
+}
+
 status_t AmNuPlayer::HTTPLiveSource::getDuration(int64_t *durationUs) {
     return mLiveSession->getDuration(durationUs);
 }
@@ -48,6 +48,7 @@ struct AmNuPlayer::HTTPLiveSource : public AmNuPlayer::Source {
     virtual status_t selectTrack(size_t trackIndex, bool select, int64_t timeUs);
     virtual status_t seekTo(int64_t seekTimeUs);
     virtual void setParentThreadId(android_thread_id_t thread_id);
+    virtual void dump(AString *out);
 
 protected:
     virtual ~HTTPLiveSource();
@@ -2058,7 +2058,8 @@ status_t AmNuPlayer::getCurrentPosition(int64_t *mediaUs) {
     return renderer->getCurrentPosition(mediaUs);
 }
 
-void AmNuPlayer::getStats(int64_t *numFramesTotal, int64_t *numFramesDropped) {
+void AmNuPlayer::getStats(int64_t *numFramesTotal, int64_t *numFramesDropped,
+        int64_t *numBytesCopiedPerSec) {
     sp<DecoderBase> decoder = getDecoder(false /* audio */);
     if (decoder != NULL) {
         decoder->getStats(numFramesTotal, numFramesDropped);
@@ -2066,6 +2067,16 @@ void AmNuPlayer::getStats(int64_t *numFramesTotal, int64_t *numFramesDropped) {
         *numFramesTotal = 0;
         *numFramesDropped = 0;
     }
+
+    sp<Source> source = mSource;
+    *numBytesCopiedPerSec = source != NULL ? source->getCopiedBytesPerSec() : -1;
+}
+
+void AmNuPlayer::dump(AString *out) {
+    sp<Source> source = mSource;
+    if (source != NULL) {
+        source->dump(out);
+    }
 }
 
 sp<MetaData> AmNuPlayer::getFileMeta() {
@@ -2387,10 +2398,20 @@ void AmNuPlayer::onSourceNotify(const sp<AMessage> &msg) {
 
         case Source::kWhatCacheStats:
         {
-            int32_t kbps;
-            CHECK(msg->findInt32("bandwidth", &kbps));
+            int64_t audioQueuedUs = -1ll, videoQueuedUs = -1ll;
+            int64_t readAheadUs = -1ll;
+            msg->findInt64("audioQueuedUs", &audioQueuedUs);
+            msg->findInt64("videoQueuedUs", &videoQueuedUs);
+            msg->findInt64("readAheadUs", &readAheadUs);
+            ALOGV("cache stats: audio queued %lld us, video queued %lld us,"
+                  " read-ahead %lld us",
+                  (long long)audioQueuedUs, (long long)videoQueuedUs,
+                  (long long)readAheadUs);
 
-            notifyListener(MEDIA_INFO, MEDIA_INFO_NETWORK_BANDWIDTH, kbps);
+            int32_t kbps;
+            if (msg->findInt32("bandwidth", &kbps)) {
+                notifyListener(MEDIA_INFO, MEDIA_INFO_NETWORK_BANDWIDTH, kbps);
+            }
             break;
         }
 
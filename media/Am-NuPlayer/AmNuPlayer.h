@@ -70,7 +70,9 @@ struct AmNuPlayer : public AHandler {
     status_t getSelectedTrack(int32_t type, Parcel* reply) const;
     status_t selectTrack(size_t trackIndex, bool select, int64_t timeUs);
     status_t getCurrentPosition(int64_t *mediaUs);
-    void getStats(int64_t *mNumFramesTotal, int64_t *mNumFramesDropped);
+    void getStats(int64_t *mNumFramesTotal, int64_t *mNumFramesDropped,
+            int64_t *numBytesCopiedPerSec);
+    void dump(AString *out);
 
     sp<MetaData> getFileMeta();
 
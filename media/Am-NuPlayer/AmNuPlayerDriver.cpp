@@ -25,6 +25,7 @@
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/AUtils.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
@@ -636,7 +637,8 @@ status_t AmNuPlayerDriver::dump(
         int fd, const Vector<String16> & /* args */) const {
     int64_t numFramesTotal;
     int64_t numFramesDropped;
-    mPlayer->getStats(&numFramesTotal, &numFramesDropped);
+    int64_t numBytesCopiedPerSec;
+    mPlayer->getStats(&numFramesTotal, &numFramesDropped, &numBytesCopiedPerSec);
 
     FILE *out = fdopen(dup(fd), "w");
 
@@ -647,6 +649,13 @@ status_t AmNuPlayerDriver::dump(
                  numFramesDropped,
                  numFramesTotal == 0
                     ? 0.0 : (double)numFramesDropped / numFramesTotal);
+    if (numBytesCopiedPerSec >= 0) {
+        fprintf(out, "  bytesCopiedPerSec(%" PRId64 ")\n", numBytesCopiedPerSec);
+    }
+
+    AString sourceDump;
+    mPlayer->dump(&sourceDump);
+    fprintf(out, "%s", sourceDump.c_str());
 
     fclose(out);
     out = NULL;
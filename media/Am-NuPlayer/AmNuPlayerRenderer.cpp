@@ -24,13 +24,14 @@
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/AUtils.h>
 #include <media/stagefright/foundation/AWakeLock.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
 
-//#include <VideoFrameScheduler.h>
+#include "AmVideoFrameScheduler.h"
 
 #include <inttypes.h>
 
@@ -951,7 +952,7 @@ void AmNuPlayer::Renderer::postDrainVideoQueue_l() {
             mDrainVideoQueuePending = true;
             mSmootOutNum = 0;
             msg->post(postDelayUs);
-            //mVideoScheduler->restart();
+            mVideoScheduler->restart();
             PTS_LOG("possible video time jump of %dms, retrying in %dms",
                (int)(delayUs / 1000), (int)(postDelayUs / 1000));
             return;
@@ -979,12 +980,21 @@ void AmNuPlayer::Renderer::postDrainVideoQueue_l() {
         }
     }
 
-    /*realTimeUs = mVideoScheduler->schedule(realTimeUs * 1000) / 1000;*/
+    int64_t mediaTimeUs;
+    CHECK(entry.mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
+    bool drop;
+    realTimeUs = mVideoScheduler->schedule(mediaTimeUs, realTimeUs, &drop);
     delayUs = realTimeUs - nowUs;
     //ALOGW_IF(delayUs > 500000, "unusually high delayUs: %" PRId64, delayUs);
     entry.mBuffer->meta()->setInt64("RealTimeUs", realTimeUs);
+    entry.mBuffer->meta()->setInt32("dropFrame", drop);
+
     // post 2 display refreshes before rendering is due
-    delayUs -= 2 * 1000000/30; /*send before 2 vsync,default 30hz*/
+    int64_t vsyncPeriodUs = mVideoScheduler->getVsyncPeriodUs();
+    if (vsyncPeriodUs <= 0) {
+        vsyncPeriodUs = 1000000 / 30; /*default 30hz*/
+    }
+    delayUs -= 2 * vsyncPeriodUs;
     mDrainVideoQueuePending = true;
     msg->post(delayUs > 0 ? delayUs : 0);
 
@@ -1032,6 +1042,9 @@ void AmNuPlayer::Renderer::onDrainVideoQueue() {
 
         mLastVideoDrainRealTimeUs = nowUs;
         setVideoLateByUs(nowUs - realTimeUs);
+        if (mVideoScheduler != NULL) {
+            mVideoScheduler->onFrameRendered(mVideoLateByUs);
+        }
         tooLate = (mVideoLateByUs > 40000);
 
         if (mInSlowSync && llabs(mVideoLateByUs) <= 40000) {
@@ -1069,8 +1082,12 @@ void AmNuPlayer::Renderer::onDrainVideoQueue() {
         }
     }
 
+    // Render anyhow, unless the scheduler found no vsync left for it.
+    int32_t dropFrame = 0;
+    entry->mBuffer->meta()->findInt32("dropFrame", &dropFrame);
+
     entry->mNotifyConsumed->setInt64("timestampNs", realTimeUs * 1000ll);
-    entry->mNotifyConsumed->setInt32("render", 1); // render anyhow
+    entry->mNotifyConsumed->setInt32("render", !dropFrame);
     entry->mNotifyConsumed->post();
     mVideoQueue.erase(mVideoQueue.begin());
     entry = NULL;
@@ -1142,6 +1159,11 @@ void AmNuPlayer::Renderer::onQueueBufferDiscontinueCheck(sp<ABuffer> buffer, boo
         PTS_LOG("  mTotalAudioJumpedTimeUs:%lld\n",mTotalAudioJumpedTimeUs);
         PTS_LOG("  mLastVideoUs:%lld\n", mLastVideoUs);
         PTS_LOG("  mLastAudioUs:%lld\n", mLastAudioUs);
+        if (mVideoScheduler != NULL) {
+            AString schedulerInfo;
+            mVideoScheduler->dump(&schedulerInfo);
+            PTS_LOG("  %s", schedulerInfo.c_str());
+        }
         mLastInfoTime = cur_time;
     }
 
@@ -1233,14 +1255,11 @@ void AmNuPlayer::Renderer::onQueueBuffer(const sp<AMessage> &msg) {
 
     setHasMedia(audio);
 
-#if 0
     if (mHasVideo) {
         if (mVideoScheduler == NULL) {
-            mVideoScheduler = new VideoFrameScheduler();
-            mVideoScheduler->init();
+            mVideoScheduler = new AmVideoFrameScheduler();
         }
     }
-#endif
 
     if (dropBufferWhileFlushing(audio, msg)) {
         return;
@@ -1426,11 +1445,9 @@ void AmNuPlayer::Renderer::onFlush(const sp<AMessage> &msg) {
         mDrainVideoQueuePending = false;
         ++mVideoQueueGeneration;
 
-#if 0
         if (mVideoScheduler != NULL) {
             mVideoScheduler->restart();
         }
-#endif
 
         prepareForMediaRenderingStart();
     }
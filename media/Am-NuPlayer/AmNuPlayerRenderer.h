@@ -24,7 +24,7 @@ namespace android {
 
 struct ABuffer;
 class  AWakeLock;
-//struct VideoFrameScheduler;
+struct AmVideoFrameScheduler;
 
 struct AmNuPlayer::Renderer : public AHandler {
     enum Flags {
@@ -140,7 +140,7 @@ private:
     List<QueueEntry> mAudioQueue;
     List<QueueEntry> mVideoQueue;
     uint32_t mNumFramesWritten;
-    //sp<VideoFrameScheduler> mVideoScheduler;
+    sp<AmVideoFrameScheduler> mVideoScheduler;
 
 /*
     int64_t mLastAudioQueueTimeUs;
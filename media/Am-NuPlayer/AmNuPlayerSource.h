@@ -92,6 +92,14 @@ struct AmNuPlayer::Source : public AHandler {
     virtual status_t dequeueAccessUnit(
             bool audio, sp<ABuffer> *accessUnit) = 0;
 
+    // Bytes per second copied while handing out access units over the
+    // last second, or -1 if the source does not track it.
+    virtual int64_t getCopiedBytesPerSec() { return -1; }
+
+    // Appends source specific state to "out" for dumpsys, may be called
+    // from any thread.
+    virtual void dump(AString * /* out */) {}
+
     virtual status_t getDuration(int64_t * /* durationUs */) {
         return INVALID_OPERATION;
     }
@@ -96,14 +96,52 @@ ssize_t AmNuPlayer::NuPlayerStreamListener::read(
         void *data, size_t size, sp<AMessage> *extra) {
     CHECK_GT(size, 0u);
 
-    extra->clear();
+    Mutex::Autolock autoLock(mLock);
+
+    const void *ptr;
+    ssize_t n = peek_l(&ptr, extra);
+    if (n <= 0 || n == INFO_DISCONTINUITY) {
+        return n;
+    }
+
+    size_t copy = n;
+    if (copy > size) {
+        copy = size;
+    }
+
+    memcpy(data, ptr, copy);
+    consume_l(copy);
+
+    return copy;
+}
+
+ssize_t AmNuPlayer::NuPlayerStreamListener::peek(
+        const void **data, sp<AMessage> *extra) {
+    Mutex::Autolock autoLock(mLock);
+    return peek_l(data, extra);
+}
 
+void AmNuPlayer::NuPlayerStreamListener::consume(size_t size) {
     Mutex::Autolock autoLock(mLock);
+    consume_l(size);
+}
+
+ssize_t AmNuPlayer::NuPlayerStreamListener::peek_l(
+        const void **data, sp<AMessage> *extra) {
+    *data = NULL;
+    extra->clear();
 
     if (mEOS) {
         return 0;
     }
 
+    // Return empty buffers right away, 0 would read as EOS.
+    while (!mQueue.empty()
+            && !mQueue.begin()->mIsCommand && mQueue.begin()->mSize == 0) {
+        mSource->onBufferAvailable(mQueue.begin()->mIndex);
+        mQueue.erase(mQueue.begin());
+    }
+
     if (mQueue.empty()) {
         mSendDataNotification = true;
 
@@ -139,26 +177,29 @@ ssize_t AmNuPlayer::NuPlayerStreamListener::read(
         }
     }
 
-    size_t copy = entry->mSize;
-    if (copy > size) {
-        copy = size;
-    }
+    // The source does not touch a queued buffer before we hand it back
+    // through onBufferAvailable().
+    *data = (const uint8_t *)mBuffers.editItemAt(entry->mIndex)->pointer()
+            + entry->mOffset;
+
+    return entry->mSize;
+}
 
-    memcpy(data,
-           (const uint8_t *)mBuffers.editItemAt(entry->mIndex)->pointer()
-            + entry->mOffset,
-           copy);
+void AmNuPlayer::NuPlayerStreamListener::consume_l(size_t size) {
+    CHECK(!mQueue.empty());
 
-    entry->mOffset += copy;
-    entry->mSize -= copy;
+    QueueEntry *entry = &*mQueue.begin();
+    CHECK(!entry->mIsCommand);
+    CHECK_LE(size, entry->mSize);
+
+    entry->mOffset += size;
+    entry->mSize -= size;
 
     if (entry->mSize == 0) {
         mSource->onBufferAvailable(entry->mIndex);
         mQueue.erase(mQueue.begin());
         entry = NULL;
     }
-
-    return copy;
 }
 
 }  // namespace android
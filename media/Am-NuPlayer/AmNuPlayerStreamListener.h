@@ -39,10 +39,17 @@ struct AmNuPlayer::NuPlayerStreamListener : public BnStreamListener {
     void start();
     ssize_t read(void *data, size_t size, sp<AMessage> *extra);
 
+    // Like read(), but returns the unread part of the next queued buffer
+    // in place instead of copying it out. The data is not consumed, it
+    // stays valid and unchanged until consume() returns the buffer to
+    // the source. Commands are returned and consumed just like read().
+    ssize_t peek(const void **data, sp<AMessage> *extra);
+    void consume(size_t size);
+
 private:
     enum {
         kNumBuffers = 8,
-        kBufferSize = 188 * 10
+        kBufferSize = 188 * 64
     };
 
     struct QueueEntry {
@@ -66,6 +73,9 @@ private:
     bool mEOS;
     bool mSendDataNotification;
 
+    ssize_t peek_l(const void **data, sp<AMessage> *extra);
+    void consume_l(size_t size);
+
     DISALLOW_EVIL_CONSTRUCTORS(NuPlayerStreamListener);
 };
 
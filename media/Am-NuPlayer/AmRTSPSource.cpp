@@ -393,17 +393,9 @@ void AmNuPlayer::RTSPSource::onMessageReceived(const sp<AMessage> &msg) {
             }
 
             if (mTSParser != NULL) {
-                size_t offset = 0;
-                status_t err = OK;
-                while (offset + 188 <= accessUnit->size()) {
-                    err = mTSParser->feedTSPacket(
-                            accessUnit->data() + offset, 188);
-                    if (err != OK) {
-                        break;
-                    }
-
-                    offset += 188;
-                }
+                size_t offset;
+                status_t err = mTSParser->feedTSPackets(
+                        accessUnit->data(), accessUnit->size(), &offset);
 
                 if (offset < accessUnit->size()) {
                     err = ERROR_MALFORMED;
@@ -32,13 +32,20 @@
 
 namespace android {
 
+// Parse at least ~50 packets per kWhatReadBuffer, as many as 1024 at high
+// input rates.
+static const size_t kMinReadBudgetBytes = 188 * 50;
+static const size_t kMaxReadBudgetBytes = 188 * 1024;
+
 AmNuPlayer::StreamingSource::StreamingSource(
         const sp<AMessage> &notify,
         const sp<IStreamSource> &source)
     : Source(notify),
       mSource(source),
       mFinalResult(OK),
-      mBuffering(false) {
+      mBuffering(false),
+      mReadBudgetBytes(kMinReadBudgetBytes),
+      mPartialPacketSize(0) {
 }
 
 AmNuPlayer::StreamingSource::~StreamingSource() {
@@ -84,10 +91,15 @@ status_t AmNuPlayer::StreamingSource::feedMoreTSData() {
 }
 
 void AmNuPlayer::StreamingSource::onReadBuffer() {
-    for (int32_t i = 0; i < 50; ++i) {
-        char buffer[188];
+    // Client buffers are parsed in place, only a TS packet that straddles
+    // two of them is copied.
+    size_t numBytesRead = 0;
+    bool drained = false;
+
+    while (numBytesRead < mReadBudgetBytes) {
+        const void *data;
         sp<AMessage> extra;
-        ssize_t n = mStreamListener->read(buffer, sizeof(buffer), &extra);
+        ssize_t n = mStreamListener->peek(&data, &extra);
 
         if (n == 0) {
             ALOGI("input data EOS reached.");
@@ -95,6 +107,12 @@ void AmNuPlayer::StreamingSource::onReadBuffer() {
             setError(ERROR_END_OF_STREAM);
             break;
         } else if (n == INFO_DISCONTINUITY) {
+            if (mPartialPacketSize > 0) {
+                ALOGW("dropping %zu bytes of an incomplete TS packet",
+                      mPartialPacketSize);
+                mPartialPacketSize = 0;
+            }
+
             int32_t type = AmATSParser::DISCONTINUITY_TIME;
 
             int32_t mask;
@@ -113,42 +131,126 @@ void AmNuPlayer::StreamingSource::onReadBuffer() {
             mTSParser->signalDiscontinuity(
                     (AmATSParser::DiscontinuityType)type, extra);
         } else if (n < 0) {
+            drained = true;
             break;
         } else {
-            if (buffer[0] == 0x00) {
-                // XXX legacy
+            status_t err = feedData((const uint8_t *)data, n);
+            mStreamListener->consume(n);
+            numBytesRead += n;
 
-                if (extra == NULL) {
-                    extra = new AMessage;
-                }
+            if (err != OK) {
+                ALOGE("TS Parser returned error %d", err);
 
-                uint8_t type = buffer[1];
+                mTSParser->signalEOS(err);
+                setError(err);
+                break;
+            }
+        }
+    }
+
+    // Running out of budget with data still queued means the input is
+    // faster than we are, while draining a small amount means we could
+    // hand control back sooner.
+    if (!drained && numBytesRead >= mReadBudgetBytes) {
+        if (mReadBudgetBytes < kMaxReadBudgetBytes) {
+            mReadBudgetBytes *= 2;
+            if (mReadBudgetBytes > kMaxReadBudgetBytes) {
+                mReadBudgetBytes = kMaxReadBudgetBytes;
+            }
+            ALOGV("read budget raised to %zu bytes", mReadBudgetBytes);
+        }
+    } else if (drained && numBytesRead < mReadBudgetBytes / 4) {
+        if (mReadBudgetBytes > kMinReadBudgetBytes) {
+            mReadBudgetBytes /= 2;
+            if (mReadBudgetBytes < kMinReadBudgetBytes) {
+                mReadBudgetBytes = kMinReadBudgetBytes;
+            }
+            ALOGV("read budget lowered to %zu bytes", mReadBudgetBytes);
+        }
+    }
+}
 
-                if (type & 2) {
-                    int64_t mediaTimeUs;
-                    memcpy(&mediaTimeUs, &buffer[2], sizeof(mediaTimeUs));
+status_t AmNuPlayer::StreamingSource::feedData(
+        const uint8_t *data, size_t size) {
+    size_t offset = 0;
 
-                    extra->setInt64(IStreamListener::kKeyMediaTimeUs, mediaTimeUs);
-                }
+    if (mPartialPacketSize > 0) {
+        size_t copy = kTSPacketSize - mPartialPacketSize;
+        if (copy > size) {
+            copy = size;
+        }
 
-                mTSParser->signalDiscontinuity(
-                        ((type & 1) == 0)
-                            ? AmATSParser::DISCONTINUITY_TIME
-                            : AmATSParser::DISCONTINUITY_FORMATCHANGE,
-                        extra);
-            } else {
-                status_t err = mTSParser->feedTSPacket(buffer, sizeof(buffer));
+        memcpy(&mPartialPacket[mPartialPacketSize], data, copy);
+        mPartialPacketSize += copy;
+        offset += copy;
 
-                if (err != OK) {
-                    ALOGE("TS Parser returned error %d", err);
+        if (mPartialPacketSize < kTSPacketSize) {
+            return OK;
+        }
 
-                    mTSParser->signalEOS(err);
-                    setError(err);
-                    break;
-                }
-            }
+        mPartialPacketSize = 0;
+
+        status_t err = feedPackets(mPartialPacket, kTSPacketSize);
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    size_t wholeSize = (size - offset) / kTSPacketSize * kTSPacketSize;
+    status_t err = feedPackets(&data[offset], wholeSize);
+    if (err != OK) {
+        return err;
+    }
+    offset += wholeSize;
+
+    // The client buffer goes back to the source, keep the rest.
+    memcpy(mPartialPacket, &data[offset], size - offset);
+    mPartialPacketSize = size - offset;
+
+    return OK;
+}
+
+status_t AmNuPlayer::StreamingSource::feedPackets(
+        const uint8_t *data, size_t size) {
+    // Hand runs of regular packets to the parser in one go.
+    size_t start = 0;
+    for (size_t offset = 0; offset < size; offset += kTSPacketSize) {
+        if (data[offset] != 0x00) {
+            continue;
+        }
+
+        status_t err = mTSParser->feedTSPackets(&data[start], offset - start);
+        if (err != OK) {
+            return err;
         }
+
+        signalLegacyDiscontinuity(&data[offset]);
+        start = offset + kTSPacketSize;
     }
+
+    return mTSParser->feedTSPackets(&data[start], size - start);
+}
+
+void AmNuPlayer::StreamingSource::signalLegacyDiscontinuity(
+        const uint8_t *packet) {
+    // XXX legacy
+
+    sp<AMessage> extra = new AMessage;
+
+    uint8_t type = packet[1];
+
+    if (type & 2) {
+        int64_t mediaTimeUs;
+        memcpy(&mediaTimeUs, &packet[2], sizeof(mediaTimeUs));
+
+        extra->setInt64(IStreamListener::kKeyMediaTimeUs, mediaTimeUs);
+    }
+
+    mTSParser->signalDiscontinuity(
+            ((type & 1) == 0)
+                ? AmATSParser::DISCONTINUITY_TIME
+                : AmATSParser::DISCONTINUITY_FORMATCHANGE,
+            extra);
 }
 
 status_t AmNuPlayer::StreamingSource::postReadBuffer() {
@@ -52,6 +52,11 @@ private:
     enum {
         kWhatReadBuffer,
     };
+
+    enum {
+        kTSPacketSize = 188,
+    };
+
     sp<IStreamSource> mSource;
     status_t mFinalResult;
     sp<NuPlayerStreamListener> mStreamListener;
@@ -61,11 +66,21 @@ private:
     Mutex mBufferingLock;
     sp<ALooper> mLooper;
 
+    // How much data one kWhatReadBuffer may parse, follows the input rate.
+    size_t mReadBudgetBytes;
+
+    // Start of a TS packet split across two client buffers.
+    uint8_t mPartialPacket[kTSPacketSize];
+    size_t mPartialPacketSize;
+
     void setError(status_t err);
     sp<AmAnotherPacketSource> getSource(bool audio);
     bool haveSufficientDataOnAllTracks();
     status_t postReadBuffer();
     void onReadBuffer();
+    status_t feedData(const uint8_t *data, size_t size);
+    status_t feedPackets(const uint8_t *data, size_t size);
+    void signalLegacyDiscontinuity(const uint8_t *packet);
 
     DISALLOW_EVIL_CONSTRUCTORS(StreamingSource);
 };
@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "NU-VideoFrameScheduler"
+#include <utils/Log.h>
+
+#include "AmVideoFrameScheduler.h"
+
+#include <binder/IServiceManager.h>
+#include <gui/ISurfaceComposer.h>
+#include <ui/DisplayStatInfo.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/Mutex.h>
+
+#include <inttypes.h>
+#include <math.h>
+
+namespace android {
+
+// How often the vsync source is asked again.
+static const int64_t kVsyncRefreshUs = 1000000ll;
+
+// Weight of a new vsync period measurement.
+static const double kVsyncPeriodWeight = 0.1;
+
+// Media time gaps above this start a new timeline.
+static const int64_t kMaxFrameGapUs = 250000ll;
+
+// Fraction of the distance to the requested render time the timeline
+// moves per frame. Small enough not to disturb the cadence.
+static const double kDriftCorrection = 1.0 / 16;
+
+// Asks SurfaceFlinger for its display stats on a looper of its own, a
+// binder call has no place on the Renderer's. getVsync() returns what the
+// last query got and starts another one.
+struct SurfaceFlingerVsyncSource : public AmVideoFrameScheduler::VsyncSource {
+    SurfaceFlingerVsyncSource()
+        : mVsyncTimeUs(-1),
+          mPeriodUs(-1),
+          mQueryPending(false) {
+        mLooper = new ALooper;
+        mLooper->setName("VsyncSource");
+        mLooper->start();
+
+        mQuerier = new Querier(this);
+        mLooper->registerHandler(mQuerier);
+    }
+
+    virtual status_t getVsync(int64_t *vsyncTimeUs, int64_t *periodUs) {
+        Mutex::Autolock autoLock(mLock);
+
+        if (!mQueryPending) {
+            mQueryPending = true;
+            (new AMessage(kWhatQuery, mQuerier))->post();
+        }
+
+        if (mPeriodUs <= 0) {
+            return NO_INIT;
+        }
+
+        *vsyncTimeUs = mVsyncTimeUs;
+        *periodUs = mPeriodUs;
+        return OK;
+    }
+
+protected:
+    virtual ~SurfaceFlingerVsyncSource() {
+        // Waits for a query in progress.
+        mLooper->stop();
+        mLooper->unregisterHandler(mQuerier->id());
+    }
+
+private:
+    enum {
+        kWhatQuery,
+    };
+
+    struct Querier : public AHandler {
+        Querier(SurfaceFlingerVsyncSource *source)
+            : mSource(source) {
+        }
+
+    protected:
+        virtual void onMessageReceived(const sp<AMessage> &msg) {
+            CHECK_EQ(msg->what(), (uint32_t)kWhatQuery);
+            mSource->query();
+        }
+
+    private:
+        SurfaceFlingerVsyncSource *mSource;
+
+        DISALLOW_EVIL_CONSTRUCTORS(Querier);
+    };
+
+    Mutex mLock;
+    int64_t mVsyncTimeUs;
+    int64_t mPeriodUs;
+    bool mQueryPending;
+
+    sp<ALooper> mLooper;
+    sp<Querier> mQuerier;
+
+    // Only used on mLooper.
+    sp<ISurfaceComposer> mComposer;
+
+    void query() {
+        DisplayStatInfo stats;
+        status_t err = NO_INIT;
+
+        if (mComposer == NULL) {
+            sp<IBinder> binder = defaultServiceManager()->checkService(
+                    String16("SurfaceFlinger"));
+            if (binder != NULL) {
+                mComposer = interface_cast<ISurfaceComposer>(binder);
+            }
+        }
+
+        if (mComposer != NULL) {
+            err = mComposer->getDisplayStats(NULL /* display */, &stats);
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        mQueryPending = false;
+
+        if (err == OK) {
+            // Both are in nanoseconds on the monotonic clock.
+            mVsyncTimeUs = stats.vsyncTime / 1000;
+            mPeriodUs = stats.vsyncPeriod / 1000;
+        }
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(SurfaceFlingerVsyncSource);
+};
+
+AmVideoFrameScheduler::AmVideoFrameScheduler(const sp<VsyncSource> &source)
+    : mSource(source),
+      mVsyncPeriodUs(-1.0),
+      mVsyncTimeUs(-1),
+      mLastVsyncUpdateUs(-1),
+      mLastMediaTimeUs(-1),
+      mFramePeriodUs(-1.0),
+      mLocked(false),
+      mTargetUs(0.0),
+      mLastVsyncIndex(0),
+      mNumRelocks(0),
+      mNumDropped(0) {
+    if (mSource == NULL) {
+        mSource = new SurfaceFlingerVsyncSource;
+    }
+
+    memset(mCadence, 0, sizeof(mCadence));
+    memset(mLateness, 0, sizeof(mLateness));
+}
+
+AmVideoFrameScheduler::~AmVideoFrameScheduler() {
+}
+
+void AmVideoFrameScheduler::restart() {
+    // The refresh period stays, updateVsync() keeps sampling it on its
+    // own schedule and notices mode changes there.
+    mLastMediaTimeUs = -1;
+    mFramePeriodUs = -1.0;
+    mLocked = false;
+}
+
+int64_t AmVideoFrameScheduler::getVsyncPeriodUs() const {
+    return mVsyncPeriodUs > 0 ? (int64_t)(mVsyncPeriodUs + 0.5) : -1;
+}
+
+void AmVideoFrameScheduler::updateVsync(int64_t nowUs) {
+    if (mLastVsyncUpdateUs >= 0 && nowUs - mLastVsyncUpdateUs < kVsyncRefreshUs
+            && nowUs >= mLastVsyncUpdateUs) {
+        return;
+    }
+
+    // Until the source has something, ask again with the next frame.
+    int64_t vsyncTimeUs, periodUs;
+    if (mSource->getVsync(&vsyncTimeUs, &periodUs) != OK || periodUs <= 0) {
+        return;
+    }
+    mLastVsyncUpdateUs = nowUs;
+
+    // The nominal period is rounded and may be slightly off, measure it
+    // over the vsyncs that passed since the previous sample instead.
+    if (mVsyncPeriodUs > 0 && fabs(periodUs - mVsyncPeriodUs) < periodUs / 10.0) {
+        int64_t deltaUs = vsyncTimeUs - mVsyncTimeUs;
+        int64_t numVsyncs = (int64_t)floor(deltaUs / mVsyncPeriodUs + 0.5);
+        if (numVsyncs > 0) {
+            double measuredUs = (double)deltaUs / numVsyncs;
+            if (fabs(measuredUs - periodUs) < periodUs / 10.0) {
+                mVsyncPeriodUs += (measuredUs - mVsyncPeriodUs) * kVsyncPeriodWeight;
+            }
+        }
+    } else {
+        ALOGV("refresh period %" PRId64 " us", periodUs);
+        mVsyncPeriodUs = periodUs;
+        mLocked = false;
+    }
+
+    if (mLocked) {
+        // Keep the vsync the last frame went to at the same index.
+        mLastVsyncIndex -= (int64_t)floor(
+                (vsyncTimeUs - mVsyncTimeUs) / mVsyncPeriodUs + 0.5);
+    }
+    mVsyncTimeUs = vsyncTimeUs;
+}
+
+void AmVideoFrameScheduler::updateFramePeriod(int64_t mediaTimeUs) {
+    int64_t deltaUs = mediaTimeUs - mLastMediaTimeUs;
+    if (mLastMediaTimeUs < 0 || deltaUs <= 0 || deltaUs > kMaxFrameGapUs) {
+        return;
+    }
+
+    // Dropped frames show up as multiples, do not let them skew this.
+    if (mFramePeriodUs < 0 || deltaUs < mFramePeriodUs * 1.5) {
+        mFramePeriodUs = mFramePeriodUs < 0
+                ? deltaUs : mFramePeriodUs + (deltaUs - mFramePeriodUs) / 8;
+    }
+}
+
+int64_t AmVideoFrameScheduler::schedule(
+        int64_t mediaTimeUs, int64_t realTimeUs, bool *drop) {
+    if (drop != NULL) {
+        *drop = false;
+    }
+
+    updateVsync(realTimeUs);
+    updateFramePeriod(mediaTimeUs);
+
+    int64_t deltaUs = mediaTimeUs - mLastMediaTimeUs;
+    bool consecutive = mLastMediaTimeUs >= 0 && deltaUs > 0 && deltaUs <= kMaxFrameGapUs;
+    mLastMediaTimeUs = mediaTimeUs;
+
+    if (mVsyncPeriodUs <= 0) {
+        return realTimeUs;
+    }
+
+    if (mLocked && consecutive) {
+        // Advance by the media time and only nudge the timeline towards
+        // the clock, so the vsync pattern follows the frame rate.
+        mTargetUs += deltaUs;
+        double errorUs = realTimeUs - mTargetUs;
+        if (fabs(errorUs) > mVsyncPeriodUs) {
+            ALOGV("timeline off by %.0f us, relocking", errorUs);
+            mLocked = false;
+            ++mNumRelocks;
+        } else {
+            mTargetUs += errorUs * kDriftCorrection;
+        }
+    } else {
+        mLocked = false;
+    }
+
+    if (!mLocked) {
+        mTargetUs = realTimeUs;
+    }
+
+    int64_t index = (int64_t)floor((mTargetUs - mVsyncTimeUs) / mVsyncPeriodUs + 0.5);
+
+    if (mLocked) {
+        int64_t step = index - mLastVsyncIndex;
+        if (step <= 0) {
+            // Never two frames for the same vsync. Jitter at a cadence edge
+            // may take the next one, as long as that stays within a
+            // refresh of the timeline. Past that the frames come faster
+            // than the display refreshes and this one has to go.
+            index = mLastVsyncIndex + 1;
+            step = 1;
+
+            if (mVsyncTimeUs + index * mVsyncPeriodUs - mTargetUs > mVsyncPeriodUs) {
+                ++mNumDropped;
+                if (drop != NULL) {
+                    *drop = true;
+                }
+                return vsyncRenderTimeUs(mLastVsyncIndex);
+            }
+        }
+        ++mCadence[step < kNumCadenceBuckets ? step - 1 : kNumCadenceBuckets - 1];
+    }
+
+    mLocked = true;
+    mLastVsyncIndex = index;
+
+    return vsyncRenderTimeUs(index);
+}
+
+int64_t AmVideoFrameScheduler::vsyncRenderTimeUs(int64_t index) const {
+    // Aim for the middle of the previous refresh, so that small delays
+    // on the way to the display do not push the frame out by a vsync.
+    int64_t vsyncUs = mVsyncTimeUs + (int64_t)(index * mVsyncPeriodUs + 0.5);
+    return vsyncUs - (int64_t)(mVsyncPeriodUs / 2);
+}
+
+void AmVideoFrameScheduler::onFrameRendered(int64_t lateByUs) {
+    if (mVsyncPeriodUs <= 0) {
+        return;
+    }
+
+    int64_t periods = (int64_t)floor(lateByUs / mVsyncPeriodUs);
+    int64_t half = kNumLatenessBuckets / 2;
+    if (periods < -half) {
+        periods = -half;
+    } else if (periods > half) {
+        periods = half;
+    }
+    ++mLateness[periods + half];
+}
+
+void AmVideoFrameScheduler::dump(AString *out) const {
+    out->append(AStringPrintf(
+            "VideoFrameScheduler: refresh %.1f us, frame period %.1f us, "
+            "%" PRIu64 " relocks, %" PRIu64 " dropped\n",
+            mVsyncPeriodUs, mFramePeriodUs, mNumRelocks, mNumDropped));
+
+    out->append(AStringPrintf(
+            "  refreshes per frame 1:%" PRIu64 " 2:%" PRIu64
+            " 3:%" PRIu64 " 4+:%" PRIu64 "\n",
+            mCadence[0], mCadence[1], mCadence[2], mCadence[3]));
+
+    out->append("  lateness in refreshes");
+    int32_t half = kNumLatenessBuckets / 2;
+    for (int32_t i = 0; i < kNumLatenessBuckets; ++i) {
+        out->append(AStringPrintf(
+                " %s%d:%" PRIu64,
+                (i == 0) ? "<=" : ((i == kNumLatenessBuckets - 1) ? ">=" : ""),
+                i - half, mLateness[i]));
+    }
+    out->append("\n");
+}
+
+}  // namespace android
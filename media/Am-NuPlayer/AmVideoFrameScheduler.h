@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+#ifndef AM_VIDEO_FRAME_SCHEDULER_H_
+
+#define AM_VIDEO_FRAME_SCHEDULER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+struct AString;
+
+// Snaps video render times of the Renderer onto display refreshes.
+//
+// Consecutive frames are placed on a vsync timeline advanced by their
+// media time deltas, so a frame rate that does not divide the refresh
+// rate comes out in a steady cadence (3:2 for 24p on 60 Hz, 2:2 for
+// 30p on 60 Hz) instead of jittering between neighbouring vsyncs. The
+// timeline is pulled slowly towards the requested render times to
+// follow clock drift and is reset when it is more than a refresh off.
+// Frames that come faster than the display refreshes are dropped rather
+// than pushed onto later vsyncs, which would leave the timeline behind.
+//
+// The refresh period is learned from the vsync timestamps the
+// VsyncSource reports over time. All times are in the ALooper::GetNowUs()
+// time base and the scheduler never reads the clock itself, so it can be
+// driven offline with a synthetic VsyncSource.
+struct AmVideoFrameScheduler : public RefBase {
+    struct VsyncSource : public RefBase {
+        // Returns the time of a recent vsync and the nominal refresh period.
+        // Called from the Renderer's looper, so it must not block.
+        virtual status_t getVsync(int64_t *vsyncTimeUs, int64_t *periodUs) = 0;
+
+    protected:
+        virtual ~VsyncSource() {}
+    };
+
+    // Without a source, SurfaceFlinger's display stats are used.
+    AmVideoFrameScheduler(const sp<VsyncSource> &source = NULL);
+
+    // Forgets the timeline, e.g. after a flush or seek.
+    void restart();
+
+    // Returns when to render the frame with "mediaTimeUs" that is due at
+    // "realTimeUs". Without vsync information "realTimeUs" is returned.
+    // "drop" (if not NULL) is set if the frame would land on a vsync taken
+    // by the previous one and should not be rendered.
+    int64_t schedule(int64_t mediaTimeUs, int64_t realTimeUs, bool *drop = NULL);
+
+    // Returns the learned refresh period, or -1 if unknown.
+    int64_t getVsyncPeriodUs() const;
+
+    // Records how late (or early, if negative) a frame was handed to the
+    // display compared to its scheduled render time.
+    void onFrameRendered(int64_t lateByUs);
+
+    // Appends the refresh period, the detected cadence and a histogram
+    // of the frame lateness in refresh periods to "out".
+    void dump(AString *out) const;
+
+protected:
+    virtual ~AmVideoFrameScheduler();
+
+private:
+    enum {
+        // Buckets of -4 and less, -3 .. 3 and 4 and more refresh periods.
+        kNumLatenessBuckets = 9,
+        // Frames shown for 1, 2, 3 and 4 or more refreshes.
+        kNumCadenceBuckets = 4,
+    };
+
+    sp<VsyncSource> mSource;
+
+    double mVsyncPeriodUs;
+    int64_t mVsyncTimeUs;
+    int64_t mLastVsyncUpdateUs;
+
+    int64_t mLastMediaTimeUs;
+    double mFramePeriodUs;
+
+    // The ideal render time of the last frame on the frame timeline and
+    // the vsync it was snapped to. Only valid if mLocked.
+    bool mLocked;
+    double mTargetUs;
+    int64_t mLastVsyncIndex;
+
+    uint64_t mNumRelocks;
+    uint64_t mNumDropped;
+    uint64_t mCadence[kNumCadenceBuckets];
+    uint64_t mLateness[kNumLatenessBuckets];
+
+    void updateVsync(int64_t nowUs);
+    void updateFramePeriod(int64_t mediaTimeUs);
+    int64_t vsyncRenderTimeUs(int64_t index) const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(AmVideoFrameScheduler);
+};
+
+}  // namespace android
+
+#endif  // AM_VIDEO_FRAME_SCHEDULER_H_
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2015, Amlogic Inc.
+ * All rights reserved
+ */
+
+// Drives AmVideoFrameScheduler with a synthetic vsync clock and frame
+// stream: common frame rate and refresh rate pairs, with jitter on the
+// due times and a skew between the media and the display clock. Prints
+// the refreshes per frame pattern and the dump for each, and fails if a
+// frame lands more than a refresh and a half from its due time or the
+// number of dropped frames is off.
+//
+// usage: amvideoschedulersim [-v]
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AmVideoFrameSchedulerSim"
+#include <utils/Log.h>
+
+#include "AmVideoFrameScheduler.h"
+
+#include <media/stagefright/foundation/AString.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace android {
+
+struct SyntheticVsyncSource : public AmVideoFrameScheduler::VsyncSource {
+    SyntheticVsyncSource(double periodUs)
+        : mPeriodUs(periodUs),
+          mNowUs(0) {
+    }
+
+    virtual status_t getVsync(int64_t *vsyncTimeUs, int64_t *periodUs) {
+        // The nominal period is rounded like SurfaceFlinger's, the vsync
+        // times are exact.
+        *vsyncTimeUs = (int64_t)(floor(mNowUs / mPeriodUs) * mPeriodUs);
+        *periodUs = (int64_t)(mPeriodUs + 0.5);
+        return OK;
+    }
+
+    double mPeriodUs;
+    int64_t mNowUs;
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(SyntheticVsyncSource);
+};
+
+struct Case {
+    double mRefreshHz;
+    double mFps;
+    double mJitterUs;
+    double mSkew;
+    // Expected fraction of frames dropped.
+    double mDropRate;
+};
+
+static const Case kCases[] = {
+    { 60.0,   24.0,    3000.0, 1.0,    0.0 },
+    { 60.0,   23.976,  2000.0, 1.0,    0.0 },
+    { 60.0,   30.0,    3000.0, 1.0,    0.0 },
+    { 50.0,   25.0,    3000.0, 1.0,    0.0 },
+    { 60.0,   24.0,    2000.0, 1.0005, 0.0 },
+    { 59.94,  25.0,    2000.0, 1.0,    0.0 },
+    { 50.0,   60.0,    1000.0, 1.0,    1.0 / 6 },
+    { 59.94,  60.0,    1000.0, 1.0,    0.001 },
+};
+
+static const int kNumFrames = 6000;
+
+static bool run(const Case &c, bool verbose) {
+    sp<SyntheticVsyncSource> source = new SyntheticVsyncSource(1E6 / c.mRefreshHz);
+    sp<AmVideoFrameScheduler> scheduler = new AmVideoFrameScheduler(source);
+
+    double framePeriodUs = 1E6 / c.mFps;
+    int64_t lastIndex = -1;
+    int numDropped = 0;
+    double maxOffUs = 0.0;
+    AString pattern;
+
+    for (int i = 0; i < kNumFrames; ++i) {
+        int64_t mediaTimeUs = (int64_t)(i * framePeriodUs);
+        double jitterUs = ((rand() % 2001) - 1000) / 1000.0 * c.mJitterUs;
+        int64_t realTimeUs =
+            (int64_t)(1000000 + i * framePeriodUs * c.mSkew + jitterUs);
+
+        // The Renderer schedules a frame a little ahead of time.
+        source->mNowUs = realTimeUs - 50000;
+
+        bool drop;
+        int64_t renderTimeUs = scheduler->schedule(mediaTimeUs, realTimeUs, &drop);
+        if (drop) {
+            ++numDropped;
+            continue;
+        }
+
+        // Render times are half a refresh before the vsync they aim for.
+        double vsyncUs = renderTimeUs + source->mPeriodUs / 2;
+        int64_t index = (int64_t)floor(vsyncUs / source->mPeriodUs + 0.5);
+
+        // Past the first second, once the period has been measured.
+        if (mediaTimeUs >= 1000000) {
+            double offUs = fabs(vsyncUs - realTimeUs);
+            if (offUs > maxOffUs) {
+                maxOffUs = offUs;
+            }
+        }
+
+        if (i >= kNumFrames - 24 && lastIndex >= 0) {
+            pattern.append((int)(index - lastIndex));
+        }
+        lastIndex = index;
+
+        scheduler->onFrameRendered(vsyncUs - source->mPeriodUs / 2 - realTimeUs);
+    }
+
+    double dropRate = numDropped / (double)kNumFrames;
+    bool ok = maxOffUs <= source->mPeriodUs * 1.5
+            && fabs(dropRate - c.mDropRate) < 0.01;
+
+    printf("%s %6.3f Hz %6.3f fps, jitter %4.0f us, skew %.4f: "
+           "pattern %s, %.1f%% dropped, max %.0f us off\n",
+           ok ? "ok  " : "FAIL", c.mRefreshHz, c.mFps, c.mJitterUs, c.mSkew,
+           pattern.c_str(), dropRate * 100.0, maxOffUs);
+
+    if (verbose) {
+        AString out;
+        scheduler->dump(&out);
+        printf("%s", out.c_str());
+    }
+
+    return ok;
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-v]\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+    bool verbose = false;
+
+    int res;
+    while ((res = getopt(argc, argv, "vh")) >= 0) {
+        switch (res) {
+            case 'v':
+                verbose = true;
+                break;
+            case 'h':
+            default:
+                usage(me);
+        }
+    }
+
+    srand(1);
+
+    int result = 0;
+    for (size_t i = 0; i < NELEM(kCases); ++i) {
+        if (!run(kCases[i], verbose)) {
+            result = 1;
+        }
+    }
+
+    return result;
+}
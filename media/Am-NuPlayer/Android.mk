@@ -14,10 +14,12 @@ LOCAL_SRC_FILES:=                       \
         AmNuPlayerStreamListener.cpp      \
         AmRTSPSource.cpp                  \
         AmStreamingSource.cpp             \
+        AmVideoFrameScheduler.cpp         \
 
 LOCAL_C_INCLUDES := \
 	$(TOP)/vendor/amlogic/frameworks/av/media/Am-NuPlayer/Am-Httplive \
     $(TOP)/vendor/amlogic/frameworks/av/media/Am-NuPlayer/Am-mpeg2ts \
+    $(TOP)/vendor/amlogic/frameworks/av/AmFFmpegAdapter/include \
 	$(TOP)/frameworks/av/media/libstagefright/include             \
 	$(TOP)/frameworks/av/media/libstagefright/rtsp                \
 	$(TOP)/frameworks/av/media/libstagefright/timedtext           \
@@ -63,4 +65,62 @@ include $(BUILD_SHARED_LIBRARY)
 
 ################################################
 
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=                       \
+        AmVideoFrameSchedulerSim.cpp      \
+        AmVideoFrameScheduler.cpp         \
+
+LOCAL_SHARED_LIBRARIES := \
+        libbinder \
+        libgui \
+        libui \
+        libstagefright_foundation \
+        libutils \
+        liblog
+
+LOCAL_MODULE:= amvideoschedulersim
+
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
+
+################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=                       \
+        AmGenericSourceBench.cpp          \
+
+LOCAL_C_INCLUDES := \
+	$(TOP)/vendor/amlogic/frameworks/av/media/Am-NuPlayer/Am-Httplive \
+    $(TOP)/vendor/amlogic/frameworks/av/media/Am-NuPlayer/Am-mpeg2ts \
+    $(TOP)/vendor/amlogic/frameworks/av/AmFFmpegAdapter/include \
+	$(TOP)/frameworks/av/media/libstagefright/include             \
+	$(TOP)/frameworks/av/media/libstagefright/rtsp                \
+	$(TOP)/frameworks/av/media/libstagefright/timedtext           \
+	$(TOP)/frameworks/av/media/libmediaplayerservice              \
+	$(TOP)/frameworks/native/include/media/openmax                \
+    $(TOP)/external/curl/include                                  \
+    $(TOP)/vendor/amlogic/frameworks/av/LibPlayer/third_parts/libcurl-ffmpeg/include \
+    $(TOP)/vendor/amlogic/frameworks/av/LibPlayer/amavutils/include \
+    $(TOP)/vendor/amlogic/frameworks/av/LibPlayer/amffmpeg
+
+LOCAL_SHARED_LIBRARIES := \
+        libamnuplayer \
+        libbinder \
+        libmedia \
+        libstagefright \
+        libstagefright_foundation \
+        libutils \
+        liblog
+
+LOCAL_MODULE:= amgenericsourcebench
+
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
+
+################################################
+
 include $(call all-makefiles-under,$(LOCAL_PATH))